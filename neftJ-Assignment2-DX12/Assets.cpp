@@ -9,6 +9,8 @@ Assets::~Assets()
 {
     // Cleanup maps here
     meshes.clear();
+    meshesByContent.clear();
+    models.clear();
     textures.clear();
     materials.clear();
     rootSignatures.clear();
@@ -31,21 +33,44 @@ void Assets::Initialize(std::string rootAssetPath, Microsoft::WRL::ComPtr<ID3D12
     if (!EndsWith(this->rootAssetPath, "/")) this->rootAssetPath += "/";
 }
 
-std::shared_ptr<Mesh> Assets::GetMesh(std::string name)
+// --------------------------------------------------------
+// Flags only apply when the mesh is actually loaded, so the
+// first request for a mesh decides how it gets created
+// --------------------------------------------------------
+std::shared_ptr<Mesh> Assets::GetMesh(std::string name, unsigned int meshFlags)
 {
     // See if the mesh is already loaded
     auto it = meshes.find(name);
     if (it != meshes.end())
         return it->second;
 
+    // Built-in shapes are generated, so they're always available
+    if (IsProceduralMeshName(name))
+        return LoadProceduralMesh(name, meshFlags);
+
     // If not, load it in
     if (allowOnDemandLoading)
     {
-        std::string filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + ".obj");
+        // Compressed meshes decode faster than the OBJ can be parsed
+        std::string filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + GEOMETRY_CODEC_EXTENSION);
+        if (std::filesystem::exists(filePath))
+        {
+            std::shared_ptr<Mesh> mesh = LoadCompressedMesh(filePath, name, meshFlags);
+            if (mesh) return mesh;
+        }
+
+        // Then glTF, binary or text
+        filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + ".glb");
+        if (std::filesystem::exists(filePath)) return LoadGltf(filePath, name, meshFlags);
+
+        filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + ".gltf");
+        if (std::filesystem::exists(filePath)) return LoadGltf(filePath, name, meshFlags);
+
+        filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + ".obj");
         
         if (std::filesystem::exists(filePath))
         {
-            return LoadMesh(filePath, name);
+            return LoadMesh(filePath, name, meshFlags);
         }
     }
 
@@ -53,6 +78,143 @@ std::shared_ptr<Mesh> Assets::GetMesh(std::string name)
     return 0;
 }
 
+// --------------------------------------------------------
+// Every part of a model file along with its material.  Files
+// without parts of their own (like OBJs) come back as a
+// single part with no material.
+// --------------------------------------------------------
+std::vector<ModelPart> Assets::GetModel(std::string name, unsigned int meshFlags)
+{
+    auto it = models.find(name);
+    if (it != models.end())
+        return it->second;
+
+    std::shared_ptr<Mesh> mesh = GetMesh(name, meshFlags);
+
+    // Loading a glTF fills in the model as well
+    it = models.find(name);
+    if (it != models.end())
+        return it->second;
+
+    std::vector<ModelPart> parts;
+    if (mesh) parts.push_back({ mesh, 0 });
+    return parts;
+}
+
+bool Assets::LoadMeshData(std::string name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+    if (IsProceduralMeshName(name))
+        return ProceduralMesh::Generate(name.substr(strlen(PROCEDURAL_MESH_PREFIX)), verts, indices);
+
+    std::string filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + GEOMETRY_CODEC_EXTENSION);
+    if (std::filesystem::exists(filePath))
+    {
+        std::vector<unsigned char> vertexData;
+        unsigned int vertexCount = 0;
+        unsigned int vertexStride = 0;
+        if (GeometryCodec::ReadMeshFile(filePath, vertexData, vertexCount, vertexStride, indices) &&
+            vertexStride == sizeof(Vertex))
+        {
+            verts.resize(vertexCount);
+            memcpy(verts.data(), vertexData.data(), vertexData.size());
+            return true;
+        }
+    }
+
+    filePath = GetFullPathTo(rootAssetPath + "Models\\" + name + ".obj");
+    return Mesh::LoadOBJ(filePath.c_str(), verts, indices);
+}
+
+std::shared_ptr<Mesh> Assets::CreateMeshFromData(std::string name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int meshFlags)
+{
+    auto it = meshes.find(name);
+    if (it != meshes.end())
+        return it->second;
+
+    if (verts.empty() || indices.empty())
+        return 0;
+
+    // Same as LoadProceduralMesh(), generated tangents are exact
+    if (IsProceduralMeshName(name))
+        meshFlags |= MESH_FLAG_HAS_TANGENTS;
+
+    return CreateMesh(name, verts.data(), (int)verts.size(), indices.data(), (int)indices.size(), meshFlags);
+}
+
+bool Assets::IsMeshLoaded(std::string name)
+{
+    return meshes.find(name) != meshes.end();
+}
+
+bool Assets::IsMaterialLoaded(std::string name)
+{
+    return materials.find(name) != materials.end();
+}
+
+// --------------------------------------------------------
+// Forgets a mesh by name.  The content entry goes too once
+// no other name shares the same mesh, so the last reference
+// held elsewhere is the one that frees it.
+// --------------------------------------------------------
+void Assets::ReleaseMesh(std::string name)
+{
+    auto it = meshes.find(name);
+    if (it == meshes.end())
+        return;
+
+    std::shared_ptr<Mesh> mesh = it->second;
+    meshes.erase(it);
+    models.erase(name);
+
+    for (auto& [otherName, other] : meshes)
+    {
+        if (other == mesh)
+            return;
+    }
+
+    for (auto content = meshesByContent.begin(); content != meshesByContent.end(); content++)
+    {
+        if (content->second == mesh)
+        {
+            meshesByContent.erase(content);
+            break;
+        }
+    }
+}
+
+void Assets::ReleaseMaterial(std::string name)
+{
+    materials.erase(name);
+}
+
+// --------------------------------------------------------
+// Converts an OBJ to the compressed format.  Tangents are
+// left out (zeroed) since they're rebuilt on load anyway.
+// --------------------------------------------------------
+bool Assets::CompressMesh(std::string name)
+{
+    std::vector<Vertex> verts;
+    std::vector<unsigned int> indices;
+    std::string objPath = GetFullPathTo(rootAssetPath + "Models\\" + name + ".obj");
+    if (!Mesh::LoadOBJ(objPath.c_str(), verts, indices) || verts.empty())
+        return false;
+
+    for (auto& v : verts)
+        v.Tangent = DirectX::XMFLOAT3(0, 0, 0);
+
+    std::string outPath = GetFullPathTo(rootAssetPath + "Models\\" + name + GEOMETRY_CODEC_EXTENSION);
+    bool success = GeometryCodec::WriteMeshFile(outPath, verts.data(), (unsigned int)verts.size(), sizeof(Vertex), indices.data(), (unsigned int)indices.size());
+
+    if (success && printLoadingProgress)
+    {
+        size_t rawSize = verts.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+        size_t compressedSize = (size_t)std::filesystem::file_size(outPath);
+        printf("Compressed %s: %zu -> %zu bytes (%.2fx)\n", name.c_str(), rawSize, compressedSize, (double)rawSize / compressedSize);
+    }
+
+    return success;
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE Assets::GetTexture(std::string name)
 {
     auto it = textures.find(name);
@@ -319,13 +481,273 @@ void Assets::ReloadAllRTVs()
     rtvReloadKeys.clear();
 }
 
-std::shared_ptr<Mesh> Assets::LoadMesh(std::string path, std::string name)
+std::shared_ptr<Mesh> Assets::LoadMesh(std::string path, std::string name, unsigned int meshFlags)
+{
+    // Parse first so the content can be checked against what's already loaded
+    std::vector<Vertex> verts;
+    std::vector<unsigned int> indices;
+    if (!Mesh::LoadOBJ(path.c_str(), verts, indices) || verts.empty())
+        return 0;
+
+    return CreateMesh(name, verts.data(), (int)verts.size(), indices.data(), (int)indices.size(), meshFlags);
+}
+
+std::shared_ptr<Mesh> Assets::LoadProceduralMesh(std::string name, unsigned int meshFlags)
+{
+    std::vector<Vertex> verts;
+    std::vector<unsigned int> indices;
+    if (!ProceduralMesh::Generate(name.substr(strlen(PROCEDURAL_MESH_PREFIX)), verts, indices))
+    {
+        if (printLoadingProgress) printf("Unknown built-in mesh %s\n", name.c_str());
+        return 0;
+    }
+
+    // Generated tangents are exact, no need to estimate them from the UVs
+    return CreateMesh(name, verts.data(), (int)verts.size(), indices.data(), (int)indices.size(), meshFlags | MESH_FLAG_HAS_TANGENTS);
+}
+
+std::shared_ptr<Mesh> Assets::LoadCompressedMesh(std::string path, std::string name, unsigned int meshFlags)
+{
+    std::vector<unsigned char> vertexData;
+    std::vector<unsigned int> indices;
+    unsigned int vertexCount = 0;
+    unsigned int vertexStride = 0;
+
+    // Only files written with our own vertex layout can be used directly
+    if (!GeometryCodec::ReadMeshFile(path, vertexData, vertexCount, vertexStride, indices) ||
+        vertexStride != sizeof(Vertex) ||
+        vertexCount == 0 ||
+        indices.empty())
+    {
+        if (printLoadingProgress) printf("Couldn't decode %s, falling back to the OBJ\n", path.c_str());
+        return 0;
+    }
+
+    // The decoded bytes go straight into the mesh's buffer creation
+    return CreateMesh(name, (Vertex*)vertexData.data(), (int)vertexCount, indices.data(), (int)indices.size(), meshFlags);
+}
+
+// --------------------------------------------------------
+// Loads every mesh, submesh and material in a glTF file.  The
+// first primitive of the first mesh is registered as the
+// name itself and the rest as name/mesh/primitive, so a
+// single-mesh file behaves like any other mesh.  Vertices
+// and indices that are already in our layout (and space) are
+// uploaded straight out of the mapped file.
+// --------------------------------------------------------
+std::shared_ptr<Mesh> Assets::LoadGltf(std::string path, std::string name, unsigned int meshFlags)
 {
-    std::shared_ptr<Mesh> newMesh = std::make_shared<Mesh>(path.c_str());
+    GltfFile file;
+    if (!file.Open(path))
+    {
+        if (printLoadingProgress) printf("Couldn't open glTF file %s\n", path.c_str());
+        return 0;
+    }
+
+    // Materials, decoding each image once even if several materials use it
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> decodedImages(file.GetImages().size());
+    std::vector<std::shared_ptr<Material>> fileMaterials;
+    for (unsigned int i = 0; i < file.GetMaterials().size(); i++)
+    {
+        std::shared_ptr<Material> mat = CreateGltfMaterial(file, i, decodedImages);
+        std::string matName = file.GetMaterials()[i].name;
+        materials.insert({ name + "/" + (matName.empty() ? std::to_string(i) : matName), mat });
+        fileMaterials.push_back(mat);
+    }
+
+    bool toLeftHanded = !file.IsLeftHanded();
+    unsigned int zeroCopyCount = 0;
+
+    std::vector<ModelPart> parts;
+    std::vector<Vertex> verts;
+    std::vector<unsigned int> indices;
+    for (unsigned int m = 0; m < file.GetMeshes().size(); m++)
+    {
+        const GltfMesh& gltfMesh = file.GetMeshes()[m];
+        for (unsigned int p = 0; p < gltfMesh.primitives.size(); p++)
+        {
+            const GltfPrimitive& primitive = gltfMesh.primitives[p];
+            std::string partName = parts.empty() ? name : name + "/" + std::to_string(m) + "/" + std::to_string(p);
+
+            // Use the file's bytes directly where we can
+            Vertex* vertData = 0;
+            unsigned int* indexData = 0;
+            unsigned int vertCount = primitive.position.count;
+            unsigned int indexCount = 0;
+            unsigned int partFlags = meshFlags;
+
+            if (!toLeftHanded && GltfFile::MatchesVertexLayout(primitive))
+            {
+                vertData = (Vertex*)primitive.position.data;
+                partFlags |= MESH_FLAG_HAS_TANGENTS;
+            }
+            else
+            {
+                if (GltfFile::ReadVertices(primitive, toLeftHanded, verts))
+                    partFlags |= MESH_FLAG_HAS_TANGENTS;
+                vertData = verts.data();
+            }
+
+            if (!toLeftHanded && GltfFile::MatchesIndexLayout(primitive))
+            {
+                indexData = (unsigned int*)primitive.indices.data;
+                indexCount = primitive.indices.count;
+            }
+            else
+            {
+                GltfFile::ReadIndices(primitive, toLeftHanded, indices);
+                indexData = indices.data();
+                indexCount = (unsigned int)indices.size();
+            }
+
+            // Anything pointing outside the vertices would read other meshes' data
+            bool valid = vertCount > 0 && indexCount > 0;
+            for (unsigned int i = 0; valid && i < indexCount; i++)
+                valid = indexData[i] < vertCount;
+            if (!valid)
+            {
+                if (printLoadingProgress) printf("Skipping invalid primitive %s in %s\n", partName.c_str(), path.c_str());
+                continue;
+            }
+
+            if (vertData != verts.data() && indexData != indices.data())
+                zeroCopyCount++;
+
+            std::shared_ptr<Mesh> mesh = CreateMesh(partName, vertData, (int)vertCount, indexData, (int)indexCount, partFlags);
+
+            std::shared_ptr<Material> mat = 0;
+            if (primitive.material >= 0 && primitive.material < (int)fileMaterials.size())
+                mat = fileMaterials[primitive.material];
+
+            parts.push_back({ mesh, mat });
+        }
+    }
+
+    if (printLoadingProgress)
+        printf("Loaded %s: %zu parts (%u without a CPU copy), %zu materials\n", path.c_str(), parts.size(), zeroCopyCount, fileMaterials.size());
+
+    if (parts.empty())
+        return 0;
+
+    models.insert({ name, parts });
+    return parts[0].mesh;
+}
+
+// --------------------------------------------------------
+// Maps a glTF metal/roughness material onto our four PBR
+// texture slots.  The packed roughness (G) / metal (B) image
+// is used for both of the last two slots through swizzled
+// views.  Missing images become 1x1 textures of the factor.
+// --------------------------------------------------------
+std::shared_ptr<Material> Assets::CreateGltfMaterial(GltfFile& file, unsigned int index, std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& decodedImages)
+{
+    const GltfMaterial& gltfMat = file.GetMaterials()[index];
+
+    std::shared_ptr<Material> newMat = std::make_shared<Material>(
+        GetRootSig("pbrRS"),
+        GetPipelineStateObject("pbrPSO"),
+        XMFLOAT3(gltfMat.baseColor.x, gltfMat.baseColor.y, gltfMat.baseColor.z),
+        XMFLOAT2(1, 1),
+        XMFLOAT2(0, 0));
+
+    auto getImage = [&](int image) -> Microsoft::WRL::ComPtr<ID3D12Resource>
+    {
+        if (image < 0 || image >= (int)decodedImages.size() || !file.GetImages()[image].data)
+            return 0;
+
+        if (!decodedImages[image])
+        {
+            const GltfImage& img = file.GetImages()[image];
+            decodedImages[image] = DX12Helper::GetInstance().DecodeTexture(img.data, img.size);
+        }
+        return decodedImages[image];
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> albedo = getImage(gltfMat.baseColorImage);
+    Microsoft::WRL::ComPtr<ID3D12Resource> normals = getImage(gltfMat.normalImage);
+    Microsoft::WRL::ComPtr<ID3D12Resource> metalRough = getImage(gltfMat.metallicRoughnessImage);
+
+    newMat->AddTexture(albedo ? DX12Helper::GetInstance().LoadTexture(albedo) : GetSolidColorTexture(XMFLOAT4(1, 1, 1, 1)), 0);
+    newMat->AddTexture(normals ? DX12Helper::GetInstance().LoadTexture(normals) : GetSolidColorTexture(XMFLOAT4(0.5f, 0.5f, 1, 1)), 1);
+    if (metalRough)
+    {
+        newMat->AddTexture(DX12Helper::GetInstance().LoadTexture(metalRough, D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(1, 1, 1, 1)), 2);
+        newMat->AddTexture(DX12Helper::GetInstance().LoadTexture(metalRough, D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(2, 2, 2, 2)), 3);
+    }
+    else
+    {
+        newMat->AddTexture(GetSolidColorTexture(XMFLOAT4(gltfMat.roughness, gltfMat.roughness, gltfMat.roughness, 1)), 2);
+        newMat->AddTexture(GetSolidColorTexture(XMFLOAT4(gltfMat.metallic, gltfMat.metallic, gltfMat.metallic, 1)), 3);
+    }
+    newMat->FinalizeMaterial();
+
+    return newMat;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE Assets::GetSolidColorTexture(DirectX::XMFLOAT4 color)
+{
+    // Keyed by the 8 bit color it'll end up as
+    auto toByte = [](float f) { return (unsigned int)(max(0.0f, min(1.0f, f)) * 255.0f + 0.5f); };
+    unsigned int key = toByte(color.x) | (toByte(color.y) << 8) | (toByte(color.z) << 16) | (toByte(color.w) << 24);
+
+    auto it = solidColorTextures.find(key);
+    if (it != solidColorTextures.end())
+        return it->second;
+
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = DX12Helper::GetInstance().LoadTexture(DX12Helper::GetInstance().CreateSolidColorTexture(color));
+    solidColorTextures.insert({ key, handle });
+    return handle;
+}
+
+// --------------------------------------------------------
+// Hashes the data before the mesh touches it (tangents are
+// filled in during buffer creation), so identical sources
+// always hash the same.  An existing mesh is only shared if
+// its 128-bit content hash matches, it was made with at
+// least the requested flags and it stores its vertices in
+// the same format.  Nothing is copied, so data handed over
+// straight from a mapped file stays zero-copy.
+// --------------------------------------------------------
+std::shared_ptr<Mesh> Assets::CreateMesh(std::string name, Vertex* verts, int numVerts, unsigned int* indices, int numIndices, unsigned int meshFlags)
+{
+    MeshContentHash hash = HashMeshContent(verts, numVerts, indices, numIndices);
+
+    auto it = meshesByContent.find(hash);
+    if (it != meshesByContent.end() &&
+        (it->second->GetFlags() & meshFlags) == meshFlags &&
+        (it->second->GetFlags() & MESH_FLAG_COMPACT_VERTICES) == (meshFlags & MESH_FLAG_COMPACT_VERTICES))
+    {
+        std::shared_ptr<Mesh> existing = it->second;
+
+        unsigned int vertexStride = (meshFlags & MESH_FLAG_COMPACT_VERTICES) ? CompactVertexFormat::Stride : StandardVertexFormat::Stride;
+        size_t saved = numVerts * vertexStride + numIndices * sizeof(unsigned int);
+        if (existing->HasPositionStream()) saved += numVerts * sizeof(VertexPosition);
+        meshBytesSaved += saved;
+        meshesShared++;
+
+        if (printLoadingProgress) printf("Mesh %s shares its geometry with an existing mesh (%zu bytes saved)\n", name.c_str(), saved);
+
+        meshes.insert({ name, existing });
+        return existing;
+    }
+
+    // Same content made with other flags is replaced, so later
+    // requests share whichever version was made most recently
+    std::shared_ptr<Mesh> newMesh = std::make_shared<Mesh>(verts, numVerts, indices, numIndices, meshFlags);
     meshes.insert({ name, newMesh });
+    meshesByContent[hash] = newMesh;
     return newMesh;
 }
 
+void Assets::PrintMeshReport()
+{
+    printf("Meshes: %zu names, %zu unique, %u shared (%.2f KB of geometry saved)\n",
+        meshes.size(),
+        meshesByContent.size(),
+        meshesShared,
+        meshBytesSaved / 1024.0);
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE Assets::LoadTexture(std::string path, std::string name)
 {
     D3D12_CPU_DESCRIPTOR_HANDLE tex = DX12Helper::GetInstance().LoadTexture(ToWideString(path).c_str());
@@ -587,7 +1009,14 @@ Microsoft::WRL::ComPtr<ID3D12PipelineState> Assets::LoadPipelineState(std::strin
         assert(doc["vsName"].IsString());
         assert(doc["psName"].IsString());
     }
-    // Input element info
+    // Input element info, either named as one of our vertex formats
+    // (see VertexFormat.h) or spelled out element by element
+    bool namedVertexFormat = doc.HasMember("vertexFormat");
+    if (namedVertexFormat)
+    {
+        assert(doc["vertexFormat"].IsString());
+    }
+    else
     {
         assert(doc["inputElements"].IsArray());
         for (int i = 0; i < doc["inputElements"].Size(); i++)
@@ -638,19 +1067,29 @@ Microsoft::WRL::ComPtr<ID3D12PipelineState> Assets::LoadPipelineState(std::strin
     D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
 
     // -- Input assembler related ---
-    D3D12_INPUT_ELEMENT_DESC* inputElements = new D3D12_INPUT_ELEMENT_DESC[doc["inputElements"].Size()];
-    for (int i = 0; i < doc["inputElements"].Size(); i++)
+    D3D12_INPUT_ELEMENT_DESC* inputElements = 0;
+    if (namedVertexFormat)
     {
-        D3D12_INPUT_ELEMENT_DESC newDesc = {};
-        newDesc.AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
-        newDesc.Format = static_cast<DXGI_FORMAT>(doc["inputElements"][i]["format"].GetInt());
-        newDesc.SemanticName = doc["inputElements"][i]["semanticName"].GetString();
-        newDesc.SemanticIndex = doc["inputElements"][i]["index"].GetInt();
-        inputElements[i] = newDesc;
+        // The layout is built at compile time and never needs freeing
+        if (!GetVertexFormatInputLayout(doc["vertexFormat"].GetString(), psoDesc.InputLayout))
+            return nullptr;
+    }
+    else
+    {
+        inputElements = new D3D12_INPUT_ELEMENT_DESC[doc["inputElements"].Size()];
+        for (int i = 0; i < doc["inputElements"].Size(); i++)
+        {
+            D3D12_INPUT_ELEMENT_DESC newDesc = {};
+            newDesc.AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+            newDesc.Format = static_cast<DXGI_FORMAT>(doc["inputElements"][i]["format"].GetInt());
+            newDesc.SemanticName = doc["inputElements"][i]["semanticName"].GetString();
+            newDesc.SemanticIndex = doc["inputElements"][i]["index"].GetInt();
+            inputElements[i] = newDesc;
+        }
+
+        psoDesc.InputLayout.NumElements = doc["inputElements"].Size();
+        psoDesc.InputLayout.pInputElementDescs = &inputElements[0];
     }
-    
-    psoDesc.InputLayout.NumElements = doc["inputElements"].Size();
-    psoDesc.InputLayout.pInputElementDescs = &inputElements[0];
     psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 
     // Root sig
@@ -659,8 +1098,12 @@ Microsoft::WRL::ComPtr<ID3D12PipelineState> Assets::LoadPipelineState(std::strin
     // -- Shaders (VS/PS) --- 
     psoDesc.VS.pShaderBytecode = GetPixelShaderBlob(doc["vsName"].GetString())->GetBufferPointer();
     psoDesc.VS.BytecodeLength = GetPixelShaderBlob(doc["vsName"].GetString())->GetBufferSize();
-    psoDesc.PS.pShaderBytecode = GetPixelShaderBlob(doc["psName"].GetString())->GetBufferPointer();
-    psoDesc.PS.BytecodeLength = GetPixelShaderBlob(doc["psName"].GetString())->GetBufferSize();
+    // An empty psName means a depth-only pipeline with no pixel shader at all
+    if (doc["psName"].GetStringLength() > 0)
+    {
+        psoDesc.PS.pShaderBytecode = GetPixelShaderBlob(doc["psName"].GetString())->GetBufferPointer();
+        psoDesc.PS.BytecodeLength = GetPixelShaderBlob(doc["psName"].GetString())->GetBufferSize();
+    }
 
     // -- Render targets ---
     psoDesc.NumRenderTargets = doc["renderTargetFormats"].Size();
@@ -836,6 +1279,67 @@ std::wstring Assets::GetFullPathTo_Wide(std::wstring relativeFilePath)
     return GetExePath_Wide() + L"\\" + relativeFilePath;
 }
 
+// --------------------------------------------------------
+// Two independent 64-bit lanes over 8 bytes at a time: one
+// is FNV-1a with an extra shift, the other a multiply and
+// rotate, and both go through a final avalanche.  The counts
+// are mixed in first so a vertex moving from one array to
+// the other can't collide.
+// --------------------------------------------------------
+Assets::MeshContentHash Assets::HashMeshContent(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+    const unsigned long long prime = 0x100000001B3ull;
+    MeshContentHash hash = { 0xCBF29CE484222325ull, 0x9E3779B97F4A7C15ull };
+
+    auto mixWord = [&](unsigned long long word)
+    {
+        hash.low = (hash.low ^ word) * prime;
+        hash.low ^= hash.low >> 29;
+
+        hash.high ^= word * 0xC2B2AE3D27D4EB4Full;
+        hash.high = ((hash.high << 31) | (hash.high >> 33)) * 0x9E3779B97F4A7C15ull;
+    };
+
+    auto hashBytes = [&](const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        size_t words = size / 8;
+        for (size_t i = 0; i < words; i++)
+        {
+            unsigned long long word;
+            memcpy(&word, bytes + i * 8, 8);
+            mixWord(word);
+        }
+
+        // Leftover bytes padded into one last word, with the length
+        // so trailing zeroes still count
+        unsigned long long tail = (unsigned long long)(size - words * 8) << 56;
+        memcpy(&tail, bytes + words * 8, size - words * 8);
+        mixWord(tail);
+    };
+
+    auto avalanche = [](unsigned long long h)
+    {
+        h ^= h >> 33; h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ull;
+        return h ^ (h >> 33);
+    };
+
+    unsigned long long counts = ((unsigned long long)numVerts << 32) | (unsigned int)numIndices;
+    hashBytes(&counts, sizeof(counts));
+    hashBytes(verts, numVerts * sizeof(Vertex));
+    hashBytes(indices, numIndices * sizeof(unsigned int));
+
+    hash.low = avalanche(hash.low);
+    hash.high = avalanche(hash.high ^ hash.low);
+    return hash;
+}
+
+bool Assets::IsProceduralMeshName(std::string name)
+{
+    return name.compare(0, strlen(PROCEDURAL_MESH_PREFIX), PROCEDURAL_MESH_PREFIX) == 0;
+}
+
 bool Assets::EndsWith(std::string str, std::string ending)
 {
     return std::equal(ending.rbegin(), ending.rend(), str.rbegin());
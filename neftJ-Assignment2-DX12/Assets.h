@@ -19,10 +19,20 @@
 #include <iostream>
 
 #include "Mesh.h"
+#include "GeometryCodec.h"
+#include "GltfFile.h"
+#include "ProceduralMesh.h"
+#include "VertexFormat.h"
 #include "Material.h"
 #include "DX12Helper.h"
 #include "Structs.h"
 
+// One drawable piece of a model file (a glTF primitive)
+struct ModelPart
+{
+	std::shared_ptr<Mesh> mesh;
+	std::shared_ptr<Material> material;
+};
 
 class Assets
 {
@@ -43,7 +53,9 @@ private:
 	static Assets* instance;
 	Assets() :
 		allowOnDemandLoading(true),
-		printLoadingProgress(false) {};
+		printLoadingProgress(false),
+		meshBytesSaved(0),
+		meshesShared(0) {};
 
 #pragma endregion
 
@@ -57,7 +69,8 @@ public:
 		bool printLoadingProgress = false);
 
 	// Getters
-	std::shared_ptr<Mesh> GetMesh(std::string name);
+	std::shared_ptr<Mesh> GetMesh(std::string name, unsigned int meshFlags = MESH_FLAG_NONE);
+	std::vector<ModelPart> GetModel(std::string name, unsigned int meshFlags = MESH_FLAG_NONE);
 	D3D12_CPU_DESCRIPTOR_HANDLE GetTexture(std::string name);
 	std::shared_ptr<Material> GetMaterial(std::string name);
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> GetRootSig(std::string name);
@@ -82,6 +95,33 @@ public:
 	void ReleaseRTVs();
 	void ReloadAllRTVs();
 
+	// Makes a mesh from raw data, sharing an existing one if the content is identical
+	std::shared_ptr<Mesh> CreateMesh(std::string name, Vertex* verts, int numVerts, unsigned int* indices, int numIndices, unsigned int meshFlags = MESH_FLAG_NONE);
+
+	// How much GPU geometry content deduplication has avoided creating
+	size_t GetMeshBytesSaved() { return meshBytesSaved; }
+	void PrintMeshReport();
+
+	// Raw mesh data (built-in shapes, then a compressed mesh if there is one, otherwise the OBJ).
+	// Touches nothing but the files, so it can be called from other threads.
+	bool LoadMeshData(std::string name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// Makes the mesh from data LoadMeshData() read, or returns it if it's already loaded
+	std::shared_ptr<Mesh> CreateMeshFromData(std::string name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int meshFlags = MESH_FLAG_NONE);
+
+	// Whether an asset is cached, and dropping it from the cache (it's
+	// freed once nothing else holds on to it)
+	bool IsMeshLoaded(std::string name);
+	bool IsMaterialLoaded(std::string name);
+	void ReleaseMesh(std::string name);
+	void ReleaseMaterial(std::string name);
+
+	// Writes a compressed copy of Models\name.obj next to it
+	bool CompressMesh(std::string name);
+
+	// Full path to a file under the asset folder, for things that read their own files
+	std::string GetFullAssetPath(std::string relativeFilePath) { return GetFullPathTo(rootAssetPath + relativeFilePath); }
+
 private:
 	// Asset manager settings
 	bool allowOnDemandLoading;
@@ -102,9 +142,35 @@ private:
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> vertexShaderBlobs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> pixelShaderBlobs;
 	std::unordered_map<std::string, RtvSrvBundle> rtvSrvBundles;
+	std::unordered_map<std::string, std::vector<ModelPart>> models;
+	std::unordered_map<unsigned int, D3D12_CPU_DESCRIPTOR_HANDLE> solidColorTextures;
+
+	// Meshes by a hash of their vertex and index data, so the same
+	// geometry under several names only lives on the GPU once.  The
+	// hash is 128 bits so a match can be trusted without keeping a
+	// CPU copy of every mesh around to compare against.
+	struct MeshContentHash
+	{
+		unsigned long long low;
+		unsigned long long high;
+
+		bool operator==(const MeshContentHash& other) const { return low == other.low && high == other.high; }
+	};
+	struct MeshContentHasher
+	{
+		size_t operator()(const MeshContentHash& hash) const { return (size_t)(hash.low ^ hash.high); }
+	};
+	std::unordered_map<MeshContentHash, std::shared_ptr<Mesh>, MeshContentHasher> meshesByContent;
+	size_t meshBytesSaved;
+	unsigned int meshesShared;
 
 	// Load methods
-	std::shared_ptr<Mesh> LoadMesh(std::string path, std::string name);
+	std::shared_ptr<Mesh> LoadMesh(std::string path, std::string name, unsigned int meshFlags);
+	std::shared_ptr<Mesh> LoadCompressedMesh(std::string path, std::string name, unsigned int meshFlags);
+	std::shared_ptr<Mesh> LoadProceduralMesh(std::string name, unsigned int meshFlags);
+	std::shared_ptr<Mesh> LoadGltf(std::string path, std::string name, unsigned int meshFlags);
+	std::shared_ptr<Material> CreateGltfMaterial(GltfFile& file, unsigned int index, std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>& decodedImages);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetSolidColorTexture(DirectX::XMFLOAT4 color);
 	D3D12_CPU_DESCRIPTOR_HANDLE LoadTexture(std::string path, std::string name);
 	D3D12_CPU_DESCRIPTOR_HANDLE LoadCubeMap(std::string path, std::string name);
 	std::shared_ptr<Material> LoadMaterial(std::string path, std::string name);
@@ -123,6 +189,8 @@ private:
 	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
 
 	bool EndsWith(std::string str, std::string ending);
+	bool IsProceduralMeshName(std::string name);
+	MeshContentHash HashMeshContent(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
 	std::wstring ToWideString(std::string str);
 	std::string RemoveFileExtension(std::string str);
 };
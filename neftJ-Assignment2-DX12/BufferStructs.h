@@ -3,6 +3,7 @@
 using namespace DirectX;
 
 #include "Lights.h"
+#include "Terrain.h"
 
 struct VertexShaderExternalData 
 {
@@ -67,4 +68,41 @@ struct IBLSpecularConvolutionData
 	int faceIndex;
 	int mipLevel;
 	float padding;
+};
+
+// Matches TerrainVS.hlsl's per frame constants
+struct TerrainVSData
+{
+	XMFLOAT4X4 View;
+	XMFLOAT4X4 Projection;
+	XMFLOAT3 cameraPosition;
+	float spacing;
+	XMFLOAT3 origin;
+	float heightScale;
+	unsigned int tilesAcross;
+	unsigned int overviewWidth;
+	XMFLOAT2 padding;
+
+	// Each LOD's morph as (end / (end - start), 1 / (end - start), unused, unused)
+	XMFLOAT4 morphConstants[TERRAIN_MAX_LODS];
+
+	// Each tile's slot in the height buffer, 0 (the overview's) when it isn't resident
+	unsigned int tileSlots[TERRAIN_MAX_TILES_ACROSS * TERRAIN_MAX_TILES_ACROSS];
+};
+
+// One instanced draw's nodes, each as (corner x, corner z, size, LOD)
+struct TerrainNodesData
+{
+	XMFLOAT4 nodes[TERRAIN_INSTANCES_PER_DRAW];
+};
+
+// Matches ScatterVS.hlsl's per draw constants
+struct ScatterVSData
+{
+	XMFLOAT4X4 View;
+	XMFLOAT4X4 Projection;
+	XMFLOAT3 meshScale;
+	unsigned int firstInstance;	// Where this draw's layer starts in the instance buffer
+	XMFLOAT3 color;
+	float padding;
 };
\ No newline at end of file
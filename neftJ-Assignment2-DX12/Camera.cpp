@@ -57,15 +57,14 @@ void Camera::Update(float dt)
 // Creates a new view matrix based on current position and orientation
 void Camera::UpdateViewMatrix()
 {
-	// Rotate the standard "forward" matrix by our rotation
-	// This gives us our "look direction"
-	XMFLOAT3 rot = transform.GetPitchYawRoll();
-	XMVECTOR dir = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rot)));
+	// Our "look direction" is the transform's forward axis,
+	// which it only rebuilds when the rotation changes
+	XMFLOAT3 dir = transform.GetForward();
 
 	XMFLOAT3 pos = transform.GetPosition();
 	XMMATRIX view = XMMatrixLookToLH(
 		XMLoadFloat3(&pos),
-		dir,
+		XMLoadFloat3(&dir),
 		XMVectorSet(0, 1, 0, 0));
 
 	XMStoreFloat4x4(&viewMatrix, view);
@@ -0,0 +1,65 @@
+
+// Matches CompactVertexFormat in VertexFormat.h.  The UV comes
+// in as halfs and the normal and tangent as octahedral snorms,
+// all of which the input assembler turns back into floats.
+struct VertexShaderInput
+{
+	float3 localPosition	: POSITION;
+	float2 uv				: TEXCOORD;
+	float2 octNormal		: NORMAL;
+	float2 octTangent		: TANGENT;
+};
+
+// Same output and constant buffer as VertexShader.hlsl, so
+// the regular pixel shaders work unchanged
+struct VertexToPixel
+{
+	float4 screenPosition : SV_POSITION;
+	float2 uv : TEXCOORD;
+	float3 normal : NORMAL;
+	float3 tangent : TANGENT;
+	float3 worldPos : POSITION; // The world position of this PIXEL
+};
+
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix worldInverseTranspose;
+	matrix view;
+	matrix projection;
+}
+
+// --------------------------------------------------------
+// Unfolds an octahedral encoded unit vector (the reverse
+// of VertexEncoding::oct16 on the C++ side)
+// --------------------------------------------------------
+float3 OctDecode(float2 e)
+{
+	float3 v = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.x += v.x >= 0.0f ? -t : t;
+	v.y += v.y >= 0.0f ? -t : t;
+	return normalize(v);
+}
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl once the attributes are unpacked
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	// precise to match the depth pre-pass bit for bit (see DepthOnlyVS)
+	precise matrix worldViewProj = mul(projection, mul(view, world));
+	precise float4 screenPosition = mul(worldViewProj, float4(input.localPosition, 1.0f));
+	output.screenPosition = screenPosition;
+
+	output.worldPos = mul(world, float4(input.localPosition, 1.0f)).xyz;
+
+	output.normal = normalize(mul((float3x3)worldInverseTranspose, OctDecode(input.octNormal)));
+	output.tangent = normalize(mul((float3x3)world, OctDecode(input.octTangent)));
+
+	output.uv = input.uv;
+
+	return output;
+}
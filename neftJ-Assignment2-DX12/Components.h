@@ -0,0 +1,183 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <stdint.h>
+
+#include "EntityManager.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
+#include "SpatialIndex.h"
+#include "SweepAndPrune.h"
+#include "TransformStore.h"
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// The components the game's entities are made of.  They
+// have to be plain data (see EntityManager), so anything
+// bigger lives somewhere else and is pointed to.
+// --------------------------------------------------------
+
+// A slot in the TransformStore, which goes when the entity does
+struct TransformComponent
+{
+	uint32_t id;
+
+	static void Cleanup(TransformComponent& t) { TransformStore::GetInstance().Free(t.id); }
+};
+
+// What the renderer draws the entity with (Assets keeps both alive)
+struct MeshRendererComponent
+{
+	Mesh* mesh;
+	Material* material;
+};
+
+// Drawn into the occlusion buffer to hide what's behind it (the
+// mesh is shared, and kept alive by whoever made the entity)
+struct OccluderComponent
+{
+	OccluderMesh* mesh;
+};
+
+// A mesh at each of its detail levels, with their geometric errors
+// and triangle counts, and level 0's bounds for picking between them
+struct LodChain
+{
+	Mesh* meshes[LOD_MAX_LEVELS];
+	float errors[LOD_MAX_LEVELS];
+	unsigned int triangles[LOD_MAX_LEVELS];
+	unsigned int count;
+	DirectX::BoundingSphere bounds;
+};
+
+// An object in the LodSelector, which swaps the entity's mesh for
+// the level it picks.  It's taken out when the entity goes.
+struct LodComponent
+{
+	const LodChain* chain;
+	uint32_t id;
+
+	static void Cleanup(LodComponent& l) { LodSelector::GetInstance().Remove(l.id); }
+};
+
+// Turns around the Y axis, in radians per second
+struct SpinComponent
+{
+	float speed;
+};
+
+// An object in a SpatialIndex, with its bounds before the
+// entity's transform (the mesh's, usually).  It's taken out
+// of the index when the entity goes.
+struct SpatialComponent
+{
+	SpatialIndex* index;
+	uint32_t proxy;
+	DirectX::BoundingBox bounds;
+
+	static void Cleanup(SpatialComponent& s) { s.index->Remove(s.proxy); }
+};
+
+// A body in a SweepAndPrune broadphase, with its bounds before the
+// entity's transform.  It's taken out when the entity goes.
+struct OverlapComponent
+{
+	SweepAndPrune* broadphase;
+	uint32_t proxy;
+	DirectX::BoundingBox bounds;
+
+	static void Cleanup(OverlapComponent& o) { o.broadphase->Remove(o.proxy); }
+};
+
+// --------------------------------------------------------
+// Turns every spinning entity.  Chunks are spread across
+// all cores if there are enough of them, which is safe as
+// the store can be written to from several threads.
+// --------------------------------------------------------
+inline void UpdateSpinners(EntityManager& entities, float deltaTime, bool allowThreads = true)
+{
+	TransformStore& store = TransformStore::GetInstance();
+	entities.ParallelForEachChunk<TransformComponent, SpinComponent>(
+		[&store, deltaTime](unsigned int count, Entity* entities, TransformComponent* transforms, SpinComponent* spins)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				store.Rotate(transforms[i].id, 0, spins[i].speed * deltaTime, 0);
+		}, allowThreads);
+}
+
+// --------------------------------------------------------
+// Moves every entity's object in its spatial index to where
+// its transform now puts it.  This stays on one thread as
+// moves can change the tree, but most are just a check that
+// the object is still inside its box.
+// --------------------------------------------------------
+inline void UpdateSpatialIndex(EntityManager& entities)
+{
+	TransformStore& store = TransformStore::GetInstance();
+	store.UpdateDirty();
+	entities.ForEachChunk<TransformComponent, SpatialComponent>(
+		[&store](unsigned int count, Entity* entities, TransformComponent* transforms, SpatialComponent* spatials)
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				DirectX::BoundingBox world;
+				spatials[i].bounds.Transform(world, DirectX::XMLoadFloat4x4(&store.GetWorldMatrix(transforms[i].id)));
+				spatials[i].index->Move(spatials[i].proxy, world);
+			}
+		});
+}
+
+// --------------------------------------------------------
+// Moves every entity's body in its broadphase to where its
+// transform now puts it.  The pairs only change when the
+// broadphase is next updated.
+// --------------------------------------------------------
+inline void UpdateOverlaps(EntityManager& entities)
+{
+	TransformStore& store = TransformStore::GetInstance();
+	store.UpdateDirty();
+	entities.ForEachChunk<TransformComponent, OverlapComponent>(
+		[&store](unsigned int count, Entity* entities, TransformComponent* transforms, OverlapComponent* overlaps)
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				DirectX::BoundingBox world;
+				overlaps[i].bounds.Transform(world, DirectX::XMLoadFloat4x4(&store.GetWorldMatrix(transforms[i].id)));
+				overlaps[i].broadphase->Move(overlaps[i].proxy, world);
+			}
+		});
+}
+
+// --------------------------------------------------------
+// Moves every LOD'd entity's bounds to where its transform
+// puts it, picks levels for the camera and points each
+// entity's renderer at the mesh for its level
+// --------------------------------------------------------
+inline void UpdateLods(EntityManager& entities, DirectX::XMFLOAT3 cameraPosition, const DirectX::XMFLOAT4X4& projection, float screenHeight)
+{
+	TransformStore& store = TransformStore::GetInstance();
+	LodSelector& selector = LodSelector::GetInstance();
+	store.UpdateDirty();
+
+	entities.ForEachChunk<TransformComponent, LodComponent>(
+		[&store, &selector](unsigned int count, Entity* entities, TransformComponent* transforms, LodComponent* lods)
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				DirectX::BoundingSphere world;
+				lods[i].chain->bounds.Transform(world, DirectX::XMLoadFloat4x4(&store.GetWorldMatrix(transforms[i].id)));
+				selector.SetBounds(lods[i].id, world.Center, world.Radius);
+			}
+		});
+
+	selector.Select(cameraPosition, projection, screenHeight);
+
+	entities.ForEachChunk<LodComponent, MeshRendererComponent>(
+		[&selector](unsigned int count, Entity* entities, LodComponent* lods, MeshRendererComponent* renderers)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				renderers[i].mesh = lods[i].chain->meshes[selector.GetLevel(lods[i].id)];
+		});
+}
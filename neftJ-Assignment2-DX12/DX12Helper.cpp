@@ -1,4 +1,8 @@
 #include "DX12Helper.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
 
 // Singleton requirement
 DX12Helper* DX12Helper::instance;
@@ -26,9 +30,12 @@ D3D12_HANDLE_BUNDLE DX12Helper::GetNextCBVSRVHeapLocationHandles()
 }
 
 // --------------------------------------------------------
-// Copies the given data into the next "unused" spot in the CBV upload heap (wrapping at the end, since 
-// we treat it like a ring buffer).  Then creates a CBV in the next "unused" spot in the CBV heap that
-// points to the aforementioned spot in the upload heap and returns that CBV (a GPU descriptor handle).
+// Copies the given data into the next "unused" spot in the CBV upload heap.  Then creates a CBV in the
+// next "unused" spot in the CBV heap that points to the aforementioned spot in the upload heap and
+// returns that CBV (a GPU descriptor handle).
+//
+// Both start over from the beginning at every submit, which waits for the GPU, so nothing filled
+// since then is ever overwritten while a recorded draw might still read it.
 // 
 // data - The data to copy to the GPU
 // dataSizeInBytes - The byte size of the data to copy
@@ -43,9 +50,13 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 	reservationSize = (reservationSize + 255); // Add 255 so we can drop last few bits
 	reservationSize = reservationSize & ~255;  // Flip 255 and then use it to mask 
 
-	// Ensure this upload will fit in the remaining space.  If not, reset to beginning.
-	if (cbUploadHeapOffsetInBytes + reservationSize >= cbUploadHeapSizeInBytes)
-		cbUploadHeapOffsetInBytes = 0;
+	// Ensure this upload will fit in the remaining space.  If not, switch to a bigger
+	// heap, keeping the full one alive for the draws that already point into it.
+	if (cbUploadHeapOffsetInBytes + reservationSize > cbUploadHeapSizeInBytes)
+	{
+		retiredCbUploadHeaps.push_back(cbUploadHeap);
+		CreateConstantBufferUploadHeap(std::max(cbUploadHeapSizeInBytes * 2, (UINT64)reservationSize));
+	}
 
 	// Where in the upload heap will this data go?
 	D3D12_GPU_VIRTUAL_ADDRESS virtualGPUAddress =
@@ -59,16 +70,23 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 
 		// Perform the mem copy to put new data into this part of the heap
 		memcpy(uploadAddress, data, dataSizeInBytes);
-
-		// Increment the offset and loop back to the beginning if necessary,
-		// allowing us to treat the upload heap like a ring buffer
 		cbUploadHeapOffsetInBytes += reservationSize;
-		if (cbUploadHeapOffsetInBytes >= cbUploadHeapSizeInBytes)
-			cbUploadHeapOffsetInBytes = 0;
 	}
 
 	// Create a CBV for this section of the heap
 	{
+		// The descriptors can't grow like the upload heap (SRVs come right
+		// after them), and starting over before a submit would overwrite ones
+		// that recorded draws still use.  maxConstantBuffers is sized so this
+		// never happens, so running out is fatal in every build.
+		if (cbvDescriptorOffset >= maxConstantBuffers)
+		{
+			fprintf(stderr, "More than %u constant buffers filled between submits\n", maxConstantBuffers);
+			assert(false);
+			abort();
+		}
+		cbFillCount++;
+
 		// Calculate the CPU and GPU side handles for this descriptor
 		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = cbvSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
 		D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = cbvSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
@@ -88,11 +106,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 		// Create the CBV, which is a lightweight operation in DX12
 		device->CreateConstantBufferView(&cbvDesc, cpuHandle);
 
-		// Increment the offset and loop back to the beginning if necessary
-		// which allows us to treat the descriptor heap as a ring buffer
 		cbvDescriptorOffset++;
-		if (cbvDescriptorOffset >= maxConstantBuffers)
-			cbvDescriptorOffset = 0;
 
 		// Now that the CBV is ready, we return the GPU handle to it
 		// so it can be set as part of the root signature during drawing
@@ -185,7 +199,12 @@ D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(const wchar_t* file, bool ge
 	return cpuHandle;
 }
 
-D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(Microsoft::WRL::ComPtr<ID3D12Resource> texture)
+// --------------------------------------------------------
+// A non-default component mapping lets one texture be seen
+// through several views (e.g. a packed roughness/metal map
+// as two single channel textures)
+// --------------------------------------------------------
+D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(Microsoft::WRL::ComPtr<ID3D12Resource> texture, UINT componentMapping)
 {
 	// Now that we have the texture, add to our list and make a CPU-side descriptor heap
 	// just for this texture's SRV.  Note that it would probably be better to put all 
@@ -207,13 +226,95 @@ D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(Microsoft::WRL::ComPtr<ID3D1
 	// Create the SRV on this descriptor heap
 	// Note: Using a null description results in the "default" SRV (same format, all mips, all array slices, etc.)
 	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = descHeap->GetCPUDescriptorHandleForHeapStart();
-	device->CreateShaderResourceView(texture.Get(), 0, cpuHandle);
+	if (componentMapping == D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING)
+	{
+		device->CreateShaderResourceView(texture.Get(), 0, cpuHandle);
+	}
+	else
+	{
+		// Swizzles need a full description
+		D3D12_RESOURCE_DESC texDesc = texture->GetDesc();
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = texDesc.Format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Shader4ComponentMapping = componentMapping;
+		srvDesc.Texture2D.MipLevels = (UINT)-1;
+		device->CreateShaderResourceView(texture.Get(), &srvDesc, cpuHandle);
+	}
 
 	// Return the CPU descriptor handle, which can be used to
 	// copy the descriptor to a shader-visible heap later
 	return cpuHandle;
 }
 
+// --------------------------------------------------------
+// Decodes an image file that's already in memory (png, jpg,
+// etc.) without creating any descriptors for it
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::DecodeTexture(const void* fileData, size_t dataSizeInBytes, bool generateMips)
+{
+	ResourceUploadBatch upload(device.Get());
+	upload.Begin();
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+	CreateWICTextureFromMemory(device.Get(), upload, (const uint8_t*)fileData, dataSizeInBytes, texture.GetAddressOf(), generateMips);
+
+	auto finish = upload.End(commandQueue.Get());
+	finish.wait();
+
+	return texture;
+}
+
+// --------------------------------------------------------
+// A 1x1 texture, for material slots that have no image
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateSolidColorTexture(XMFLOAT4 color)
+{
+	unsigned char texel[4] = {
+		(unsigned char)(color.x * 255.0f + 0.5f),
+		(unsigned char)(color.y * 255.0f + 0.5f),
+		(unsigned char)(color.z * 255.0f + 0.5f),
+		(unsigned char)(color.w * 255.0f + 0.5f) };
+
+	D3D12_HEAP_PROPERTIES heapProps = {};
+	heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+	heapProps.CreationNodeMask = 1;
+	heapProps.VisibleNodeMask = 1;
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+	device->CreateCommittedResource(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		0,
+		IID_PPV_ARGS(texture.GetAddressOf()));
+
+	D3D12_SUBRESOURCE_DATA data = {};
+	data.pData = texel;
+	data.RowPitch = sizeof(texel);
+	data.SlicePitch = sizeof(texel);
+
+	ResourceUploadBatch upload(device.Get());
+	upload.Begin();
+	upload.Upload(texture.Get(), 0, &data, 1);
+	upload.Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	auto finish = upload.End(commandQueue.Get());
+	finish.wait();
+
+	return texture;
+}
+
 D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(D3D12_CPU_DESCRIPTOR_HANDLE firstDescriptorToCopy, unsigned int numDescriptorsToCopy)
 {
 	// Grab the actual heap start on both sides and offset to the next open SRV portion
@@ -324,7 +425,7 @@ void DX12Helper::Initialize(Microsoft::WRL::ComPtr<ID3D12Device> device, Microso
 	waitFenceEvent = CreateEventEx(0, 0, 0, EVENT_ALL_ACCESS);
 	waitFenceCounter = 0;
 
-	this->CreateConstantBufferUploadHeap();
+	this->CreateConstantBufferUploadHeap(maxConstantBuffers * (UINT64)256);
 	this->CreateCBVSRVDescriptorHeap();
 	this->CreateRTVHeap();
 }
@@ -351,15 +452,36 @@ unsigned int DX12Helper::GetHeight()
 
 Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(unsigned int dataStride, unsigned int dataCount, void* data)
 {
-	// Set up the resource pointer
+	UINT64 sizeInBytes = (UINT64)dataStride * dataCount;
+
+	// Starts in copy dest, since we're copying to it first, and then
+	// lives in generic read for the rest of the app lifetime (presumably)
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer = CreateBuffer(
+		sizeInBytes,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	QueueBufferCopy(buffer, 0, data, sizeInBytes, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	// Outside of a batch, this goes to the GPU right away
+	if (!uploadBatchOpen)
+		SubmitQueuedCopies();
+
+	return buffer;
+}
+
+// --------------------------------------------------------
+// Creates a plain buffer resource in the given heap type
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateBuffer(UINT64 sizeInBytes, D3D12_HEAP_TYPE heapType, D3D12_RESOURCE_STATES initialState)
+{
 	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
 
-	// We first need to make an upload heap where we can copy data to the GPU
 	D3D12_HEAP_PROPERTIES props = {};
 	props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
 	props.CreationNodeMask = 1;
 	props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	props.Type = D3D12_HEAP_TYPE_DEFAULT;
+	props.Type = heapType;
 	props.VisibleNodeMask = 1;
 
 	D3D12_RESOURCE_DESC desc = {};
@@ -368,61 +490,227 @@ Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(unsigned i
 	desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 	desc.Flags = D3D12_RESOURCE_FLAG_NONE;
 	desc.Format = DXGI_FORMAT_UNKNOWN;
-	desc.Height = 1; // Assuming this is a regular buffer, not a texture
+	desc.Height = 1;
 	desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 	desc.MipLevels = 1;
 	desc.SampleDesc.Count = 1;
 	desc.SampleDesc.Quality = 0;
-	desc.Width = dataStride * dataCount; // Size of the buffer
+	desc.Width = sizeInBytes;
 
 	device->CreateCommittedResource(
 		&props,
 		D3D12_HEAP_FLAG_NONE,
 		&desc,
-		D3D12_RESOURCE_STATE_COPY_DEST, // Will eventually be "common", but we're copying to it first!
+		initialState,
 		0,
 		IID_PPV_ARGS(buffer.GetAddressOf()));
 
-	// Now create an intermediate upload heap for copying initial data
-	D3D12_HEAP_PROPERTIES uploadProps = {};
-	uploadProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	uploadProps.CreationNodeMask = 1;
-	uploadProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	uploadProps.Type = D3D12_HEAP_TYPE_UPLOAD; // Can only ever be Generic_Read state
-	uploadProps.VisibleNodeMask = 1;
+	return buffer;
+}
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> uploadHeap;
-	device->CreateCommittedResource(
-		&uploadProps,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		0,
-		IID_PPV_ARGS(uploadHeap.GetAddressOf()));
+// --------------------------------------------------------
+// Copies data into part of an existing default heap buffer.
+// The buffer is expected to be in destinationState before the
+// call and is put back into that state afterwards.
+// --------------------------------------------------------
+void DX12Helper::UploadBufferRegion(Microsoft::WRL::ComPtr<ID3D12Resource> destination, UINT64 destinationOffset, void* data, UINT64 dataSizeInBytes, D3D12_RESOURCE_STATES destinationState)
+{
+	if (dataSizeInBytes == 0) return;
+
+	QueueBufferCopy(destination, destinationOffset, data, dataSizeInBytes, destinationState, destinationState);
+
+	if (!uploadBatchOpen)
+		SubmitQueuedCopies();
+}
+
+// --------------------------------------------------------
+// Starts collecting buffer uploads instead of submitting each
+// one on its own.  Loading lots of meshes one at a time means a
+// full CPU/GPU round trip per buffer, so wrap bulk loads in
+// Begin/EndUploadBatch() to pay for just one.
+// --------------------------------------------------------
+void DX12Helper::BeginUploadBatch()
+{
+	if (uploadBatchOpen) return;
+
+	uploadBatchOpen = true;
+	currentBatchStats = {};
+	uploadBatchStartTime = std::chrono::high_resolution_clock::now();
+}
+
+// --------------------------------------------------------
+// Sends everything queued so far to the GPU but leaves the batch
+// open.  Needed when something is about to read from or replace
+// a buffer that still has copies queued against it.
+// --------------------------------------------------------
+void DX12Helper::FlushUploadBatch()
+{
+	if (!queuedCopies.empty())
+		SubmitQueuedCopies();
+}
+
+// --------------------------------------------------------
+// Submits whatever is still queued, releases the staging memory
+// and returns how much was uploaded and how quickly
+// --------------------------------------------------------
+UploadBatchStats DX12Helper::EndUploadBatch()
+{
+	if (!uploadBatchOpen) return lastBatchStats;
+
+	FlushUploadBatch();
+	uploadBatchOpen = false;
+	stagingPages.clear();
+
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - uploadBatchStartTime;
+	currentBatchStats.seconds = elapsed.count();
+	currentBatchStats.megabytesPerSecond = currentBatchStats.copySeconds > 0.0 ?
+		(currentBatchStats.bytesUploaded / (1024.0 * 1024.0)) / currentBatchStats.copySeconds :
+		0.0;
+
+	lastBatchStats = currentBatchStats;
+	return lastBatchStats;
+}
+
+bool DX12Helper::IsUploadBatchOpen()
+{
+	return uploadBatchOpen;
+}
+
+UploadBatchStats DX12Helper::GetLastUploadBatchStats()
+{
+	return lastBatchStats;
+}
 
+// --------------------------------------------------------
+// Copies the data into the staging pages (making a new page if
+// none of them have room) and remembers the copy for later.
+// The caller's data can be thrown away as soon as this returns.
+// --------------------------------------------------------
+void DX12Helper::QueueBufferCopy(Microsoft::WRL::ComPtr<ID3D12Resource> destination, UINT64 destinationOffset, void* data, UINT64 dataSizeInBytes, D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+{
+	// Keep each chunk 16-byte aligned within its page
+	UINT64 reservationSize = (dataSizeInBytes + 15) & ~15ull;
 
-	// Do a straight map/memcpy/unmap
-	void* gpuAddress = 0;
-	uploadHeap->Map(0, 0, &gpuAddress);
-	memcpy(gpuAddress, data, dataStride * dataCount);
-	uploadHeap->Unmap(0, 0);
+	// Find a page with room (there are only ever a handful)
+	StagingPage* page = 0;
+	for (auto& p : stagingPages)
+	{
+		if (p.offsetInBytes + reservationSize <= p.sizeInBytes)
+		{
+			page = &p;
+			break;
+		}
+	}
 
-	// Copy the whole buffer from uploadheap to vert buffer
-	commandList->CopyResource(buffer.Get(), uploadHeap.Get());
+	if (!page)
+	{
+		// A one-off upload gets a page of exactly the right size
+		UINT64 pageSize = reservationSize;
+		if (uploadBatchOpen && pageSize < stagingPageSizeInBytes)
+			pageSize = stagingPageSizeInBytes;
+
+		StagingPage newPage = {};
+		newPage.resource = CreateBuffer(pageSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+		newPage.sizeInBytes = pageSize;
+		newPage.offsetInBytes = 0;
+
+		// Upload heaps can stay mapped for their whole life
+		D3D12_RANGE readRange = { 0, 0 };
+		newPage.resource->Map(0, &readRange, &newPage.cpuAddress);
+
+		stagingPages.push_back(newPage);
+		currentBatchStats.stagingBytesAllocated += pageSize;
+		page = &stagingPages.back();
+	}
 
-	// Transition the buffer to generic read for the rest of the app lifetime (presumable)
-	D3D12_RESOURCE_BARRIER rb = {};
-	rb.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-	rb.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-	rb.Transition.pResource = buffer.Get();
-	rb.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-	rb.Transition.StateAfter = D3D12_RESOURCE_STATE_GENERIC_READ;
-	rb.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-	commandList->ResourceBarrier(1, &rb);
+	memcpy((char*)page->cpuAddress + page->offsetInBytes, data, dataSizeInBytes);
 
-	// Execute the command list and return the buffer
+	QueuedBufferCopy copy = {};
+	copy.destination = destination;
+	copy.destinationOffset = destinationOffset;
+	copy.source = page->resource.Get();
+	copy.sourceOffset = page->offsetInBytes;
+	copy.sizeInBytes = dataSizeInBytes;
+	copy.stateBefore = stateBefore;
+	copy.stateAfter = stateAfter;
+	queuedCopies.push_back(copy);
+
+	page->offsetInBytes += reservationSize;
+}
+
+// --------------------------------------------------------
+// Records every queued copy, with one set of barriers into
+// copy dest up front and one set back out at the end, then
+// executes it all and waits once
+// --------------------------------------------------------
+void DX12Helper::SubmitQueuedCopies()
+{
+	if (queuedCopies.empty()) return;
+
+	// One barrier per destination, no matter how many copies it gets
+	std::vector<D3D12_RESOURCE_BARRIER> toCopyDest;
+	std::vector<D3D12_RESOURCE_BARRIER> fromCopyDest;
+	std::vector<ID3D12Resource*> seen;
+	for (auto& c : queuedCopies)
+	{
+		if (std::find(seen.begin(), seen.end(), c.destination.Get()) != seen.end())
+			continue;
+		seen.push_back(c.destination.Get());
+
+		D3D12_RESOURCE_BARRIER rb = {};
+		rb.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		rb.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		rb.Transition.pResource = c.destination.Get();
+		rb.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+		if (c.stateBefore != D3D12_RESOURCE_STATE_COPY_DEST)
+		{
+			rb.Transition.StateBefore = c.stateBefore;
+			rb.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+			toCopyDest.push_back(rb);
+		}
+
+		if (c.stateAfter != D3D12_RESOURCE_STATE_COPY_DEST)
+		{
+			rb.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+			rb.Transition.StateAfter = c.stateAfter;
+			fromCopyDest.push_back(rb);
+		}
+	}
+
+	if (!toCopyDest.empty())
+		commandList->ResourceBarrier((UINT)toCopyDest.size(), toCopyDest.data());
+
+	for (auto& c : queuedCopies)
+	{
+		commandList->CopyBufferRegion(c.destination.Get(), c.destinationOffset, c.source, c.sourceOffset, c.sizeInBytes);
+		currentBatchStats.bytesUploaded += c.sizeInBytes;
+	}
+	currentBatchStats.copyCount += (unsigned int)queuedCopies.size();
+
+	if (!fromCopyDest.empty())
+		commandList->ResourceBarrier((UINT)fromCopyDest.size(), fromCopyDest.data());
+
+	// The staging pages have to outlive the copies.  Timing just the
+	// submit and the wait for its fence leaves out the loading work
+	// the batch wraps.
+	auto submitStart = std::chrono::high_resolution_clock::now();
 	CloseExecuteAndResetCommandList();
-	return buffer;
+	currentBatchStats.copySeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - submitStart).count();
+	currentBatchStats.submitCount++;
+	queuedCopies.clear();
+
+	// The GPU is done with them now, so the pages can be refilled
+	// during a batch, or let go of entirely if this was a one-off
+	if (uploadBatchOpen)
+	{
+		for (auto& page : stagingPages)
+			page.offsetInBytes = 0;
+	}
+	else
+	{
+		stagingPages.clear();
+	}
 }
 
 void DX12Helper::CloseExecuteAndResetCommandList()
@@ -439,6 +727,13 @@ void DX12Helper::CloseExecuteAndResetCommandList()
 	commandAllocator->Reset();
 	commandList->Reset(commandAllocator.Get(), 0);
 
+	// Nothing recorded before this point is still in use, so constant
+	// buffers start again from the beginning
+	cbUploadHeapOffsetInBytes = 0;
+	cbvDescriptorOffset = 0;
+	cbFillCount = 0;
+	retiredCbUploadHeaps.clear();
+
 }
 
 void DX12Helper::WaitForGPU()
@@ -463,18 +758,16 @@ void DX12Helper::WaitForGPU()
 // --------------------------------------------------------
 // Creates a single CB upload heap which will store all
 // constant buffer data for the entire program.  This
-// heap is treated as a ring buffer, allowing the program
-// to continually re-use the memory as frames progress.
+// heap is reused from the start after every submit, and
+// replaced with a bigger one if a submit's worth of data
+// doesn't fit.
 // --------------------------------------------------------
-void DX12Helper::CreateConstantBufferUploadHeap()
+void DX12Helper::CreateConstantBufferUploadHeap(UINT64 sizeInBytes)
 {
 	// This heap MUST have a size that is a multiple of 256
-	// We'll support up to the max number of CBs if they're
-	// all 256 bytes or less, or fewer overall CBs if they're larger
-	cbUploadHeapSizeInBytes = maxConstantBuffers * (UINT64)256;
+	cbUploadHeapSizeInBytes = (sizeInBytes + 255) & ~255ull;
 
-	// Assume the first CB will start at the beginning of the heap
-	// This offset changes as we use more CBs, and wraps around when full
+	// The next CB will start at the beginning of the heap
 	cbUploadHeapOffsetInBytes = 0;
 
 	// Create the upload heap for our constant buffer
@@ -516,8 +809,7 @@ void DX12Helper::CreateConstantBufferUploadHeap()
 // --------------------------------------------------------
 // Creates a single CBV descriptor heap which will store all
 // CBVs and SRVs for the entire program.  Like the CBV upload heap,
-// this heap is treated as a ring buffer, allowing the program
-// to continually re-use the memory as frames progress.
+// the CBV part is reused from the start after every submit.
 // --------------------------------------------------------
 void DX12Helper::CreateCBVSRVDescriptorHeap()
 {
@@ -534,9 +826,10 @@ void DX12Helper::CreateCBVSRVDescriptorHeap()
 	device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(cbvSrvDescriptorHeap.GetAddressOf()));
 
 	// Assume the first CBV will be at the beginning of the heap
-	// This will increase as we use more CBVs and will wrap back to 0
-	// when it reaches maxConstantBuffers
+	// This will increase as we use more CBVs and goes back to 0
+	// at every submit
 	cbvDescriptorOffset = 0;
+	cbFillCount = 0;
 
 	// Assume the first SRV will be after all possible CBVs
 	srvDescriptorOffset = maxConstantBuffers;
@@ -4,6 +4,7 @@
 #include <dxgi1_6.h>
 #include <wrl/client.h>
 #include <vector>
+#include <chrono>
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
 #include "ResourceUploadBatch.h"
@@ -58,6 +59,26 @@ public:
 		unsigned int dataStride,
 		unsigned int dataCount,
 		void* data);
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(
+		UINT64 sizeInBytes,
+		D3D12_HEAP_TYPE heapType,
+		D3D12_RESOURCE_STATES initialState);
+	void UploadBufferRegion(
+		Microsoft::WRL::ComPtr<ID3D12Resource> destination,
+		UINT64 destinationOffset,
+		void* data,
+		UINT64 dataSizeInBytes,
+		D3D12_RESOURCE_STATES destinationState);
+
+	// Batched uploads.  While a batch is open, CreateStaticBuffer() and
+	// UploadBufferRegion() only stage their data and queue the copy; all
+	// of the queued copies are recorded and submitted together (with a
+	// single wait) when the batch is flushed or ended.
+	void BeginUploadBatch();
+	void FlushUploadBatch();
+	UploadBatchStats EndUploadBatch();
+	bool IsUploadBatchOpen();
+	UploadBatchStats GetLastUploadBatchStats();
 
 	// Command List and Synchronization
 	void CloseExecuteAndResetCommandList();
@@ -69,10 +90,18 @@ public:
 		void* data,
 		unsigned int dataSizeInBytes);
 
+	// Constant buffers filled since the last submit, and how many fit
+	unsigned int GetConstantBufferFillCount() { return cbFillCount; }
+	unsigned int GetMaxConstantBuffers() { return maxConstantBuffers; }
+
 	// Texture stuffs
 	D3D12_CPU_DESCRIPTOR_HANDLE LoadCubeMap(const wchar_t* file, bool generateMips = true);
 	D3D12_CPU_DESCRIPTOR_HANDLE LoadTexture(const wchar_t* file, bool generateMips = true);
-	D3D12_CPU_DESCRIPTOR_HANDLE LoadTexture(Microsoft::WRL::ComPtr<ID3D12Resource> texture);
+	D3D12_CPU_DESCRIPTOR_HANDLE LoadTexture(
+		Microsoft::WRL::ComPtr<ID3D12Resource> texture,
+		UINT componentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING);
+	Microsoft::WRL::ComPtr<ID3D12Resource> DecodeTexture(const void* fileData, size_t dataSizeInBytes, bool generateMips = true);
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateSolidColorTexture(XMFLOAT4 color);
 	D3D12_GPU_DESCRIPTOR_HANDLE CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(
 		D3D12_CPU_DESCRIPTOR_HANDLE firstDescriptorToCopy,
 		unsigned int numDescriptorsToCopy);
@@ -103,24 +132,31 @@ private:
 	unsigned int width;
 	unsigned int height;
 
-	// Maximum number of constant buffers, assuming each buffer
-	// is 256 bytes or less.  Larger buffers are fine, but will
-	// result in fewer buffers in use at any time
-	const unsigned int maxConstantBuffers = 1000;
+	// Maximum number of constant buffers filled between two submits
+	// (a frame, usually).  A draw fills up to three (the PBR pass one
+	// for the vertex shader and one for the material, the depth prepass
+	// one more), so this covers over 5000 draws; the scene and a fully
+	// streamed world come to around 1200 entities.
+	const unsigned int maxConstantBuffers = 16384;
 	const unsigned int maxRTVs = 1000;
 
-	// GPU-side contant buffer upload heap
+	// GPU-side contant buffer upload heap, which starts out with 256 bytes
+	// per constant buffer and grows if bigger ones fill it
 	Microsoft::WRL::ComPtr<ID3D12Resource> cbUploadHeap;
 	UINT64 cbUploadHeapSizeInBytes;
 	UINT64 cbUploadHeapOffsetInBytes;
 	void* cbUploadHeapStartAddress;
 
+	// Heaps replaced since the last submit, which recorded draws may still read
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> retiredCbUploadHeaps;
+	unsigned int cbFillCount;
+
 	// GPU-side CBV/SRV descriptor heap
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> cbvSrvDescriptorHeap;
 	SIZE_T cbvSrvDescriptorHeapIncrementSize;
 	unsigned int cbvDescriptorOffset;
 
-	void CreateConstantBufferUploadHeap();
+	void CreateConstantBufferUploadHeap(UINT64 sizeInBytes);
 	void CreateCBVSRVDescriptorHeap();
 	void CreateRTVHeap();
 
@@ -141,5 +177,45 @@ private:
 	unsigned int rtvDescriptorOffset;
 	SIZE_T rtvDescriptorSize;
 	std::vector< Microsoft::WRL::ComPtr<ID3D12Resource>> rtvPool;
+
+	// Upload batching
+	struct StagingPage
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		void* cpuAddress;
+		UINT64 sizeInBytes;
+		UINT64 offsetInBytes;
+	};
+
+	struct QueuedBufferCopy
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> destination;
+		UINT64 destinationOffset;
+		ID3D12Resource* source;		// Kept alive by stagingPages
+		UINT64 sourceOffset;
+		UINT64 sizeInBytes;
+		D3D12_RESOURCE_STATES stateBefore;
+		D3D12_RESOURCE_STATES stateAfter;
+	};
+
+	// Pages are at least this big while a batch is open.  Anything
+	// larger gets a page of its own.
+	const UINT64 stagingPageSizeInBytes = 16 * 1024 * 1024;
+
+	std::vector<StagingPage> stagingPages;
+	std::vector<QueuedBufferCopy> queuedCopies;
+	bool uploadBatchOpen = false;
+	UploadBatchStats currentBatchStats = {};
+	UploadBatchStats lastBatchStats = {};
+	std::chrono::high_resolution_clock::time_point uploadBatchStartTime;
+
+	void QueueBufferCopy(
+		Microsoft::WRL::ComPtr<ID3D12Resource> destination,
+		UINT64 destinationOffset,
+		void* data,
+		UINT64 dataSizeInBytes,
+		D3D12_RESOURCE_STATES stateBefore,
+		D3D12_RESOURCE_STATES stateAfter);
+	void SubmitQueuedCopies();
 };
 
@@ -0,0 +1,31 @@
+// Only the position is read, so this pairs with the
+// position-only vertex stream (VertexPosition in C++)
+struct VertexShaderInput
+{
+	float3 localPosition	: POSITION;
+};
+
+// Same layout as VertexShader.hlsl so the same constant
+// buffer data can be used for both
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix worldInverseTranspose;
+	matrix view;
+	matrix projection;
+}
+
+// --------------------------------------------------------
+// Vertex shader for depth-only passes (depth pre-pass,
+// shadow maps).  There's no pixel shader to pass anything to,
+// so only the clip space position comes out.
+// --------------------------------------------------------
+float4 main(VertexShaderInput input) : SV_POSITION
+{
+	// precise, and the same operations in the same order as the
+	// other vertex shaders, so the main pass lands on exactly the
+	// depth written here and passes LESS_EQUAL
+	precise matrix worldViewProj = mul(projection, mul(view, world));
+	precise float4 screenPosition = mul(worldViewProj, float4(input.localPosition, 1.0f));
+	return screenPosition;
+}
@@ -29,13 +29,14 @@ EngineGUI::~EngineGUI()
 	ImGui::DestroyContext();
 }
 
-void EngineGUI::Update(float deltaTime, float totalTime, unsigned int width, unsigned int height, std::vector<std::shared_ptr<GameEntity>> allEntities, std::vector<Light> lights)
+void EngineGUI::Update(float deltaTime, float totalTime, unsigned int width, unsigned int height, std::shared_ptr<EntityManager> allEntities, std::vector<Light> lights, RenderStats renderStats)
 {
 	// Update engineGUI elements
 	this->width = width;
 	this->height = height;
 	this->allEntities = allEntities;
 	this->lights = lights;
+	this->renderStats = renderStats;
 
 	ImGui_ImplDX12_NewFrame();
 	ImGui_ImplWin32_NewFrame();
@@ -82,6 +83,9 @@ void EngineGUI::CreateBaseTree(unsigned int width, unsigned int height)
 	DisplayRTVImages();
 	DisplayLights();
 	DisplayGameEntities();
+	DisplayWorld();
+	DisplayStaticBatching();
+	DisplayHlod();
 	DisplayEmitters();
 
 	ImGui::End();
@@ -95,6 +99,10 @@ void EngineGUI::DisplayGeneralInfo()
 		ImGui::Text(("FPS: " + std::to_string(io.Framerate)).c_str());
 		ImGui::Text(("Width: " + std::to_string(width) + " Height: " + std::to_string(height)).c_str());
 		ImGui::Text(("Aspect Ratio: " + std::to_string((float)width / (float)height)).c_str());
+		ImGui::Text(("Draws: " + std::to_string(renderStats.draws) + " (" + std::to_string(renderStats.items) + " items visible)").c_str());
+		ImGui::Text(("Render CPU: " + std::to_string(renderStats.cpuMs) + " ms").c_str());
+
+		ImGui::Text(("Constant buffers: " + std::to_string(renderStats.constantBuffers) + " / " + std::to_string(renderStats.maxConstantBuffers)).c_str());
 	}
 }
 
@@ -125,6 +133,86 @@ void EngineGUI::DisplayLights()
 
 void EngineGUI::DisplayGameEntities()
 {
+	if (ImGui::CollapsingHeader("Entities") && allEntities)
+	{
+		ImGui::Text(("Entities: " + std::to_string(allEntities->GetCount())).c_str());
+		ImGui::Text(("Archetypes: " + std::to_string(allEntities->GetArchetypeCount())).c_str());
+		ImGui::Text(("Chunks: " + std::to_string(allEntities->GetChunkCount()) + " (" + std::to_string(ENTITY_CHUNK_SIZE / 1024) + " KB each)").c_str());
+
+		LodSelector& lods = LodSelector::GetInstance();
+		ImGui::Text(("LOD bias: " + std::to_string(lods.GetBias())).c_str());
+		ImGui::Text(("LOD triangles: " + std::to_string(lods.GetTrianglesSelected()) + " (" + std::to_string(lods.GetTrianglesSaved()) + " saved)").c_str());
+	}
+}
+
+void EngineGUI::DisplayWorld()
+{
+	WorldPartition& world = WorldPartition::GetInstance();
+	if (ImGui::CollapsingHeader("World Streaming") && world.GetCellCount() > 0)
+	{
+		ImGui::Text(("Cells: " + std::to_string(world.GetCellCount()) +
+			" (" + std::to_string(world.GetCellCount(CellState::Active)) + " active, " +
+			std::to_string(world.GetCellCount(CellState::Loading) + world.GetCellCount(CellState::Loaded) + world.GetCellCount(CellState::Activating)) + " streaming in, " +
+			std::to_string(world.GetCellCount(CellState::Failed)) + " failed)").c_str());
+		ImGui::Text(("Streamed entities: " + std::to_string(world.GetStreamedEntityCount())).c_str());
+		ImGui::Text(("Resident assets: " + std::to_string(world.GetResidentMeshCount()) + " meshes, " + std::to_string(world.GetResidentMaterialCount()) + " materials").c_str());
+		ImGui::Text(("Bandwidth: " + std::to_string(world.GetBytesPerSecond() / 1024.0) + " KB/s (" + std::to_string(world.GetBytesLoaded() / 1024) + " KB total)").c_str());
+		ImGui::Text(("Activation: " + std::to_string(world.GetLastActivationMs()) + " ms").c_str());
+
+		// One square per cell, coloured by its state
+		const ImU32 colors[] = {
+			IM_COL32(60, 60, 60, 255),		// Unloaded
+			IM_COL32(200, 160, 40, 255),	// Loading
+			IM_COL32(80, 120, 220, 255),	// Loaded
+			IM_COL32(80, 200, 220, 255),	// Activating
+			IM_COL32(60, 200, 80, 255),		// Active
+			IM_COL32(220, 60, 60, 255)		// Failed
+		};
+		const float size = 12.0f;
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		ImVec2 corner = ImGui::GetCursorScreenPos();
+		for (int z = 0; z < world.GetCellsZ(); z++)
+		{
+			for (int x = 0; x < world.GetCellsX(); x++)
+			{
+				// Rows go up the screen as z goes up the world
+				ImVec2 min(corner.x + x * size, corner.y + (world.GetCellsZ() - 1 - z) * size);
+				CellState state = world.GetCellState(world.GetMinCellX() + x, world.GetMinCellZ() + z);
+				drawList->AddRectFilled(min, ImVec2(min.x + size - 1, min.y + size - 1), colors[(int)state]);
+			}
+		}
+		ImGui::Dummy(ImVec2(world.GetCellsX() * size, world.GetCellsZ() * size));
+	}
+}
+
+void EngineGUI::DisplayStaticBatching()
+{
+	StaticBatcher& batcher = StaticBatcher::GetInstance();
+	if (ImGui::CollapsingHeader("Static Batching") && allEntities)
+	{
+		bool enabled = batcher.GetEnabled();
+		if (ImGui::Checkbox("Batch static scenery", &enabled))
+			batcher.SetEnabled(*allEntities, enabled);
+
+		ImGui::Text(("Static instances: " + std::to_string(batcher.GetInstanceCount()) + " in " + std::to_string(batcher.GetBatchCount()) + " batches").c_str());
+		ImGui::Text(("Draws: " + std::to_string(renderStats.draws) + ", render CPU: " + std::to_string(renderStats.cpuMs) + " ms").c_str());
+	}
+}
+
+void EngineGUI::DisplayHlod()
+{
+	HlodSystem& hlod = HlodSystem::GetInstance();
+	if (ImGui::CollapsingHeader("HLOD"))
+	{
+		float distance = hlod.GetDistance();
+		if (ImGui::SliderFloat("Proxy distance", &distance, 5.0f, 100.0f))
+			hlod.SetDistance(distance);
+
+		ImGui::Text(("Proxies: " + std::to_string(hlod.GetProxiesShown()) + " of " + std::to_string(hlod.GetClusterCount()) + " clusters").c_str());
+		ImGui::Text(("Draws saved: " + std::to_string(hlod.GetDrawsSaved())).c_str());
+		ImGui::Text(("Constant buffers: " + std::to_string(renderStats.constantBuffers) + " / " + std::to_string(renderStats.maxConstantBuffers)).c_str());
+		ImGui::Text(("Proxy triangles: " + std::to_string(hlod.GetProxyTriangles()) + " (from " + std::to_string(hlod.GetSourceTriangles()) + ")").c_str());
+	}
 }
 
 void EngineGUI::DisplayEmitters()
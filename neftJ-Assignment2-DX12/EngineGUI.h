@@ -1,6 +1,10 @@
 #pragma once
 
-#include "GameEntity.h"
+#include "EntityManager.h"
+#include "LodSelector.h"
+#include "WorldPartition.h"
+#include "StaticBatcher.h"
+#include "HlodSystem.h"
 #include "Input.h"
 #include "Assets.h"
 
@@ -17,8 +21,9 @@ public:
 	~EngineGUI();
 
 	void Update(float deltaTime, float totalTime, unsigned int width, unsigned int height,
-		std::vector<std::shared_ptr<GameEntity>> allEntities,
-		std::vector<Light> lights);
+		std::shared_ptr<EntityManager> allEntities,
+		std::vector<Light> lights,
+		RenderStats renderStats);
 	void Draw();
 
 private:
@@ -31,11 +36,8 @@ private:
 
 	// Scene information
 	std::vector<Light> lights;
-	std::vector<std::shared_ptr<GameEntity>> allEntities;
-	std::vector<std::shared_ptr<GameEntity>> standardEntities;
-	std::vector<std::shared_ptr<GameEntity>> pbrEntities;
-	std::vector<std::shared_ptr<GameEntity>> transparentEntities;
-	std::vector<std::shared_ptr<GameEntity>> refractiveEntities;
+	std::shared_ptr<EntityManager> allEntities;
+	RenderStats renderStats;
 
 	// Drawing methods (breaking up drawing for my own sanity)
 	void CreateBaseTree(unsigned int width, unsigned int height);
@@ -45,8 +47,11 @@ private:
 	void DisplayLights();
 	void CreateSingleLight(Light* light, unsigned int lightNum);
 	void DisplayGameEntities();
-	void CreateSingleEntity(std::shared_ptr<GameEntity> ge, unsigned int geNum);
+	void CreateSingleEntity(Entity e, unsigned int geNum);
 	void CreateSingleMaterial(std::string name, std::shared_ptr<Material> mat);
+	void DisplayWorld();
+	void DisplayStaticBatching();
+	void DisplayHlod();
 	void DisplayEmitters();
 	//void CreateSingleEmitter(std::shared_ptr<Emitter> e, int eNum);
 };
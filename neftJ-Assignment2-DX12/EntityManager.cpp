@@ -0,0 +1,312 @@
+#include "EntityManager.h"
+#include "Components.h"
+#include "TransformStore.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Rounds a size within a chunk up to the next cache line
+static unsigned int AlignToCacheLine(unsigned int size) { return (size + 63) & ~63u; }
+
+EntityManager::EntityManager()
+{
+}
+
+EntityManager::~EntityManager()
+{
+	// Let components release what they refer to
+	for (uint32_t i = 0; i < records.size(); i++)
+	{
+		Entity e = { i, records[i].generation };
+		if (IsAlive(e))
+			Destroy(e);
+	}
+
+	for (Archetype& archetype : archetypes)
+	{
+		for (EntityChunk* chunk : archetype.chunks)
+			delete chunk;
+	}
+}
+
+std::vector<EntityManager::ComponentTypeInfo>& EntityManager::GetComponentTypes()
+{
+	static std::vector<ComponentTypeInfo> types;
+	return types;
+}
+
+unsigned int EntityManager::RegisterComponentType(unsigned int size, void (*cleanup)(void* component))
+{
+	std::vector<ComponentTypeInfo>& types = GetComponentTypes();
+
+	// Every type needs its own signature bit, and handing out a shared one
+	// would silently mix two components' data, so this is fatal
+	if (types.size() == ENTITY_MAX_COMPONENT_TYPES)
+	{
+		fprintf(stderr, "More than %d component types registered\n", ENTITY_MAX_COMPONENT_TYPES);
+		assert(false);
+		abort();
+	}
+
+	types.push_back({ size, cleanup });
+	return (unsigned int)types.size() - 1;
+}
+
+void EntityManager::RunCleanup(unsigned int type, void* component)
+{
+	if (GetComponentTypes()[type].cleanup)
+		GetComponentTypes()[type].cleanup(component);
+}
+
+bool EntityManager::IsAlive(Entity e)
+{
+	return e.index < records.size() &&
+		records[e.index].generation == e.generation &&
+		records[e.index].archetype != UINT32_MAX;
+}
+
+void EntityManager::Destroy(Entity e)
+{
+	if (!IsAlive(e))
+		return;
+
+	EntityRecord& record = records[e.index];
+	Archetype& archetype = archetypes[record.archetype];
+	for (unsigned int type = 0; type < ENTITY_MAX_COMPONENT_TYPES; type++)
+	{
+		if (archetype.signature & (1ull << type))
+			RunCleanup(type, archetype.chunks[record.chunk]->data + archetype.offsets[type] + record.row * GetComponentTypes()[type].size);
+	}
+
+	RemoveRow(record.archetype, record.chunk, record.row);
+
+	// Bumping the generation makes any copies of this entity stale
+	record.archetype = UINT32_MAX;
+	record.generation++;
+	freeIndices.push_back(e.index);
+}
+
+unsigned int EntityManager::GetChunkCount()
+{
+	unsigned int count = 0;
+	for (Archetype& archetype : archetypes)
+		count += (unsigned int)archetype.chunks.size();
+	return count;
+}
+
+// --------------------------------------------------------
+// Finds (or sets up) the archetype for a set of components,
+// working out how many entities fit in a chunk and where
+// each component's array starts
+// --------------------------------------------------------
+uint32_t EntityManager::GetArchetype(uint64_t signature)
+{
+	auto existing = archetypeLookup.find(signature);
+	if (existing != archetypeLookup.end())
+		return existing->second;
+
+	Archetype archetype = {};
+	archetype.signature = signature;
+
+	std::vector<ComponentTypeInfo>& types = GetComponentTypes();
+	unsigned int rowSize = sizeof(Entity);
+	for (unsigned int type = 0; type < ENTITY_MAX_COMPONENT_TYPES; type++)
+	{
+		if (signature & (1ull << type))
+			rowSize += types[type].size;
+	}
+
+	// How many bytes a chunk of the given capacity needs,
+	// with every array starting on its own cache line
+	auto layoutSize = [&](unsigned int capacity)
+		{
+			unsigned int size = AlignToCacheLine(capacity * sizeof(Entity));
+			for (unsigned int type = 0; type < ENTITY_MAX_COMPONENT_TYPES; type++)
+			{
+				if (signature & (1ull << type))
+					size += AlignToCacheLine(capacity * types[type].size);
+			}
+			return size;
+		};
+
+	// Start from the most that could fit and back off until
+	// the cache line padding between arrays fits too
+	unsigned int capacity = sizeof(EntityChunk::data) / rowSize;
+	while (capacity > 0 && layoutSize(capacity) > sizeof(EntityChunk::data))
+		capacity--;
+
+	if (capacity == 0)
+	{
+		fprintf(stderr, "Components of %u bytes per entity don't fit in a %d byte chunk\n", rowSize, ENTITY_CHUNK_SIZE);
+		assert(false);
+		abort();
+	}
+
+	// Lay the arrays out for the capacity that was settled on
+	unsigned int offset = AlignToCacheLine(capacity * sizeof(Entity));
+	for (unsigned int type = 0; type < ENTITY_MAX_COMPONENT_TYPES; type++)
+	{
+		if (!(signature & (1ull << type)))
+			continue;
+
+		archetype.offsets[type] = offset;
+		offset += AlignToCacheLine(capacity * types[type].size);
+	}
+	archetype.capacity = capacity;
+
+	archetypes.push_back(archetype);
+	archetypeLookup[signature] = (uint32_t)archetypes.size() - 1;
+	return (uint32_t)archetypes.size() - 1;
+}
+
+Entity EntityManager::CreateWithSignature(uint64_t signature)
+{
+	Entity e;
+	if (freeIndices.empty())
+	{
+		e.index = (uint32_t)records.size();
+		e.generation = 0;
+		records.push_back({ UINT32_MAX, 0, 0, 0 });
+	}
+	else
+	{
+		e.index = freeIndices.back();
+		e.generation = records[e.index].generation;
+		freeIndices.pop_back();
+	}
+
+	uint32_t archetypeIndex = GetArchetype(signature);
+	AddRow(archetypeIndex, records[e.index]);
+
+	Archetype& archetype = archetypes[archetypeIndex];
+	reinterpret_cast<Entity*>(archetype.chunks[records[e.index].chunk]->data)[records[e.index].row] = e;
+	return e;
+}
+
+// --------------------------------------------------------
+// Makes room for one more entity at the end of an archetype
+// and points the record at it
+// --------------------------------------------------------
+void EntityManager::AddRow(uint32_t archetypeIndex, EntityRecord& record)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+	if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.capacity)
+	{
+		EntityChunk* chunk = new EntityChunk;
+		chunk->count = 0;
+		archetype.chunks.push_back(chunk);
+	}
+
+	EntityChunk* chunk = archetype.chunks.back();
+	record.archetype = archetypeIndex;
+	record.chunk = (uint32_t)archetype.chunks.size() - 1;
+	record.row = chunk->count++;
+}
+
+// --------------------------------------------------------
+// Fills a gap with the archetype's last entity, so chunks
+// stay packed
+// --------------------------------------------------------
+void EntityManager::RemoveRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+	EntityChunk* chunk = archetype.chunks[chunkIndex];
+	EntityChunk* lastChunk = archetype.chunks.back();
+	uint32_t lastRow = lastChunk->count - 1;
+
+	if (chunk != lastChunk || row != lastRow)
+	{
+		std::vector<ComponentTypeInfo>& types = GetComponentTypes();
+		for (unsigned int type = 0; type < ENTITY_MAX_COMPONENT_TYPES; type++)
+		{
+			if (!(archetype.signature & (1ull << type)))
+				continue;
+
+			unsigned int size = types[type].size;
+			memcpy(chunk->data + archetype.offsets[type] + row * size,
+				lastChunk->data + archetype.offsets[type] + lastRow * size, size);
+		}
+
+		Entity moved = reinterpret_cast<Entity*>(lastChunk->data)[lastRow];
+		reinterpret_cast<Entity*>(chunk->data)[row] = moved;
+		records[moved.index].chunk = chunkIndex;
+		records[moved.index].row = row;
+	}
+
+	lastChunk->count--;
+	if (lastChunk->count == 0)
+	{
+		delete lastChunk;
+		archetype.chunks.pop_back();
+	}
+}
+
+// --------------------------------------------------------
+// Moves an entity to another archetype, keeping the
+// components the two have in common
+// --------------------------------------------------------
+void EntityManager::MoveToSignature(Entity e, uint64_t signature)
+{
+	EntityRecord oldRecord = records[e.index];
+	EntityRecord newRecord = oldRecord;
+	uint32_t newArchetypeIndex = GetArchetype(signature);
+	AddRow(newArchetypeIndex, newRecord);
+
+	// Both references are safe to hold now that GetArchetype() is done
+	Archetype& oldArchetype = archetypes[oldRecord.archetype];
+	Archetype& newArchetype = archetypes[newArchetypeIndex];
+	EntityChunk* from = oldArchetype.chunks[oldRecord.chunk];
+	EntityChunk* to = newArchetype.chunks[newRecord.chunk];
+
+	std::vector<ComponentTypeInfo>& types = GetComponentTypes();
+	uint64_t shared = oldArchetype.signature & newArchetype.signature;
+	for (unsigned int type = 0; type < ENTITY_MAX_COMPONENT_TYPES; type++)
+	{
+		if (!(shared & (1ull << type)))
+			continue;
+
+		unsigned int size = types[type].size;
+		memcpy(to->data + newArchetype.offsets[type] + newRecord.row * size,
+			from->data + oldArchetype.offsets[type] + oldRecord.row * size, size);
+	}
+	reinterpret_cast<Entity*>(to->data)[newRecord.row] = e;
+
+	RemoveRow(oldRecord.archetype, oldRecord.chunk, oldRecord.row);
+	records[e.index] = newRecord;
+}
+
+EntityUpdateTimings EntityManager::MeasureUpdate(unsigned int numEntities)
+{
+	EntityUpdateTimings timings = {};
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	{
+		EntityManager entities;
+		TransformStore& store = TransformStore::GetInstance();
+
+		auto start = now();
+		for (unsigned int i = 0; i < numEntities; i++)
+		{
+			uint32_t transform = store.Allocate();
+			store.SetPosition(transform, DirectX::XMFLOAT3((float)(i % 1000), 0, (float)(i / 1000)));
+			entities.Create(TransformComponent{ transform }, SpinComponent{ (float)(i % 7) * 0.1f + 0.1f });
+		}
+		timings.createMs = std::chrono::duration<double, std::milli>(now() - start).count();
+		timings.chunks = entities.GetChunkCount();
+
+		start = now();
+		UpdateSpinners(entities, 0.016f, false);
+		timings.updateMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+		start = now();
+		UpdateSpinners(entities, 0.016f, true);
+		timings.updateThreadedMs = std::chrono::duration<double, std::milli>(now() - start).count();
+	}
+
+	// The transforms were all freed with the entities
+	TransformStore::GetInstance().Trim();
+	return timings;
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Size of one block of entities, which all share an archetype
+#define ENTITY_CHUNK_SIZE			(16 * 1024)
+
+// Component types are told apart by one bit each in a signature
+#define ENTITY_MAX_COMPONENT_TYPES	64
+
+// Below this many entities a parallel query stays on one thread
+#define ENTITY_PARALLEL_MIN			16384
+
+// --------------------------------------------------------
+// An entity is nothing but an id.  The generation changes
+// every time an index is reused, so a stale copy of a
+// destroyed entity never matches the new one.
+// --------------------------------------------------------
+struct Entity
+{
+	uint32_t index;
+	uint32_t generation;
+
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// --------------------------------------------------------
+// One 16 KB block of entities.  The data holds the entity
+// ids and then one array per component (each starting on
+// a cache line), so a system touching two components only
+// ever reads those two arrays.
+// --------------------------------------------------------
+struct EntityChunk
+{
+	unsigned int count;
+	alignas(64) unsigned char data[ENTITY_CHUNK_SIZE - 64];
+};
+
+// Timings from MeasureUpdate()
+struct EntityUpdateTimings
+{
+	double createMs;			// Creating every entity
+	double updateMs;			// One pass over every entity, one thread
+	double updateThreadedMs;	// The same pass, all cores
+	unsigned int chunks;
+};
+
+// --------------------------------------------------------
+// Stores entities by archetype (the exact set of component
+// types they have).  Each archetype keeps its entities in
+// 16 KB chunks, and every chunk but the last is full, since
+// destroying an entity moves the archetype's last one into
+// the gap.  Adding or removing a component moves the entity
+// to the matching archetype.
+//
+// Components have to be plain data, since they're moved
+// with memcpy.  One that refers to something it has to
+// release can have a static Cleanup(T&), which is called
+// whenever an entity loses it (when it's destroyed or by
+// Remove()).
+//
+// Queries pick out every chunk with a set of components
+// and hand over the arrays directly, optionally spread
+// across all cores.  Nothing may be created, destroyed or
+// moved during a query, and pointers from Get() are only
+// good until the next of those.
+// --------------------------------------------------------
+class EntityManager
+{
+public:
+	EntityManager();
+	~EntityManager();
+
+	EntityManager(EntityManager const&) = delete;
+	void operator=(EntityManager const&) = delete;
+
+	// Every component type gets a number the first time it's used
+	template<typename T>
+	static unsigned int ComponentType()
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Components are moved with memcpy, so they need to be plain data");
+		static_assert(alignof(T) <= 64, "Component arrays are only aligned to cache lines");
+		static_assert(64 + sizeof(T) <= sizeof(EntityChunk::data), "A component has to fit in a chunk next to its entity");
+		static unsigned int type = RegisterComponentType((unsigned int)sizeof(T), CleanupFunction<T>());
+		return type;
+	}
+
+	template<typename... Components>
+	Entity Create(const Components&... components)
+	{
+		Entity e = CreateWithSignature(SignatureOf<Components...>());
+		((*Get<Components>(e) = components), ...);
+		return e;
+	}
+
+	void Destroy(Entity e);
+	bool IsAlive(Entity e);
+
+	// Null if the entity doesn't have one (or has been destroyed)
+	template<typename T>
+	T* Get(Entity e)
+	{
+		if (!IsAlive(e))
+			return nullptr;
+
+		const EntityRecord& record = records[e.index];
+		const Archetype& archetype = archetypes[record.archetype];
+		unsigned int type = ComponentType<T>();
+		if (!(archetype.signature & (1ull << type)))
+			return nullptr;
+
+		return reinterpret_cast<T*>(archetype.chunks[record.chunk]->data + archetype.offsets[type]) + record.row;
+	}
+
+	template<typename T>
+	bool Has(Entity e) { return IsAlive(e) && (archetypes[records[e.index].archetype].signature & (1ull << ComponentType<T>())) != 0; }
+
+	// Adding a component the entity already has cleans up
+	// the old value and sets the new one
+	template<typename T>
+	void Add(Entity e, const T& component)
+	{
+		assert(IsAlive(e));
+		if (Has<T>(e))
+			RunCleanup(ComponentType<T>(), Get<T>(e));
+		else
+			MoveToSignature(e, archetypes[records[e.index].archetype].signature | (1ull << ComponentType<T>()));
+		*Get<T>(e) = component;
+	}
+
+	template<typename T>
+	void Remove(Entity e)
+	{
+		if (!Has<T>(e))
+			return;
+
+		RunCleanup(ComponentType<T>(), Get<T>(e));
+		MoveToSignature(e, archetypes[records[e.index].archetype].signature & ~(1ull << ComponentType<T>()));
+	}
+
+	// --------------------------------------------------------
+	// Calls f(count, entities, components...) for each chunk
+	// with all of the components, where each is an array of
+	// count elements
+	// --------------------------------------------------------
+	template<typename... Components, typename F>
+	void ForEachChunk(F f)
+	{
+		uint64_t signature = SignatureOf<Components...>();
+		for (Archetype& archetype : archetypes)
+		{
+			if ((archetype.signature & signature) != signature)
+				continue;
+
+			for (EntityChunk* chunk : archetype.chunks)
+				CallWithChunk<Components...>(archetype, chunk, f);
+		}
+	}
+
+	// The same, but with the chunks split between all cores.  Each chunk
+	// is only seen by one thread, but f is called from several at once.
+	template<typename... Components, typename F>
+	void ParallelForEachChunk(F f, bool allowThreads = true)
+	{
+		uint64_t signature = SignatureOf<Components...>();
+		std::vector<std::pair<Archetype*, EntityChunk*>> chunks;
+		size_t entityCount = 0;
+		for (Archetype& archetype : archetypes)
+		{
+			if ((archetype.signature & signature) != signature)
+				continue;
+
+			for (EntityChunk* chunk : archetype.chunks)
+			{
+				chunks.push_back(std::make_pair(&archetype, chunk));
+				entityCount += chunk->count;
+			}
+		}
+
+		auto job = [&chunks, &f](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				CallWithChunk<Components...>(*chunks[i].first, chunks[i].second, f);
+		};
+
+		unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+		if (cores == 1 || entityCount < ENTITY_PARALLEL_MIN)
+		{
+			job(0, chunks.size());
+			return;
+		}
+
+		std::vector<std::future<void>> jobs;
+		size_t perJob = (chunks.size() + cores - 1) / cores;
+		for (size_t first = perJob; first < chunks.size(); first += perJob)
+		{
+			size_t last = std::min(first + perJob, chunks.size());
+			jobs.push_back(std::async(std::launch::async, [&job, first, last]() { job(first, last); }));
+		}
+
+		job(0, std::min(perJob, chunks.size()));
+		for (auto& j : jobs)
+			j.get();
+	}
+
+	// Calls f(entity, components&...) for every entity with all of the components
+	template<typename... Components, typename F>
+	void ForEach(F f)
+	{
+		ForEachChunk<Components...>([&f](unsigned int count, Entity* entities, Components*... components)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				f(entities[i], components[i]...);
+		});
+	}
+
+	template<typename... Components, typename F>
+	void ParallelForEach(F f, bool allowThreads = true)
+	{
+		ParallelForEachChunk<Components...>([&f](unsigned int count, Entity* entities, Components*... components)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				f(entities[i], components[i]...);
+		}, allowThreads);
+	}
+
+	unsigned int GetCount() { return (unsigned int)(records.size() - freeIndices.size()); }
+	unsigned int GetArchetypeCount() { return (unsigned int)archetypes.size(); }
+	unsigned int GetChunkCount();
+
+	// Creates lots of spinning entities in a separate manager and times
+	// the same update the game does on them
+	static EntityUpdateTimings MeasureUpdate(unsigned int numEntities);
+
+private:
+	struct ComponentTypeInfo
+	{
+		unsigned int size;
+		void (*cleanup)(void* component);
+	};
+
+	struct Archetype
+	{
+		uint64_t signature;
+		unsigned int capacity;								// Entities per chunk
+		unsigned int offsets[ENTITY_MAX_COMPONENT_TYPES];	// Start of each component's array within a chunk
+		std::vector<EntityChunk*> chunks;
+	};
+
+	// Where an entity lives
+	struct EntityRecord
+	{
+		uint32_t archetype;
+		uint32_t chunk;
+		uint32_t row;
+		uint32_t generation;
+	};
+
+	std::vector<Archetype> archetypes;
+	std::unordered_map<uint64_t, uint32_t> archetypeLookup;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+
+	static std::vector<ComponentTypeInfo>& GetComponentTypes();
+	static unsigned int RegisterComponentType(unsigned int size, void (*cleanup)(void* component));
+
+	template<typename T, typename = void>
+	struct HasCleanup : std::false_type {};
+	template<typename T>
+	struct HasCleanup<T, std::void_t<decltype(T::Cleanup(std::declval<T&>()))>> : std::true_type {};
+
+	template<typename T>
+	static constexpr void (*CleanupFunction())(void*)
+	{
+		if constexpr (HasCleanup<T>::value)
+			return [](void* component) { T::Cleanup(*static_cast<T*>(component)); };
+		else
+			return nullptr;
+	}
+	static void RunCleanup(unsigned int type, void* component);
+
+	template<typename... Components>
+	static uint64_t SignatureOf() { return (0ull | ... | (1ull << ComponentType<Components>())); }
+
+	template<typename... Components, typename F>
+	static void CallWithChunk(Archetype& archetype, EntityChunk* chunk, F& f)
+	{
+		f(chunk->count, reinterpret_cast<Entity*>(chunk->data),
+			reinterpret_cast<Components*>(chunk->data + archetype.offsets[ComponentType<Components>()])...);
+	}
+
+	uint32_t GetArchetype(uint64_t signature);
+	Entity CreateWithSignature(uint64_t signature);
+	void AddRow(uint32_t archetypeIndex, EntityRecord& record);
+	void RemoveRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row);
+	void MoveToSignature(Entity e, uint64_t signature);
+};
@@ -0,0 +1,222 @@
+#include "FreeListAllocator.h"
+#include <algorithm>
+
+FreeListAllocator::FreeListAllocator(uint64_t capacity)
+{
+	Reset(capacity);
+}
+
+FreeListAllocator::~FreeListAllocator()
+{
+
+}
+
+void FreeListAllocator::Reset(uint64_t capacity)
+{
+	this->capacity = capacity;
+	this->used = 0;
+
+	freeBlocks.clear();
+	records.clear();
+	freeIds.clear();
+
+	// Everything starts out as one big free block
+	if (capacity > 0)
+		freeBlocks.insert({ 0, capacity });
+}
+
+FreeListAllocator::Allocation FreeListAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	Allocation result = { InvalidId, InvalidOffset, 0 };
+	if (size == 0) return result;
+	if (alignment == 0) alignment = 1;
+
+	// First fit, walking the free blocks from the lowest offset up.
+	// This keeps things packed towards the front of the buffer.
+	for (auto it = freeBlocks.begin(); it != freeBlocks.end(); it++)
+	{
+		uint64_t blockOffset = it->first;
+		uint64_t blockSize = it->second;
+
+		uint64_t alignedOffset = AlignUp(blockOffset, alignment);
+		uint64_t padding = alignedOffset - blockOffset;
+		if (padding + size > blockSize)
+			continue;
+
+		// Carve the allocation out of this block, leaving the
+		// padding (if any) and the remainder (if any) as free blocks
+		freeBlocks.erase(it);
+		if (padding > 0)
+			freeBlocks.insert({ blockOffset, padding });
+
+		uint64_t remainder = blockSize - padding - size;
+		if (remainder > 0)
+			freeBlocks.insert({ alignedOffset + size, remainder });
+
+		// Grab an id for this allocation, recycling if we can
+		uint32_t id;
+		if (!freeIds.empty())
+		{
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else
+		{
+			id = (uint32_t)records.size();
+			records.push_back({});
+		}
+
+		records[id] = { alignedOffset, size, alignment, true };
+		used += size;
+
+		result.id = id;
+		result.offset = alignedOffset;
+		result.size = size;
+		return result;
+	}
+
+	// Nothing big enough
+	return result;
+}
+
+void FreeListAllocator::Free(uint32_t id)
+{
+	if (!IsValid(id)) return;
+
+	Record& r = records[id];
+	InsertFreeBlock(r.offset, r.size);
+	used -= r.size;
+
+	r.live = false;
+	freeIds.push_back(id);
+}
+
+void FreeListAllocator::Grow(uint64_t newCapacity)
+{
+	if (newCapacity <= capacity) return;
+
+	InsertFreeBlock(capacity, newCapacity - capacity);
+	capacity = newCapacity;
+}
+
+std::vector<FreeListAllocator::Move> FreeListAllocator::Defragment()
+{
+	std::vector<Move> moves;
+
+	// Gather the live allocations in offset order
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < records.size(); i++)
+	{
+		if (records[i].live) order.push_back(i);
+	}
+	std::sort(order.begin(), order.end(),
+		[&](uint32_t a, uint32_t b) { return records[a].offset < records[b].offset; });
+
+	// Slide each one down as far as its alignment allows.  Since we go in
+	// offset order, a destination never passes its own source.
+	uint64_t cursor = 0;
+	for (uint32_t id : order)
+	{
+		Record& r = records[id];
+		uint64_t dst = AlignUp(cursor, r.alignment);
+		moves.push_back({ id, r.offset, dst, r.size });
+		r.offset = dst;
+		cursor = dst + r.size;
+	}
+
+	// Rebuild the free list from the gaps (alignment padding + the tail)
+	freeBlocks.clear();
+	uint64_t previousEnd = 0;
+	for (uint32_t id : order)
+	{
+		if (records[id].offset > previousEnd)
+			freeBlocks.insert({ previousEnd, records[id].offset - previousEnd });
+		previousEnd = records[id].offset + records[id].size;
+	}
+	if (capacity > previousEnd)
+		freeBlocks.insert({ previousEnd, capacity - previousEnd });
+
+	return moves;
+}
+
+bool FreeListAllocator::IsValid(uint32_t id)
+{
+	return id < records.size() && records[id].live;
+}
+
+uint64_t FreeListAllocator::GetOffset(uint32_t id)
+{
+	return IsValid(id) ? records[id].offset : InvalidOffset;
+}
+
+uint64_t FreeListAllocator::GetSize(uint32_t id)
+{
+	return IsValid(id) ? records[id].size : 0;
+}
+
+uint64_t FreeListAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+uint64_t FreeListAllocator::GetUsed()
+{
+	return used;
+}
+
+uint64_t FreeListAllocator::GetFree()
+{
+	return capacity - used;
+}
+
+uint64_t FreeListAllocator::GetLargestFreeBlock()
+{
+	uint64_t largest = 0;
+	for (const auto& [offset, size] : freeBlocks)
+		largest = std::max(largest, size);
+	return largest;
+}
+
+unsigned int FreeListAllocator::GetFreeBlockCount()
+{
+	return (unsigned int)freeBlocks.size();
+}
+
+unsigned int FreeListAllocator::GetAllocationCount()
+{
+	return (unsigned int)(records.size() - freeIds.size());
+}
+
+// --------------------------------------------------------
+// Adds a block to the free list, merging it with the blocks
+// directly before and after it if they touch
+// --------------------------------------------------------
+void FreeListAllocator::InsertFreeBlock(uint64_t offset, uint64_t size)
+{
+	// Merge with the following block?
+	auto next = freeBlocks.find(offset + size);
+	if (next != freeBlocks.end())
+	{
+		size += next->second;
+		freeBlocks.erase(next);
+	}
+
+	// Merge with the previous block?
+	auto prev = freeBlocks.lower_bound(offset);
+	if (prev != freeBlocks.begin())
+	{
+		prev--;
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+
+	freeBlocks.insert({ offset, size });
+}
+
+uint64_t FreeListAllocator::AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
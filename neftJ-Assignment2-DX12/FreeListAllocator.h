@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// --------------------------------------------------------
+// A simple offset allocator that hands out ranges of some
+// larger block of memory (a GPU buffer, usually).
+//
+// It never touches the memory itself - it only does the
+// bookkeeping - so it has no DirectX dependencies at all.
+// Units are up to the caller (bytes, vertices, indices...).
+// --------------------------------------------------------
+class FreeListAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+	static const uint32_t InvalidId = ~0u;
+
+	// One live allocation
+	struct Allocation
+	{
+		uint32_t id;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// One relocation produced by Defragment()
+	struct Move
+	{
+		uint32_t id;
+		uint64_t srcOffset;
+		uint64_t dstOffset;
+		uint64_t size;
+	};
+
+	FreeListAllocator(uint64_t capacity = 0);
+	~FreeListAllocator();
+
+	void Reset(uint64_t capacity);
+
+	// Returns an allocation with offset == InvalidOffset if nothing fits
+	Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+	void Free(uint32_t id);
+
+	// Adds space to the end of the range, merging it with any trailing free block
+	void Grow(uint64_t newCapacity);
+
+	// Packs every allocation towards offset zero (keeping their alignment)
+	// and returns one move per live allocation, in offset order, for the
+	// caller to apply to the real memory.  Allocations that stayed put
+	// have srcOffset == dstOffset.
+	std::vector<Move> Defragment();
+
+	// Getters
+	bool IsValid(uint32_t id);
+	uint64_t GetOffset(uint32_t id);
+	uint64_t GetSize(uint32_t id);
+	uint64_t GetCapacity();
+	uint64_t GetUsed();
+	uint64_t GetFree();
+	uint64_t GetLargestFreeBlock();
+	unsigned int GetFreeBlockCount();
+	unsigned int GetAllocationCount();
+
+private:
+	struct Record
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t alignment;
+		bool live;
+	};
+
+	uint64_t capacity;
+	uint64_t used;
+
+	// Free blocks keyed by offset so neighbours can be found for coalescing
+	std::map<uint64_t, uint64_t> freeBlocks;
+
+	// Allocation records indexed by id, plus a list of ids we can recycle
+	std::vector<Record> records;
+	std::vector<uint32_t> freeIds;
+
+	void InsertFreeBlock(uint64_t offset, uint64_t size);
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment);
+};
@@ -0,0 +1,341 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+Frustum Frustum::FromViewProjection(XMFLOAT4X4 view, XMFLOAT4X4 projection)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	// With row vectors each clip space coordinate is a column of the
+	// matrix, and each plane is a sum or difference of two of them
+	// (D3D's depth runs 0 to 1, so near is the z column on its own)
+	auto column = [&m](int c) { return XMFLOAT4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]); };
+	XMFLOAT4 x = column(0), y = column(1), z = column(2), w = column(3);
+
+	Frustum frustum;
+	frustum.planes[0] = XMFLOAT4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w);	// Left
+	frustum.planes[1] = XMFLOAT4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w);	// Right
+	frustum.planes[2] = XMFLOAT4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w);	// Bottom
+	frustum.planes[3] = XMFLOAT4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w);	// Top
+	frustum.planes[4] = z;														// Near
+	frustum.planes[5] = XMFLOAT4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w);	// Far
+
+	// Normalized so the distances can be compared to radii
+	for (XMFLOAT4& p : frustum.planes)
+	{
+		float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+		p = XMFLOAT4(p.x / length, p.y / length, p.z / length, p.w / length);
+	}
+
+	return frustum;
+}
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+}
+
+void FrustumCuller::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+	count = 0;
+}
+
+void FrustumCuller::Reserve(unsigned int numSpheres)
+{
+	size_t padded = (numSpheres + 3) & ~3u;
+	for (std::vector<float>* a : { &centerX, &centerY, &centerZ, &radius })
+		a->reserve(padded);
+}
+
+uint32_t FrustumCuller::Add(XMFLOAT3 center, float radius)
+{
+	// Start a new group of four, filled with spheres that are never visible
+	if (count % 4 == 0)
+	{
+		for (std::vector<float>* a : { &centerX, &centerY, &centerZ })
+			a->resize(count + 4, 0.0f);
+		this->radius.resize(count + 4, -FLT_MAX);
+	}
+
+	centerX[count] = center.x;
+	centerY[count] = center.y;
+	centerZ[count] = center.z;
+	this->radius[count] = radius;
+	return count++;
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<uint32_t>& visible, bool allowThreads)
+{
+	visible.clear();
+
+	size_t groups = (count + 3) / 4;
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	if (cores == 1 || count < CULLING_PARALLEL_MIN)
+	{
+		CullGroups(frustum, 0, groups, visible);
+		return;
+	}
+
+	// Each thread gets a range of groups and its own list, and
+	// the lists are joined in order so the output doesn't change
+	size_t perJob = (groups + cores - 1) / cores;
+	std::vector<std::vector<uint32_t>> lists((groups + perJob - 1) / perJob);
+	std::vector<std::future<void>> jobs;
+	for (size_t j = 1; j < lists.size(); j++)
+	{
+		size_t first = j * perJob;
+		size_t last = std::min(first + perJob, groups);
+		jobs.push_back(std::async(std::launch::async, [this, &frustum, &lists, j, first, last]() { CullGroups(frustum, first, last, lists[j]); }));
+	}
+
+	CullGroups(frustum, 0, std::min(perJob, groups), visible);
+	for (size_t j = 1; j < lists.size(); j++)
+	{
+		jobs[j - 1].get();
+		visible.insert(visible.end(), lists[j].begin(), lists[j].end());
+	}
+}
+
+// --------------------------------------------------------
+// Tests four spheres against each plane at a time.  A
+// sphere is outside if it's entirely behind any one plane,
+// and a group stops being tested once all four are out.
+// --------------------------------------------------------
+void FrustumCuller::CullGroups(const Frustum& frustum, size_t firstGroup, size_t lastGroup, std::vector<uint32_t>& visible)
+{
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = XMVectorReplicate(frustum.planes[p].x);
+		planeY[p] = XMVectorReplicate(frustum.planes[p].y);
+		planeZ[p] = XMVectorReplicate(frustum.planes[p].z);
+		planeW[p] = XMVectorReplicate(frustum.planes[p].w);
+	}
+
+	XMVECTOR zero = XMVectorZero();
+	for (size_t g = firstGroup; g < lastGroup; g++)
+	{
+		size_t first = g * 4;
+		XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerX[first]));
+		XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerY[first]));
+		XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerZ[first]));
+		XMVECTOR negativeRadius = -XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&radius[first]));
+
+		XMVECTOR inside = XMVectorTrueInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = cx * planeX[p] + cy * planeY[p] + cz * planeZ[p] + planeW[p];
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, negativeRadius));
+			if (XMVector4EqualInt(inside, zero))
+				break;
+		}
+
+		uint32_t lanes[4];
+		XMStoreInt4(lanes, inside);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if (lanes[lane])
+				visible.push_back((uint32_t)first + lane);
+		}
+	}
+}
+
+void FrustumCuller::CullViews(const Frustum* frustums, unsigned int numViews, std::vector<uint16_t>& viewMasks, bool allowThreads)
+{
+	numViews = std::min(numViews, (unsigned int)CULLING_MAX_VIEWS);
+
+	// Padded to whole groups while culling, since each writes four masks
+	size_t groups = (count + 3) / 4;
+	viewMasks.resize(groups * 4);
+
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	if (cores == 1 || count < CULLING_PARALLEL_MIN)
+	{
+		CullGroupsForViews(frustums, numViews, 0, groups, viewMasks.data());
+	}
+	else
+	{
+		// Every job writes its own range of the masks, so there's nothing to join
+		size_t perJob = (groups + cores - 1) / cores;
+		std::vector<std::future<void>> jobs;
+		for (size_t first = perJob; first < groups; first += perJob)
+		{
+			size_t last = std::min(first + perJob, groups);
+			jobs.push_back(std::async(std::launch::async, [this, frustums, numViews, first, last, &viewMasks]() { CullGroupsForViews(frustums, numViews, first, last, viewMasks.data()); }));
+		}
+
+		CullGroupsForViews(frustums, numViews, 0, std::min(perJob, groups), viewMasks.data());
+		for (std::future<void>& job : jobs)
+			job.get();
+	}
+
+	viewMasks.resize(count);
+}
+
+// --------------------------------------------------------
+// Each group of four spheres is loaded once and tested
+// against every view, with the results for each view ORed
+// into the masks as that view's bit
+// --------------------------------------------------------
+void FrustumCuller::CullGroupsForViews(const Frustum* frustums, unsigned int numViews, size_t firstGroup, size_t lastGroup, uint16_t* viewMasks)
+{
+	XMVECTOR planeX[CULLING_MAX_VIEWS][6], planeY[CULLING_MAX_VIEWS][6], planeZ[CULLING_MAX_VIEWS][6], planeW[CULLING_MAX_VIEWS][6];
+	XMVECTOR viewBits[CULLING_MAX_VIEWS];
+	for (unsigned int v = 0; v < numViews; v++)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[v][p] = XMVectorReplicate(frustums[v].planes[p].x);
+			planeY[v][p] = XMVectorReplicate(frustums[v].planes[p].y);
+			planeZ[v][p] = XMVectorReplicate(frustums[v].planes[p].z);
+			planeW[v][p] = XMVectorReplicate(frustums[v].planes[p].w);
+		}
+		viewBits[v] = XMVectorReplicateInt(1u << v);
+	}
+
+	XMVECTOR zero = XMVectorZero();
+	for (size_t g = firstGroup; g < lastGroup; g++)
+	{
+		size_t first = g * 4;
+		XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerX[first]));
+		XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerY[first]));
+		XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerZ[first]));
+		XMVECTOR negativeRadius = -XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&radius[first]));
+
+		XMVECTOR masks = zero;
+		for (unsigned int v = 0; v < numViews; v++)
+		{
+			XMVECTOR inside = XMVectorTrueInt();
+			for (int p = 0; p < 6; p++)
+			{
+				XMVECTOR distance = cx * planeX[v][p] + cy * planeY[v][p] + cz * planeZ[v][p] + planeW[v][p];
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, negativeRadius));
+				if (XMVector4EqualInt(inside, zero))
+					break;
+			}
+			masks = XMVectorOrInt(masks, XMVectorAndInt(inside, viewBits[v]));
+		}
+
+		uint32_t lanes[4];
+		XMStoreInt4(lanes, masks);
+		for (uint32_t lane = 0; lane < 4; lane++)
+			viewMasks[first + lane] = (uint16_t)lanes[lane];
+	}
+}
+
+void FrustumCuller::ExtractView(const std::vector<uint16_t>& viewMasks, unsigned int view, std::vector<uint32_t>& visible)
+{
+	visible.clear();
+	uint16_t bit = (uint16_t)(1u << view);
+	for (uint32_t i = 0; i < viewMasks.size(); i++)
+	{
+		if (viewMasks[i] & bit)
+			visible.push_back(i);
+	}
+}
+
+CullingTimings FrustumCuller::MeasureCulling(unsigned int numSpheres)
+{
+	CullingTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// Spheres all around a camera at the origin looking down +Z,
+	// so about one in twenty ends up in view
+	FrustumCuller culler;
+	culler.Reserve(numSpheres);
+	for (unsigned int i = 0; i < numSpheres; i++)
+		culler.Add(XMFLOAT3(random(-500, 500), random(-500, 500), random(-500, 500)), random(0.5f, 2.0f));
+
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+	Frustum frustum = Frustum::FromViewProjection(view, projection);
+
+	// Averaged over a few runs since a single one is very short
+	const int runs = 10;
+	std::vector<uint32_t> visible;
+	auto start = now();
+	for (int r = 0; r < runs; r++)
+		culler.Cull(frustum, visible, false);
+	timings.singleMs = std::chrono::duration<double, std::milli>(now() - start).count() / runs;
+
+	start = now();
+	for (int r = 0; r < runs; r++)
+		culler.Cull(frustum, visible, true);
+	timings.threadedMs = std::chrono::duration<double, std::milli>(now() - start).count() / runs;
+
+	timings.visible = (unsigned int)visible.size();
+	return timings;
+}
+
+MultiViewCullingTimings FrustumCuller::MeasureMultiViewCulling(unsigned int numSpheres)
+{
+	MultiViewCullingTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	FrustumCuller culler;
+	culler.Reserve(numSpheres);
+	for (unsigned int i = 0; i < numSpheres; i++)
+		culler.Add(XMFLOAT3(random(-500, 500), random(-500, 500), random(-500, 500)), random(0.5f, 2.0f));
+
+	// The main camera, then a cube map's faces (like a reflection probe's)
+	std::vector<Frustum> frustums;
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+	frustums.push_back(Frustum::FromViewProjection(view, projection));
+
+	XMVECTOR directions[6] = { XMVectorSet(1, 0, 0, 0), XMVectorSet(-1, 0, 0, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, -1, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 0, -1, 0) };
+	XMVECTOR ups[6] = { XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 0, -1, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 1, 0, 0) };
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.1f, 300.0f));
+	for (int face = 0; face < 6; face++)
+	{
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(50, 0, 50, 0), directions[face], ups[face]));
+		frustums.push_back(Frustum::FromViewProjection(view, projection));
+	}
+	unsigned int numViews = (unsigned int)frustums.size();
+
+	const int runs = 10;
+	std::vector<uint32_t> visible;
+	auto start = now();
+	for (int r = 0; r < runs; r++)
+	{
+		for (const Frustum& frustum : frustums)
+			culler.Cull(frustum, visible, false);
+	}
+	timings.separateMs = std::chrono::duration<double, std::milli>(now() - start).count() / runs;
+
+	std::vector<uint16_t> viewMasks;
+	for (bool threaded : { false, true })
+	{
+		start = now();
+		for (int r = 0; r < runs; r++)
+		{
+			culler.CullViews(frustums.data(), numViews, viewMasks, threaded);
+			for (unsigned int v = 0; v < numViews; v++)
+				ExtractView(viewMasks, v, visible);
+		}
+		(threaded ? timings.combinedThreadedMs : timings.combinedMs) = std::chrono::duration<double, std::milli>(now() - start).count() / runs;
+	}
+
+	for (unsigned int v = 0; v < numViews; v++)
+	{
+		ExtractView(viewMasks, v, visible);
+		timings.visible += (unsigned int)visible.size();
+	}
+	return timings;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <vector>
+
+// Below this many spheres culling stays on one thread
+#define CULLING_PARALLEL_MIN	16384
+
+// Most views CullViews() can handle at once (one bit each in a mask)
+#define CULLING_MAX_VIEWS		16
+
+// Timings from MeasureCulling()
+struct CullingTimings
+{
+	unsigned int visible;
+	double singleMs;		// One thread
+	double threadedMs;		// All cores
+};
+
+// Timings from MeasureMultiViewCulling()
+struct MultiViewCullingTimings
+{
+	unsigned int visible;		// Summed over every view
+	double separateMs;			// Cull() once per view, one thread
+	double combinedMs;			// CullViews() and extracting each view's list, one thread
+	double combinedThreadedMs;	// The same on all cores
+};
+
+// --------------------------------------------------------
+// The six planes of a view frustum, facing inwards, as
+// (normal, distance) so a point p is inside a plane when
+// dot(normal, p) + distance >= 0
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+
+	// Pulls the planes straight out of the combined matrix (Gribb & Hartmann)
+	static Frustum FromViewProjection(DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection);
+};
+
+// --------------------------------------------------------
+// World space bounding spheres kept as structure-of-arrays,
+// so each plane test covers four spheres in one XMVECTOR.
+// The arrays are padded to a multiple of four with spheres
+// that can never be visible.
+//
+// Cull() writes the index (in the order they were added) of
+// every sphere that's at least partly inside the frustum.
+//
+// CullViews() does the same for several frustums (the main
+// camera, shadow cascades, cube map faces...) in one pass
+// over the spheres, writing a mask per sphere with a bit
+// for each view it's in.  ExtractView() then turns one bit
+// of those masks into that view's list.
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	void Clear();
+	void Reserve(unsigned int numSpheres);
+	uint32_t Add(DirectX::XMFLOAT3 center, float radius);
+
+	void Cull(const Frustum& frustum, std::vector<uint32_t>& visible, bool allowThreads = true);
+	void CullViews(const Frustum* frustums, unsigned int numViews, std::vector<uint16_t>& viewMasks, bool allowThreads = true);
+	static void ExtractView(const std::vector<uint16_t>& viewMasks, unsigned int view, std::vector<uint32_t>& visible);
+
+	unsigned int GetCount() { return count; }
+
+	// Scatters spheres around a camera and times culling them
+	static CullingTimings MeasureCulling(unsigned int numSpheres);
+
+	// Culls spheres against the six faces of a cube around the camera
+	// plus a main view, separately and then all in one pass
+	static MultiViewCullingTimings MeasureMultiViewCulling(unsigned int numSpheres);
+
+private:
+	std::vector<float> centerX, centerY, centerZ, radius;
+	unsigned int count;
+
+	void CullGroups(const Frustum& frustum, size_t firstGroup, size_t lastGroup, std::vector<uint32_t>& visible);
+	void CullGroupsForViews(const Frustum* frustums, unsigned int numViews, size_t firstGroup, size_t lastGroup, uint16_t* viewMasks);
+};
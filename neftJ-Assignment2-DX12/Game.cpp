@@ -2,10 +2,20 @@
 #include "Vertex.h"
 #include "Input.h"
 #include "Assets.h"
+#include "GeometryPool.h"
+#include "GeometryCodec.h"
+#include "HlodSystem.h"
+#include "SceneFile.h"
+#include "TransformStore.h"
+#include "StaticBatcher.h"
+#include "WorldPartition.h"
 
 // Needed for a helper function to read compiled shader files from the hard drive
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 #define RandomRange(min, max) (float)rand() / RAND_MAX * (max - min) + min
 
@@ -29,10 +39,16 @@ Game::Game(HINSTANCE hInstance)
 		true),			   // Show extra stats (fps) in title bar?
 	vsync(false)
 {
+	runBenchmarks = strstr(GetCommandLineA(), "-benchmark") != 0;
+
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
 	printf("Console window created successfully.  Feel free to printf() here.\n");
+#else
+	// Benchmarks are only meaningful in release, and need somewhere to print
+	if (runBenchmarks)
+		CreateConsoleWindow(500, 120, 32, 120);
 #endif
 
 	ibView = {};
@@ -52,6 +68,8 @@ Game::~Game()
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object created in Game
 
+	// Streamed entities use meshes and materials from Assets
+	WorldPartition::GetInstance().Close();
 	delete &Assets::GetInstance();
 
 	// We need to wait here until the GPU
@@ -65,9 +83,24 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// Shared geometry buffers need to exist before any meshes load
+	GeometryPool::GetInstance().Initialize(device, commandList);
+
 	Assets& am = Assets::GetInstance();
 	am.Initialize("..\\..\\Assets\\", device, true, true);
-	camera = std::make_shared<Camera>(0, 0, -10.0f, 5.0f, 1.0f, width / height);
+
+	// The scene says what's in the world, how it's lit and where the camera starts
+	SceneData scene;
+	auto sceneStart = std::chrono::high_resolution_clock::now();
+	if (SceneFile::Load(am.GetFullAssetPath("Scenes\\Demo.json"), scene))
+		printf("Loaded a scene of %u entities in %.2f ms\n", scene.GetEntityCount(), std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sceneStart).count());
+	else
+		printf("Couldn't load the scene\n");
+
+	const SceneCamera& start = scene.camera;
+	camera = std::make_shared<Camera>(start.position.x, start.position.y, start.position.z, start.moveSpeed, start.lookSpeed, width / height);
+	camera->GetTransform()->SetRotation(start.rotation);
+	camera->UpdateViewMatrix();
 
 	DX12Helper::GetInstance().SetWidth(width);
 	DX12Helper::GetInstance().SetHeight(height);
@@ -79,95 +112,481 @@ void Game::Init()
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
 	CreateRootSigAndPipelineState();
-	CreateBasicGeometry();
-	CreateLights();
+
+	// All of the static geometry goes up to the GPU in one go
+	DX12Helper::GetInstance().BeginUploadBatch();
+	CreateBasicGeometry(scene);
+	UploadBatchStats uploadStats = DX12Helper::GetInstance().EndUploadBatch();
+	printf("Uploaded %.2f MB of geometry in %u copies and %u submissions (%.2f ms copying, %.1f MB/s; %.2f ms loading in all)\n",
+		uploadStats.bytesUploaded / (1024.0 * 1024.0),
+		uploadStats.copyCount,
+		uploadStats.submitCount,
+		uploadStats.copySeconds * 1000.0,
+		uploadStats.megabytesPerSecond,
+		uploadStats.seconds * 1000.0);
+	Assets::GetInstance().PrintMeshReport();
+	renderer->SetSpatialIndex(spatialIndex);
+
+	CreateLights(scene);
+
+	// Rolling hills below the scene, streamed in around the camera
+	terrain = std::make_shared<Terrain>();
+	TerrainDesc terrainDesc = { 1024, 0.25f, 8.0f, XMFLOAT3(-128.0f, -12.0f, -128.0f) };
+	if (terrain->Create(terrainDesc, Terrain::ProceduralTiles(1)))
+		renderer->SetTerrain(terrain);
+	else
+		printf("Couldn't create the terrain\n");
+
+	// Grass in the valleys and rocks all over the terrain, drawn as instances rather than entities
+	std::vector<ScatterLayer> scatterLayers = {
+		{ am.GetMesh("builtin:cube").get(), XMFLOAT3(0.03f, 0.5f, 0.03f), XMFLOAT3(0.3f, 0.5f, 0.2f), 0.26f, 3.0f, 0.6f, 1.4f, -12.0f, -6.0f, 0.6f, 30.0f },
+		{ am.GetMesh("builtin:sphere:8").get(), XMFLOAT3(0.6f, 0.4f, 0.5f), XMFLOAT3(0.45f, 0.42f, 0.38f), 0.3f, 0.05f, 0.5f, 2.0f, -12.0f, 0.0f, 10.0f, 100.0f } };
+	ScatterDesc scatterDesc = { XMFLOAT2(terrainDesc.origin.x, terrainDesc.origin.z), 8.0f, 32, 1 };
+	scatter = std::make_shared<InstanceScatter>();
+	if (scatter->Generate(scatterDesc, scatterLayers, InstanceScatter::TerrainHeights(terrainDesc, Terrain::ProceduralTiles(1))))
+		renderer->SetScatter(scatter);
+	else
+		printf("Couldn't scatter the grass and rocks\n");
+
+	// The rest of the world streams in around the camera as it moves
+	if (!WorldPartition::GetInstance().Open(am.GetFullAssetPath("Worlds\\Demo\\world.json"), entities))
+		printf("Couldn't open the streamed world\n");
+
+	if (runBenchmarks)
+		RunBenchmarks();
 }
 
 // --------------------------------------------------------
-// Creates the geometry we're going to draw - a single triangle for now
+// Creates everything the scene has in it, and the sky
 // --------------------------------------------------------
-void Game::CreateBasicGeometry()
+void Game::CreateBasicGeometry(const SceneData& scene)
 {
-	// Create meshes
-	std::shared_ptr<Mesh> cubeMesh = Assets::GetInstance().GetMesh("cube");
-	std::shared_ptr<Mesh> sphereMesh = Assets::GetInstance().GetMesh("sphere");
-	std::shared_ptr<Mesh> helixMesh = Assets::GetInstance().GetMesh("helix");
+	Assets& assets = Assets::GetInstance();
+	TransformStore& store = TransformStore::GetInstance();
 
-	// Create materials
-	std::shared_ptr<Material> woodMat = Assets::GetInstance().GetMaterial("woodMat");
-	std::shared_ptr<Material> scratchMat = Assets::GetInstance().GetMaterial("scratchMat");
+	// Every mesh and material the scene uses, by their indices in it
+	std::vector<std::shared_ptr<Mesh>> meshes(scene.meshNames.size());
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		// Compact meshes are stored quantized (24 bytes per vertex instead of 44)
+		unsigned int flags = MESH_FLAG_KEEP_BVH | MESH_FLAG_POSITION_STREAM;
+		if (scene.meshFlags[m] & SCENE_MESH_COMPACT) flags |= MESH_FLAG_COMPACT_VERTICES;
+		meshes[m] = assets.GetMesh(scene.meshNames[m], flags);
+	}
 
-	// Create game entities
-	std::shared_ptr<GameEntity> cube1 = std::make_shared<GameEntity>(cubeMesh, woodMat);
-	cube1->GetTransform()->SetPosition(5, 0, 0);
-	entities.push_back(cube1);
+	std::vector<std::shared_ptr<Material>> materials(scene.materialNames.size());
+	for (size_t m = 0; m < materials.size(); m++)
+		materials[m] = assets.GetMaterial(scene.materialNames[m]);
 
-	std::shared_ptr<GameEntity> cube2 = std::make_shared<GameEntity>(cubeMesh, scratchMat);
-	cube2->GetTransform()->SetPosition(-5, 0, 0);
-	entities.push_back(cube2);
+	// Each LOD chain with its levels' triangle counts, and level 0's bounds
+	// for picking between them.  Chains stop at the first missing mesh.
+	lodChains.assign(scene.lodNames.size(), LodChain{});
+	for (size_t c = 0; c < lodChains.size(); c++)
+	{
+		LodChain& chain = lodChains[c];
+		unsigned int levels = std::min(scene.lodCount[c], (uint32_t)LOD_MAX_LEVELS);
+		for (chain.count = 0; chain.count < levels; chain.count++)
+		{
+			uint32_t level = scene.lodFirst[c] + chain.count;
+			Mesh* mesh = meshes[scene.lodMeshes[level]].get();
+			if (!mesh)
+				break;
+
+			chain.meshes[chain.count] = mesh;
+			chain.errors[chain.count] = scene.lodErrors[level];
+			chain.triangles[chain.count] = mesh->GetIndexCount() / 3;
+		}
+
+		if (chain.count > 0)
+			chain.bounds = chain.meshes[0]->GetBoundingSphere();
+	}
 
-	std::shared_ptr<GameEntity> sphere1 = std::make_shared<GameEntity>(sphereMesh, woodMat);
-	sphere1->GetTransform()->SetPosition(3, 0, 0);
-	entities.push_back(sphere1);
+	// Under vsync frames sit right at 60 fps, so the target is below that
+	LodSelector::GetInstance().SetFrameTimeTarget(1000.0f / 30.0f);
+
+	// Create game entities, each with its own transform, what to draw, a place
+	// in the spatial index and a body in the broadphase (which both need the
+	// entity to exist first).  Static scenery goes to the batcher instead and
+	// clusters of buildings to the HLOD system, which both make their own.
+	entities = std::make_shared<EntityManager>();
+	spatialIndex = std::make_shared<SpatialIndex>();
+	broadphase = std::make_shared<SweepAndPrune>();
+	boxOccluders.clear();
+	StaticBatcher& batcher = StaticBatcher::GetInstance();
+	HlodSystem& hlod = HlodSystem::GetInstance();
+	for (unsigned int i = 0; i < scene.GetEntityCount(); i++)
+	{
+		Mesh* mesh = meshes[scene.meshes[i]].get();
+		Material* material = materials[scene.materials[i]].get();
+		if (!mesh || !material)
+			continue;
+
+		const XMFLOAT3& pitchYawRoll = scene.rotations[i];
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(pitchYawRoll.x, pitchYawRoll.y, pitchYawRoll.z));
+
+		if (scene.flags[i] & (SCENE_ENTITY_STATIC | SCENE_ENTITY_HLOD))
+		{
+			const std::string& name = scene.meshNames[scene.meshes[i]];
+			if (scene.flags[i] & SCENE_ENTITY_STATIC) batcher.Add(name, material, scene.positions[i], rotation, scene.scales[i]);
+			else hlod.Add(name, material, scene.positions[i], rotation, scene.scales[i]);
+			continue;
+		}
+
+		uint32_t transform = store.Allocate();
+		store.SetPosition(transform, scene.positions[i]);
+		store.SetRotation(transform, rotation);
+		store.SetScale(transform, scene.scales[i]);
+		Entity e = entities->Create(
+			TransformComponent{ transform },
+			MeshRendererComponent{ mesh, material });
+
+		if (scene.spins[i] != 0)
+			entities->Add(e, SpinComponent{ scene.spins[i] });
+
+		BoundingBox bounds;
+		mesh->GetAABB().Transform(bounds, XMLoadFloat4x4(&store.GetWorldMatrix(transform)));
+		entities->Add(e, SpatialComponent{ spatialIndex.get(), spatialIndex->Insert(bounds, e.index), mesh->GetAABB() });
+		entities->Add(e, OverlapComponent{ broadphase.get(), broadphase->Add(bounds, e.index), mesh->GetAABB() });
+
+		// Occluders are their mesh's box, shared by everything with that mesh
+		if (scene.flags[i] & SCENE_ENTITY_OCCLUDER)
+		{
+			std::shared_ptr<OccluderMesh>& occluder = boxOccluders[mesh];
+			if (!occluder)
+				occluder = std::make_shared<OccluderMesh>(OccluderMesh::FromBox(mesh->GetAABB()));
+			entities->Add(e, OccluderComponent{ occluder.get() });
+		}
+
+		if (scene.lods[i] != SCENE_NO_LOD && lodChains[scene.lods[i]].count > 0)
+		{
+			const LodChain& chain = lodChains[scene.lods[i]];
+			entities->Add(e, LodComponent{ &chain, LodSelector::GetInstance().Add(chain.errors, chain.triangles, chain.count) });
+		}
+	}
 
-	std::shared_ptr<GameEntity> sphere2 = std::make_shared<GameEntity>(sphereMesh, scratchMat);
-	sphere2->GetTransform()->SetPosition(-3, 0, 0);
-	entities.push_back(sphere2);
+	// Both of these create meshes, so they're done here
+	batcher.Cook(*entities);
+	hlod.Build(*entities);
 
-	std::shared_ptr<GameEntity> helix1 = std::make_shared<GameEntity>(helixMesh, woodMat);
-	helix1->GetTransform()->SetPosition(1, 0, 0);
-	entities.push_back(helix1);
+	// Create the skybox now
+	skyBox = std::make_shared<Sky>(this->device, this->commandList, this->dsvHandle, this->viewport, this->scissorRect, Assets::GetInstance().GetTexture("SkyBoxes\\SunnyCubeMap"), assets.GetMesh("builtin:cube", MESH_FLAG_KEEP_BVH | MESH_FLAG_POSITION_STREAM));
+}
 
-	std::shared_ptr<GameEntity> helix2 = std::make_shared<GameEntity>(helixMesh, scratchMat);
-	helix2->GetTransform()->SetPosition(-1, 0, 0);
-	entities.push_back(helix2);
+// --------------------------------------------------------
+// Prints timings for the CPU-side systems when the game is
+// launched with -benchmark
+// --------------------------------------------------------
+void Game::RunBenchmarks()
+{
+	printf("\n=== Benchmarks ===\n");
 
-	// Create the skybox now
-	skyBox = std::make_shared<Sky>(this->device, this->commandList, this->dsvHandle, this->viewport, this->scissorRect, Assets::GetInstance().GetTexture("SkyBoxes\\SunnyCubeMap"), cubeMesh);
+	// Ray queries against each mesh that kept a BVH
+	const unsigned int numRays = 1 << 20;
+	std::vector<Mesh*> tested;
+	entities->ForEach<MeshRendererComponent>([&](Entity e, MeshRendererComponent& meshRenderer)
+	{
+		Mesh* mesh = meshRenderer.mesh;
+		std::shared_ptr<MeshBVH> bvh = mesh->GetBVH();
+		if (!bvh || std::find(tested.begin(), tested.end(), mesh) != tested.end())
+			return;
+		tested.push_back(mesh);
+
+		printf("BVH: %u tris, %u nodes, %.1f KB | single %.2f Mrays/s | packet4 %.2f Mrays/s\n",
+			bvh->GetTriangleCount(),
+			bvh->GetNodeCount(),
+			bvh->GetMemorySizeInBytes() / 1024.0,
+			bvh->MeasureRaysPerSecond(numRays, false),
+			bvh->MeasureRaysPerSecond(numRays, true));
+	});
+
+	// Geometry codec, decoding each bundled model enough times to get a stable number
+	const char* modelNames[] = { "builtin:cube", "builtin:sphere", "builtin:helix" };
+	for (const char* name : modelNames)
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!Assets::GetInstance().LoadMeshData(name, verts, indices) || verts.empty())
+			continue;
+
+		std::vector<unsigned char> vertexData = GeometryCodec::EncodeVertexBuffer(verts.data(), verts.size(), sizeof(Vertex));
+		std::vector<unsigned char> indexData = GeometryCodec::EncodeIndexBuffer(indices.data(), indices.size());
+		size_t rawSize = verts.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+
+		unsigned int iterations = (unsigned int)(256 * 1024 * 1024 / rawSize) + 1;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < iterations; i++)
+		{
+			GeometryCodec::DecodeVertexBuffer(verts.data(), verts.size(), sizeof(Vertex), vertexData.data(), vertexData.size());
+			GeometryCodec::DecodeIndexBuffer(indices.data(), indices.size(), indexData.data(), indexData.size());
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		printf("Codec %s: %zu -> %zu bytes (%.2fx) | decode %.2f GB/s\n",
+			name,
+			rawSize,
+			vertexData.size() + indexData.size(),
+			(double)rawSize / (vertexData.size() + indexData.size()),
+			rawSize * (double)iterations / elapsed.count() / 1e9);
+	}
+
+	// Transform updates, the old way (one object at a time with a general
+	// inverse) against the store's batched updates, on one core and all of them
+	{
+		const unsigned int numTransforms = 1 << 17;
+		TransformStore& store = TransformStore::GetInstance();
+
+		struct ObjectTransform { XMFLOAT3 position, pitchYawRoll, scale; XMFLOAT4X4 world, worldInverseTranspose; };
+		std::vector<ObjectTransform> objects(numTransforms);
+		std::vector<uint32_t> ids(numTransforms);
+		for (unsigned int i = 0; i < numTransforms; i++)
+		{
+			float scale = RandomRange(0.5f, 2.0f);
+			objects[i].position = XMFLOAT3(RandomRange(-100, 100), RandomRange(-100, 100), RandomRange(-100, 100));
+			objects[i].pitchYawRoll = XMFLOAT3(RandomRange(-3, 3), RandomRange(-3, 3), RandomRange(-3, 3));
+			objects[i].scale = XMFLOAT3(scale, scale, scale);
+
+			ids[i] = store.Allocate();
+			store.SetPosition(ids[i], objects[i].position);
+			store.SetPitchYawRoll(ids[i], objects[i].pitchYawRoll);
+			store.SetScale(ids[i], objects[i].scale);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (ObjectTransform& o : objects)
+		{
+			XMMATRIX world =
+				XMMatrixScalingFromVector(XMLoadFloat3(&o.scale)) *
+				XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&o.pitchYawRoll)) *
+				XMMatrixTranslationFromVector(XMLoadFloat3(&o.position));
+			XMStoreFloat4x4(&o.world, world);
+			XMStoreFloat4x4(&o.worldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(world)));
+		}
+		std::chrono::duration<double, std::milli> perObject = std::chrono::high_resolution_clock::now() - start;
+
+		start = std::chrono::high_resolution_clock::now();
+		store.UpdateDirty(false);
+		std::chrono::duration<double, std::milli> batched = std::chrono::high_resolution_clock::now() - start;
+
+		// Dirty them all again for the threaded run
+		for (uint32_t id : ids)
+			store.SetScale(id, store.GetScale(id));
+
+		start = std::chrono::high_resolution_clock::now();
+		store.UpdateDirty(true);
+		std::chrono::duration<double, std::milli> threaded = std::chrono::high_resolution_clock::now() - start;
+
+		printf("Transforms: %u | per-object %.2f ms | batched %.2f ms | batched, %u threads %.2f ms\n",
+			numTransforms,
+			perObject.count(),
+			batched.count(),
+			std::max(1u, std::thread::hardware_concurrency()),
+			threaded.count());
+
+		for (uint32_t id : ids)
+			store.Free(id);
+		store.Trim();
+	}
+
+	// A synthetic hierarchy, four children per node
+	{
+		const unsigned int numNodes = 1 << 20;
+		TransformHierarchyTimings timings = TransformStore::MeasureHierarchy(numNodes, 4);
+		printf("Hierarchy: %u nodes, %u levels | full %.2f ms | full, threaded %.2f ms | 1%% dirty %.2f ms | reparent %.2f us\n",
+			numNodes,
+			timings.levels,
+			timings.fullUpdateMs,
+			timings.fullUpdateThreadedMs,
+			timings.partialUpdateMs,
+			timings.reparentMicroseconds);
+	}
+
+	// The game's own entity update (spinning) over lots of entities
+	{
+		const unsigned int numEntities = 1 << 20;
+		EntityUpdateTimings timings = EntityManager::MeasureUpdate(numEntities);
+		printf("Entities: %u in %u chunks | create %.2f ms | update %.2f ms | update, %u threads %.2f ms\n",
+			numEntities,
+			timings.chunks,
+			timings.createMs,
+			timings.updateMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.updateThreadedMs);
+	}
+
+	// Frustum culling bounding spheres, four at a time
+	for (unsigned int numSpheres : { 100000u, 1000000u })
+	{
+		CullingTimings timings = FrustumCuller::MeasureCulling(numSpheres);
+		printf("Culling: %u spheres, %u visible | %.2f ms | %u threads %.2f ms\n",
+			numSpheres,
+			timings.visible,
+			timings.singleMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.threadedMs);
+	}
+
+	// Seven views culled one at a time and then together
+	{
+		const unsigned int numSpheres = 1000000;
+		MultiViewCullingTimings timings = FrustumCuller::MeasureMultiViewCulling(numSpheres);
+		printf("Multi-view culling: %u spheres, 7 views, %u visible | separate %.2f ms | one pass %.2f ms | one pass, %u threads %.2f ms\n",
+			numSpheres,
+			timings.visible,
+			timings.separateMs,
+			timings.combinedMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.combinedThreadedMs);
+	}
+
+	// Level of detail selection for lots of objects
+	{
+		const unsigned int numObjects = 1000000;
+		LodTimings timings = LodSelector::MeasureSelection(numObjects);
+		printf("LOD: %u objects | select %.2f ms | select, %u threads %.2f ms | %llu of %llu triangles kept | level changes %u (%u without hysteresis)\n",
+			numObjects,
+			timings.selectMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.selectThreadedMs,
+			(unsigned long long)timings.trianglesSelected,
+			(unsigned long long)timings.trianglesFull,
+			timings.changesWithHysteresis,
+			timings.changesWithout);
+	}
+
+	// Occlusion culling in a city of box buildings
+	{
+		const unsigned int numOccludees = 100000;
+		OcclusionTimings timings = OcclusionCuller::MeasureOcclusion(numOccludees);
+		printf("Occlusion: %u occluder tris | %u of %u in frustum culled (%.1f%%) | raster %.2f ms | raster, %u threads %.2f ms | test %.2f ms\n",
+			timings.occluderTriangles,
+			timings.inFrustum - timings.visible,
+			timings.inFrustum,
+			timings.inFrustum ? 100.0 * (timings.inFrustum - timings.visible) / timings.inFrustum : 0.0,
+			timings.rasterizeMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.rasterizeThreadedMs,
+			timings.testMs);
+	}
+
+	// The spatial index, against a flat culler for frustum queries
+	{
+		const unsigned int numObjects = 1000000;
+		SpatialIndexTimings timings = SpatialIndex::MeasureSpatialIndex(numObjects);
+		printf("Spatial index: %u objects | insert %.2f ms | rebuild %.2f ms | rebuild, %u threads %.2f ms | refit %.2f ms\n",
+			numObjects,
+			timings.insertMs,
+			timings.rebuildMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.rebuildThreadedMs,
+			timings.refitMs);
+		printf("Spatial index: frustum %u visible %.2f ms (flat %.2f ms) | sphere %.2f us | nearest 8 %.2f us | raycast %.2f us | cost %.2f -> %.2f after rebuild\n",
+			timings.visible,
+			timings.frustumMs,
+			timings.flatFrustumMs,
+			timings.sphereMicroseconds,
+			timings.nearestMicroseconds,
+			timings.raycastMicroseconds,
+			timings.costBeforeRebuild,
+			timings.costAfterRebuild);
+	}
+
+	// Overlapping pairs of moving bodies, kept by sweep-and-prune
+	{
+		const unsigned int numBodies = 100000;
+		const unsigned int numFrames = 60;
+		SweepAndPruneTimings timings = SweepAndPrune::MeasureSweepAndPrune(numBodies, numFrames);
+		printf("Sweep-and-prune: %u moving bodies | build %.2f ms | update %.2f ms | %u pairs, +%u/-%u per update\n",
+			numBodies,
+			timings.buildMs,
+			timings.updateMs,
+			timings.pairs,
+			timings.added,
+			timings.removed);
+	}
+
+	// Cooking static scenery into batches
+	{
+		const unsigned int numInstances = 20000;
+		StaticBatchTimings timings = StaticBatcher::MeasureCook(numInstances);
+		printf("Static batching: %u instances into %u batches (%u vertices) | merge %.2f ms | merge, %u threads %.2f ms\n",
+			timings.instances,
+			timings.batches,
+			timings.vertices,
+			timings.mergeMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.mergeThreadedMs);
+	}
+
+	// Building HLOD proxies for a city of blocks
+	{
+		const unsigned int numInstances = 10000;
+		HlodTimings timings = HlodSystem::MeasureBuild(numInstances);
+		printf("HLOD: %u instances in %u clusters | %llu -> %llu triangles | build %.2f ms | build, %u threads %.2f ms\n",
+			timings.instances,
+			timings.clusters,
+			(unsigned long long)timings.sourceTriangles,
+			(unsigned long long)timings.proxyTriangles,
+			timings.buildMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.buildThreadedMs);
+	}
+
+	// Loading a big scene from each of its forms
+	{
+		const unsigned int numEntities = 100000;
+		SceneLoadTimings timings = SceneFile::MeasureLoad(numEntities);
+		printf("Scene files: %u entities | JSON %.2f MB in %.2f ms | binary %.2f MB in %.2f ms | convert %.2f ms\n",
+			timings.entities,
+			timings.jsonBytes / (1024.0 * 1024.0),
+			timings.loadJsonMs,
+			timings.binaryBytes / (1024.0 * 1024.0),
+			timings.loadBinaryMs,
+			timings.convertMs);
+	}
+
+	// Selecting CDLOD terrain nodes over a big heightfield
+	{
+		const unsigned int size = 16384;
+		TerrainTimings timings = Terrain::MeasureTerrain(size);
+		printf("Terrain: %ux%u, %u LODs | build %.2f ms, %u threads | stream %u tiles in %.2f ms | select %.3f ms (max %.3f) | %u nodes (max %u)\n",
+			timings.size,
+			timings.size,
+			timings.lods,
+			timings.buildMs,
+			std::max(1u, std::thread::hardware_concurrency()),
+			timings.residentTiles,
+			timings.streamMs,
+			timings.selectMs,
+			timings.maxSelectMs,
+			timings.nodes,
+			timings.maxNodes);
+	}
+
+	// Culling millions of scattered instances
+	{
+		const unsigned int numInstances = 10000000;
+		ScatterTimings timings = InstanceScatter::MeasureScatter(numInstances);
+		unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+		printf("Scatter: %u instances (%.2f MB) | generate %.2f ms, %u threads | cull %.3f ms | cull, %u threads %.3f ms (max %.3f) | %u tested one by one, %u visible\n",
+			timings.instances,
+			timings.bytes / (1024.0 * 1024.0),
+			timings.generateMs,
+			threads,
+			timings.cullMs,
+			threads,
+			timings.cullThreadedMs,
+			timings.maxCullThreadedMs,
+			timings.tested,
+			timings.visible);
+	}
 }
 
-void Game::CreateLights()
+void Game::CreateLights(const SceneData& scene)
 {
-	// Reset
-	lights.clear();
-
-	// Setup directional lights
-	Light dir1 = {};
-	dir1.Type = LIGHT_TYPE_DIRECTIONAL;
-	dir1.Direction = XMFLOAT3(1, -1, 1);
-	dir1.Color = XMFLOAT3(0.8f, 0.8f, 0.8f);
-	dir1.Intensity = 1.0f;
-
-	Light dir2 = {};
-	dir2.Type = LIGHT_TYPE_DIRECTIONAL;
-	dir2.Direction = XMFLOAT3(-1, -0.25f, 0);
-	dir2.Color = XMFLOAT3(0.2f, 0.2f, 0.2f);
-	dir2.Intensity = 1.0f;
-
-	Light dir3 = {};
-	dir3.Type = LIGHT_TYPE_DIRECTIONAL;
-	dir3.Direction = XMFLOAT3(0, -1, 1);
-	dir3.Color = XMFLOAT3(0.2f, 0.2f, 0.2f);
-	dir3.Intensity = 1.0f;
-
-	// Add light to the list
-	lights.push_back(dir1);
-	lights.push_back(dir2);
-	lights.push_back(dir3);
-
-	while (lights.size() < 10)
-	{
-		Light point = {};
-		point.Type = LIGHT_TYPE_POINT;
-		point.Position = XMFLOAT3(RandomRange(-10, 10), RandomRange(-2, 2), RandomRange(-10, 10));
-		point.Color = XMFLOAT3(RandomRange(0, 1), RandomRange(0, 1), RandomRange(0, 1));
-		point.Range = RandomRange(1, 10);
-		point.Intensity = RandomRange(0.1f, 10);
-
-		lights.push_back(point);
-	}
-
-	lightCount = lights.size();
+	// The shaders only have room for so many
+	lights.assign(scene.lights.begin(), scene.lights.begin() + std::min(scene.lights.size(), (size_t)MAX_LIGHTS));
+	lightCount = (int)lights.size();
 }
 
 // --------------------------------------------------------
@@ -213,14 +632,24 @@ void Game::Update(float deltaTime, float totalTime)
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
 
-	// Spin entities
-	for (auto& e : entities)
-	{
-		e->GetTransform()->Rotate(0, deltaTime * 0.5f, 0);
-	}
+	// Spin entities, then keep the spatial index up to date with them
+	UpdateSpinners(*entities, deltaTime);
+	UpdateSpatialIndex(*entities);
+	spatialIndex->RebuildIfDegraded();
+	UpdateOverlaps(*entities);
+	broadphase->Update();
 
 	camera->Update(deltaTime);
 
+	// Stream world cells and terrain tiles in and out around the camera, and draw far clusters as their proxies
+	WorldPartition::GetInstance().Update(camera->GetTransform()->GetPosition());
+	terrain->Update(camera->GetTransform()->GetPosition());
+	HlodSystem::GetInstance().Update(*entities, camera->GetTransform()->GetPosition());
+
+	// Pick detail levels for the camera, coarser if frames are running slow
+	LodSelector::GetInstance().UpdateBias(deltaTime * 1000.0f);
+	UpdateLods(*entities, camera->GetTransform()->GetPosition(), camera->GetProjection(), (float)height);
+
 	// Update the entities in the renderer
 	renderer->Update(deltaTime, totalTime, entities, skyBox, lights, lightCount);
 }
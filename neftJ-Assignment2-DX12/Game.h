@@ -5,12 +5,15 @@
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include "Camera.h"
 #include "Mesh.h"
-#include "GameEntity.h"
+#include "EntityManager.h"
+#include "Components.h"
+#include <unordered_map>
 #include <vector>
 #include "Structs.h"
 #include "Material.h"
 #include "Sky.h"
 #include "Renderer.h"
+#include "SceneFile.h"
 
 class Game 
 	: public DXCore
@@ -32,10 +35,14 @@ private:
 	// Should we use vsync to limit the frame rate?
 	bool vsync;
 
+	// Was the game launched with -benchmark?
+	bool runBenchmarks;
+
 	// Initialization helper methods - feel free to customize, combine, etc.
-	void CreateBasicGeometry();
-	void CreateLights();
+	void CreateBasicGeometry(const SceneData& scene);
+	void CreateLights(const SceneData& scene);
 	void CreateRootSigAndPipelineState();
+	void RunBenchmarks();
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -52,8 +59,15 @@ private:
 	D3D12_INDEX_BUFFER_VIEW ibView;
 
 	std::shared_ptr<Camera> camera;
-	std::vector<std::shared_ptr<GameEntity>> entities;
+	// Declared first so they outlive the entities, which point at them
+	std::shared_ptr<SpatialIndex> spatialIndex;
+	std::shared_ptr<SweepAndPrune> broadphase;
+	std::unordered_map<Mesh*, std::shared_ptr<OccluderMesh>> boxOccluders;
+	std::vector<LodChain> lodChains;
+	std::shared_ptr<EntityManager> entities;
 	std::shared_ptr<Sky> skyBox;
+	std::shared_ptr<Terrain> terrain;
+	std::shared_ptr<InstanceScatter> scatter;
 
 	std::vector<Light> lights;
 	int lightCount;
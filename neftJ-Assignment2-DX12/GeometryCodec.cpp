@@ -0,0 +1,629 @@
+#include "GeometryCodec.h"
+
+#include <cstring>
+#include <fstream>
+#include <emmintrin.h>
+
+// Vertices are worked on in blocks so one block's planes fit in L1
+#define VERTEX_BLOCK_SIZE		256
+#define VERTEX_GROUP_SIZE		16
+#define VERTEX_MAX_STRIDE		256
+
+#define VERTEX_CODEC_VERSION	0xA1
+#define INDEX_CODEC_VERSION		0xE1
+
+#define INDEX_FIFO_SIZE			16
+
+// Lower nibble of an index code byte that means "explicit index follows"
+#define INDEX_CODE_EXPLICIT		15
+
+#pragma region Shared helpers
+
+static inline unsigned char ZigZag8(unsigned char delta)
+{
+	signed char s = (signed char)delta;
+	return (unsigned char)((delta << 1) ^ (unsigned char)(s >> 7));
+}
+
+static inline unsigned int ZigZag32(int value)
+{
+	return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+static inline int UnZigZag32(unsigned int value)
+{
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static void WriteVarInt(std::vector<unsigned char>& out, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+// Returns false if the data runs out part way through
+static inline bool ReadVarInt(const unsigned char*& data, const unsigned char* end, unsigned int& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (data == end) return false;
+		unsigned char b = *data++;
+		value |= (unsigned int)(b & 0x7F) << shift;
+		if (!(b & 0x80)) return true;
+	}
+	return false;
+}
+
+#pragma endregion
+
+#pragma region Vertex codec
+
+// Number of bytes a packed group takes for each of the four bit widths
+static const unsigned int groupSizes[4] = { 0, 4, 8, 16 };
+
+// --------------------------------------------------------
+// Packs 16 zigzagged bytes with the given bit width (index
+// into groupSizes).  Value i of a 2-bit group lives in byte
+// i % 4 at bit 2 * (i / 4), and value i of a 4-bit group in
+// byte i % 8 at bit 4 * (i / 8), which is the order the SSE2
+// decoder can unpack without any shuffling.
+// --------------------------------------------------------
+static void EncodeGroup(std::vector<unsigned char>& out, const unsigned char* values, int bitWidth)
+{
+	if (bitWidth == 1)
+	{
+		for (int b = 0; b < 4; b++)
+		{
+			out.push_back((unsigned char)(
+				values[b] |
+				(values[b + 4] << 2) |
+				(values[b + 8] << 4) |
+				(values[b + 12] << 6)));
+		}
+	}
+	else if (bitWidth == 2)
+	{
+		for (int b = 0; b < 8; b++)
+			out.push_back((unsigned char)(values[b] | (values[b + 8] << 4)));
+	}
+	else if (bitWidth == 3)
+	{
+		out.insert(out.end(), values, values + VERTEX_GROUP_SIZE);
+	}
+}
+
+std::vector<unsigned char> GeometryCodec::EncodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexStride)
+{
+	std::vector<unsigned char> out;
+	if (vertexStride == 0 || vertexStride > VERTEX_MAX_STRIDE) return out;
+
+	out.push_back(VERTEX_CODEC_VERSION);
+
+	const unsigned char* src = (const unsigned char*)vertices;
+	unsigned char lastVertex[VERTEX_MAX_STRIDE] = {};
+	unsigned char plane[VERTEX_BLOCK_SIZE];
+
+	for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VERTEX_BLOCK_SIZE)
+	{
+		size_t blockCount = vertexCount - blockStart;
+		if (blockCount > VERTEX_BLOCK_SIZE) blockCount = VERTEX_BLOCK_SIZE;
+		size_t groupCount = (blockCount + VERTEX_GROUP_SIZE - 1) / VERTEX_GROUP_SIZE;
+
+		for (size_t k = 0; k < vertexStride; k++)
+		{
+			// Delta against the previous vertex (padding decodes as "no change")
+			unsigned char previous = lastVertex[k];
+			for (size_t i = 0; i < blockCount; i++)
+			{
+				unsigned char current = src[(blockStart + i) * vertexStride + k];
+				plane[i] = ZigZag8((unsigned char)(current - previous));
+				previous = current;
+			}
+			memset(plane + blockCount, 0, groupCount * VERTEX_GROUP_SIZE - blockCount);
+
+			// Pick the smallest width that holds every value in each group
+			size_t headerStart = out.size();
+			out.resize(out.size() + (groupCount + 3) / 4, 0);
+			for (size_t g = 0; g < groupCount; g++)
+			{
+				unsigned char largest = 0;
+				for (int i = 0; i < VERTEX_GROUP_SIZE; i++)
+					largest |= plane[g * VERTEX_GROUP_SIZE + i];
+
+				int bitWidth = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+				out[headerStart + g / 4] |= (unsigned char)(bitWidth << ((g % 4) * 2));
+			}
+
+			for (size_t g = 0; g < groupCount; g++)
+			{
+				int bitWidth = (out[headerStart + g / 4] >> ((g % 4) * 2)) & 3;
+				EncodeGroup(out, plane + g * VERTEX_GROUP_SIZE, bitWidth);
+			}
+		}
+
+		memcpy(lastVertex, src + (blockStart + blockCount - 1) * vertexStride, vertexStride);
+	}
+
+	return out;
+}
+
+// --------------------------------------------------------
+// Unpacks one group of 16 zigzagged deltas
+// --------------------------------------------------------
+static inline __m128i DecodeGroup(const unsigned char* data, int bitWidth)
+{
+	switch (bitWidth)
+	{
+	case 1:
+	{
+		int packed;
+		memcpy(&packed, data, 4);
+		__m128i x = _mm_cvtsi32_si128(packed);
+		__m128i mask = _mm_set1_epi8(3);
+
+		// The 16-bit shifts drag bits in from the next byte, which the mask throws away
+		__m128i r0 = _mm_and_si128(x, mask);
+		__m128i r1 = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+		__m128i r2 = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+		__m128i r3 = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+		return _mm_unpacklo_epi64(_mm_unpacklo_epi32(r0, r1), _mm_unpacklo_epi32(r2, r3));
+	}
+	case 2:
+	{
+		__m128i x = _mm_loadl_epi64((const __m128i*)data);
+		__m128i mask = _mm_set1_epi8(15);
+		__m128i lo = _mm_and_si128(x, mask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+		return _mm_unpacklo_epi64(lo, hi);
+	}
+	case 3:
+		return _mm_loadu_si128((const __m128i*)data);
+	default:
+		return _mm_setzero_si128();
+	}
+}
+
+// --------------------------------------------------------
+// Undoes the zigzag and the delta coding for 16 bytes of a
+// plane.  The deltas are summed with a log-step prefix sum,
+// then the previous value is added to every lane.
+// --------------------------------------------------------
+static inline __m128i DecodeDeltas(__m128i zigzag, __m128i previous)
+{
+	__m128i one = _mm_set1_epi8(1);
+	__m128i half = _mm_and_si128(_mm_srli_epi16(zigzag, 1), _mm_set1_epi8(0x7F));
+	__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(zigzag, one));
+	__m128i x = _mm_xor_si128(half, sign);
+
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+	x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+	return _mm_add_epi8(x, previous);
+}
+
+// --------------------------------------------------------
+// Interleaves four planes back into 16 vertices, writing
+// four bytes of each vertex at a time
+// --------------------------------------------------------
+static inline void TransposeFourPlanes(unsigned char* dest, size_t vertexStride, size_t count, const unsigned char* p0, const unsigned char* p1, const unsigned char* p2, const unsigned char* p3)
+{
+	__m128i a = _mm_load_si128((const __m128i*)p0);
+	__m128i b = _mm_load_si128((const __m128i*)p1);
+	__m128i c = _mm_load_si128((const __m128i*)p2);
+	__m128i d = _mm_load_si128((const __m128i*)p3);
+
+	__m128i ab0 = _mm_unpacklo_epi8(a, b);
+	__m128i ab1 = _mm_unpackhi_epi8(a, b);
+	__m128i cd0 = _mm_unpacklo_epi8(c, d);
+	__m128i cd1 = _mm_unpackhi_epi8(c, d);
+
+	alignas(16) unsigned int words[16];
+	_mm_store_si128((__m128i*)(words + 0), _mm_unpacklo_epi16(ab0, cd0));
+	_mm_store_si128((__m128i*)(words + 4), _mm_unpackhi_epi16(ab0, cd0));
+	_mm_store_si128((__m128i*)(words + 8), _mm_unpacklo_epi16(ab1, cd1));
+	_mm_store_si128((__m128i*)(words + 12), _mm_unpackhi_epi16(ab1, cd1));
+
+	for (size_t i = 0; i < count; i++)
+		memcpy(dest + i * vertexStride, &words[i], 4);
+}
+
+bool GeometryCodec::DecodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexStride, const unsigned char* data, size_t dataSize)
+{
+	if (vertexStride == 0 || vertexStride > VERTEX_MAX_STRIDE) return false;
+
+	const unsigned char* end = data + dataSize;
+	if (dataSize < 1 || *data++ != VERTEX_CODEC_VERSION) return false;
+
+	unsigned char* dest = (unsigned char*)destination;
+	unsigned char lastVertex[VERTEX_MAX_STRIDE] = {};
+
+	// One block's worth of decoded planes
+	alignas(16) unsigned char planes[VERTEX_MAX_STRIDE][VERTEX_BLOCK_SIZE];
+
+	for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VERTEX_BLOCK_SIZE)
+	{
+		size_t blockCount = vertexCount - blockStart;
+		if (blockCount > VERTEX_BLOCK_SIZE) blockCount = VERTEX_BLOCK_SIZE;
+		size_t groupCount = (blockCount + VERTEX_GROUP_SIZE - 1) / VERTEX_GROUP_SIZE;
+		size_t headerSize = (groupCount + 3) / 4;
+
+		for (size_t k = 0; k < vertexStride; k++)
+		{
+			if ((size_t)(end - data) < headerSize) return false;
+			const unsigned char* header = data;
+			data += headerSize;
+
+			__m128i previous = _mm_set1_epi8((char)lastVertex[k]);
+			for (size_t g = 0; g < groupCount; g++)
+			{
+				int bitWidth = (header[g / 4] >> ((g % 4) * 2)) & 3;
+
+				// Each width only ever reads exactly its own bytes
+				size_t groupSize = groupSizes[bitWidth];
+				if ((size_t)(end - data) < groupSize) return false;
+
+				__m128i values = DecodeDeltas(DecodeGroup(data, bitWidth), previous);
+				data += groupSize;
+
+				_mm_store_si128((__m128i*)(planes[k] + g * VERTEX_GROUP_SIZE), values);
+
+				// Broadcast the last byte for the next group
+				previous = _mm_set1_epi8((char)planes[k][g * VERTEX_GROUP_SIZE + 15]);
+			}
+
+			lastVertex[k] = planes[k][blockCount - 1];
+		}
+
+		// Put the planes back together into whole vertices
+		unsigned char* blockDest = dest + blockStart * vertexStride;
+		size_t k = 0;
+		for (; k + 4 <= vertexStride; k += 4)
+		{
+			for (size_t v = 0; v < blockCount; v += VERTEX_GROUP_SIZE)
+			{
+				size_t count = blockCount - v < VERTEX_GROUP_SIZE ? blockCount - v : VERTEX_GROUP_SIZE;
+				TransposeFourPlanes(blockDest + v * vertexStride + k, vertexStride, count,
+					planes[k] + v, planes[k + 1] + v, planes[k + 2] + v, planes[k + 3] + v);
+			}
+		}
+
+		// Strides that aren't a multiple of four have a few stragglers
+		for (; k < vertexStride; k++)
+		{
+			for (size_t v = 0; v < blockCount; v++)
+				blockDest[v * vertexStride + k] = planes[k][v];
+		}
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Index codec
+
+// Small ring buffers of recently used edges and vertices
+struct IndexFifos
+{
+	unsigned int edges[INDEX_FIFO_SIZE][2];
+	unsigned int vertices[INDEX_FIFO_SIZE];
+	unsigned int edgeOffset;
+	unsigned int vertexOffset;
+
+	IndexFifos()
+	{
+		memset(edges, 0xFF, sizeof(edges));
+		memset(vertices, 0xFF, sizeof(vertices));
+		edgeOffset = 0;
+		vertexOffset = 0;
+	}
+
+	void PushEdge(unsigned int a, unsigned int b)
+	{
+		edges[edgeOffset][0] = a;
+		edges[edgeOffset][1] = b;
+		edgeOffset = (edgeOffset + 1) % INDEX_FIFO_SIZE;
+	}
+
+	void PushVertex(unsigned int v)
+	{
+		vertices[vertexOffset] = v;
+		vertexOffset = (vertexOffset + 1) % INDEX_FIFO_SIZE;
+	}
+
+	// Distance back from the most recent entry
+	unsigned int EdgeAt(unsigned int distance, int which)
+	{
+		return edges[(edgeOffset + INDEX_FIFO_SIZE - 1 - distance) % INDEX_FIFO_SIZE][which];
+	}
+
+	unsigned int VertexAt(unsigned int distance)
+	{
+		return vertices[(vertexOffset + INDEX_FIFO_SIZE - 1 - distance) % INDEX_FIFO_SIZE];
+	}
+
+	int FindEdge(unsigned int a, unsigned int b)
+	{
+		for (unsigned int i = 0; i < INDEX_FIFO_SIZE - 1; i++)
+		{
+			if (EdgeAt(i, 0) == a && EdgeAt(i, 1) == b)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	int FindVertex(unsigned int v)
+	{
+		for (unsigned int i = 0; i < INDEX_FIFO_SIZE - 2; i++)
+		{
+			if (VertexAt(i) == v)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	// Neighbouring triangles share edges in the opposite direction
+	void PushTriangle(unsigned int a, unsigned int b, unsigned int c)
+	{
+		PushEdge(b, a);
+		PushEdge(c, b);
+		PushEdge(a, c);
+	}
+};
+
+// --------------------------------------------------------
+// Writes a single vertex reference as a code: 0 for the next
+// brand new vertex, 1 + fifo distance for a recent vertex, or
+// INDEX_CODE_EXPLICIT followed by a zigzagged delta
+// --------------------------------------------------------
+static unsigned int EncodeVertexReference(std::vector<unsigned char>& extra, IndexFifos& fifos, unsigned int v, unsigned int& next, unsigned int& last)
+{
+	unsigned int code;
+	if (v == next)
+	{
+		code = 0;
+		next++;
+		fifos.PushVertex(v);
+	}
+	else
+	{
+		int distance = fifos.FindVertex(v);
+		if (distance >= 0)
+		{
+			code = 1 + distance;
+		}
+		else
+		{
+			code = INDEX_CODE_EXPLICIT;
+			WriteVarInt(extra, ZigZag32((int)(v - last)));
+			fifos.PushVertex(v);
+		}
+	}
+
+	last = v;
+	return code;
+}
+
+static bool DecodeVertexReference(unsigned int code, const unsigned char*& data, const unsigned char* end, IndexFifos& fifos, unsigned int& next, unsigned int& last, unsigned int& v)
+{
+	if (code == 0)
+	{
+		v = next++;
+		fifos.PushVertex(v);
+	}
+	else if (code < INDEX_CODE_EXPLICIT)
+	{
+		v = fifos.VertexAt(code - 1);
+	}
+	else
+	{
+		unsigned int delta;
+		if (!ReadVarInt(data, end, delta)) return false;
+		v = last + (unsigned int)UnZigZag32(delta);
+		fifos.PushVertex(v);
+	}
+
+	last = v;
+	return true;
+}
+
+// --------------------------------------------------------
+// Each triangle starts with one code byte.  The high nibble
+// is the edge fifo distance of a shared edge (or 15 for none)
+// and the low nibble is the code for the third vertex.  When
+// no edge matched, a low nibble of 1 means "three brand new
+// vertices" (very common for meshes straight out of an OBJ),
+// otherwise two more bytes hold a code for each vertex.
+// --------------------------------------------------------
+std::vector<unsigned char> GeometryCodec::EncodeIndexBuffer(const unsigned int* indices, size_t indexCount)
+{
+	std::vector<unsigned char> out;
+	if (indexCount % 3 != 0) return out;
+
+	out.push_back(INDEX_CODEC_VERSION);
+	out.reserve(indexCount / 3 + 16);
+
+	IndexFifos fifos;
+	unsigned int next = 0;
+	unsigned int last = 0;
+	std::vector<unsigned char> extra;
+
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		unsigned int a = indices[i + 0];
+		unsigned int b = indices[i + 1];
+		unsigned int c = indices[i + 2];
+
+		// Try each rotation so the shared edge (if any) comes first
+		int edge = -1;
+		for (int r = 0; r < 3 && edge < 0; r++)
+		{
+			edge = fifos.FindEdge(a, b);
+			if (edge < 0)
+			{
+				unsigned int t = a; a = b; b = c; c = t;
+			}
+		}
+
+		extra.clear();
+		if (edge >= 0)
+		{
+			unsigned int code = EncodeVertexReference(extra, fifos, c, next, last);
+			out.push_back((unsigned char)((edge << 4) | code));
+		}
+		else if (a == next && b == next + 1 && c == next + 2)
+		{
+			out.push_back(0xF1);
+			for (unsigned int v = 0; v < 3; v++)
+				fifos.PushVertex(next++);
+			last = c;
+		}
+		else
+		{
+			out.push_back(0xF0);
+			unsigned int codes[3];
+			codes[0] = EncodeVertexReference(extra, fifos, a, next, last);
+			codes[1] = EncodeVertexReference(extra, fifos, b, next, last);
+			codes[2] = EncodeVertexReference(extra, fifos, c, next, last);
+
+			// Two codes share a byte, explicit deltas follow in order
+			out.push_back((unsigned char)((codes[0] << 4) | codes[1]));
+			out.push_back((unsigned char)codes[2]);
+		}
+		out.insert(out.end(), extra.begin(), extra.end());
+
+		fifos.PushTriangle(a, b, c);
+	}
+
+	return out;
+}
+
+bool GeometryCodec::DecodeIndexBuffer(unsigned int* destination, size_t indexCount, const unsigned char* data, size_t dataSize)
+{
+	if (indexCount % 3 != 0) return false;
+
+	const unsigned char* end = data + dataSize;
+	if (dataSize < 1 || *data++ != INDEX_CODEC_VERSION) return false;
+
+	IndexFifos fifos;
+	unsigned int next = 0;
+	unsigned int last = 0;
+
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		if (data == end) return false;
+		unsigned char code = *data++;
+		unsigned int edge = code >> 4;
+
+		unsigned int a, b, c;
+		if (edge < INDEX_FIFO_SIZE - 1)
+		{
+			a = fifos.EdgeAt(edge, 0);
+			b = fifos.EdgeAt(edge, 1);
+			if (!DecodeVertexReference(code & 15, data, end, fifos, next, last, c)) return false;
+		}
+		else if (code & 1)
+		{
+			a = next++;
+			b = next++;
+			c = next++;
+			fifos.PushVertex(a);
+			fifos.PushVertex(b);
+			fifos.PushVertex(c);
+			last = c;
+		}
+		else
+		{
+			if (end - data < 2) return false;
+			unsigned char codes01 = *data++;
+			unsigned char codes2 = *data++;
+			if (!DecodeVertexReference(codes01 >> 4, data, end, fifos, next, last, a)) return false;
+			if (!DecodeVertexReference(codes01 & 15, data, end, fifos, next, last, b)) return false;
+			if (!DecodeVertexReference(codes2 & 15, data, end, fifos, next, last, c)) return false;
+		}
+
+		destination[i + 0] = a;
+		destination[i + 1] = b;
+		destination[i + 2] = c;
+		fifos.PushTriangle(a, b, c);
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Files
+
+bool GeometryCodec::WriteMeshFile(std::string path, const void* vertices, unsigned int vertexCount, unsigned int vertexStride, const unsigned int* indices, unsigned int indexCount)
+{
+	std::vector<unsigned char> vertexData = EncodeVertexBuffer(vertices, vertexCount, vertexStride);
+	std::vector<unsigned char> indexData = EncodeIndexBuffer(indices, indexCount);
+	if (vertexData.empty() || indexData.empty()) return false;
+
+	FileHeader header = {};
+	memcpy(header.magic, "GMSH", 4);
+	header.vertexCount = vertexCount;
+	header.vertexStride = vertexStride;
+	header.indexCount = indexCount;
+	header.vertexDataSize = (unsigned int)vertexData.size();
+	header.indexDataSize = (unsigned int)indexData.size();
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)vertexData.data(), vertexData.size());
+	file.write((const char*)indexData.data(), indexData.size());
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Reads and decodes a mesh file.  The vertex bytes come out
+// exactly as they went in, so they can be handed straight to
+// anything expecting the original vertex struct.  Files whose
+// indices aren't whole triangles of their own vertices are
+// rejected.
+// --------------------------------------------------------
+bool GeometryCodec::ReadMeshFile(std::string path, std::vector<unsigned char>& vertices, unsigned int& vertexCount, unsigned int& vertexStride, std::vector<unsigned int>& indices)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	FileHeader header = {};
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() || memcmp(header.magic, "GMSH", 4) != 0) return false;
+
+	std::vector<unsigned char> data((size_t)header.vertexDataSize + header.indexDataSize);
+	file.read((char*)data.data(), data.size());
+	if (!file.good()) return false;
+
+	// Only whole triangles
+	if (header.indexCount % 3 != 0) return false;
+
+	vertexCount = header.vertexCount;
+	vertexStride = header.vertexStride;
+	vertices.resize((size_t)vertexCount * vertexStride);
+	indices.resize(header.indexCount);
+
+	if (!DecodeVertexBuffer(vertices.data(), vertexCount, vertexStride, data.data(), header.vertexDataSize) ||
+		!DecodeIndexBuffer(indices.data(), header.indexCount, data.data() + header.vertexDataSize, header.indexDataSize))
+		return false;
+
+	// A damaged file can decode to indices past the end of the
+	// vertices, which would read outside the mesh on the GPU
+	for (unsigned int index : indices)
+	{
+		if (index >= vertexCount) return false;
+	}
+
+	return true;
+}
+
+#pragma endregion
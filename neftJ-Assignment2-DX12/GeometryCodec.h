@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// File extension for compressed meshes (tried before .obj)
+#define GEOMETRY_CODEC_EXTENSION	".gmesh"
+
+// --------------------------------------------------------
+// Lossless compression for vertex and index buffers, built
+// so that decoding is cheaper than reading the raw data
+// from disk.
+//
+// Vertices: each byte of the vertex is treated as its own
+// stream ("byte plane"), delta coded against the previous
+// vertex and zigzagged so small changes become small bytes.
+// Every 16 bytes of a plane are then packed with 0, 2, 4 or
+// 8 bits each.  Decoding is SSE2 all the way through.
+//
+// Indices: each triangle is matched against recently seen
+// edges and vertices (two small FIFOs), so most triangles in
+// a well-ordered mesh cost a single byte.  Triangles may come
+// back rotated, but winding is always preserved.
+//
+// None of this touches DirectX, so it can be used by offline
+// tools as well.
+// --------------------------------------------------------
+class GeometryCodec
+{
+public:
+	// Vertex streams (stride is in bytes, max 256)
+	static std::vector<unsigned char> EncodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexStride);
+	static bool DecodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexStride, const unsigned char* data, size_t dataSize);
+
+	// Index streams (triangle lists only)
+	static std::vector<unsigned char> EncodeIndexBuffer(const unsigned int* indices, size_t indexCount);
+	static bool DecodeIndexBuffer(unsigned int* destination, size_t indexCount, const unsigned char* data, size_t dataSize);
+
+	// Whole meshes on disk
+	static bool WriteMeshFile(std::string path, const void* vertices, unsigned int vertexCount, unsigned int vertexStride, const unsigned int* indices, unsigned int indexCount);
+	static bool ReadMeshFile(std::string path, std::vector<unsigned char>& vertices, unsigned int& vertexCount, unsigned int& vertexStride, std::vector<unsigned int>& indices);
+
+private:
+	struct FileHeader
+	{
+		char magic[4];
+		unsigned int vertexCount;
+		unsigned int vertexStride;
+		unsigned int indexCount;
+		unsigned int vertexDataSize;
+		unsigned int indexDataSize;
+	};
+};
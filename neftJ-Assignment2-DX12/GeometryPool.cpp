@@ -0,0 +1,315 @@
+#include "GeometryPool.h"
+#include "VertexFormat.h"
+
+// Singleton requirement
+GeometryPool* GeometryPool::instance;
+
+GeometryPool::~GeometryPool()
+{
+
+}
+
+void GeometryPool::Initialize(Microsoft::WRL::ComPtr<ID3D12Device> device, Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList)
+{
+	this->device = device;
+	this->commandList = commandList;
+
+	// The built-in formats always exist, in the order of their ids
+	formats.clear();
+	RegisterFormat(StandardVertexFormat::Stride, 256 * 1024, 1024 * 1024);
+	RegisterFormat(PositionVertexFormat::Stride, 64 * 1024, 0);
+	RegisterFormat(CompactVertexFormat::Stride, 64 * 1024, 256 * 1024);
+}
+
+unsigned int GeometryPool::RegisterFormat(unsigned int vertexStride, unsigned int initialVertexCapacity, unsigned int initialIndexCapacity)
+{
+	FormatPool pool;
+	pool.stride = vertexStride;
+	pool.vertexAllocator.Reset(initialVertexCapacity);
+	pool.indexAllocator.Reset(initialIndexCapacity);
+	pool.vertexBuffer = CreatePoolBuffer((UINT64)vertexStride * initialVertexCapacity);
+	pool.indexBuffer = CreatePoolBuffer((UINT64)sizeof(unsigned int) * initialIndexCapacity);
+
+	formats.push_back(pool);
+	return (unsigned int)formats.size() - 1;
+}
+
+// --------------------------------------------------------
+// Finds room for the given vertices and indices in the buffers
+// for this format (growing them if necessary) and copies the
+// data over to the GPU.
+// --------------------------------------------------------
+GeometryHandle GeometryPool::Allocate(unsigned int format, void* vertices, unsigned int numVerts, unsigned int* indices, unsigned int numIndices)
+{
+	FormatPool& pool = formats[format];
+
+	GeometryHandle handle = {};
+	handle.format = format;
+	handle.vertexAllocation = AllocateRange(pool.vertexAllocator, pool.vertexBuffer, pool.stride, numVerts);
+	handle.indexAllocation = AllocateRange(pool.indexAllocator, pool.indexBuffer, sizeof(unsigned int), numIndices);
+
+	// Copy the actual data into place
+	DX12Helper::GetInstance().UploadBufferRegion(
+		pool.vertexBuffer,
+		pool.vertexAllocator.GetOffset(handle.vertexAllocation) * pool.stride,
+		vertices,
+		(UINT64)numVerts * pool.stride,
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+	DX12Helper::GetInstance().UploadBufferRegion(
+		pool.indexBuffer,
+		pool.indexAllocator.GetOffset(handle.indexAllocation) * sizeof(unsigned int),
+		indices,
+		(UINT64)numIndices * sizeof(unsigned int),
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	return handle;
+}
+
+void GeometryPool::Free(GeometryHandle handle)
+{
+	if (handle.format >= formats.size()) return;
+
+	formats[handle.format].vertexAllocator.Free(handle.vertexAllocation);
+	formats[handle.format].indexAllocator.Free(handle.indexAllocation);
+}
+
+// --------------------------------------------------------
+// Vertex-only allocations, for formats that are drawn with
+// another format's indices (the position stream, for instance)
+// --------------------------------------------------------
+uint32_t GeometryPool::AllocateVertices(unsigned int format, void* vertices, unsigned int numVerts)
+{
+	FormatPool& pool = formats[format];
+
+	uint32_t allocation = AllocateRange(pool.vertexAllocator, pool.vertexBuffer, pool.stride, numVerts);
+	DX12Helper::GetInstance().UploadBufferRegion(
+		pool.vertexBuffer,
+		pool.vertexAllocator.GetOffset(allocation) * pool.stride,
+		vertices,
+		(UINT64)numVerts * pool.stride,
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	return allocation;
+}
+
+void GeometryPool::FreeVertices(unsigned int format, uint32_t vertexAllocation)
+{
+	if (format >= formats.size()) return;
+	formats[format].vertexAllocator.Free(vertexAllocation);
+}
+
+int GeometryPool::GetBaseVertex(unsigned int format, uint32_t vertexAllocation)
+{
+	return (int)formats[format].vertexAllocator.GetOffset(vertexAllocation);
+}
+
+// --------------------------------------------------------
+// Packs all of the meshes in this format towards the start of
+// their buffers.  Handles stay valid since the offsets are
+// looked up through the allocators at draw time.
+// --------------------------------------------------------
+void GeometryPool::Defragment(unsigned int format)
+{
+	FormatPool& pool = formats[format];
+
+	std::vector<FreeListAllocator::Move> vertexMoves = pool.vertexAllocator.Defragment();
+	if (AnyMoved(vertexMoves))
+		RelocateBuffer(pool.vertexBuffer, pool.vertexAllocator.GetCapacity() * pool.stride, vertexMoves, pool.stride);
+
+	std::vector<FreeListAllocator::Move> indexMoves = pool.indexAllocator.Defragment();
+	if (AnyMoved(indexMoves))
+		RelocateBuffer(pool.indexBuffer, pool.indexAllocator.GetCapacity() * sizeof(unsigned int), indexMoves, sizeof(unsigned int));
+}
+
+D3D12_VERTEX_BUFFER_VIEW GeometryPool::GetVertexBufferView(unsigned int format)
+{
+	FormatPool& pool = formats[format];
+
+	D3D12_VERTEX_BUFFER_VIEW vbView = {};
+	vbView.BufferLocation = pool.vertexBuffer->GetGPUVirtualAddress();
+	vbView.StrideInBytes = pool.stride;
+	vbView.SizeInBytes = (UINT)(pool.vertexAllocator.GetCapacity() * pool.stride);
+	return vbView;
+}
+
+D3D12_INDEX_BUFFER_VIEW GeometryPool::GetIndexBufferView(unsigned int format)
+{
+	FormatPool& pool = formats[format];
+
+	D3D12_INDEX_BUFFER_VIEW ibView = {};
+	if (!pool.indexBuffer) return ibView;
+
+	ibView.BufferLocation = pool.indexBuffer->GetGPUVirtualAddress();
+	ibView.Format = DXGI_FORMAT_R32_UINT;
+	ibView.SizeInBytes = (UINT)(pool.indexAllocator.GetCapacity() * sizeof(unsigned int));
+	return ibView;
+}
+
+int GeometryPool::GetBaseVertex(GeometryHandle handle)
+{
+	return (int)formats[handle.format].vertexAllocator.GetOffset(handle.vertexAllocation);
+}
+
+unsigned int GeometryPool::GetStartIndex(GeometryHandle handle)
+{
+	return (unsigned int)formats[handle.format].indexAllocator.GetOffset(handle.indexAllocation);
+}
+
+unsigned int GeometryPool::GetFormatCount()
+{
+	return (unsigned int)formats.size();
+}
+
+UINT64 GeometryPool::GetVertexBytesUsed(unsigned int format)
+{
+	return formats[format].vertexAllocator.GetUsed() * formats[format].stride;
+}
+
+UINT64 GeometryPool::GetIndexBytesUsed(unsigned int format)
+{
+	return formats[format].indexAllocator.GetUsed() * sizeof(unsigned int);
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GeometryPool::CreatePoolBuffer(UINT64 sizeInBytes)
+{
+	if (sizeInBytes == 0) return 0;
+
+	// Pool buffers sit in generic read for their whole life,
+	// except for the brief moments we're copying into them
+	return DX12Helper::GetInstance().CreateBuffer(
+		sizeInBytes,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+}
+
+// --------------------------------------------------------
+// Replaces the buffer with a bigger one, copying the old
+// contents over before the old one goes away
+// --------------------------------------------------------
+void GeometryPool::ResizeBuffer(Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, UINT64 oldSizeInBytes, UINT64 newSizeInBytes)
+{
+	// Nothing to keep if there was no buffer yet
+	if (!buffer || oldSizeInBytes == 0)
+	{
+		buffer = CreatePoolBuffer(newSizeInBytes);
+		return;
+	}
+
+	// Anything still queued for the old buffer has to land before we copy it
+	DX12Helper::GetInstance().FlushUploadBatch();
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> newBuffer = DX12Helper::GetInstance().CreateBuffer(
+		newSizeInBytes,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	D3D12_RESOURCE_BARRIER rb[2] = {};
+	rb[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	rb[0].Transition.pResource = buffer.Get();
+	rb[0].Transition.StateBefore = D3D12_RESOURCE_STATE_GENERIC_READ;
+	rb[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	rb[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	commandList->ResourceBarrier(1, &rb[0]);
+
+	commandList->CopyBufferRegion(newBuffer.Get(), 0, buffer.Get(), 0, oldSizeInBytes);
+
+	rb[1].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	rb[1].Transition.pResource = newBuffer.Get();
+	rb[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+	rb[1].Transition.StateAfter = D3D12_RESOURCE_STATE_GENERIC_READ;
+	rb[1].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	commandList->ResourceBarrier(1, &rb[1]);
+
+	// The old buffer can't be released until the copy is done
+	DX12Helper::GetInstance().CloseExecuteAndResetCommandList();
+	buffer = newBuffer;
+}
+
+// --------------------------------------------------------
+// Applies a set of defragmentation moves.  All moves read from
+// the old buffer and write to a fresh one, so overlapping source
+// and destination ranges are never a problem, and the destination
+// ranges never overlap each other so no barriers are needed between
+// the individual copies.
+// --------------------------------------------------------
+void GeometryPool::RelocateBuffer(Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, UINT64 sizeInBytes, const std::vector<FreeListAllocator::Move>& moves, unsigned int elementSize)
+{
+	DX12Helper::GetInstance().FlushUploadBatch();
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> newBuffer = DX12Helper::GetInstance().CreateBuffer(
+		sizeInBytes,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	D3D12_RESOURCE_BARRIER rb = {};
+	rb.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	rb.Transition.pResource = buffer.Get();
+	rb.Transition.StateBefore = D3D12_RESOURCE_STATE_GENERIC_READ;
+	rb.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	rb.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	commandList->ResourceBarrier(1, &rb);
+
+	// One copy per live range (including the ones that stayed put)
+	for (auto& m : moves)
+	{
+		commandList->CopyBufferRegion(
+			newBuffer.Get(), m.dstOffset * elementSize,
+			buffer.Get(), m.srcOffset * elementSize,
+			m.size * elementSize);
+	}
+
+	rb.Transition.pResource = newBuffer.Get();
+	rb.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+	rb.Transition.StateAfter = D3D12_RESOURCE_STATE_GENERIC_READ;
+	commandList->ResourceBarrier(1, &rb);
+
+	DX12Helper::GetInstance().CloseExecuteAndResetCommandList();
+	buffer = newBuffer;
+}
+
+// --------------------------------------------------------
+// Grabs a range from the allocator.  If there isn't a big enough
+// free block but there's enough free space in total, the buffer
+// is only fragmented, so it's packed down first; otherwise the
+// allocator and its buffer grow.
+// --------------------------------------------------------
+uint32_t GeometryPool::AllocateRange(FreeListAllocator& allocator, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, unsigned int elementSize, unsigned int count)
+{
+	if (count == 0) return FreeListAllocator::InvalidId;
+
+	FreeListAllocator::Allocation alloc = allocator.Allocate(count);
+	if (alloc.offset != FreeListAllocator::InvalidOffset)
+		return alloc.id;
+
+	// Packing leaves all the free space in one block at the end (pool
+	// ranges are never aligned beyond one element)
+	if (allocator.GetFree() >= count)
+	{
+		std::vector<FreeListAllocator::Move> moves = allocator.Defragment();
+		if (AnyMoved(moves))
+			RelocateBuffer(buffer, allocator.GetCapacity() * elementSize, moves, elementSize);
+
+		alloc = allocator.Allocate(count);
+		if (alloc.offset != FreeListAllocator::InvalidOffset)
+			return alloc.id;
+	}
+
+	// Out of room - at least double so we don't end up doing this every mesh
+	uint64_t oldCapacity = allocator.GetCapacity();
+	uint64_t newCapacity = oldCapacity * 2;
+	if (newCapacity < oldCapacity + count) newCapacity = oldCapacity + count;
+
+	ResizeBuffer(buffer, oldCapacity * elementSize, newCapacity * elementSize);
+	allocator.Grow(newCapacity);
+
+	return allocator.Allocate(count).id;
+}
+
+bool GeometryPool::AnyMoved(const std::vector<FreeListAllocator::Move>& moves)
+{
+	for (auto& m : moves)
+	{
+		if (m.srcOffset != m.dstOffset) return true;
+	}
+	return false;
+}
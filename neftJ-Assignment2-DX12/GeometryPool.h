@@ -0,0 +1,106 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+
+#include "FreeListAllocator.h"
+#include "DX12Helper.h"
+
+// Built-in vertex formats, each of which gets its own pair of buffers
+#define GEOMETRY_FORMAT_STANDARD	0	// struct Vertex
+#define GEOMETRY_FORMAT_POSITION	1	// struct VertexPosition (vertices only, shares the standard indices)
+#define GEOMETRY_FORMAT_COMPACT		2	// CompactVertexFormat (quantized, 24 bytes per vertex)
+
+// Where a single mesh lives inside the pool
+struct GeometryHandle
+{
+	unsigned int format;
+	uint32_t vertexAllocation;
+	uint32_t indexAllocation;
+};
+
+// --------------------------------------------------------
+// One big vertex buffer and one big index buffer per vertex
+// format.  Meshes are suballocated out of these so a mesh is
+// just an offset and a count, and draws that share a format
+// don't need to rebind any buffers.
+// --------------------------------------------------------
+class GeometryPool
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static GeometryPool& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new GeometryPool();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	GeometryPool(GeometryPool const&) = delete;
+	void operator=(GeometryPool const&) = delete;
+
+private:
+	static GeometryPool* instance;
+	GeometryPool() {};
+#pragma endregion
+
+public:
+	~GeometryPool();
+
+	void Initialize(
+		Microsoft::WRL::ComPtr<ID3D12Device> device,
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList);
+
+	// Adds a new vertex format (returns its id).  Capacities are counts, not bytes,
+	// and an index capacity of zero means the format only ever holds vertices.
+	unsigned int RegisterFormat(unsigned int vertexStride, unsigned int initialVertexCapacity, unsigned int initialIndexCapacity);
+
+	// Allocating/freeing mesh data
+	GeometryHandle Allocate(unsigned int format, void* vertices, unsigned int numVerts, unsigned int* indices, unsigned int numIndices);
+	void Free(GeometryHandle handle);
+	void Defragment(unsigned int format);
+
+	// Extra vertex streams with no indices of their own
+	uint32_t AllocateVertices(unsigned int format, void* vertices, unsigned int numVerts);
+	void FreeVertices(unsigned int format, uint32_t vertexAllocation);
+	int GetBaseVertex(unsigned int format, uint32_t vertexAllocation);
+
+	// Drawing info
+	D3D12_VERTEX_BUFFER_VIEW GetVertexBufferView(unsigned int format);
+	D3D12_INDEX_BUFFER_VIEW GetIndexBufferView(unsigned int format);
+	int GetBaseVertex(GeometryHandle handle);
+	unsigned int GetStartIndex(GeometryHandle handle);
+
+	// Stats
+	unsigned int GetFormatCount();
+	UINT64 GetVertexBytesUsed(unsigned int format);
+	UINT64 GetIndexBytesUsed(unsigned int format);
+
+private:
+	struct FormatPool
+	{
+		unsigned int stride;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
+		FreeListAllocator vertexAllocator;	// In vertices
+		FreeListAllocator indexAllocator;	// In indices
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+
+	std::vector<FormatPool> formats;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreatePoolBuffer(UINT64 sizeInBytes);
+	void ResizeBuffer(Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, UINT64 oldSizeInBytes, UINT64 newSizeInBytes);
+	void RelocateBuffer(Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, UINT64 sizeInBytes, const std::vector<FreeListAllocator::Move>& moves, unsigned int elementSize);
+	bool AnyMoved(const std::vector<FreeListAllocator::Move>& moves);
+	uint32_t AllocateRange(FreeListAllocator& allocator, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer, unsigned int elementSize, unsigned int count);
+};
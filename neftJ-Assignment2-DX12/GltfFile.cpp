@@ -0,0 +1,708 @@
+#include "GltfFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Chunk identifiers for binary (.glb) files
+#define GLB_MAGIC		0x46546C67	// "glTF"
+#define GLB_CHUNK_JSON	0x4E4F534A	// "JSON"
+#define GLB_CHUNK_BIN	0x004E4942	// "BIN\0"
+
+// Primitive mode for triangle lists (the default)
+#define GLTF_MODE_TRIANGLES	4
+
+// Paths and URIs in glTF are UTF-8
+static std::wstring ToWide(const std::string& str)
+{
+	int length = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, 0, 0);
+	if (length <= 1) return std::wstring();
+
+	std::wstring wide(length - 1, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, &wide[0], length);
+	return wide;
+}
+
+// --------------------------------------------------------
+// Typed member lookups.  Each one fails if the member is
+// missing or the wrong type instead of tripping rapidjson's
+// asserts (or reading garbage in release), so optional
+// members are checked with HasMember first.
+// --------------------------------------------------------
+static const rapidjson::Value* JsonMember(const rapidjson::Value& parent, const char* name)
+{
+	if (!parent.IsObject())
+		return 0;
+
+	auto it = parent.FindMember(name);
+	return it == parent.MemberEnd() ? 0 : &it->value;
+}
+
+static const rapidjson::Value* JsonObject(const rapidjson::Value& parent, const char* name)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	return value && value->IsObject() ? value : 0;
+}
+
+static const rapidjson::Value* JsonArray(const rapidjson::Value& parent, const char* name)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	return value && value->IsArray() ? value : 0;
+}
+
+static bool JsonString(const rapidjson::Value& parent, const char* name, std::string& out)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	if (!value || !value->IsString()) return false;
+	out.assign(value->GetString(), value->GetStringLength());
+	return true;
+}
+
+static bool JsonInt(const rapidjson::Value& parent, const char* name, int& out)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	if (!value || !value->IsInt()) return false;
+	out = value->GetInt();
+	return true;
+}
+
+static bool JsonUint(const rapidjson::Value& parent, const char* name, unsigned int& out)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	if (!value || !value->IsUint()) return false;
+	out = value->GetUint();
+	return true;
+}
+
+static bool JsonSize(const rapidjson::Value& parent, const char* name, size_t& out)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	if (!value || !value->IsUint64()) return false;
+	out = (size_t)value->GetUint64();
+	return true;
+}
+
+static bool JsonFloat(const rapidjson::Value& parent, const char* name, float& out)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	if (!value || !value->IsNumber()) return false;
+	out = value->GetFloat();
+	return true;
+}
+
+static bool JsonBool(const rapidjson::Value& parent, const char* name, bool& out)
+{
+	const rapidjson::Value* value = JsonMember(parent, name);
+	if (!value || !value->IsBool()) return false;
+	out = value->GetBool();
+	return true;
+}
+
+GltfFile::GltfFile() :
+	leftHanded(false)
+{
+}
+
+GltfFile::~GltfFile()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Maps the file and everything it references, then parses
+// the JSON.  Nothing is copied except data URIs, which have
+// to be decoded from base64.
+// --------------------------------------------------------
+bool GltfFile::Open(std::string path)
+{
+	Close();
+
+	std::wstring widePath = ToWide(path);
+	std::wstring directory = widePath.substr(0, widePath.find_last_of(L"\\/") + 1);
+
+	MappedFile file;
+	if (!MapFile(widePath, file))
+		return false;
+
+	// Binary files are a header followed by a JSON chunk and an optional binary chunk
+	if (file.size >= 12 && *(const unsigned int*)file.data == GLB_MAGIC)
+	{
+		unsigned int version = *(const unsigned int*)(file.data + 4);
+		unsigned int totalLength = *(const unsigned int*)(file.data + 8);
+		if (version != 2 || totalLength > file.size)
+		{
+			Close();
+			return false;
+		}
+
+		BufferRange json = {};
+		BufferRange binary = {};
+		size_t offset = 12;
+		while (offset + 8 <= totalLength)
+		{
+			unsigned int chunkLength = *(const unsigned int*)(file.data + offset);
+			unsigned int chunkType = *(const unsigned int*)(file.data + offset + 4);
+			offset += 8;
+			if (offset + chunkLength > totalLength)
+				break;
+
+			if (chunkType == GLB_CHUNK_JSON && !json.data) json = { file.data + offset, chunkLength };
+			else if (chunkType == GLB_CHUNK_BIN && !binary.data) binary = { file.data + offset, chunkLength };
+
+			// Chunks are 4 byte aligned
+			offset += (chunkLength + 3) & ~3u;
+		}
+
+		if (!json.data || !Parse((const char*)json.data, json.size, binary, directory))
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	// Otherwise the whole file is the JSON
+	if (!Parse((const char*)file.data, file.size, BufferRange{}, directory))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void GltfFile::Close()
+{
+	for (auto& f : mappedFiles)
+	{
+		UnmapViewOfFile(f.data);
+		CloseHandle(f.mapping);
+		CloseHandle(f.file);
+	}
+
+	mappedFiles.clear();
+	decodedData.clear();
+	buffers.clear();
+	meshes.clear();
+	materials.clear();
+	images.clear();
+	leftHanded = false;
+}
+
+bool GltfFile::MapFile(std::wstring path, MappedFile& mapped)
+{
+	mapped = {};
+	mapped.file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (mapped.file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Empty files can't be mapped
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(mapped.file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(mapped.file);
+		return false;
+	}
+
+	mapped.mapping = CreateFileMappingW(mapped.file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapped.mapping)
+	{
+		CloseHandle(mapped.file);
+		return false;
+	}
+
+	mapped.data = (const unsigned char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mapped.data)
+	{
+		CloseHandle(mapped.mapping);
+		CloseHandle(mapped.file);
+		return false;
+	}
+
+	mapped.size = (size_t)size.QuadPart;
+	mappedFiles.push_back(mapped);
+	return true;
+}
+
+// --------------------------------------------------------
+// URIs are either relative file paths (mapped) or base64
+// data URIs (decoded into memory we own)
+// --------------------------------------------------------
+bool GltfFile::ResolveUri(std::string uri, std::wstring directory, BufferRange& range)
+{
+	range = {};
+
+	if (uri.compare(0, 5, "data:") == 0)
+	{
+		size_t comma = uri.find(";base64,");
+		if (comma == std::string::npos)
+			return false;
+
+		auto decodeChar = [](char c) -> int
+		{
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+') return 62;
+			if (c == '/') return 63;
+			return -1;
+		};
+
+		std::vector<unsigned char> bytes;
+		bytes.reserve((uri.size() - comma) * 3 / 4);
+
+		unsigned int bits = 0;
+		int bitCount = 0;
+		for (size_t i = comma + 8; i < uri.size(); i++)
+		{
+			int value = decodeChar(uri[i]);
+			if (value < 0) break; // Padding
+			bits = (bits << 6) | value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				bytes.push_back((unsigned char)(bits >> bitCount));
+			}
+		}
+
+		decodedData.push_back(std::move(bytes));
+		range = { decodedData.back().data(), decodedData.back().size() };
+		return true;
+	}
+
+	// Undo any percent encoding (spaces, mostly) before opening
+	std::string decoded;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size())
+		{
+			decoded.push_back((char)strtol(uri.substr(i + 1, 2).c_str(), 0, 16));
+			i += 2;
+		}
+		else decoded.push_back(uri[i]);
+	}
+
+	MappedFile file;
+	if (!MapFile(directory + ToWide(decoded), file))
+		return false;
+
+	range = { file.data, file.size };
+	return true;
+}
+
+bool GltfFile::ReadAccessor(const rapidjson::Document& doc, int index, GltfAccessor& accessor)
+{
+	accessor = {};
+	const rapidjson::Value* accessors = JsonArray(doc, "accessors");
+	if (!accessors || index < 0 || index >= (int)accessors->Size())
+		return false;
+
+	const rapidjson::Value& acc = (*accessors)[index];
+	if (!acc.IsObject() || acc.HasMember("sparse"))
+		return false;
+
+	std::string type;
+	int viewIndex;
+	if (!JsonString(acc, "type", type) ||
+		!JsonInt(acc, "componentType", accessor.componentType) ||
+		!JsonUint(acc, "count", accessor.count) ||
+		!JsonInt(acc, "bufferView", viewIndex))
+		return false;
+	if (acc.HasMember("normalized") && !JsonBool(acc, "normalized", accessor.normalized))
+		return false;
+
+	if (type == "SCALAR") accessor.components = 1;
+	else if (type == "VEC2") accessor.components = 2;
+	else if (type == "VEC3") accessor.components = 3;
+	else if (type == "VEC4") accessor.components = 4;
+	else return false;
+
+	unsigned int componentSize = 0;
+	switch (accessor.componentType)
+	{
+	case GLTF_COMPONENT_UNSIGNED_BYTE: componentSize = 1; break;
+	case GLTF_COMPONENT_UNSIGNED_SHORT: componentSize = 2; break;
+	case GLTF_COMPONENT_UNSIGNED_INT:
+	case GLTF_COMPONENT_FLOAT: componentSize = 4; break;
+	default: return false;
+	}
+	unsigned int elementSize = componentSize * accessor.components;
+
+	const rapidjson::Value* views = JsonArray(doc, "bufferViews");
+	if (!views || viewIndex < 0 || viewIndex >= (int)views->Size())
+		return false;
+
+	const rapidjson::Value& view = (*views)[viewIndex];
+	unsigned int bufferIndex;
+	size_t viewOffset = 0;
+	size_t viewLength;
+	size_t accessorOffset = 0;
+	accessor.stride = elementSize;
+	if (!JsonUint(view, "buffer", bufferIndex) ||
+		!JsonSize(view, "byteLength", viewLength) ||
+		(view.HasMember("byteOffset") && !JsonSize(view, "byteOffset", viewOffset)) ||
+		(view.HasMember("byteStride") && !JsonUint(view, "byteStride", accessor.stride)) ||
+		(acc.HasMember("byteOffset") && !JsonSize(acc, "byteOffset", accessorOffset)))
+		return false;
+
+	if (bufferIndex >= buffers.size() || !buffers[bufferIndex].data)
+		return false;
+
+	// Everything the accessor touches has to be inside the view, and the view inside the buffer
+	if (viewOffset + viewLength > buffers[bufferIndex].size)
+		return false;
+	if (accessor.count > 0 && accessorOffset + (size_t)accessor.stride * (accessor.count - 1) + elementSize > viewLength)
+		return false;
+
+	accessor.data = buffers[bufferIndex].data + viewOffset + accessorOffset;
+	return true;
+}
+
+bool GltfFile::Parse(const char* json, size_t jsonLength, BufferRange binaryChunk, std::wstring directory)
+{
+	rapidjson::Document doc;
+	doc.Parse(json, jsonLength);
+	if (doc.HasParseError() || !doc.IsObject())
+		return false;
+
+	// Only version 2 is supported
+	const rapidjson::Value* asset = JsonObject(doc, "asset");
+	std::string version;
+	if (!asset || !JsonString(*asset, "version", version) || version.empty() || version[0] != '2')
+		return false;
+
+	// Our own exports can say they're already in our space
+	const rapidjson::Value* extras = JsonObject(*asset, "extras");
+	leftHanded = false;
+	if (extras && extras->HasMember("leftHanded") && !JsonBool(*extras, "leftHanded", leftHanded))
+		return false;
+
+	// Buffers (the first one may be the binary chunk of a .glb).  Anything
+	// malformed further down keeps its slot, empty, so indices still line up.
+	if (const rapidjson::Value* bufferArray = JsonArray(doc, "buffers"))
+	{
+		for (unsigned int i = 0; i < bufferArray->Size(); i++)
+		{
+			const rapidjson::Value& buffer = (*bufferArray)[i];
+
+			BufferRange range = {};
+			std::string uri;
+			size_t length;
+			if (!JsonSize(buffer, "byteLength", length))
+			{
+				buffers.push_back(range);
+				continue;
+			}
+
+			if (JsonString(buffer, "uri", uri)) ResolveUri(uri, directory, range);
+			else if (i == 0 && !buffer.HasMember("uri")) range = binaryChunk;
+
+			// Chunks may be padded past the buffer's real length
+			if (range.size < length) range = {};
+			else range.size = length;
+
+			buffers.push_back(range);
+		}
+	}
+
+	// Images, either in a buffer view or their own file
+	const rapidjson::Value* views = JsonArray(doc, "bufferViews");
+	if (const rapidjson::Value* imageArray = JsonArray(doc, "images"))
+	{
+		for (auto& image : imageArray->GetArray())
+		{
+			GltfImage newImage = {};
+			unsigned int viewIndex;
+			std::string uri;
+			if (JsonUint(image, "bufferView", viewIndex))
+			{
+				unsigned int bufferIndex;
+				size_t viewOffset = 0;
+				size_t viewLength;
+				if (views && viewIndex < views->Size())
+				{
+					const rapidjson::Value& view = (*views)[viewIndex];
+					if (JsonUint(view, "buffer", bufferIndex) &&
+						JsonSize(view, "byteLength", viewLength) &&
+						(!view.HasMember("byteOffset") || JsonSize(view, "byteOffset", viewOffset)) &&
+						bufferIndex < buffers.size() && buffers[bufferIndex].data &&
+						viewOffset + viewLength <= buffers[bufferIndex].size)
+					{
+						newImage.data = buffers[bufferIndex].data + viewOffset;
+						newImage.size = viewLength;
+					}
+				}
+			}
+			else if (JsonString(image, "uri", uri))
+			{
+				BufferRange range;
+				if (ResolveUri(uri, directory, range))
+				{
+					newImage.data = range.data;
+					newImage.size = range.size;
+				}
+			}
+			images.push_back(newImage);
+		}
+	}
+
+	// Textures just point at images (samplers are ignored)
+	std::vector<int> textureImages;
+	if (const rapidjson::Value* textureArray = JsonArray(doc, "textures"))
+	{
+		for (auto& texture : textureArray->GetArray())
+		{
+			int source = -1;
+			if (!JsonInt(texture, "source", source))
+				source = -1;
+			textureImages.push_back(source);
+		}
+	}
+
+	auto imageFromTextureInfo = [&](const rapidjson::Value& parent, const char* member)
+	{
+		const rapidjson::Value* info = JsonObject(parent, member);
+		int texture;
+		if (!info || !JsonInt(*info, "index", texture))
+			return -1;
+
+		if (texture < 0 || texture >= (int)textureImages.size())
+			return -1;
+		return textureImages[texture];
+	};
+
+	// Materials (metal/roughness only)
+	if (const rapidjson::Value* materialArray = JsonArray(doc, "materials"))
+	{
+		for (auto& material : materialArray->GetArray())
+		{
+			GltfMaterial newMaterial = {};
+			JsonString(material, "name", newMaterial.name);
+			newMaterial.baseColor = DirectX::XMFLOAT4(1, 1, 1, 1);
+			newMaterial.metallic = 1.0f;
+			newMaterial.roughness = 1.0f;
+			newMaterial.baseColorImage = -1;
+			newMaterial.metallicRoughnessImage = -1;
+			newMaterial.normalImage = imageFromTextureInfo(material, "normalTexture");
+
+			if (const rapidjson::Value* pbr = JsonObject(material, "pbrMetallicRoughness"))
+			{
+				const rapidjson::Value* factor = JsonArray(*pbr, "baseColorFactor");
+				if (factor && factor->Size() == 4 &&
+					(*factor)[0].IsNumber() && (*factor)[1].IsNumber() &&
+					(*factor)[2].IsNumber() && (*factor)[3].IsNumber())
+				{
+					newMaterial.baseColor = DirectX::XMFLOAT4(
+						(*factor)[0].GetFloat(),
+						(*factor)[1].GetFloat(),
+						(*factor)[2].GetFloat(),
+						(*factor)[3].GetFloat());
+				}
+				JsonFloat(*pbr, "metallicFactor", newMaterial.metallic);
+				JsonFloat(*pbr, "roughnessFactor", newMaterial.roughness);
+				newMaterial.baseColorImage = imageFromTextureInfo(*pbr, "baseColorTexture");
+				newMaterial.metallicRoughnessImage = imageFromTextureInfo(*pbr, "metallicRoughnessTexture");
+			}
+			materials.push_back(newMaterial);
+		}
+	}
+
+	// Meshes and their primitives
+	if (const rapidjson::Value* meshArray = JsonArray(doc, "meshes"))
+	{
+		for (auto& mesh : meshArray->GetArray())
+		{
+			GltfMesh newMesh;
+			JsonString(mesh, "name", newMesh.name);
+
+			const rapidjson::Value* primitives = JsonArray(mesh, "primitives");
+			for (unsigned int p = 0; primitives && p < primitives->Size(); p++)
+			{
+				const rapidjson::Value& primitive = (*primitives)[p];
+				int mode = GLTF_MODE_TRIANGLES;
+				if (primitive.HasMember("mode") && !JsonInt(primitive, "mode", mode))
+					continue;
+				if (mode != GLTF_MODE_TRIANGLES)
+					continue;
+
+				const rapidjson::Value* attributes = JsonObject(primitive, "attributes");
+				int positionIndex;
+				if (!attributes || !JsonInt(*attributes, "POSITION", positionIndex))
+					continue;
+
+				GltfPrimitive newPrimitive = {};
+				newPrimitive.material = -1;
+				if (primitive.HasMember("material") && !JsonInt(primitive, "material", newPrimitive.material))
+					continue;
+
+				// Position is required, the rest is optional
+				if (!ReadAccessor(doc, positionIndex, newPrimitive.position) ||
+					newPrimitive.position.componentType != GLTF_COMPONENT_FLOAT ||
+					newPrimitive.position.components != 3)
+					continue;
+
+				int attributeIndex;
+				if (JsonInt(*attributes, "NORMAL", attributeIndex)) ReadAccessor(doc, attributeIndex, newPrimitive.normal);
+				if (JsonInt(*attributes, "TEXCOORD_0", attributeIndex)) ReadAccessor(doc, attributeIndex, newPrimitive.uv);
+				if (JsonInt(*attributes, "TANGENT", attributeIndex)) ReadAccessor(doc, attributeIndex, newPrimitive.tangent);
+
+				int indicesIndex;
+				if (primitive.HasMember("indices") &&
+					(!JsonInt(primitive, "indices", indicesIndex) || !ReadAccessor(doc, indicesIndex, newPrimitive.indices)))
+					continue;
+
+				newMesh.primitives.push_back(newPrimitive);
+			}
+
+			meshes.push_back(newMesh);
+		}
+	}
+
+	return true;
+}
+
+bool GltfFile::MatchesVertexLayout(const GltfPrimitive& primitive)
+{
+	auto isFloats = [](const GltfAccessor& a, int components)
+	{
+		return a.data &&
+			a.componentType == GLTF_COMPONENT_FLOAT &&
+			a.components == components &&
+			a.stride == sizeof(Vertex);
+	};
+
+	const unsigned char* base = primitive.position.data;
+	return
+		isFloats(primitive.position, 3) &&
+		isFloats(primitive.uv, 2) &&
+		isFloats(primitive.normal, 3) &&
+		isFloats(primitive.tangent, 3) &&
+		primitive.uv.data == base + offsetof(Vertex, UV) &&
+		primitive.normal.data == base + offsetof(Vertex, Normal) &&
+		primitive.tangent.data == base + offsetof(Vertex, Tangent) &&
+		primitive.uv.count == primitive.position.count &&
+		primitive.normal.count == primitive.position.count &&
+		primitive.tangent.count == primitive.position.count;
+}
+
+bool GltfFile::MatchesIndexLayout(const GltfPrimitive& primitive)
+{
+	return
+		primitive.indices.data &&
+		primitive.indices.componentType == GLTF_COMPONENT_UNSIGNED_INT &&
+		primitive.indices.stride == sizeof(unsigned int) &&
+		primitive.indices.count % 3 == 0;
+}
+
+// Reads one component of an element as a float, handling normalized integers
+static float ReadComponent(const GltfAccessor& accessor, unsigned int element, int component)
+{
+	const unsigned char* data = accessor.data + (size_t)accessor.stride * element;
+	switch (accessor.componentType)
+	{
+	case GLTF_COMPONENT_FLOAT:
+	{
+		float value;
+		memcpy(&value, data + component * 4, 4);
+		return value;
+	}
+	case GLTF_COMPONENT_UNSIGNED_BYTE:
+		return data[component] / (accessor.normalized ? 255.0f : 1.0f);
+	case GLTF_COMPONENT_UNSIGNED_SHORT:
+	{
+		unsigned short value;
+		memcpy(&value, data + component * 2, 2);
+		return value / (accessor.normalized ? 65535.0f : 1.0f);
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+// --------------------------------------------------------
+// glTF's UV origin is already top-left like ours, so only
+// the handedness needs converting.  Tangents are copied if
+// the file has them for every vertex (dropping VEC4's sign,
+// since our bitangent always comes from a cross product);
+// otherwise they're left at zero and built the same way as
+// every other mesh.
+// --------------------------------------------------------
+bool GltfFile::ReadVertices(const GltfPrimitive& primitive, bool toLeftHanded, std::vector<Vertex>& verts)
+{
+	unsigned int count = primitive.position.count;
+	verts.assign(count, Vertex{});
+
+	bool hasTangents =
+		primitive.tangent.data && primitive.normal.data &&
+		primitive.tangent.componentType == GLTF_COMPONENT_FLOAT &&
+		(primitive.tangent.components == 3 || primitive.tangent.components == 4) &&
+		primitive.normal.components == 3 &&
+		primitive.tangent.count >= count &&
+		primitive.normal.count >= count;
+
+	float zSign = toLeftHanded ? -1.0f : 1.0f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Vertex& v = verts[i];
+		v.Position.x = ReadComponent(primitive.position, i, 0);
+		v.Position.y = ReadComponent(primitive.position, i, 1);
+		v.Position.z = ReadComponent(primitive.position, i, 2) * zSign;
+
+		if (primitive.normal.data && primitive.normal.components == 3 && i < primitive.normal.count)
+		{
+			v.Normal.x = ReadComponent(primitive.normal, i, 0);
+			v.Normal.y = ReadComponent(primitive.normal, i, 1);
+			v.Normal.z = ReadComponent(primitive.normal, i, 2) * zSign;
+		}
+
+		if (primitive.uv.data && primitive.uv.components == 2 && i < primitive.uv.count)
+		{
+			v.UV.x = ReadComponent(primitive.uv, i, 0);
+			v.UV.y = ReadComponent(primitive.uv, i, 1);
+		}
+
+		if (hasTangents)
+		{
+			v.Tangent.x = ReadComponent(primitive.tangent, i, 0);
+			v.Tangent.y = ReadComponent(primitive.tangent, i, 1);
+			v.Tangent.z = ReadComponent(primitive.tangent, i, 2) * zSign;
+		}
+	}
+
+	return hasTangents;
+}
+
+void GltfFile::ReadIndices(const GltfPrimitive& primitive, bool toLeftHanded, std::vector<unsigned int>& indices)
+{
+	const GltfAccessor& accessor = primitive.indices;
+
+	// No index accessor means every three vertices are a triangle
+	if (!accessor.data)
+	{
+		indices.resize(primitive.position.count - primitive.position.count % 3);
+		for (unsigned int i = 0; i < indices.size(); i++)
+			indices[i] = i;
+	}
+	else
+	{
+		indices.resize(accessor.count - accessor.count % 3);
+		for (unsigned int i = 0; i < indices.size(); i++)
+		{
+			const unsigned char* data = accessor.data + (size_t)accessor.stride * i;
+			switch (accessor.componentType)
+			{
+			case GLTF_COMPONENT_UNSIGNED_BYTE: indices[i] = *data; break;
+			case GLTF_COMPONENT_UNSIGNED_SHORT: { unsigned short value; memcpy(&value, data, 2); indices[i] = value; break; }
+			case GLTF_COMPONENT_UNSIGNED_INT: memcpy(&indices[i], data, 4); break;
+			default: indices[i] = 0; break;
+			}
+		}
+	}
+
+	// Mirroring the Z axis flips the winding, so flip it back
+	if (toLeftHanded)
+	{
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			std::swap(indices[i + 1], indices[i + 2]);
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "rapidjson/document.h"
+#include "Vertex.h"
+
+// One accessor resolved to a pointer into the file's (mapped) data
+struct GltfAccessor
+{
+	const unsigned char* data;	// First element, or null if the accessor is missing
+	unsigned int count;
+	unsigned int stride;		// Bytes between elements
+	int componentType;			// GLTF_COMPONENT_*
+	int components;				// 1 for SCALAR up to 4 for VEC4
+	bool normalized;
+};
+
+// A single draw's worth of geometry (a "submesh")
+struct GltfPrimitive
+{
+	GltfAccessor position;
+	GltfAccessor normal;
+	GltfAccessor uv;
+	GltfAccessor tangent;
+	GltfAccessor indices;
+	int material;				// -1 if none
+};
+
+struct GltfMesh
+{
+	std::string name;
+	std::vector<GltfPrimitive> primitives;
+};
+
+// Images are either inside one of the buffers or their own file
+struct GltfImage
+{
+	const unsigned char* data;
+	size_t size;
+};
+
+struct GltfMaterial
+{
+	std::string name;
+	DirectX::XMFLOAT4 baseColor;
+	float metallic;
+	float roughness;
+	int baseColorImage;			// Image indices, -1 if none
+	int normalImage;
+	int metallicRoughnessImage;	// Roughness in green, metal in blue
+};
+
+// Component types from the spec
+#define GLTF_COMPONENT_UNSIGNED_BYTE	5121
+#define GLTF_COMPONENT_UNSIGNED_SHORT	5123
+#define GLTF_COMPONENT_UNSIGNED_INT		5125
+#define GLTF_COMPONENT_FLOAT			5126
+
+// --------------------------------------------------------
+// Reads glTF 2.0 files (.glb or .gltf) for their meshes and
+// materials.  Every buffer (and external image) is memory
+// mapped rather than read, and accessors are handed out as
+// pointers straight into those mappings, so geometry that's
+// already in our layout never gets copied on the CPU.  The
+// mappings live as long as this object does.
+//
+// Node hierarchies, animation, skins and sparse accessors
+// aren't supported; primitives that need them are skipped.
+// --------------------------------------------------------
+class GltfFile
+{
+public:
+	GltfFile();
+	~GltfFile();
+
+	GltfFile(GltfFile const&) = delete;
+	void operator=(GltfFile const&) = delete;
+
+	bool Open(std::string path);
+	void Close();
+
+	const std::vector<GltfMesh>& GetMeshes() { return meshes; }
+	const std::vector<GltfMaterial>& GetMaterials() { return materials; }
+	const std::vector<GltfImage>& GetImages() { return images; }
+
+	// glTF is right-handed, but files can mark themselves as already being
+	// in our left-handed space with "asset": { "extras": { "leftHanded": true } }
+	bool IsLeftHanded() { return leftHanded; }
+
+	// True if the primitive's vertices are exactly an array of Vertex
+	// (interleaved, same order, 3 component float tangents) and can be
+	// used straight from the file.  Standard glTF tangents are VEC4 (the
+	// w is the bitangent sign), so only files written by an exporter that
+	// knows our layout get here; everything else goes through ReadVertices.
+	static bool MatchesVertexLayout(const GltfPrimitive& primitive);
+
+	// True if the indices are already 32 bit and tightly packed
+	static bool MatchesIndexLayout(const GltfPrimitive& primitive);
+
+	// Converts any supported layout to our Vertex, optionally moving it from
+	// glTF's right-handed space to our left-handed one (same as the OBJ loader).
+	// Returns true if the file's tangents (VEC3 or VEC4) were copied in too.
+	static bool ReadVertices(const GltfPrimitive& primitive, bool toLeftHanded, std::vector<Vertex>& verts);
+	static void ReadIndices(const GltfPrimitive& primitive, bool toLeftHanded, std::vector<unsigned int>& indices);
+
+private:
+	struct MappedFile
+	{
+		HANDLE file;
+		HANDLE mapping;
+		const unsigned char* data;
+		size_t size;
+	};
+
+	// Where each buffer's bytes live (mapped file, GLB chunk or decoded data URI)
+	struct BufferRange
+	{
+		const unsigned char* data;
+		size_t size;
+	};
+
+	std::vector<MappedFile> mappedFiles;
+	std::vector<std::vector<unsigned char>> decodedData;
+	std::vector<BufferRange> buffers;
+
+	std::vector<GltfMesh> meshes;
+	std::vector<GltfMaterial> materials;
+	std::vector<GltfImage> images;
+	bool leftHanded;
+
+	bool MapFile(std::wstring path, MappedFile& mapped);
+	bool ResolveUri(std::string uri, std::wstring directory, BufferRange& range);
+	bool ReadAccessor(const rapidjson::Document& doc, int index, GltfAccessor& accessor);
+	bool Parse(const char* json, size_t jsonLength, BufferRange binaryChunk, std::wstring directory);
+};
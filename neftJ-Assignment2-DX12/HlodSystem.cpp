@@ -0,0 +1,404 @@
+#include "HlodSystem.h"
+#include "Assets.h"
+#include "ProceduralMesh.h"
+#include "StaticBatcher.h"
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+// Singleton requirement
+HlodSystem* HlodSystem::instance;
+
+HlodSystem::HlodSystem()
+{
+	builtProxies = 0;
+	distance = HLOD_DISTANCE;
+	proxiesShown = 0;
+	drawsSaved = 0;
+	sourceTriangles = 0;
+	proxyTriangles = 0;
+}
+
+void HlodSystem::Add(std::string meshName, Material* material, XMFLOAT3 position, XMFLOAT4 rotation, XMFLOAT3 scale)
+{
+	pending.push_back({ meshName, material, position, rotation, scale });
+}
+
+void HlodSystem::Build(EntityManager& entities)
+{
+	if (pending.empty())
+		return;
+
+	// Every mesh's source data, loaded once no matter how many instances use it
+	Assets& assets = Assets::GetInstance();
+	std::unordered_map<std::string, SourceMesh> sources;
+	for (const Instance& i : pending)
+	{
+		if (sources.find(i.mesh) != sources.end())
+			continue;
+
+		SourceMesh& source = sources[i.mesh];
+		if (!assets.LoadMeshData(i.mesh, source.verts, source.indices))
+		{
+			source.verts.clear();
+			source.indices.clear();
+		}
+	}
+
+	std::vector<Cluster> built = GroupInstances(pending, sources);
+	BuildClusters(built, pending, sources, true);
+
+	// Every instance's own entity, drawn while its cluster is close.  Clusters
+	// switch from holding indices into the pending instances to holding
+	// indices into these.
+	TransformStore& store = TransformStore::GetInstance();
+	std::vector<uint32_t> entityIndex(pending.size());
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		const Instance& instance = pending[i];
+		std::shared_ptr<Mesh> mesh = assets.GetMesh(instance.mesh);
+		if (!mesh || sources[instance.mesh].verts.empty())
+			continue;
+
+		uint32_t transform = store.Allocate();
+		store.SetPosition(transform, instance.position);
+		store.SetRotation(transform, instance.rotation);
+		store.SetScale(transform, instance.scale);
+
+		MeshRendererComponent renderer = { mesh.get(), instance.material };
+		entityIndex[i] = (uint32_t)instanceEntities.size();
+		instanceEntities.push_back(entities.Create(TransformComponent{ transform }, renderer));
+		instanceRenderers.push_back(renderer);
+	}
+
+	// The proxies, already in world space and hidden until they're far away
+	for (Cluster& cluster : built)
+	{
+		for (uint32_t& i : cluster.instances)
+			i = entityIndex[i];
+
+		sourceTriangles += cluster.sourceTriangles;
+		for (Proxy& proxy : cluster.proxies)
+		{
+			std::shared_ptr<Mesh> mesh;
+			if (!proxy.indices.empty())
+			{
+				mesh = assets.CreateMesh(
+					"hlod:" + std::to_string(builtProxies++),
+					proxy.verts.data(), (int)proxy.verts.size(),
+					proxy.indices.data(), (int)proxy.indices.size(),
+					MESH_FLAG_POSITION_STREAM);
+			}
+
+			proxyTriangles += proxy.indices.size() / 3;
+			std::vector<Vertex>().swap(proxy.verts);
+			std::vector<unsigned int>().swap(proxy.indices);
+
+			// A material whose instances all simplified away has nothing to draw
+			proxy.renderer = { mesh.get(), proxy.material };
+			proxy.entity = mesh ? entities.Create(TransformComponent{ store.Allocate() }) : Entity{ UINT32_MAX, 0 };
+		}
+		cluster.proxyShown = false;
+		clusters.push_back(std::move(cluster));
+	}
+
+	pending.clear();
+}
+
+void HlodSystem::Update(EntityManager& entities, XMFLOAT3 cameraPosition)
+{
+	proxiesShown = 0;
+	drawsSaved = 0;
+
+	XMVECTOR camera = XMLoadFloat3(&cameraPosition);
+	for (Cluster& cluster : clusters)
+	{
+		// Distance to the closest point of the cluster's bounds
+		XMVECTOR center = XMLoadFloat3(&cluster.bounds.Center);
+		XMVECTOR extents = XMLoadFloat3(&cluster.bounds.Extents);
+		XMVECTOR closest = XMVectorClamp(camera, center - extents, center + extents);
+		float clusterDistance = XMVectorGetX(XMVector3Length(camera - closest));
+
+		bool useProxy = cluster.proxyShown ?
+			clusterDistance > distance * (1.0f - HLOD_HYSTERESIS) :
+			clusterDistance > distance * (1.0f + HLOD_HYSTERESIS);
+
+		if (useProxy != cluster.proxyShown)
+		{
+			cluster.proxyShown = useProxy;
+			for (uint32_t i : cluster.instances)
+			{
+				if (!entities.IsAlive(instanceEntities[i])) continue;
+				if (useProxy) entities.Remove<MeshRendererComponent>(instanceEntities[i]);
+				else entities.Add(instanceEntities[i], instanceRenderers[i]);
+			}
+
+			for (const Proxy& proxy : cluster.proxies)
+			{
+				if (!proxy.renderer.mesh || !entities.IsAlive(proxy.entity)) continue;
+				if (useProxy) entities.Add(proxy.entity, proxy.renderer);
+				else entities.Remove<MeshRendererComponent>(proxy.entity);
+			}
+		}
+
+		if (cluster.proxyShown)
+		{
+			unsigned int proxyDraws = 0;
+			for (const Proxy& proxy : cluster.proxies)
+				proxyDraws += proxy.renderer.mesh ? 1 : 0;
+
+			proxiesShown++;
+			drawsSaved += (unsigned int)cluster.instances.size() - std::min((unsigned int)cluster.instances.size(), proxyDraws);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Puts each instance in the cluster for the column of the
+// ground it stands in.  Instances whose mesh couldn't be
+// loaded are left out.
+// --------------------------------------------------------
+std::vector<HlodSystem::Cluster> HlodSystem::GroupInstances(const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources)
+{
+	std::unordered_map<uint64_t, size_t> clusterOf;
+	std::vector<Cluster> clusters;
+	for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+	{
+		if (sources.at(instances[i].mesh).verts.empty())
+			continue;
+
+		int x = (int)floorf(instances[i].position.x / HLOD_CLUSTER_SIZE);
+		int z = (int)floorf(instances[i].position.z / HLOD_CLUSTER_SIZE);
+		uint64_t key = ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+
+		auto it = clusterOf.find(key);
+		if (it == clusterOf.end())
+		{
+			it = clusterOf.insert({ key, clusters.size() }).first;
+			clusters.emplace_back();
+		}
+		clusters[it->second].instances.push_back(i);
+	}
+
+	return clusters;
+}
+
+void HlodSystem::BuildClusters(std::vector<Cluster>& clusters, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources, bool allowThreads)
+{
+	size_t numClusters = clusters.size();
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	size_t perJob = (numClusters + cores - 1) / cores;
+	if (cores == 1 || numClusters < 2)
+	{
+		for (Cluster& cluster : clusters)
+			BuildCluster(cluster, instances, sources);
+		return;
+	}
+
+	std::vector<std::future<void>> jobs;
+	for (size_t first = perJob; first < numClusters; first += perJob)
+	{
+		size_t last = std::min(first + perJob, numClusters);
+		jobs.push_back(std::async(std::launch::async, [&clusters, &instances, &sources, first, last]()
+			{
+				for (size_t c = first; c < last; c++)
+					BuildCluster(clusters[c], instances, sources);
+			}));
+	}
+
+	for (size_t c = 0; c < std::min(perJob, numClusters); c++)
+		BuildCluster(clusters[c], instances, sources);
+	for (std::future<void>& job : jobs)
+		job.get();
+}
+
+void HlodSystem::BuildCluster(Cluster& cluster, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources)
+{
+	cluster.proxies.clear();
+
+	// Merged, one proxy for each material so none of them changes colour
+	std::unordered_map<Material*, size_t> proxyOf;
+	for (uint32_t i : cluster.instances)
+	{
+		const Instance& instance = instances[i];
+		auto it = proxyOf.find(instance.material);
+		if (it == proxyOf.end())
+		{
+			it = proxyOf.insert({ instance.material, cluster.proxies.size() }).first;
+			cluster.proxies.emplace_back();
+			cluster.proxies.back().material = instance.material;
+		}
+
+		Proxy& proxy = cluster.proxies[it->second];
+		const SourceMesh& source = sources.at(instance.mesh);
+		StaticBatcher::AppendTransformed(source.verts, source.indices, instance.position, instance.rotation, instance.scale, proxy.verts, proxy.indices);
+	}
+
+	cluster.sourceTriangles = 0;
+	std::vector<XMFLOAT3> positions;
+	for (const Proxy& proxy : cluster.proxies)
+	{
+		cluster.sourceTriangles += (unsigned int)(proxy.indices.size() / 3);
+		for (const Vertex& v : proxy.verts)
+			positions.push_back(v.Position);
+	}
+	BoundingBox::CreateFromPoints(cluster.bounds, positions.size(), positions.data(), sizeof(XMFLOAT3));
+
+	// Tall clusters get a bigger grid cell, so there's the same number across the
+	// longest side.  Every material uses the same grid so their proxies still meet.
+	float size = std::max(HLOD_CLUSTER_SIZE, 2.0f * std::max(cluster.bounds.Extents.x, std::max(cluster.bounds.Extents.y, cluster.bounds.Extents.z)));
+	for (Proxy& proxy : cluster.proxies)
+		Simplify(proxy.verts, proxy.indices, size / HLOD_GRID_CELLS);
+}
+
+// --------------------------------------------------------
+// Vertex clustering: every vertex in the same grid cell,
+// facing the same way (by the axis its normal is closest
+// to), becomes one vertex at their average.  Keeping faces
+// that point different ways apart stops the two sides of
+// something thin from merging and cancelling each other's
+// normals.  Triangles with two corners in the same cell are
+// gone, as are copies of a triangle.
+// --------------------------------------------------------
+void HlodSystem::Simplify(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, float cellSize)
+{
+	std::unordered_map<uint64_t, uint32_t> cellVertex;
+	std::vector<uint32_t> remap(verts.size());
+	std::vector<Vertex> sums;
+	std::vector<float> counts;
+
+	float inverseCell = 1.0f / cellSize;
+	for (size_t v = 0; v < verts.size(); v++)
+	{
+		const Vertex& vertex = verts[v];
+
+		// 20 bits for each coordinate and 3 for the direction
+		auto cell = [inverseCell](float p) { return (uint64_t)((int64_t)floorf(p * inverseCell) & 0xFFFFF); };
+		float ax = fabsf(vertex.Normal.x), ay = fabsf(vertex.Normal.y), az = fabsf(vertex.Normal.z);
+		uint64_t direction = ax >= ay && ax >= az ? (vertex.Normal.x < 0 ? 1 : 0) :
+			ay >= az ? (vertex.Normal.y < 0 ? 3 : 2) :
+			(vertex.Normal.z < 0 ? 5 : 4);
+		uint64_t key = (cell(vertex.Position.x) << 43) | (cell(vertex.Position.y) << 23) | (cell(vertex.Position.z) << 3) | direction;
+
+		auto it = cellVertex.find(key);
+		if (it == cellVertex.end())
+		{
+			it = cellVertex.insert({ key, (uint32_t)sums.size() }).first;
+			Vertex zero = {};
+			sums.push_back(zero);
+			counts.push_back(0);
+		}
+
+		uint32_t merged = it->second;
+		remap[v] = merged;
+		Vertex& sum = sums[merged];
+		sum.Position.x += vertex.Position.x;
+		sum.Position.y += vertex.Position.y;
+		sum.Position.z += vertex.Position.z;
+		sum.UV.x += vertex.UV.x;
+		sum.UV.y += vertex.UV.y;
+		sum.Normal.x += vertex.Normal.x;
+		sum.Normal.y += vertex.Normal.y;
+		sum.Normal.z += vertex.Normal.z;
+		counts[merged]++;
+	}
+
+	for (size_t v = 0; v < sums.size(); v++)
+	{
+		Vertex& vertex = sums[v];
+		float inverseCount = 1.0f / counts[v];
+		vertex.Position = XMFLOAT3(vertex.Position.x * inverseCount, vertex.Position.y * inverseCount, vertex.Position.z * inverseCount);
+		vertex.UV = XMFLOAT2(vertex.UV.x * inverseCount, vertex.UV.y * inverseCount);
+		XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMLoadFloat3(&vertex.Normal)));
+		vertex.Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// Each surviving triangle, rotated so its smallest index comes first
+	// (which keeps its winding) so copies sort next to each other
+	struct Triangle
+	{
+		uint32_t a, b, c;
+		bool operator<(const Triangle& o) const { return a != o.a ? a < o.a : b != o.b ? b < o.b : c < o.c; }
+		bool operator==(const Triangle& o) const { return a == o.a && b == o.b && c == o.c; }
+	};
+
+	std::vector<Triangle> triangles;
+	triangles.reserve(indices.size() / 3);
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+		if (a == b || b == c || a == c)
+			continue;
+
+		if (b < a && b < c) triangles.push_back({ b, c, a });
+		else if (c < a && c < b) triangles.push_back({ c, a, b });
+		else triangles.push_back({ a, b, c });
+	}
+	std::sort(triangles.begin(), triangles.end());
+	triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+	indices.clear();
+	indices.reserve(triangles.size() * 3);
+	for (const Triangle& t : triangles)
+	{
+		indices.push_back(t.a);
+		indices.push_back(t.b);
+		indices.push_back(t.c);
+	}
+	verts.swap(sums);
+}
+
+HlodTimings HlodSystem::MeasureBuild(unsigned int numInstances)
+{
+	HlodTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// Shapes are generated straight away, so this needs no assets or GPU
+	const char* shapes[] = { "cube", "sphere:16", "cylinder:16" };
+	std::unordered_map<std::string, SourceMesh> sources;
+	for (const char* shape : shapes)
+		ProceduralMesh::Generate(shape, sources[shape].verts, sources[shape].indices);
+
+	// A city of blocks over a few hundred units, with two materials
+	Material* materials[] = { reinterpret_cast<Material*>(1), reinterpret_cast<Material*>(2) };
+	std::vector<Instance> instances(numInstances);
+	for (Instance& i : instances)
+	{
+		i.mesh = shapes[rand() % 3];
+		i.material = materials[rand() % 2];
+		float height = random(1.0f, 10.0f);
+		i.position = XMFLOAT3(random(-200, 200), height * 0.5f, random(-200, 200));
+		XMStoreFloat4(&i.rotation, XMQuaternionRotationRollPitchYaw(0, random(0, XM_2PI), 0));
+		i.scale = XMFLOAT3(random(1.0f, 3.0f), height, random(1.0f, 3.0f));
+	}
+
+	std::vector<Cluster> clusters = GroupInstances(instances, sources);
+	timings.instances = numInstances;
+	timings.clusters = (unsigned int)clusters.size();
+
+	for (bool threaded : { false, true })
+	{
+		// Each build starts from the unsimplified instances
+		std::vector<Cluster> built = clusters;
+		auto start = now();
+		BuildClusters(built, instances, sources, threaded);
+		(threaded ? timings.buildThreadedMs : timings.buildMs) = std::chrono::duration<double, std::milli>(now() - start).count();
+
+		timings.sourceTriangles = 0;
+		timings.proxyTriangles = 0;
+		for (const Cluster& cluster : built)
+		{
+			timings.sourceTriangles += cluster.sourceTriangles;
+			for (const Proxy& proxy : cluster.proxies)
+				timings.proxyTriangles += proxy.indices.size() / 3;
+		}
+	}
+
+	return timings;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EntityManager.h"
+#include "Components.h"
+#include "Vertex.h"
+
+class Material;
+
+// Entities are clustered by square columns of the ground this wide
+#define HLOD_CLUSTER_SIZE		32.0f
+
+// Proxies are simplified on a grid with this many cells across a
+// cluster, so detail smaller than a cell is lost
+#define HLOD_GRID_CELLS			48
+
+// Default distance (from the camera to a cluster's bounds) past which
+// the cluster is drawn as its proxy
+#define HLOD_DISTANCE			40.0f
+
+// A cluster only switches once it's this fraction past the distance
+// either way, so clusters right at the distance don't flicker
+#define HLOD_HYSTERESIS			0.1f
+
+// Timings from MeasureBuild()
+struct HlodTimings
+{
+	unsigned int instances;
+	unsigned int clusters;
+	uint64_t sourceTriangles;
+	uint64_t proxyTriangles;
+	double buildMs;				// Merging and simplifying, one thread
+	double buildThreadedMs;		// The same on all cores
+};
+
+// --------------------------------------------------------
+// Hierarchical LOD: whole clusters of entities are drawn
+// as one simplified proxy mesh when they're far away.
+//
+// Instances (a mesh by asset name, a material and a
+// transform) are added while the scene is built.  Building
+// groups them into clusters by where they stand, then for
+// every cluster (in parallel) merges its instances in world
+// space and simplifies the result by vertex clustering:
+// vertices that share a grid cell and roughly the same
+// normal become one, and triangles that collapse are gone.
+//
+// Each instance gets an entity of its own, and each cluster
+// a proxy entity per material its instances use, so the
+// proxies keep their colours (the textures only live on the
+// GPU, so they can't be baked into an atlas here).  Update()
+// swaps a cluster's entities for its proxies (or back) as
+// the camera crosses the distance, by moving their
+// MeshRendererComponents.
+// --------------------------------------------------------
+class HlodSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static HlodSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new HlodSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	HlodSystem(HlodSystem const&) = delete;
+	void operator=(HlodSystem const&) = delete;
+
+private:
+	static HlodSystem* instance;
+	HlodSystem();
+#pragma endregion
+
+public:
+	// Rotation is a quaternion
+	void Add(std::string meshName, Material* material, DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale);
+
+	// Builds the proxies and every entity for what's been added so far
+	// (which creates meshes, so this goes inside an upload batch)
+	void Build(EntityManager& entities);
+
+	// Swaps clusters to or from their proxies for a camera at this position
+	void Update(EntityManager& entities, DirectX::XMFLOAT3 cameraPosition);
+
+	void SetDistance(float distance) { this->distance = distance; }
+	float GetDistance() { return distance; }
+
+	unsigned int GetClusterCount() { return (unsigned int)clusters.size(); }
+	unsigned int GetProxiesShown() { return proxiesShown; }
+
+	// Draws the proxies shown are saving (their instances less the proxies)
+	unsigned int GetDrawsSaved() { return drawsSaved; }
+	uint64_t GetSourceTriangles() { return sourceTriangles; }
+	uint64_t GetProxyTriangles() { return proxyTriangles; }
+
+	// Scatters instances of a few meshes in clusters and times building proxies
+	static HlodTimings MeasureBuild(unsigned int numInstances);
+
+private:
+	struct Instance
+	{
+		std::string mesh;
+		Material* material;
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT4 rotation;
+		DirectX::XMFLOAT3 scale;
+	};
+
+	struct SourceMesh
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+	};
+
+	// The simplified geometry for one material's instances in a cluster
+	struct Proxy
+	{
+		Material* material;
+
+		// Only until it's uploaded
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+
+		Entity entity;
+		MeshRendererComponent renderer;
+	};
+
+	struct Cluster
+	{
+		std::vector<uint32_t> instances;
+
+		// Filled in by building, one proxy per material in the order they first appear
+		DirectX::BoundingBox bounds;
+		std::vector<Proxy> proxies;
+		unsigned int sourceTriangles;
+		bool proxyShown;
+	};
+
+	std::vector<Instance> pending;
+	std::vector<Cluster> clusters;
+	unsigned int builtProxies;
+	float distance;
+
+	// Every instance's entity, with what it draws when its cluster is close
+	std::vector<Entity> instanceEntities;
+	std::vector<MeshRendererComponent> instanceRenderers;
+
+	unsigned int proxiesShown;
+	unsigned int drawsSaved;
+	uint64_t sourceTriangles;
+	uint64_t proxyTriangles;
+
+	static std::vector<Cluster> GroupInstances(const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources);
+	static void BuildClusters(std::vector<Cluster>& clusters, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources, bool allowThreads);
+	static void BuildCluster(Cluster& cluster, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources);
+	static void Simplify(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, float cellSize);
+};
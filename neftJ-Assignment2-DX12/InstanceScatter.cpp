@@ -0,0 +1,561 @@
+#include "InstanceScatter.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Marks a candidate block that's entirely inside, so it's taken whole
+#define SCATTER_WHOLE_BLOCK		0x80000000u
+
+// The start of a cell's random sequence for one layer
+static uint32_t CellSeed(unsigned int seed, unsigned int cell, unsigned int layer)
+{
+	uint32_t h = seed * 0x9E3779B9u ^ (uint32_t)cell * 0x85EBCA6Bu ^ (uint32_t)(layer + 1) * 0xC2B2AE35u;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return h ? h : 1;
+}
+
+// A value in [0, 1) from a xorshift sequence
+static float NextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+InstanceScatter::InstanceScatter()
+{
+	desc = {};
+	cellCount = 0;
+	cellStride = 0;
+	instanceCount = 0;
+}
+
+// --------------------------------------------------------
+// Places the instances of a run of cells into a chunk of
+// their own, then puts the chunks together layer by layer.
+// Each chunk is a whole run of cells, so the blocks come
+// out in cell order within each layer.
+// --------------------------------------------------------
+bool InstanceScatter::Generate(const ScatterDesc& desc, const std::vector<ScatterLayer>& layers, ScatterHeightFunction height, bool allowThreads)
+{
+	if (layers.empty() || layers.size() > SCATTER_MAX_LAYERS || desc.cellsAcross == 0 || !height)
+		return false;
+
+	this->desc = desc;
+	this->layers = layers;
+	cellCount = desc.cellsAcross * desc.cellsAcross;
+	cellStride = (cellCount + 3) & ~3u;
+
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	unsigned int perJob = (cellCount + cores - 1) / cores;
+	std::vector<Chunk> chunks((cellCount + perJob - 1) / perJob);
+
+	std::vector<std::future<void>> jobs;
+	for (unsigned int first = perJob; first < cellCount; first += perJob)
+	{
+		unsigned int last = std::min(first + perJob, cellCount);
+		Chunk* chunk = &chunks[first / perJob];
+		jobs.push_back(std::async(std::launch::async, [this, first, last, &height, chunk]() { GenerateCells(first, last, height, *chunk); }));
+	}
+	GenerateCells(0, std::min(perJob, cellCount), height, chunks[0]);
+	for (std::future<void>& job : jobs)
+		job.wait();
+
+	size_t total = 0;
+	for (const Chunk& chunk : chunks)
+	{
+		for (unsigned int l = 0; l < layers.size(); l++)
+			total += chunk.posX[l].size();
+	}
+	instanceCount = (unsigned int)total;
+
+	// Four spare on the end, so a group of four starting at any instance is in range
+	posX.assign(total + 4, 0);
+	posY.assign(total + 4, 0);
+	posZ.assign(total + 4, 0);
+	yaw.assign(total + 4, 0);
+	scale.assign(total + 4, 0);
+
+	size_t numBlocks = (size_t)layers.size() * cellStride;
+	blocks.assign(numBlocks, Block());
+	boxCenterX.assign(numBlocks, 0.0f);
+	boxCenterY.assign(numBlocks, 0.0f);
+	boxCenterZ.assign(numBlocks, 0.0f);
+	boxExtentX.assign(numBlocks, 0.0f);
+	boxExtentY.assign(numBlocks, 0.0f);
+	boxExtentZ.assign(numBlocks, 0.0f);
+
+	uint32_t next = 0;
+	for (unsigned int l = 0; l < layers.size(); l++)
+	{
+		float reach = layers[l].radius * layers[l].maxScale;
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			Chunk& chunk = chunks[c];
+			size_t count = chunk.posX[l].size();
+			std::copy(chunk.posX[l].begin(), chunk.posX[l].end(), posX.begin() + next);
+			std::copy(chunk.posY[l].begin(), chunk.posY[l].end(), posY.begin() + next);
+			std::copy(chunk.posZ[l].begin(), chunk.posZ[l].end(), posZ.begin() + next);
+			std::copy(chunk.yaw[l].begin(), chunk.yaw[l].end(), yaw.begin() + next);
+			std::copy(chunk.scale[l].begin(), chunk.scale[l].end(), scale.begin() + next);
+
+			for (size_t b = 0; b < chunk.blocks[l].size(); b++)
+			{
+				size_t index = (size_t)l * cellStride + c * perJob + b;
+				Block& block = blocks[index];
+				block = chunk.blocks[l][b];
+				block.first += next;
+
+				// Grown by the largest an instance can be, so the box holds every sphere
+				float spanY = block.stepY * SCATTER_POSITION_STEPS;
+				boxCenterX[index] = block.x + desc.cellSize * 0.5f;
+				boxCenterY[index] = block.minY + spanY * 0.5f;
+				boxCenterZ[index] = block.z + desc.cellSize * 0.5f;
+				boxExtentX[index] = desc.cellSize * 0.5f + reach;
+				boxExtentY[index] = spanY * 0.5f + reach;
+				boxExtentZ[index] = desc.cellSize * 0.5f + reach;
+			}
+
+			next += (uint32_t)count;
+		}
+	}
+
+	return true;
+}
+
+void InstanceScatter::GenerateCells(unsigned int firstCell, unsigned int lastCell, const ScatterHeightFunction& height, Chunk& chunk)
+{
+	struct Placement
+	{
+		float x, y, z;
+		uint8_t yaw, scale;
+	};
+	std::vector<Placement> placements;
+
+	for (unsigned int cell = firstCell; cell < lastCell; cell++)
+	{
+		float cellX = desc.origin.x + (cell % desc.cellsAcross) * desc.cellSize;
+		float cellZ = desc.origin.y + (cell / desc.cellsAcross) * desc.cellSize;
+
+		for (unsigned int l = 0; l < layers.size(); l++)
+		{
+			const ScatterLayer& layer = layers[l];
+
+			// The fraction of an instance left over is a chance of one more,
+			// so any density averages out right
+			uint32_t random = CellSeed(desc.seed, cell, l);
+			unsigned int tries = (unsigned int)(layer.density * desc.cellSize * desc.cellSize + NextRandom(random));
+
+			placements.clear();
+			for (unsigned int i = 0; i < tries; i++)
+			{
+				// Every try takes the same randoms, kept or not
+				Placement p;
+				p.x = NextRandom(random);
+				p.z = NextRandom(random);
+				p.yaw = (uint8_t)(NextRandom(random) * 256.0f);
+				p.scale = (uint8_t)(NextRandom(random) * 256.0f);
+
+				float x = cellX + p.x * desc.cellSize;
+				float z = cellZ + p.z * desc.cellSize;
+				p.y = height(x, z);
+				if (p.y < layer.minHeight || p.y > layer.maxHeight)
+					continue;
+
+				float slopeX = (height(x + SCATTER_SLOPE_STEP, z) - height(x - SCATTER_SLOPE_STEP, z)) / (2.0f * SCATTER_SLOPE_STEP);
+				float slopeZ = (height(x, z + SCATTER_SLOPE_STEP) - height(x, z - SCATTER_SLOPE_STEP)) / (2.0f * SCATTER_SLOPE_STEP);
+				if (slopeX * slopeX + slopeZ * slopeZ > layer.maxSlope * layer.maxSlope)
+					continue;
+
+				placements.push_back(p);
+			}
+
+			Block block = {};
+			block.x = cellX;
+			block.z = cellZ;
+			block.first = (uint32_t)chunk.posX[l].size();
+			block.count = (uint32_t)placements.size();
+
+			// Heights are quantized over just the range this block spans
+			if (!placements.empty())
+			{
+				float minY = placements[0].y, maxY = placements[0].y;
+				for (const Placement& p : placements)
+				{
+					minY = std::min(minY, p.y);
+					maxY = std::max(maxY, p.y);
+				}
+				block.minY = minY;
+				block.stepY = (maxY - minY) / SCATTER_POSITION_STEPS;
+			}
+
+			for (const Placement& p : placements)
+			{
+				chunk.posX[l].push_back((uint16_t)(p.x * SCATTER_POSITION_STEPS + 0.5f));
+				chunk.posY[l].push_back(block.stepY > 0.0f ? (uint16_t)std::min((p.y - block.minY) / block.stepY + 0.5f, SCATTER_POSITION_STEPS) : 0);
+				chunk.posZ[l].push_back((uint16_t)(p.z * SCATTER_POSITION_STEPS + 0.5f));
+				chunk.yaw[l].push_back(p.yaw);
+				chunk.scale[l].push_back(p.scale);
+			}
+			chunk.blocks[l].push_back(block);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Finds the blocks to draw from, then shares their
+// instances out between the cores.  Each job's instances
+// are in layer order and the jobs follow on from each
+// other, so putting them end to end keeps the layers
+// together.
+// --------------------------------------------------------
+void InstanceScatter::Cull(const Frustum& frustum, XMFLOAT3 cameraPosition, ScatterVisible& visible, bool allowThreads)
+{
+	visible.instances.clear();
+	memset(visible.layerFirst, 0, sizeof(visible.layerFirst));
+	visible.blocks = 0;
+	visible.tested = 0;
+	if (layers.empty())
+		return;
+
+	// Each layer's far plane is pulled in to its draw distance (the far
+	// plane faces the camera, so its distance there is how far it reaches)
+	Frustum layerFrustums[SCATTER_MAX_LAYERS];
+	candidates.clear();
+	for (unsigned int l = 0; l < layers.size(); l++)
+	{
+		layerFrustums[l] = frustum;
+		XMFLOAT4& farPlane = layerFrustums[l].planes[5];
+		float alongNormal = farPlane.x * cameraPosition.x + farPlane.y * cameraPosition.y + farPlane.z * cameraPosition.z;
+		if (layers[l].drawDistance < alongNormal + farPlane.w)
+			farPlane.w = layers[l].drawDistance - alongNormal;
+
+		ClassifyBlocks(layerFrustums[l], l);
+	}
+	visible.blocks = (unsigned int)candidates.size();
+
+	uint64_t total = 0;
+	for (uint32_t candidate : candidates)
+		total += blocks[candidate & ~SCATTER_WHOLE_BLOCK].count;
+
+	// Split wherever a job has its share of the instances
+	unsigned int cores = allowThreads && total >= SCATTER_PARALLEL_MIN ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	uint64_t perJob = (total + cores - 1) / cores;
+	std::vector<size_t> splits(1, 0);
+	uint64_t counted = 0;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		counted += blocks[candidates[i] & ~SCATTER_WHOLE_BLOCK].count;
+		if (counted >= perJob * splits.size() && i + 1 < candidates.size())
+			splits.push_back(i + 1);
+	}
+	splits.push_back(candidates.size());
+
+	size_t numJobs = splits.size() - 1;
+	if (jobInstances.size() < numJobs)
+		jobInstances.resize(numJobs);
+	std::vector<uint32_t> layerCounts(numJobs * SCATTER_MAX_LAYERS, 0);
+	std::vector<unsigned int> tested(numJobs, 0);
+
+	std::vector<std::future<void>> jobs;
+	for (size_t j = 1; j < numJobs; j++)
+	{
+		jobs.push_back(std::async(std::launch::async, [this, &layerFrustums, &splits, &layerCounts, &tested, j]()
+			{
+				CullBlocks(layerFrustums, splits[j], splits[j + 1], jobInstances[j], &layerCounts[j * SCATTER_MAX_LAYERS], tested[j]);
+			}));
+	}
+	CullBlocks(layerFrustums, splits[0], splits[1], jobInstances[0], &layerCounts[0], tested[0]);
+	for (std::future<void>& job : jobs)
+		job.wait();
+
+	for (size_t j = 0; j < numJobs; j++)
+	{
+		visible.instances.insert(visible.instances.end(), jobInstances[j].begin(), jobInstances[j].end());
+		visible.tested += tested[j];
+		for (unsigned int l = 0; l < SCATTER_MAX_LAYERS; l++)
+			visible.layerFirst[l + 1] += layerCounts[j * SCATTER_MAX_LAYERS + l];
+	}
+	for (unsigned int l = 0; l < SCATTER_MAX_LAYERS; l++)
+		visible.layerFirst[l + 1] += visible.layerFirst[l];
+}
+
+// --------------------------------------------------------
+// Tests four of a layer's block boxes at a time, adding the
+// ones that aren't entirely outside to the candidates
+// --------------------------------------------------------
+void InstanceScatter::ClassifyBlocks(const Frustum& frustum, unsigned int layer)
+{
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	XMVECTOR absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = XMVectorReplicate(frustum.planes[p].x);
+		planeY[p] = XMVectorReplicate(frustum.planes[p].y);
+		planeZ[p] = XMVectorReplicate(frustum.planes[p].z);
+		planeW[p] = XMVectorReplicate(frustum.planes[p].w);
+		absX[p] = XMVectorAbs(planeX[p]);
+		absY[p] = XMVectorAbs(planeY[p]);
+		absZ[p] = XMVectorAbs(planeZ[p]);
+	}
+
+	XMVECTOR allTrue = XMVectorTrueInt();
+	size_t firstBlock = (size_t)layer * cellStride;
+	for (size_t first = firstBlock; first < firstBlock + cellStride; first += 4)
+	{
+		XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&boxCenterX[first]));
+		XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&boxCenterY[first]));
+		XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&boxCenterZ[first]));
+		XMVECTOR ex = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&boxExtentX[first]));
+		XMVECTOR ey = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&boxExtentY[first]));
+		XMVECTOR ez = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&boxExtentZ[first]));
+
+		XMVECTOR outside = XMVectorFalseInt();
+		XMVECTOR inside = allTrue;
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = cx * planeX[p] + cy * planeY[p] + cz * planeZ[p] + planeW[p];
+			XMVECTOR reach = ex * absX[p] + ey * absY[p] + ez * absZ[p];
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, -reach));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, reach));
+			if (XMVector4EqualInt(outside, allTrue))
+				break;
+		}
+
+		uint32_t outsideLanes[4], insideLanes[4];
+		XMStoreInt4(outsideLanes, outside);
+		XMStoreInt4(insideLanes, inside);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			uint32_t index = (uint32_t)first + lane;
+			if (!outsideLanes[lane] && blocks[index].count > 0)
+				candidates.push_back(index | (insideLanes[lane] ? SCATTER_WHOLE_BLOCK : 0));
+		}
+	}
+}
+
+void InstanceScatter::CullBlocks(const Frustum* layerFrustums, size_t first, size_t last, std::vector<ScatterInstance>& instances, uint32_t* layerCounts, unsigned int& tested)
+{
+	instances.clear();
+	for (size_t i = first; i < last; i++)
+	{
+		uint32_t index = candidates[i] & ~SCATTER_WHOLE_BLOCK;
+		unsigned int layer = index / cellStride;
+		const Block& block = blocks[index];
+
+		size_t before = instances.size();
+		if (candidates[i] & SCATTER_WHOLE_BLOCK)
+		{
+			AddWhole(block, layer, instances);
+		}
+		else
+		{
+			AddVisible(layerFrustums[layer], block, layer, instances);
+			tested += block.count;
+		}
+		layerCounts[layer] += (uint32_t)(instances.size() - before);
+	}
+}
+
+void InstanceScatter::AddWhole(const Block& block, unsigned int layer, std::vector<ScatterInstance>& instances)
+{
+	size_t before = instances.size();
+	instances.resize(before + block.count);
+	for (uint32_t i = 0; i < block.count; i++)
+		instances[before + i] = Dequantize(block, layers[layer], block.first + i);
+}
+
+// --------------------------------------------------------
+// Tests a block's instances four at a time.  An instance's
+// position and radius are each a step times its quantized
+// value plus an offset, so a plane's distance to its sphere
+// is the quantized values times constants (the plane scaled
+// by the steps) plus one more constant (the plane at the
+// block's corner, plus the smallest radius).  Nothing needs
+// dequantizing until it's known to be visible.
+// --------------------------------------------------------
+void InstanceScatter::AddVisible(const Frustum& frustum, const Block& block, unsigned int layer, std::vector<ScatterInstance>& instances)
+{
+	const ScatterLayer& l = layers[layer];
+	float cellStep = desc.cellSize / SCATTER_POSITION_STEPS;
+	float scaleStep = (l.maxScale - l.minScale) / 255.0f;
+
+	XMVECTOR kx[6], ky[6], kz[6], kw[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = frustum.planes[p];
+		kx[p] = XMVectorReplicate(plane.x * cellStep);
+		ky[p] = XMVectorReplicate(plane.y * block.stepY);
+		kz[p] = XMVectorReplicate(plane.z * cellStep);
+		kw[p] = XMVectorReplicate(plane.x * block.x + plane.y * block.minY + plane.z * block.z + plane.w + l.radius * l.minScale);
+	}
+	XMVECTOR radiusStep = XMVectorReplicate(l.radius * scaleStep);
+
+	XMVECTOR zero = XMVectorZero();
+	for (uint32_t i = 0; i < block.count; i += 4)
+	{
+		uint32_t index = block.first + i;
+		XMVECTOR qx = XMLoadUShort4(reinterpret_cast<const XMUSHORT4*>(&posX[index]));
+		XMVECTOR qy = XMLoadUShort4(reinterpret_cast<const XMUSHORT4*>(&posY[index]));
+		XMVECTOR qz = XMLoadUShort4(reinterpret_cast<const XMUSHORT4*>(&posZ[index]));
+		XMVECTOR radius = XMLoadUByte4(reinterpret_cast<const XMUBYTE4*>(&scale[index])) * radiusStep;
+
+		XMVECTOR inside = XMVectorTrueInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = qx * kx[p] + qy * ky[p] + qz * kz[p] + kw[p] + radius;
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, zero));
+			if (XMVector4EqualInt(inside, zero))
+				break;
+		}
+
+		// The last group can run past the block's end
+		uint32_t lanes[4];
+		XMStoreInt4(lanes, inside);
+		uint32_t numLanes = std::min(4u, block.count - i);
+		for (uint32_t lane = 0; lane < numLanes; lane++)
+		{
+			if (lanes[lane])
+				instances.push_back(Dequantize(block, l, index + lane));
+		}
+	}
+}
+
+ScatterInstance InstanceScatter::Dequantize(const Block& block, const ScatterLayer& layer, uint32_t index)
+{
+	float cellStep = desc.cellSize / SCATTER_POSITION_STEPS;
+
+	ScatterInstance instance;
+	instance.position = XMFLOAT3(
+		block.x + posX[index] * cellStep,
+		block.minY + posY[index] * block.stepY,
+		block.z + posZ[index] * cellStep);
+	instance.yaw = yaw[index] * (XM_2PI / 256.0f);
+	instance.scale = layer.minScale + scale[index] * ((layer.maxScale - layer.minScale) / 255.0f);
+	return instance;
+}
+
+uint64_t InstanceScatter::GetInstanceBytes()
+{
+	return (uint64_t)instanceCount * (sizeof(uint16_t) * 3 + sizeof(uint8_t) * 2);
+}
+
+ScatterHeightFunction InstanceScatter::TerrainHeights(const TerrainDesc& desc, TerrainTileLoader loader)
+{
+	unsigned int tilesAcross = std::max(desc.size / TERRAIN_TILE_SIZE, 1u);
+	auto tiles = std::make_shared<std::vector<std::vector<uint16_t>>>(tilesAcross * tilesAcross);
+	for (unsigned int z = 0; z < tilesAcross; z++)
+	{
+		for (unsigned int x = 0; x < tilesAcross; x++)
+		{
+			// Flat where a tile can't be read
+			std::vector<uint16_t>& samples = (*tiles)[z * tilesAcross + x];
+			if (!loader(x, z, samples) || samples.size() != TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES)
+				samples.assign(TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES, 0);
+		}
+	}
+
+	return [desc, tilesAcross, tiles](float x, float z)
+		{
+			float sampleX = std::min(std::max((x - desc.origin.x) / desc.spacing, 0.0f), (float)desc.size);
+			float sampleZ = std::min(std::max((z - desc.origin.z) / desc.spacing, 0.0f), (float)desc.size);
+			unsigned int tileX = std::min((unsigned int)sampleX / TERRAIN_TILE_SIZE, tilesAcross - 1);
+			unsigned int tileZ = std::min((unsigned int)sampleZ / TERRAIN_TILE_SIZE, tilesAcross - 1);
+			sampleX -= tileX * TERRAIN_TILE_SIZE;
+			sampleZ -= tileZ * TERRAIN_TILE_SIZE;
+
+			unsigned int cornerX = std::min((unsigned int)sampleX, TERRAIN_TILE_SIZE - 1u);
+			unsigned int cornerZ = std::min((unsigned int)sampleZ, TERRAIN_TILE_SIZE - 1u);
+			float fx = sampleX - cornerX;
+			float fz = sampleZ - cornerZ;
+
+			const uint16_t* row = &(*tiles)[tileZ * tilesAcross + tileX][cornerZ * TERRAIN_TILE_SAMPLES + cornerX];
+			float back = row[0] + (row[1] - row[0]) * fx;
+			float front = row[TERRAIN_TILE_SAMPLES] + (row[TERRAIN_TILE_SAMPLES + 1] - row[TERRAIN_TILE_SAMPLES]) * fx;
+			return desc.origin.y + (back + (front - back) * fz) * desc.heightScale / 65535.0f;
+		};
+}
+
+ScatterTimings InstanceScatter::MeasureScatter(unsigned int numInstances)
+{
+	ScatterTimings timings = {};
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+	auto elapsedMs = [](auto start, auto end) { return std::chrono::duration<double, std::milli>(end - start).count(); };
+
+	// Grass thick on the gentler slopes out to 60 metres, and rocks
+	// anywhere out to 250, over hills a few metres high
+	std::vector<ScatterLayer> layers = {
+		{ nullptr, XMFLOAT3(0.03f, 0.5f, 0.03f), XMFLOAT3(0.3f, 0.5f, 0.2f), 0.26f, 4.0f, 0.6f, 1.4f, -100.0f, 100.0f, 0.3f, 60.0f },
+		{ nullptr, XMFLOAT3(0.6f, 0.4f, 0.5f), XMFLOAT3(0.45f, 0.42f, 0.38f), 0.3f, 0.25f, 0.5f, 2.0f, -100.0f, 100.0f, 10.0f, 250.0f } };
+	auto height = [](float x, float z) { return 3.0f * sinf(x * 0.05f) * cosf(z * 0.037f) + 1.5f * sinf((x + z) * 0.11f); };
+
+	// Enough 16 metre cells for the densities to come to about the number asked for
+	float density = 0;
+	for (const ScatterLayer& layer : layers)
+		density += layer.density;
+	ScatterDesc desc = {};
+	desc.origin = XMFLOAT2(0, 0);
+	desc.cellSize = 16.0f;
+	desc.cellsAcross = std::max(1u, (unsigned int)ceilf(sqrtf(numInstances / density) / desc.cellSize));
+	desc.seed = 1;
+
+	InstanceScatter scatter;
+	auto start = now();
+	scatter.Generate(desc, layers, height);
+	timings.generateMs = elapsedMs(start, now());
+	timings.instances = scatter.GetInstanceCount();
+	timings.bytes = scatter.GetInstanceBytes();
+
+	// Flying diagonally across a little above the ground, weaving from
+	// side to side, with the far plane out past both draw distances
+	float size = desc.cellsAcross * desc.cellSize;
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+
+	const unsigned int steps = 100;
+	ScatterVisible visible;
+	double totalMs = 0, totalThreadedMs = 0;
+	uint64_t totalTested = 0, totalVisible = 0;
+	for (unsigned int i = 0; i < steps; i++)
+	{
+		float t = 0.1f + 0.8f * i / steps;
+		XMFLOAT3 position(size * t, 0, size * t);
+		position.y = height(position.x, position.z) + 2.0f;
+
+		float yaw = XM_PIDIV4 + sinf(i * 0.1f);
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position), XMVectorSet(sinf(yaw), -0.1f, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+		Frustum frustum = Frustum::FromViewProjection(view, projection);
+
+		start = now();
+		scatter.Cull(frustum, position, visible, false);
+		totalMs += elapsedMs(start, now());
+
+		start = now();
+		scatter.Cull(frustum, position, visible, true);
+		double ms = elapsedMs(start, now());
+		totalThreadedMs += ms;
+		timings.maxCullThreadedMs = std::max(timings.maxCullThreadedMs, ms);
+
+		totalTested += visible.tested;
+		totalVisible += visible.instances.size();
+	}
+
+	timings.cullMs = totalMs / steps;
+	timings.cullThreadedMs = totalThreadedMs / steps;
+	timings.tested = (unsigned int)(totalTested / steps);
+	timings.visible = (unsigned int)(totalVisible / steps);
+	return timings;
+}
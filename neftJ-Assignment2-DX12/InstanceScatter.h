@@ -0,0 +1,180 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "Terrain.h"
+
+class Mesh;
+
+// Most layers (kinds of thing to scatter) a field can have
+#define SCATTER_MAX_LAYERS		8
+
+// Instances the GPU's instance buffer starts out with room for (it
+// grows when more than that are visible)
+#define SCATTER_INITIAL_VISIBLE	262144
+
+// Below this many instances in the cells that pass, culling stays on one thread
+#define SCATTER_PARALLEL_MIN	16384
+
+// Steps a quantized position has across its cell
+#define SCATTER_POSITION_STEPS	65535.0f
+
+// Distance either side of an instance the ground's slope is measured over
+#define SCATTER_SLOPE_STEP		0.25f
+
+// One kind of thing to scatter, and the rules for where it grows
+struct ScatterLayer
+{
+	Mesh* mesh;
+	DirectX::XMFLOAT3 meshScale;	// Shape of the mesh at an instance scale of 1
+	DirectX::XMFLOAT3 color;
+	float radius;					// Bounding radius of the shaped mesh at an instance scale of 1
+	float density;					// Instances per square world unit, before the rules below
+	float minScale;
+	float maxScale;
+	float minHeight;				// World heights it grows between
+	float maxHeight;
+	float maxSlope;					// Steepest ground it grows on, as rise over run
+	float drawDistance;				// Furthest from the camera it's drawn
+};
+
+// Where the cells are.  Cell (x, z) starts at origin + (x, z) * cellSize.
+struct ScatterDesc
+{
+	DirectX::XMFLOAT2 origin;		// World x and z
+	float cellSize;
+	unsigned int cellsAcross;
+	unsigned int seed;
+};
+
+// Ground height at a world position.  Called from several threads at once.
+using ScatterHeightFunction = std::function<float(float x, float z)>;
+
+// One visible instance, as the vertex shader reads it (matches ScatterVS.hlsl)
+struct ScatterInstance
+{
+	DirectX::XMFLOAT3 position;
+	float yaw;
+	float scale;
+};
+
+// Everything Cull() found, with each layer's instances together
+struct ScatterVisible
+{
+	std::vector<ScatterInstance> instances;
+	uint32_t layerFirst[SCATTER_MAX_LAYERS + 1];	// Layer l is layerFirst[l] up to layerFirst[l + 1]
+	unsigned int blocks;		// Cells (one layer's part of each) that weren't culled whole
+	unsigned int tested;		// Instances tested one at a time, in cells crossing the frustum
+};
+
+// Timings from MeasureScatter()
+struct ScatterTimings
+{
+	unsigned int instances;
+	uint64_t bytes;				// Quantized instance data
+	double generateMs;			// All cores
+	double cullMs;				// Average over a camera flying across the field, one thread
+	double cullThreadedMs;		// The same on all cores
+	double maxCullThreadedMs;
+	unsigned int tested;		// Average per view
+	unsigned int visible;
+};
+
+// --------------------------------------------------------
+// Grass, rocks and anything else there's far too much of
+// for an entity each.
+//
+// Generate() splits the ground into a square of cells and
+// places each layer's instances in every cell from its
+// density and rules (height and slope), seeded by the cell
+// so a cell always comes out the same.  Instances are kept
+// quantized, one layer's cell at a time (a block): their
+// position within the cell's box in 16 bits per axis and
+// yaw and scale in 8 bits each, so 8 bytes apiece.
+//
+// Cull() first tests every block's box against the frustum,
+// four blocks per XMVECTOR.  Blocks entirely inside are
+// taken whole, and the instances of those crossing it are
+// tested four at a time straight from the quantized values
+// (each block folds its dequantizing into the planes).  The
+// blocks left are split between cores by instance count.
+// What's visible comes out as one array, each layer's part
+// ready for a DrawIndexedInstanced() of its mesh.
+// --------------------------------------------------------
+class InstanceScatter
+{
+public:
+	InstanceScatter();
+
+	// Places every layer's instances across all cores, false if there
+	// are no layers, too many or no cells
+	bool Generate(const ScatterDesc& desc, const std::vector<ScatterLayer>& layers, ScatterHeightFunction height, bool allowThreads = true);
+
+	// Every instance in view and within its layer's draw distance
+	void Cull(const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition, ScatterVisible& visible, bool allowThreads = true);
+
+	const ScatterDesc& GetDesc() { return desc; }
+	unsigned int GetLayerCount() { return (unsigned int)layers.size(); }
+	const ScatterLayer& GetLayer(unsigned int layer) { return layers[layer]; }
+	unsigned int GetInstanceCount() { return instanceCount; }
+	uint64_t GetInstanceBytes();
+
+	// Heights straight from a terrain's tiles, which are all read up
+	// front (so it's only for small fields)
+	static ScatterHeightFunction TerrainHeights(const TerrainDesc& desc, TerrainTileLoader loader);
+
+	// Scatters about this many grass and rock instances over rolling
+	// hills and times culling them from a camera flying across
+	static ScatterTimings MeasureScatter(unsigned int numInstances);
+
+private:
+	// One layer's instances in one cell, and the box around them
+	struct Block
+	{
+		float x, z;				// The cell's corner
+		float minY;
+		float stepY;			// World height of one step of a quantized y
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// What one generating job places, per layer
+	struct Chunk
+	{
+		std::vector<uint16_t> posX[SCATTER_MAX_LAYERS], posY[SCATTER_MAX_LAYERS], posZ[SCATTER_MAX_LAYERS];
+		std::vector<uint8_t> yaw[SCATTER_MAX_LAYERS], scale[SCATTER_MAX_LAYERS];
+		std::vector<Block> blocks[SCATTER_MAX_LAYERS];
+	};
+
+	ScatterDesc desc;
+	std::vector<ScatterLayer> layers;
+	unsigned int cellCount;
+	unsigned int cellStride;		// Blocks per layer, padded to a multiple of four
+	unsigned int instanceCount;
+
+	// Every instance, block by block and layer by layer, with a few
+	// spare at the end so the last group of four can always be loaded
+	std::vector<uint16_t> posX, posY, posZ;
+	std::vector<uint8_t> yaw, scale;
+
+	// Layer l's block for cell c is l * cellStride + c, and their
+	// boxes are kept as structure-of-arrays for testing four at once
+	std::vector<Block> blocks;
+	std::vector<float> boxCenterX, boxCenterY, boxCenterZ, boxExtentX, boxExtentY, boxExtentZ;
+
+	// Reused by Cull(): the blocks that passed (the top bit set when
+	// they're entirely inside) and each job's instances
+	std::vector<uint32_t> candidates;
+	std::vector<std::vector<ScatterInstance>> jobInstances;
+
+	void GenerateCells(unsigned int firstCell, unsigned int lastCell, const ScatterHeightFunction& height, Chunk& chunk);
+	void ClassifyBlocks(const Frustum& frustum, unsigned int layer);
+	void CullBlocks(const Frustum* layerFrustums, size_t first, size_t last, std::vector<ScatterInstance>& instances, uint32_t* layerCounts, unsigned int& tested);
+	void AddWhole(const Block& block, unsigned int layer, std::vector<ScatterInstance>& instances);
+	void AddVisible(const Frustum& frustum, const Block& block, unsigned int layer, std::vector<ScatterInstance>& instances);
+	ScatterInstance Dequantize(const Block& block, const ScatterLayer& layer, uint32_t index);
+};
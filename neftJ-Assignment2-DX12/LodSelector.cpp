@@ -0,0 +1,245 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+// Singleton requirement
+LodSelector* LodSelector::instance;
+
+LodSelector::LodSelector()
+{
+	count = 0;
+	bias = 1.0f;
+	frameTimeTarget = 0;
+	hysteresis = LOD_HYSTERESIS;
+	trianglesFull = 0;
+	trianglesSelected = 0;
+}
+
+uint32_t LodSelector::Add(const float* geometricErrors, const unsigned int* triangleCounts, unsigned int numLevels)
+{
+	numLevels = std::max(1u, std::min(numLevels, (unsigned int)LOD_MAX_LEVELS));
+
+	uint32_t id;
+	if (!freeIds.empty())
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		// Start a new group of four, filled with objects that never change level
+		if (count % 4 == 0)
+		{
+			for (std::vector<float>* a : { &centerX, &centerY, &centerZ, &radius })
+				a->resize(count + 4, 0.0f);
+			for (int l = 0; l < LOD_MAX_LEVELS; l++)
+			{
+				errors[l].resize(count + 4, FLT_MAX);
+				triangles[l].resize(count + 4, 0);
+			}
+			levels.resize(count + 4, 0);
+		}
+		id = count++;
+	}
+
+	for (unsigned int l = 0; l < LOD_MAX_LEVELS; l++)
+	{
+		errors[l][id] = l < numLevels ? geometricErrors[l] : FLT_MAX;
+		triangles[l][id] = l < numLevels ? triangleCounts[l] : 0;
+	}
+	levels[id] = 0;
+	return id;
+}
+
+void LodSelector::Remove(uint32_t id)
+{
+	for (int l = 0; l < LOD_MAX_LEVELS; l++)
+	{
+		errors[l][id] = FLT_MAX;
+		triangles[l][id] = 0;
+	}
+	levels[id] = 0;
+	freeIds.push_back(id);
+}
+
+void LodSelector::SetBounds(uint32_t id, XMFLOAT3 center, float radius)
+{
+	centerX[id] = center.x;
+	centerY[id] = center.y;
+	centerZ[id] = center.z;
+	this->radius[id] = radius;
+}
+
+void LodSelector::Select(XMFLOAT3 cameraPosition, const XMFLOAT4X4& projection, float screenHeight, bool allowThreads)
+{
+	// How many pixels one world unit covers one unit in front of the camera
+	float pixelsAtUnitDistance = projection.m[1][1] * screenHeight * 0.5f;
+
+	size_t groups = (count + 3) / 4;
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	if (cores == 1 || count < LOD_PARALLEL_MIN)
+	{
+		trianglesFull = 0;
+		trianglesSelected = 0;
+		SelectGroups(cameraPosition, pixelsAtUnitDistance, 0, groups, trianglesFull, trianglesSelected);
+		return;
+	}
+
+	// Each job counts its own triangles, which are added up afterwards
+	size_t perJob = (groups + cores - 1) / cores;
+	size_t numJobs = (groups + perJob - 1) / perJob;
+	std::vector<uint64_t> full(numJobs, 0), selected(numJobs, 0);
+	std::vector<std::future<void>> jobs;
+	for (size_t j = 1; j < numJobs; j++)
+	{
+		size_t first = j * perJob;
+		size_t last = std::min(first + perJob, groups);
+		jobs.push_back(std::async(std::launch::async, [this, cameraPosition, pixelsAtUnitDistance, first, last, j, &full, &selected]()
+			{ SelectGroups(cameraPosition, pixelsAtUnitDistance, first, last, full[j], selected[j]); }));
+	}
+
+	SelectGroups(cameraPosition, pixelsAtUnitDistance, 0, std::min(perJob, groups), full[0], selected[0]);
+	for (std::future<void>& job : jobs)
+		job.get();
+
+	trianglesFull = 0;
+	trianglesSelected = 0;
+	for (size_t j = 0; j < numJobs; j++)
+	{
+		trianglesFull += full[j];
+		trianglesSelected += selected[j];
+	}
+}
+
+// --------------------------------------------------------
+// For four objects at a time, counts how many levels past
+// 0 are under the allowed error minus the hysteresis (the
+// coarsest level it could drop to) and how many are under
+// it plus the hysteresis (the coarsest it may stay at).
+// As errors grow with each level, clamping the current
+// level between those two picks the new one.
+// --------------------------------------------------------
+void LodSelector::SelectGroups(XMFLOAT3 cameraPosition, float pixelsAtUnitDistance, size_t firstGroup, size_t lastGroup, uint64_t& full, uint64_t& selected)
+{
+	XMVECTOR cameraX = XMVectorReplicate(cameraPosition.x);
+	XMVECTOR cameraY = XMVectorReplicate(cameraPosition.y);
+	XMVECTOR cameraZ = XMVectorReplicate(cameraPosition.z);
+	XMVECTOR pixelScale = XMVectorReplicate(pixelsAtUnitDistance);
+	XMVECTOR dropBelow = XMVectorReplicate(LOD_ERROR_PIXELS * bias * (1.0f - hysteresis));
+	XMVECTOR keepBelow = XMVectorReplicate(LOD_ERROR_PIXELS * bias * (1.0f + hysteresis));
+
+	// Cameras inside an object's bounds see it up close
+	XMVECTOR minDistance = XMVectorReplicate(0.001f);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+
+	for (size_t g = firstGroup; g < lastGroup; g++)
+	{
+		size_t first = g * 4;
+		XMVECTOR dx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerX[first])) - cameraX;
+		XMVECTOR dy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerY[first])) - cameraY;
+		XMVECTOR dz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&centerZ[first])) - cameraZ;
+		XMVECTOR distance = XMVectorSqrt(dx * dx + dy * dy + dz * dz) - XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&radius[first]));
+		XMVECTOR pixelsPerUnit = pixelScale * XMVectorReciprocal(XMVectorMax(distance, minDistance));
+
+		XMVECTOR dropTo = zero;
+		XMVECTOR keepUpTo = zero;
+		for (int l = 1; l < LOD_MAX_LEVELS; l++)
+		{
+			XMVECTOR pixels = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&errors[l][first])) * pixelsPerUnit;
+			dropTo = dropTo + XMVectorSelect(zero, one, XMVectorLessOrEqual(pixels, dropBelow));
+			keepUpTo = keepUpTo + XMVectorSelect(zero, one, XMVectorLessOrEqual(pixels, keepBelow));
+		}
+
+		XMFLOAT4 lowest, highest;
+		XMStoreFloat4(&lowest, dropTo);
+		XMStoreFloat4(&highest, keepUpTo);
+		const float* lowestLanes = &lowest.x;
+		const float* highestLanes = &highest.x;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			size_t i = first + lane;
+			uint8_t level = (uint8_t)std::min(std::max((float)levels[i], lowestLanes[lane]), highestLanes[lane]);
+			levels[i] = level;
+			full += triangles[0][i];
+			selected += triangles[level][i];
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Steps the bias up while frames are over the target and
+// back down once they're comfortably under it, so a small
+// step each frame settles rather than oscillating
+// --------------------------------------------------------
+void LodSelector::UpdateBias(float frameMs)
+{
+	if (frameTimeTarget <= 0)
+		return;
+
+	if (frameMs > frameTimeTarget)
+		bias *= LOD_BIAS_STEP;
+	else if (frameMs < frameTimeTarget * 0.9f)
+		bias /= LOD_BIAS_STEP;
+
+	bias = std::max(LOD_MIN_BIAS, std::min(bias, LOD_MAX_BIAS));
+}
+
+LodTimings LodSelector::MeasureSelection(unsigned int numObjects)
+{
+	LodTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// Three levels each, a quarter of the triangles and four times the error of the last
+	LodSelector selector;
+	const unsigned int triangleCounts[] = { 2048, 512, 128 };
+	for (unsigned int i = 0; i < numObjects; i++)
+	{
+		float size = random(0.5f, 3.0f);
+		float errors[] = { size * 0.005f, size * 0.02f, size * 0.08f };
+		uint32_t id = selector.Add(errors, triangleCounts, 3);
+		selector.SetBounds(id, XMFLOAT3(random(-500, 500), random(-500, 500), random(-500, 500)), size);
+	}
+
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+	XMFLOAT3 camera(0, 0, 0);
+
+	const int runs = 10;
+	for (bool threaded : { false, true })
+	{
+		auto start = now();
+		for (int r = 0; r < runs; r++)
+			selector.Select(camera, projection, 1080, threaded);
+		(threaded ? timings.selectThreadedMs : timings.selectMs) = std::chrono::duration<double, std::milli>(now() - start).count() / runs;
+	}
+	timings.trianglesFull = selector.trianglesFull;
+	timings.trianglesSelected = selector.trianglesSelected;
+
+	// A camera stepping back and forth a little, which shouldn't change much
+	for (float h : { (float)LOD_HYSTERESIS, 0.0f })
+	{
+		selector.hysteresis = h;
+		selector.Select(camera, projection, 1080);
+		std::vector<uint8_t> previous = selector.levels;
+
+		unsigned int changes = 0;
+		for (int frame = 0; frame < 20; frame++)
+		{
+			selector.Select(XMFLOAT3(0, 0, frame % 2 ? 2.0f : 0.0f), projection, 1080);
+			for (size_t i = 0; i < previous.size(); i++)
+				changes += selector.levels[i] != previous[i] ? 1 : 0;
+			previous = selector.levels;
+		}
+		(h > 0 ? timings.changesWithHysteresis : timings.changesWithout) = changes;
+	}
+
+	return timings;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <vector>
+
+// Most detail levels an object can have (0 being the finest)
+#define LOD_MAX_LEVELS		4
+
+// Screen space error (in pixels) allowed at a bias of 1
+#define LOD_ERROR_PIXELS	1.0f
+
+// A level is only dropped once its error is this fraction under the
+// allowed error, and only kept until it's this fraction over it
+#define LOD_HYSTERESIS		0.25f
+
+// Range of the bias, and how much it moves per frame that misses
+// (or comfortably beats) the frame time target
+#define LOD_MIN_BIAS		0.5f
+#define LOD_MAX_BIAS		16.0f
+#define LOD_BIAS_STEP		1.05f
+
+// Below this many objects selection stays on one thread
+#define LOD_PARALLEL_MIN	16384
+
+// Timings from MeasureSelection()
+struct LodTimings
+{
+	double selectMs;				// One thread
+	double selectThreadedMs;		// All cores
+	uint64_t trianglesFull;			// Everything at level 0...
+	uint64_t trianglesSelected;		// ...and at the levels picked
+	unsigned int changesWithHysteresis;	// Level changes while the camera shuffles back and forth
+	unsigned int changesWithout;
+};
+
+// --------------------------------------------------------
+// Picks a detail level for every object each frame from
+// how big its geometric error would look on screen.
+//
+// Each object has a world bounding sphere and, per level,
+// its geometric error (how far that level's surface can
+// be from the real one, in world units, which must grow
+// with each level) and triangle count.  These are kept as
+// structure-of-arrays and a whole pass works on four
+// objects at a time.
+//
+// The error in pixels at an object's closest point is
+// compared with the allowed error, which is scaled by a
+// bias.  The bias can follow a frame time target, rising
+// when frames are slow (coarser levels) and falling when
+// they're quick.  Levels only change once the error is
+// clearly past the allowed amount either way, so objects
+// near a boundary don't flicker between two levels.
+// --------------------------------------------------------
+class LodSelector
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static LodSelector& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new LodSelector();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	LodSelector(LodSelector const&) = delete;
+	void operator=(LodSelector const&) = delete;
+
+private:
+	static LodSelector* instance;
+	LodSelector();
+#pragma endregion
+
+public:
+	// New objects start at level 0
+	uint32_t Add(const float* geometricErrors, const unsigned int* triangleCounts, unsigned int numLevels);
+	void Remove(uint32_t id);
+	void SetBounds(uint32_t id, DirectX::XMFLOAT3 center, float radius);
+
+	unsigned int GetLevel(uint32_t id) { return levels[id]; }
+
+	// Picks every object's level for a camera, where the projection gives
+	// the vertical field of view and screenHeight is in pixels
+	void Select(DirectX::XMFLOAT3 cameraPosition, const DirectX::XMFLOAT4X4& projection, float screenHeight, bool allowThreads = true);
+
+	// Nudges the bias towards hitting the frame time target (if there is one)
+	void UpdateBias(float frameMs);
+	void SetFrameTimeTarget(float ms) { frameTimeTarget = ms; }
+	float GetFrameTimeTarget() { return frameTimeTarget; }
+	void SetBias(float bias) { this->bias = bias; }
+	float GetBias() { return bias; }
+
+	// From the last Select()
+	uint64_t GetTrianglesSelected() { return trianglesSelected; }
+	uint64_t GetTrianglesSaved() { return trianglesFull - trianglesSelected; }
+
+	unsigned int GetCount() { return count - (unsigned int)freeIds.size(); }
+
+	// Scatters objects around a camera and times selecting their levels
+	static LodTimings MeasureSelection(unsigned int numObjects);
+
+private:
+	// Padded to a multiple of four with objects that always stay
+	// at level 0 and have no triangles (as are removed objects)
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> errors[LOD_MAX_LEVELS];
+	std::vector<uint32_t> triangles[LOD_MAX_LEVELS];
+	std::vector<uint8_t> levels;
+	std::vector<uint32_t> freeIds;
+	unsigned int count;
+
+	float bias;
+	float frameTimeTarget;
+	float hysteresis;
+	uint64_t trianglesFull;
+	uint64_t trianglesSelected;
+
+	void SelectGroups(DirectX::XMFLOAT3 cameraPosition, float pixelsAtUnitDistance, size_t firstGroup, size_t lastGroup, uint64_t& full, uint64_t& selected);
+};
@@ -5,26 +5,49 @@
 
 using namespace DirectX;
 
-Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices)
+Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, unsigned int flags)
 {
-	CreateBuffers(vertArray, numVerts, indexArray, numIndices);
+	CreateBuffers(vertArray, numVerts, indexArray, numIndices, flags);
 }
 
-Mesh::Mesh(const char* objFile)
+Mesh::Mesh(const char* objFile, unsigned int flags)
 {
+	// Nothing allocated until the file is read
+	geometry = { GEOMETRY_FORMAT_STANDARD, FreeListAllocator::InvalidId, FreeListAllocator::InvalidId };
+	positionAllocation = FreeListAllocator::InvalidId;
+	numIndices = 0;
+	numVerts = 0;
+	this->flags = flags;
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!LoadOBJ(objFile, verts, indices) || verts.empty())
+		return;
+
+	CreateBuffers(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), flags);
+}
+
+// --------------------------------------------------------
+// Reads an OBJ file into a vertex and index list, converted
+// to DirectX's left-handed space, without creating anything
+// on the GPU.  Tangents are left for CreateBuffers().
+// --------------------------------------------------------
+bool Mesh::LoadOBJ(const char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	verts.clear();
+	indices.clear();
+
 	// File input object
 	std::ifstream obj(objFile);
 
 	// Check for successful open
 	if (!obj.is_open())
-		return;
+		return false;
 
 	// Variables used while reading the file
 	std::vector<XMFLOAT3> positions;     // Positions from the file
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
 	unsigned int vertCounter = 0;        // Count of vertices/indices
 	char chars[100];                     // String for line reading
 
@@ -91,17 +114,17 @@ Mesh::Mesh(const char* objFile)
 			//    corresponding data from vectors
 			// - OBJ File indices are 1-based, so
 			//    they need to be adusted
-			Vertex v1;
+			Vertex v1 = {};
 			v1.Position = positions[i[0] - 1];
 			v1.UV = uvs[i[1] - 1];
 			v1.Normal = normals[i[2] - 1];
 
-			Vertex v2;
+			Vertex v2 = {};
 			v2.Position = positions[i[3] - 1];
 			v2.UV = uvs[i[4] - 1];
 			v2.Normal = normals[i[5] - 1];
 
-			Vertex v3;
+			Vertex v3 = {};
 			v3.Position = positions[i[6] - 1];
 			v3.UV = uvs[i[7] - 1];
 			v3.Normal = normals[i[8] - 1];
@@ -146,7 +169,7 @@ Mesh::Mesh(const char* objFile)
 			if (facesRead == 12)
 			{
 				// Make the last vertex
-				Vertex v4;
+				Vertex v4 = {};
 				v4.Position = positions[i[9] - 1];
 				v4.UV = uvs[i[10] - 1];
 				v4.Normal = normals[i[11] - 1];
@@ -169,7 +192,7 @@ Mesh::Mesh(const char* objFile)
 		}
 	}
 
-	// Close the file and create the actual buffers
+	// Close the file
 	obj.close();
 
 
@@ -184,38 +207,112 @@ Mesh::Mesh(const char* objFile)
 	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
 	//    one, you'll need to write some extra code to handle cases when you don't.
 
-	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter);
+	return true;
+}
 
 
+Mesh::~Mesh(void)
+{
+	// Give our space in the shared buffers back
+	GeometryPool::GetInstance().Free(geometry);
+	GeometryPool::GetInstance().FreeVertices(GEOMETRY_FORMAT_POSITION, positionAllocation);
 }
 
+D3D12_VERTEX_BUFFER_VIEW Mesh::GetVertexBuffer()
+{
+	return GeometryPool::GetInstance().GetVertexBufferView(geometry.format);
+}
 
-Mesh::~Mesh(void)
+D3D12_INDEX_BUFFER_VIEW Mesh::GetIndexBuffer()
 {
+	return GeometryPool::GetInstance().GetIndexBufferView(geometry.format);
+}
 
+int Mesh::GetBaseVertex()
+{
+	return GeometryPool::GetInstance().GetBaseVertex(geometry);
 }
 
-void Mesh::CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices)
+unsigned int Mesh::GetStartIndex()
 {
-	this->numIndices = numIndices;
+	return GeometryPool::GetInstance().GetStartIndex(geometry);
+}
+
+bool Mesh::HasPositionStream()
+{
+	return positionAllocation != FreeListAllocator::InvalidId;
+}
+
+D3D12_VERTEX_BUFFER_VIEW Mesh::GetPositionBuffer()
+{
+	return GeometryPool::GetInstance().GetVertexBufferView(GEOMETRY_FORMAT_POSITION);
+}
 
-	// Always calculate the tangents before copying to buffer
-	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+int Mesh::GetPositionBaseVertex()
+{
+	return GeometryPool::GetInstance().GetBaseVertex(GEOMETRY_FORMAT_POSITION, positionAllocation);
+}
 
-	// Create static buffers
-	vb = DX12Helper::GetInstance().CreateStaticBuffer(sizeof(Vertex), numVerts, vertArray);
-	ib = DX12Helper::GetInstance().CreateStaticBuffer(sizeof(unsigned int), numIndices, indexArray);
+void Mesh::CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, unsigned int flags)
+{
+	this->numIndices = numIndices;
+	this->numVerts = numVerts;
+	this->flags = flags;
+	this->positionAllocation = FreeListAllocator::InvalidId;
+
+	// Calculate the tangents before copying to buffer, unless the source
+	// already had them (its data may not even be writable in that case)
+	if (!(flags & MESH_FLAG_HAS_TANGENTS))
+		CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	CalculateBounds(vertArray, numVerts);
+
+	// The vertex data is gone once it's on the GPU, so this is our only chance
+	if (flags & MESH_FLAG_KEEP_BVH)
+	{
+		bvh = std::make_shared<MeshBVH>();
+		bvh->Build(&vertArray[0].Position, sizeof(Vertex), indexArray, numIndices);
+	}
 
-	// Set up views
-	vbView.StrideInBytes = sizeof(Vertex);
-	vbView.SizeInBytes = sizeof(Vertex) * numVerts;
-	vbView.BufferLocation = vb->GetGPUVirtualAddress();
+	// Suballocate from the shared vertex/index buffers, packing the vertices
+	// down first if the mesh asked for the compact format
+	if (flags & MESH_FLAG_COMPACT_VERTICES)
+	{
+		std::vector<unsigned char> packed((size_t)numVerts * CompactVertexFormat::Stride);
+		CompactVertexFormat::Pack(vertArray, numVerts, packed.data());
+		geometry = GeometryPool::GetInstance().Allocate(GEOMETRY_FORMAT_COMPACT, packed.data(), numVerts, indexArray, numIndices);
+	}
+	else
+	{
+		geometry = GeometryPool::GetInstance().Allocate(GEOMETRY_FORMAT_STANDARD, vertArray, numVerts, indexArray, numIndices);
+	}
+
+	// Deinterleaved positions for depth-only passes, which then fetch
+	// 12 bytes per vertex instead of the full 44
+	if (flags & MESH_FLAG_POSITION_STREAM)
+	{
+		std::vector<VertexPosition> positions(numVerts);
+		for (int i = 0; i < numVerts; i++)
+			positions[i].Position = vertArray[i].Position;
 
-	ibView.Format = DXGI_FORMAT_R32_UINT;
-	ibView.SizeInBytes = sizeof(unsigned int) * numIndices;
-	ibView.BufferLocation = ib->GetGPUVirtualAddress();
+		positionAllocation = GeometryPool::GetInstance().AllocateVertices(GEOMETRY_FORMAT_POSITION, positions.data(), numVerts);
+	}
 }
 
+// --------------------------------------------------------
+// Local space bounding box and sphere around all of the vertices
+// --------------------------------------------------------
+void Mesh::CalculateBounds(Vertex* vertArray, int numVerts)
+{
+	if (numVerts <= 0)
+	{
+		aabb = BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0));
+		sphere = BoundingSphere(XMFLOAT3(0, 0, 0), 0.0f);
+		return;
+	}
+
+	BoundingBox::CreateFromPoints(aabb, numVerts, &vertArray[0].Position, sizeof(Vertex));
+	BoundingSphere::CreateFromPoints(sphere, numVerts, &vertArray[0].Position, sizeof(Vertex));
+}
 
 // Calculates the tangents of the vertices in a mesh
 // Code originally adapted from: http://www.terathon.com/code/tangent.html
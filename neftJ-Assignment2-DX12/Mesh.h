@@ -2,30 +2,69 @@
 
 #include <d3d12.h>
 #include <wrl/client.h>
+#include <DirectXCollision.h>
+#include <memory>
+#include <vector>
 
 #include "Vertex.h"
 #include "DX12Helper.h"
+#include "GeometryPool.h"
+#include "MeshBVH.h"
+#include "VertexFormat.h"
 
+// Options for how a mesh is created (can be OR'd together)
+#define MESH_FLAG_NONE		0
+#define MESH_FLAG_KEEP_BVH	1	// Keep a triangle BVH on the CPU for ray queries
+#define MESH_FLAG_POSITION_STREAM	2	// Also upload a position-only copy of the vertices
+#define MESH_FLAG_HAS_TANGENTS	4	// Tangents are already filled in, so the vertex data is never written
+#define MESH_FLAG_COMPACT_VERTICES	8	// Store the vertices quantized (CompactVertexFormat) instead of as full Vertex structs
 
 class Mesh
 {
 public:
-	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices);
-	Mesh(const char* objFile);
+	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, unsigned int flags = MESH_FLAG_NONE);
+	Mesh(const char* objFile, unsigned int flags = MESH_FLAG_NONE);
 	~Mesh();
 
-	D3D12_VERTEX_BUFFER_VIEW GetVertexBuffer() { return vbView; }
-	D3D12_INDEX_BUFFER_VIEW GetIndexBuffer() { return ibView; }
+	// Just the parsing part of loading an OBJ, for tools and other loaders
+	static bool LoadOBJ(const char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// The vertex and index buffers are shared by every mesh with the same
+	// vertex format, so drawing needs the base vertex and start index too
+	D3D12_VERTEX_BUFFER_VIEW GetVertexBuffer();
+	D3D12_INDEX_BUFFER_VIEW GetIndexBuffer();
+	unsigned int GetVertexFormat() { return geometry.format; }
+	int GetBaseVertex();
+	unsigned int GetStartIndex();
 	int GetIndexCount() { return numIndices; }
+	int GetVertexCount() { return numVerts; }
+	unsigned int GetFlags() { return flags; }
+
+	// Position-only stream (drawn with the same index buffer and start index)
+	bool HasPositionStream();
+	D3D12_VERTEX_BUFFER_VIEW GetPositionBuffer();
+	int GetPositionBaseVertex();
+
+	// Bounds in local space
+	DirectX::BoundingBox GetAABB() { return aabb; }
+	DirectX::BoundingSphere GetBoundingSphere() { return sphere; }
+
+	// Only exists if the mesh was made with MESH_FLAG_KEEP_BVH
+	std::shared_ptr<MeshBVH> GetBVH() { return bvh; }
 
 private:
-	D3D12_VERTEX_BUFFER_VIEW vbView;
-	Microsoft::WRL::ComPtr<ID3D12Resource> vb;
-	D3D12_INDEX_BUFFER_VIEW ibView;
-	Microsoft::WRL::ComPtr<ID3D12Resource> ib;
+	GeometryHandle geometry;
+	uint32_t positionAllocation;
 	int numIndices;
+	int numVerts;
+	unsigned int flags;
+
+	DirectX::BoundingBox aabb;
+	DirectX::BoundingSphere sphere;
+	std::shared_ptr<MeshBVH> bvh;
 
-	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices);
+	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, unsigned int flags);
+	void CalculateBounds(Vertex* vertArray, int numVerts);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 };
 
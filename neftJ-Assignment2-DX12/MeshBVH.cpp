@@ -0,0 +1,661 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+using namespace DirectX;
+
+// Number of SAH buckets tried along each axis
+#define BVH_BINS			16
+
+// Leaves bigger than this get split even when SAH says not to
+// (unless they are already BVH_MAX_DEPTH deep)
+#define BVH_MAX_LEAF_SIZE	16
+
+// Subtrees smaller than this aren't worth a thread
+#define BVH_PARALLEL_MIN_TRIANGLES	8192
+
+// Traversal stack entries.  A ray pushes at most one node per level
+// (a packet at most one more), so the build stops splitting at
+// BVH_MAX_DEPTH and the stack can never overflow.
+#define BVH_STACK_SIZE		64
+#define BVH_MAX_DEPTH		(BVH_STACK_SIZE - 2)
+
+struct BVHBox
+{
+	float min[3];
+	float max[3];
+
+	void Reset()
+	{
+		min[0] = min[1] = min[2] = FLT_MAX;
+		max[0] = max[1] = max[2] = -FLT_MAX;
+	}
+
+	void Grow(const BVHBox& other)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			min[i] = std::min(min[i], other.min[i]);
+			max[i] = std::max(max[i], other.max[i]);
+		}
+	}
+
+	// Half of the surface area, which is all SAH needs
+	float HalfArea() const
+	{
+		float dx = max[0] - min[0];
+		float dy = max[1] - min[1];
+		float dz = max[2] - min[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+};
+
+struct MeshBVH::BuildContext
+{
+	std::vector<BVHBox> triangleBounds;
+	std::vector<XMFLOAT3> centroids;
+	std::vector<unsigned int> order;	// Triangle ids, partitioned in place as we go
+	std::atomic<unsigned int> nodesUsed;
+	unsigned int parallelDepth;
+};
+
+MeshBVH::MeshBVH()
+{
+	nodeCount = 0;
+}
+
+MeshBVH::~MeshBVH()
+{
+
+}
+
+// --------------------------------------------------------
+// Builds the hierarchy for an indexed triangle list
+// --------------------------------------------------------
+void MeshBVH::Build(const XMFLOAT3* positions, unsigned int positionStride, const unsigned int* indices, unsigned int numIndices)
+{
+	nodes.clear();
+	triangles.clear();
+	nodeCount = 0;
+
+	unsigned int numTriangles = numIndices / 3;
+	if (numTriangles == 0) return;
+
+	auto position = [&](unsigned int i) -> const XMFLOAT3&
+	{
+		return *(const XMFLOAT3*)((const char*)positions + (size_t)i * positionStride);
+	};
+
+	// Per-triangle bounds and centroids are all the build looks at
+	BuildContext context;
+	context.triangleBounds.resize(numTriangles);
+	context.centroids.resize(numTriangles);
+	context.order.resize(numTriangles);
+	for (unsigned int t = 0; t < numTriangles; t++)
+	{
+		const XMFLOAT3& a = position(indices[t * 3 + 0]);
+		const XMFLOAT3& b = position(indices[t * 3 + 1]);
+		const XMFLOAT3& c = position(indices[t * 3 + 2]);
+
+		BVHBox& box = context.triangleBounds[t];
+		box.min[0] = std::min({ a.x, b.x, c.x });
+		box.min[1] = std::min({ a.y, b.y, c.y });
+		box.min[2] = std::min({ a.z, b.z, c.z });
+		box.max[0] = std::max({ a.x, b.x, c.x });
+		box.max[1] = std::max({ a.y, b.y, c.y });
+		box.max[2] = std::max({ a.z, b.z, c.z });
+
+		context.centroids[t] = XMFLOAT3(
+			(a.x + b.x + c.x) / 3.0f,
+			(a.y + b.y + c.y) / 3.0f,
+			(a.z + b.z + c.z) / 3.0f);
+
+		context.order[t] = t;
+	}
+
+	// Go wide for roughly the first log2(cores) levels
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	context.parallelDepth = 0;
+	while ((1u << context.parallelDepth) < cores) context.parallelDepth++;
+
+	// A binary tree over N leaves never needs more than 2N - 1 nodes.
+	// Nodes are allocated up front so threads can hand them out atomically.
+	nodes.resize((size_t)numTriangles * 2);
+	nodes[0].leftFirst = 0;
+	nodes[0].count = numTriangles;
+	context.nodesUsed = 1;
+
+	Subdivide(context, 0, 0);
+
+	nodeCount = context.nodesUsed;
+	nodes.resize(nodeCount);
+	nodes.shrink_to_fit();
+
+	// Store the triangles in leaf order, ready for intersection
+	triangles.resize(numTriangles);
+	for (unsigned int i = 0; i < numTriangles; i++)
+	{
+		unsigned int t = context.order[i];
+		const XMFLOAT3& a = position(indices[t * 3 + 0]);
+		const XMFLOAT3& b = position(indices[t * 3 + 1]);
+		const XMFLOAT3& c = position(indices[t * 3 + 2]);
+
+		Triangle& tri = triangles[i];
+		tri.v0[0] = a.x;		tri.v0[1] = a.y;		tri.v0[2] = a.z;
+		tri.e1[0] = b.x - a.x;	tri.e1[1] = b.y - a.y;	tri.e1[2] = b.z - a.z;
+		tri.e2[0] = c.x - a.x;	tri.e2[1] = c.y - a.y;	tri.e2[2] = c.z - a.z;
+		tri.index = t;
+	}
+}
+
+void MeshBVH::UpdateNodeBounds(BuildContext& context, unsigned int nodeIndex)
+{
+	Node& node = nodes[nodeIndex];
+
+	BVHBox box;
+	box.Reset();
+	for (unsigned int i = 0; i < node.count; i++)
+		box.Grow(context.triangleBounds[context.order[node.leftFirst + i]]);
+
+	for (int i = 0; i < 3; i++)
+	{
+		node.min[i] = box.min[i];
+		node.max[i] = box.max[i];
+	}
+}
+
+// --------------------------------------------------------
+// Splits a node using binned SAH, then recurses.  Both halves
+// of a split work on disjoint ranges of the triangle order and
+// the node array, so big subtrees can be built on other threads.
+// --------------------------------------------------------
+void MeshBVH::Subdivide(BuildContext& context, unsigned int nodeIndex, unsigned int depth)
+{
+	Node& node = nodes[nodeIndex];
+	UpdateNodeBounds(context, nodeIndex);
+	if (node.count <= 2 || depth >= BVH_MAX_DEPTH) return;
+
+	unsigned int first = node.leftFirst;
+	unsigned int count = node.count;
+
+	// Split on centroids rather than boxes
+	float cMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float cMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const XMFLOAT3& c = context.centroids[context.order[first + i]];
+		cMin[0] = std::min(cMin[0], c.x); cMax[0] = std::max(cMax[0], c.x);
+		cMin[1] = std::min(cMin[1], c.y); cMax[1] = std::max(cMax[1], c.y);
+		cMin[2] = std::min(cMin[2], c.z); cMax[2] = std::max(cMax[2], c.z);
+	}
+
+	// Find the cheapest bin boundary over all three axes
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = cMax[axis] - cMin[axis];
+		if (extent <= 0.0f) continue;
+
+		BVHBox binBounds[BVH_BINS];
+		unsigned int binCounts[BVH_BINS] = {};
+		for (int b = 0; b < BVH_BINS; b++) binBounds[b].Reset();
+
+		float scale = BVH_BINS / extent;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int t = context.order[first + i];
+			float c = (&context.centroids[t].x)[axis];
+			int b = std::min(BVH_BINS - 1, (int)((c - cMin[axis]) * scale));
+			binCounts[b]++;
+			binBounds[b].Grow(context.triangleBounds[t]);
+		}
+
+		// Sweep from both ends to get the cost of each boundary
+		float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+		unsigned int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+		BVHBox leftBox, rightBox;
+		leftBox.Reset();
+		rightBox.Reset();
+		unsigned int leftSum = 0, rightSum = 0;
+		for (int i = 0; i < BVH_BINS - 1; i++)
+		{
+			leftSum += binCounts[i];
+			leftBox.Grow(binBounds[i]);
+			leftCount[i] = leftSum;
+			leftArea[i] = leftSum > 0 ? leftBox.HalfArea() : 0.0f;
+
+			rightSum += binCounts[BVH_BINS - 1 - i];
+			rightBox.Grow(binBounds[BVH_BINS - 1 - i]);
+			rightCount[BVH_BINS - 2 - i] = rightSum;
+			rightArea[BVH_BINS - 2 - i] = rightSum > 0 ? rightBox.HalfArea() : 0.0f;
+		}
+
+		for (int i = 0; i < BVH_BINS - 1; i++)
+		{
+			if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+
+			float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// All centroids in one spot - nothing we can do
+	if (bestAxis == -1) return;
+
+	// Compare against just leaving this as a leaf (traversal step costs about one triangle test)
+	BVHBox nodeBox;
+	for (int i = 0; i < 3; i++) { nodeBox.min[i] = node.min[i]; nodeBox.max[i] = node.max[i]; }
+	float parentArea = nodeBox.HalfArea();
+	float splitCost = parentArea > 0.0f ? 1.0f + bestCost / parentArea : FLT_MAX;
+	if (splitCost >= (float)count && count <= BVH_MAX_LEAF_SIZE)
+		return;
+
+	// Partition the triangle order around the chosen boundary
+	float scale = BVH_BINS / (cMax[bestAxis] - cMin[bestAxis]);
+	unsigned int i = first;
+	unsigned int j = first + count;
+	while (i < j)
+	{
+		float c = (&context.centroids[context.order[i]].x)[bestAxis];
+		int b = std::min(BVH_BINS - 1, (int)((c - cMin[bestAxis]) * scale));
+		if (b <= bestSplit)
+			i++;
+		else
+			std::swap(context.order[i], context.order[--j]);
+	}
+
+	unsigned int leftCount = i - first;
+	if (leftCount == 0 || leftCount == count) return;
+
+	// Children are always allocated as a pair
+	unsigned int leftChild = context.nodesUsed.fetch_add(2);
+	nodes[leftChild].leftFirst = first;
+	nodes[leftChild].count = leftCount;
+	nodes[leftChild + 1].leftFirst = i;
+	nodes[leftChild + 1].count = count - leftCount;
+
+	node.leftFirst = leftChild;
+	node.count = 0;
+
+	if (depth < context.parallelDepth && count >= BVH_PARALLEL_MIN_TRIANGLES)
+	{
+		std::future<void> left = std::async(std::launch::async,
+			[this, &context, leftChild, depth]() { Subdivide(context, leftChild, depth + 1); });
+		Subdivide(context, leftChild + 1, depth + 1);
+		left.get();
+	}
+	else
+	{
+		Subdivide(context, leftChild, depth + 1);
+		Subdivide(context, leftChild + 1, depth + 1);
+	}
+}
+
+// --------------------------------------------------------
+// Slab test of one ray against one node.  Returns the entry
+// distance, or FLT_MAX if the box is missed (or is further
+// away than the closest hit so far).
+//
+// The fourth lane of each load is leftFirst/count, so it's
+// replaced with a copy of x before doing any math.
+// --------------------------------------------------------
+static inline float IntersectNode(const float* nodeMin, const float* nodeMax, __m128 origin, __m128 invDirection, float tClosest)
+{
+	__m128 bMin = _mm_loadu_ps(nodeMin);
+	__m128 bMax = _mm_loadu_ps(nodeMax);
+	bMin = _mm_shuffle_ps(bMin, bMin, _MM_SHUFFLE(0, 2, 1, 0));
+	bMax = _mm_shuffle_ps(bMax, bMax, _MM_SHUFFLE(0, 2, 1, 0));
+
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(bMin, origin), invDirection);
+	__m128 t2 = _mm_mul_ps(_mm_sub_ps(bMax, origin), invDirection);
+	__m128 vNear = _mm_min_ps(t1, t2);
+	__m128 vFar = _mm_max_ps(t1, t2);
+
+	// Horizontal max of the near distances, min of the far ones
+	vNear = _mm_max_ps(vNear, _mm_shuffle_ps(vNear, vNear, _MM_SHUFFLE(1, 0, 3, 2)));
+	vNear = _mm_max_ps(vNear, _mm_shuffle_ps(vNear, vNear, _MM_SHUFFLE(2, 3, 0, 1)));
+	vFar = _mm_min_ps(vFar, _mm_shuffle_ps(vFar, vFar, _MM_SHUFFLE(1, 0, 3, 2)));
+	vFar = _mm_min_ps(vFar, _mm_shuffle_ps(vFar, vFar, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	float tNear = _mm_cvtss_f32(vNear);
+	float tFar = _mm_cvtss_f32(vFar);
+	if (tFar >= tNear && tFar > 0.0f && tNear < tClosest)
+		return tNear;
+	return FLT_MAX;
+}
+
+bool MeshBVH::Intersect(XMFLOAT3 origin, XMFLOAT3 direction, float tMax, RayHit& hit) const
+{
+	hit.t = tMax;
+	hit.triangle = MESH_BVH_NO_HIT;
+	hit.u = 0.0f;
+	hit.v = 0.0f;
+	if (nodeCount == 0) return false;
+
+	__m128 o = _mm_set_ps(origin.x, origin.z, origin.y, origin.x);
+	__m128 invD = _mm_set_ps(1.0f / direction.x, 1.0f / direction.z, 1.0f / direction.y, 1.0f / direction.x);
+
+	if (IntersectNode(nodes[0].min, nodes[0].max, o, invD, hit.t) == FLT_MAX)
+		return false;
+
+	unsigned int stack[BVH_STACK_SIZE];
+	unsigned int stackSize = 0;
+	unsigned int current = 0;
+	while (true)
+	{
+		const Node& node = nodes[current];
+		if (node.count > 0)
+		{
+			// Leaf - test each triangle (Moller-Trumbore)
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				const Triangle& tri = triangles[node.leftFirst + i];
+
+				float hx = direction.y * tri.e2[2] - direction.z * tri.e2[1];
+				float hy = direction.z * tri.e2[0] - direction.x * tri.e2[2];
+				float hz = direction.x * tri.e2[1] - direction.y * tri.e2[0];
+				float a = tri.e1[0] * hx + tri.e1[1] * hy + tri.e1[2] * hz;
+				if (fabsf(a) < 1e-8f) continue;
+
+				float f = 1.0f / a;
+				float sx = origin.x - tri.v0[0];
+				float sy = origin.y - tri.v0[1];
+				float sz = origin.z - tri.v0[2];
+				float u = f * (sx * hx + sy * hy + sz * hz);
+				if (u < 0.0f || u > 1.0f) continue;
+
+				float qx = sy * tri.e1[2] - sz * tri.e1[1];
+				float qy = sz * tri.e1[0] - sx * tri.e1[2];
+				float qz = sx * tri.e1[1] - sy * tri.e1[0];
+				float v = f * (direction.x * qx + direction.y * qy + direction.z * qz);
+				if (v < 0.0f || u + v > 1.0f) continue;
+
+				float t = f * (tri.e2[0] * qx + tri.e2[1] * qy + tri.e2[2] * qz);
+				if (t > 1e-6f && t < hit.t)
+				{
+					hit.t = t;
+					hit.triangle = tri.index;
+					hit.u = u;
+					hit.v = v;
+				}
+			}
+
+			if (stackSize == 0) break;
+			current = stack[--stackSize];
+			continue;
+		}
+
+		// Interior - visit the nearer child first
+		unsigned int nearChild = node.leftFirst;
+		unsigned int farChild = node.leftFirst + 1;
+		float dNear = IntersectNode(nodes[nearChild].min, nodes[nearChild].max, o, invD, hit.t);
+		float dFar = IntersectNode(nodes[farChild].min, nodes[farChild].max, o, invD, hit.t);
+		if (dFar < dNear)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(dNear, dFar);
+		}
+
+		if (dNear == FLT_MAX)
+		{
+			if (stackSize == 0) break;
+			current = stack[--stackSize];
+			continue;
+		}
+
+		current = nearChild;
+		if (dFar != FLT_MAX)
+		{
+			assert(stackSize < BVH_STACK_SIZE);
+			stack[stackSize++] = farChild;
+		}
+	}
+
+	return hit.triangle != MESH_BVH_NO_HIT;
+}
+
+// Picks new where the mask is set, old everywhere else
+static inline __m128 Select(__m128 mask, __m128 newValue, __m128 oldValue)
+{
+	return _mm_or_ps(_mm_and_ps(mask, newValue), _mm_andnot_ps(mask, oldValue));
+}
+
+// --------------------------------------------------------
+// Same as Intersect(), but each node and triangle is tested
+// against all four rays with one set of SSE instructions.
+// Works best when the rays are coherent (nearby origins and
+// similar directions), like camera or shadow rays.
+// --------------------------------------------------------
+unsigned int MeshBVH::Intersect4(const RayPacket4& packet, RayHit hits[4]) const
+{
+	__m128 ox = _mm_load_ps(packet.originX);
+	__m128 oy = _mm_load_ps(packet.originY);
+	__m128 oz = _mm_load_ps(packet.originZ);
+	__m128 dx = _mm_load_ps(packet.directionX);
+	__m128 dy = _mm_load_ps(packet.directionY);
+	__m128 dz = _mm_load_ps(packet.directionZ);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 idx = _mm_div_ps(one, dx);
+	__m128 idy = _mm_div_ps(one, dy);
+	__m128 idz = _mm_div_ps(one, dz);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 epsilon = _mm_set1_ps(1e-8f);
+	__m128 tEpsilon = _mm_set1_ps(1e-6f);
+	__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	__m128 tBest = _mm_load_ps(packet.tMax);
+	__m128 uBest = zero;
+	__m128 vBest = zero;
+	__m128 triBest = _mm_castsi128_ps(_mm_set1_epi32((int)MESH_BVH_NO_HIT));
+
+	unsigned int stack[BVH_STACK_SIZE];
+	unsigned int stackSize = 0;
+	if (nodeCount > 0) stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+
+		// Slab test for all four rays
+		__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[0]), ox), idx);
+		__m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[0]), ox), idx);
+		__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[1]), oy), idy);
+		__m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[1]), oy), idy);
+		__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[2]), oz), idz);
+		__m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[2]), oz), idz);
+		__m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_min_ps(t1z, t2z));
+		__m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_max_ps(t1z, t2z));
+		__m128 boxHit = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(tFar, tNear), _mm_cmpgt_ps(tFar, zero)),
+			_mm_cmplt_ps(tNear, tBest));
+		if (_mm_movemask_ps(boxHit) == 0)
+			continue;
+
+		if (node.count == 0)
+		{
+			// Right first so the left child is popped next
+			assert(stackSize + 2 <= BVH_STACK_SIZE);
+			stack[stackSize++] = node.leftFirst + 1;
+			stack[stackSize++] = node.leftFirst;
+			continue;
+		}
+
+		for (unsigned int i = 0; i < node.count; i++)
+		{
+			const Triangle& tri = triangles[node.leftFirst + i];
+			__m128 e1x = _mm_set1_ps(tri.e1[0]), e1y = _mm_set1_ps(tri.e1[1]), e1z = _mm_set1_ps(tri.e1[2]);
+			__m128 e2x = _mm_set1_ps(tri.e2[0]), e2y = _mm_set1_ps(tri.e2[1]), e2z = _mm_set1_ps(tri.e2[2]);
+
+			__m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			__m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			__m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+			__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+			__m128 f = _mm_div_ps(one, a);
+
+			__m128 sx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0[0]));
+			__m128 sy = _mm_sub_ps(oy, _mm_set1_ps(tri.v0[1]));
+			__m128 sz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0[2]));
+			__m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+			__m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+			__m128 mask = _mm_cmpgt_ps(_mm_and_ps(a, absMask), epsilon);
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+			mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, tEpsilon));
+			mask = _mm_and_ps(mask, _mm_cmplt_ps(t, tBest));
+			if (_mm_movemask_ps(mask) == 0) continue;
+
+			tBest = Select(mask, t, tBest);
+			uBest = Select(mask, u, uBest);
+			vBest = Select(mask, v, vBest);
+			triBest = Select(mask, _mm_castsi128_ps(_mm_set1_epi32((int)tri.index)), triBest);
+		}
+	}
+
+	alignas(16) float tOut[4], uOut[4], vOut[4];
+	alignas(16) unsigned int triOut[4];
+	_mm_store_ps(tOut, tBest);
+	_mm_store_ps(uOut, uBest);
+	_mm_store_ps(vOut, vBest);
+	_mm_store_si128((__m128i*)triOut, _mm_castps_si128(triBest));
+
+	unsigned int hitMask = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		hits[i].t = tOut[i];
+		hits[i].triangle = triOut[i];
+		hits[i].u = uOut[i];
+		hits[i].v = vOut[i];
+		if (triOut[i] != MESH_BVH_NO_HIT) hitMask |= 1 << i;
+	}
+	return hitMask;
+}
+
+// --------------------------------------------------------
+// Fires rays from a sphere around the mesh towards random
+// points inside its bounds.  Rays come in groups of four
+// that share an origin and aim at nearby points, so the
+// packet path sees the kind of coherence camera rays have.
+// Both paths trace the exact same rays.
+// --------------------------------------------------------
+double MeshBVH::MeasureRaysPerSecond(unsigned int numRays, bool usePackets) const
+{
+	if (nodeCount == 0 || numRays == 0) return 0.0;
+
+	float center[3], extent[3];
+	for (int i = 0; i < 3; i++)
+	{
+		center[i] = (nodes[0].min[i] + nodes[0].max[i]) * 0.5f;
+		extent[i] = (nodes[0].max[i] - nodes[0].min[i]) * 0.5f;
+	}
+	float radius = sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+	if (radius <= 0.0f) return 0.0;
+
+	// Deterministic so runs can be compared
+	unsigned int seed = 0x12345678;
+	auto random = [&]() -> float
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
+
+	unsigned int numPackets = (numRays + 3) / 4;
+	std::vector<RayPacket4> packets(numPackets);
+	for (auto& p : packets)
+	{
+		// Origin on a sphere twice the size of the bounds
+		float z = random() * 2.0f - 1.0f;
+		float angle = random() * XM_2PI;
+		float r = sqrtf(std::max(0.0f, 1.0f - z * z));
+		float origin[3] = {
+			center[0] + r * cosf(angle) * radius * 2.0f,
+			center[1] + r * sinf(angle) * radius * 2.0f,
+			center[2] + z * radius * 2.0f };
+
+		float target[3];
+		for (int i = 0; i < 3; i++)
+			target[i] = center[i] + (random() * 2.0f - 1.0f) * extent[i];
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			p.originX[lane] = origin[0];
+			p.originY[lane] = origin[1];
+			p.originZ[lane] = origin[2];
+			p.directionX[lane] = target[0] + (random() - 0.5f) * radius * 0.02f - origin[0];
+			p.directionY[lane] = target[1] + (random() - 0.5f) * radius * 0.02f - origin[1];
+			p.directionZ[lane] = target[2] + (random() - 0.5f) * radius * 0.02f - origin[2];
+			p.tMax[lane] = FLT_MAX;
+		}
+	}
+
+	unsigned int hitCount = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	if (usePackets)
+	{
+		RayHit hits[4];
+		for (auto& p : packets)
+		{
+			unsigned int mask = Intersect4(p, hits);
+			hitCount += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+		}
+	}
+	else
+	{
+		RayHit hit;
+		for (auto& p : packets)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				XMFLOAT3 o(p.originX[lane], p.originY[lane], p.originZ[lane]);
+				XMFLOAT3 d(p.directionX[lane], p.directionY[lane], p.directionZ[lane]);
+				if (Intersect(o, d, p.tMax[lane], hit)) hitCount++;
+			}
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	// Keeps the traversal from being optimized away
+	static volatile unsigned int sink;
+	sink = hitCount;
+
+	double seconds = elapsed.count();
+	return seconds > 0.0 ? (numPackets * 4.0) / seconds / 1000000.0 : 0.0;
+}
+
+unsigned int MeshBVH::GetNodeCount() const
+{
+	return nodeCount;
+}
+
+unsigned int MeshBVH::GetTriangleCount() const
+{
+	return (unsigned int)triangles.size();
+}
+
+size_t MeshBVH::GetMemorySizeInBytes() const
+{
+	return nodes.size() * sizeof(Node) + triangles.size() * sizeof(Triangle);
+}
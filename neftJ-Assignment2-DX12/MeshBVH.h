@@ -0,0 +1,91 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Triangle id reported for rays that don't hit anything
+#define MESH_BVH_NO_HIT	0xFFFFFFFF
+
+// Result of a single ray query
+struct RayHit
+{
+	float t;				// Distance along the ray
+	unsigned int triangle;	// Triangle index (first index / 3) or MESH_BVH_NO_HIT
+	float u;				// Barycentrics of the hit point
+	float v;
+};
+
+// Four rays laid out for SIMD (one ray per lane)
+struct RayPacket4
+{
+	alignas(16) float originX[4];
+	alignas(16) float originY[4];
+	alignas(16) float originZ[4];
+	alignas(16) float directionX[4];
+	alignas(16) float directionY[4];
+	alignas(16) float directionZ[4];
+	alignas(16) float tMax[4];
+};
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over a mesh's triangles for
+// CPU-side ray queries (picking, visibility tests, etc.)
+//
+// Built top-down with binned SAH, with the big subtrees
+// built in parallel.  Nodes are 32 bytes each and the
+// triangles are stored pre-transformed for Moller-Trumbore,
+// so the mesh's own vertex data isn't needed afterwards.
+// --------------------------------------------------------
+class MeshBVH
+{
+public:
+	MeshBVH();
+	~MeshBVH();
+
+	// Positions are read with the given stride so a Vertex array can be passed directly
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int positionStride, const unsigned int* indices, unsigned int numIndices);
+
+	// Closest hit along the ray (direction does not need to be normalized)
+	bool Intersect(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float tMax, RayHit& hit) const;
+
+	// Closest hits for four rays at once.  Returns a bit mask of the lanes that hit.
+	unsigned int Intersect4(const RayPacket4& packet, RayHit hits[4]) const;
+
+	// Traces random rays at the mesh and returns millions of rays per second
+	double MeasureRaysPerSecond(unsigned int numRays, bool usePackets) const;
+
+	// Stats
+	unsigned int GetNodeCount() const;
+	unsigned int GetTriangleCount() const;
+	size_t GetMemorySizeInBytes() const;
+
+private:
+	// Interior nodes: count == 0, children at leftFirst and leftFirst + 1
+	// Leaves: count triangles starting at leftFirst
+	struct Node
+	{
+		float min[3];
+		unsigned int leftFirst;
+		float max[3];
+		unsigned int count;
+	};
+
+	// Vertex 0 plus the two edges coming out of it
+	struct Triangle
+	{
+		float v0[3];
+		float e1[3];
+		float e2[3];
+		unsigned int index;
+	};
+
+	// Scratch data that only exists during Build()
+	struct BuildContext;
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	unsigned int nodeCount;
+
+	void Subdivide(BuildContext& context, unsigned int nodeIndex, unsigned int depth);
+	void UpdateNodeBounds(BuildContext& context, unsigned int nodeIndex);
+};
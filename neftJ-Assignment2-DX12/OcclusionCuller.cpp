@@ -0,0 +1,410 @@
+#include "OcclusionCuller.h"
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+static const int TilesX = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+static const int TilesY = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+
+static unsigned int LevelWidth(unsigned int level) { return std::max(1, OCCLUSION_WIDTH >> level); }
+static unsigned int LevelHeight(unsigned int level) { return std::max(1, OCCLUSION_HEIGHT >> level); }
+
+OccluderMesh OccluderMesh::FromBox(const BoundingBox& box)
+{
+	OccluderMesh mesh;
+	for (int i = 0; i < 8; i++)
+	{
+		mesh.positions.push_back(XMFLOAT3(
+			box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x),
+			box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y),
+			box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z)));
+	}
+
+	// Two triangles per face (winding doesn't matter, as both sides are drawn)
+	mesh.indices = {
+		0, 1, 3,  0, 3, 2,		// -Z
+		4, 6, 7,  4, 7, 5,		// +Z
+		0, 2, 6,  0, 6, 4,		// -X
+		1, 5, 7,  1, 7, 3,		// +X
+		0, 4, 5,  0, 5, 1,		// -Y
+		2, 3, 7,  2, 7, 6 };	// +Y
+	return mesh;
+}
+
+OcclusionCuller::OcclusionCuller()
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	bins.resize(TilesX * TilesY);
+
+	// closest[0] is never used, since level 0 has one depth per pixel
+	for (unsigned int level = 0; ; level++)
+	{
+		farthest.push_back(std::vector<float>(LevelWidth(level) * LevelHeight(level), 0.0f));
+		closest.push_back(std::vector<float>(level == 0 ? 0 : farthest.back().size(), 0.0f));
+		if (LevelWidth(level) == 1 && LevelHeight(level) == 1)
+			break;
+	}
+}
+
+void OcclusionCuller::BeginFrame(XMFLOAT4X4 view, XMFLOAT4X4 projection)
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	triangles.clear();
+	std::fill(farthest[0].begin(), farthest[0].end(), 0.0f);
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const XMFLOAT4X4& world)
+{
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection));
+
+	std::vector<XMFLOAT4> clip(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); i++)
+		XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&mesh.positions[i]), worldViewProjection));
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		SetupTriangle(clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]]);
+}
+
+// --------------------------------------------------------
+// Projects a clip space triangle to the buffer and works
+// out its edge functions (positive inside) and its depth
+// plane.  Triangles that reach behind the near plane are
+// dropped instead of clipped, which only means they hide
+// less than they could.
+// --------------------------------------------------------
+void OcclusionCuller::SetupTriangle(XMFLOAT4 a, XMFLOAT4 b, XMFLOAT4 c)
+{
+	if (a.w < OCCLUSION_NEAR || b.w < OCCLUSION_NEAR || c.w < OCCLUSION_NEAR)
+		return;
+
+	float x[3], y[3], z[3];
+	const XMFLOAT4* v[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; i++)
+	{
+		float invW = 1.0f / v[i]->w;
+		x[i] = (v[i]->x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		y[i] = (0.5f - v[i]->y * invW * 0.5f) * OCCLUSION_HEIGHT;
+		z[i] = invW * (1.0f - OCCLUSION_DEPTH_BIAS);
+	}
+
+	Triangle t;
+	t.minX = std::max(0, (int)floorf(std::min({ x[0], x[1], x[2] })));
+	t.minY = std::max(0, (int)floorf(std::min({ y[0], y[1], y[2] })));
+	t.maxX = std::min(OCCLUSION_WIDTH - 1, (int)floorf(std::max({ x[0], x[1], x[2] })));
+	t.maxY = std::min(OCCLUSION_HEIGHT - 1, (int)floorf(std::max({ y[0], y[1], y[2] })));
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	// Twice the signed area, which flips the edges of back facing triangles
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0)
+		return;
+	float sign = area > 0 ? 1.0f : -1.0f;
+
+	// Edge i runs from vertex i to the next one
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i + 1) % 3;
+		t.edgeA[i] = (y[i] - y[j]) * sign;
+		t.edgeB[i] = (x[j] - x[i]) * sign;
+		t.edgeC[i] = -(t.edgeA[i] * x[i] + t.edgeB[i] * y[i]);
+	}
+
+	// Each vertex's weight is the edge opposite it over the area
+	float invArea = sign / area;
+	float dz1 = (z[1] - z[0]) * invArea, dz2 = (z[2] - z[0]) * invArea;
+	t.depthA = dz1 * t.edgeA[2] + dz2 * t.edgeA[0];
+	t.depthB = dz1 * t.edgeB[2] + dz2 * t.edgeB[0];
+	t.depthC = z[0] + dz1 * t.edgeC[2] + dz2 * t.edgeC[0];
+
+	triangles.push_back(t);
+}
+
+void OcclusionCuller::Rasterize(bool allowThreads)
+{
+	// Every tile gets a list of the triangles whose bounds overlap it
+	for (std::vector<uint32_t>& bin : bins)
+		bin.clear();
+	for (uint32_t i = 0; i < triangles.size(); i++)
+	{
+		const Triangle& t = triangles[i];
+		for (int ty = t.minY / OCCLUSION_TILE_HEIGHT; ty <= t.maxY / OCCLUSION_TILE_HEIGHT; ty++)
+		{
+			for (int tx = t.minX / OCCLUSION_TILE_WIDTH; tx <= t.maxX / OCCLUSION_TILE_WIDTH; tx++)
+				bins[ty * TilesX + tx].push_back(i);
+		}
+	}
+
+	// Tiles don't share any pixels, so each thread takes a range of them
+	size_t tiles = bins.size();
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	if (cores == 1 || triangles.empty())
+	{
+		RasterizeTiles(0, tiles);
+	}
+	else
+	{
+		size_t perJob = (tiles + cores - 1) / cores;
+		std::vector<std::future<void>> jobs;
+		for (size_t first = perJob; first < tiles; first += perJob)
+		{
+			size_t last = std::min(first + perJob, tiles);
+			jobs.push_back(std::async(std::launch::async, [this, first, last]() { RasterizeTiles(first, last); }));
+		}
+
+		RasterizeTiles(0, std::min(perJob, tiles));
+		for (std::future<void>& job : jobs)
+			job.get();
+	}
+
+	BuildHierarchy();
+}
+
+void OcclusionCuller::RasterizeTiles(size_t firstTile, size_t lastTile)
+{
+	for (size_t tile = firstTile; tile < lastTile; tile++)
+	{
+		int tileX = (int)(tile % TilesX) * OCCLUSION_TILE_WIDTH;
+		int tileY = (int)(tile / TilesX) * OCCLUSION_TILE_HEIGHT;
+		for (uint32_t i : bins[tile])
+			RasterizeTriangle(triangles[i], tileX, tileY);
+	}
+}
+
+// --------------------------------------------------------
+// Draws the part of a triangle inside one tile, four
+// pixels at a time.  Pixels count as covered if their
+// centers are inside all three edges, and the covered
+// lanes keep whichever depth is closer.
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTriangle(const Triangle& t, int tileX, int tileY)
+{
+	int minX = std::max(t.minX, tileX) & ~3;
+	int maxX = std::min(t.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+	int minY = std::max(t.minY, tileY);
+	int maxY = std::min(t.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+
+	XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR edgeA[3];
+	for (int e = 0; e < 3; e++)
+		edgeA[e] = XMVectorReplicate(t.edgeA[e]);
+	XMVECTOR depthA = XMVectorReplicate(t.depthA);
+
+	float* buffer = farthest[0].data();
+	for (int y = minY; y <= maxY; y++)
+	{
+		// The parts of each function that only change per row
+		float centerY = y + 0.5f;
+		XMVECTOR edgeRow[3];
+		for (int e = 0; e < 3; e++)
+			edgeRow[e] = XMVectorReplicate(t.edgeB[e] * centerY + t.edgeC[e]);
+		XMVECTOR depthRow = XMVectorReplicate(t.depthB * centerY + t.depthC);
+
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			XMVECTOR centerX = XMVectorReplicate((float)x) + laneOffsets;
+			XMVECTOR inside = XMVectorGreaterOrEqual(edgeA[0] * centerX + edgeRow[0], zero);
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(edgeA[1] * centerX + edgeRow[1], zero));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(edgeA[2] * centerX + edgeRow[2], zero));
+			if (XMVector4EqualInt(inside, zero))
+				continue;
+
+			XMFLOAT4* pixels = reinterpret_cast<XMFLOAT4*>(&buffer[y * OCCLUSION_WIDTH + x]);
+			XMVECTOR current = XMLoadFloat4(pixels);
+			XMVECTOR depth = depthA * centerX + depthRow;
+			XMStoreFloat4(pixels, XMVectorSelect(current, XMVectorMax(current, depth), inside));
+		}
+	}
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	for (unsigned int level = 1; level < farthest.size(); level++)
+	{
+		unsigned int width = LevelWidth(level), height = LevelHeight(level);
+		unsigned int sourceWidth = LevelWidth(level - 1), sourceHeight = LevelHeight(level - 1);
+		const std::vector<float>& sourceFarthest = farthest[level - 1];
+		const std::vector<float>& sourceClosest = level == 1 ? farthest[0] : closest[level - 1];
+
+		for (unsigned int y = 0; y < height; y++)
+		{
+			unsigned int y0 = y * 2, y1 = std::min(y * 2 + 1, sourceHeight - 1);
+			for (unsigned int x = 0; x < width; x++)
+			{
+				unsigned int x0 = x * 2, x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				size_t a = y0 * sourceWidth + x0, b = y0 * sourceWidth + x1;
+				size_t c = y1 * sourceWidth + x0, d = y1 * sourceWidth + x1;
+				farthest[level][y * width + x] = std::min({ sourceFarthest[a], sourceFarthest[b], sourceFarthest[c], sourceFarthest[d] });
+				closest[level][y * width + x] = std::max({ sourceClosest[a], sourceClosest[b], sourceClosest[c], sourceClosest[d] });
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Projects the box's corners for the pixels it could cover
+// and its closest depth, then starts at the level where
+// that rectangle is at most 2x2 texels
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const BoundingBox& box) const
+{
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float depth = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		XMFLOAT3 corner(
+			box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x),
+			box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y),
+			box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z));
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), matrix));
+		if (clip.w < OCCLUSION_NEAR)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		float y = (0.5f - clip.y * invW * 0.5f) * OCCLUSION_HEIGHT;
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+		depth = std::max(depth, invW);
+	}
+
+	// Every pixel the box touches, not just those whose centers it covers
+	int x0 = std::max(0, (int)floorf(minX)), y0 = std::max(0, (int)floorf(minY));
+	int x1 = std::min(OCCLUSION_WIDTH - 1, (int)floorf(maxX)), y1 = std::min(OCCLUSION_HEIGHT - 1, (int)floorf(maxY));
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	unsigned int level = 0;
+	while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+		level++;
+
+	for (int y = y0 >> level; y <= y1 >> level; y++)
+	{
+		for (int x = x0 >> level; x <= x1 >> level; x++)
+		{
+			if (IsRegionVisible(level, x, y, x0, y0, x1, y1, depth))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Whether a depth is in front of any pixel inside both one
+// texel of a level and the rectangle (in pixels)
+// --------------------------------------------------------
+bool OcclusionCuller::IsRegionVisible(unsigned int level, int x, int y, int minX, int minY, int maxX, int maxY, float depth) const
+{
+	size_t texel = y * LevelWidth(level) + x;
+
+	// Behind everything here
+	if (depth < farthest[level][texel])
+		return false;
+
+	// In front of everything here, or a single pixel it isn't behind
+	if (level == 0 || depth >= closest[level][texel])
+		return true;
+
+	unsigned int childLevel = level - 1;
+	int childWidth = (int)LevelWidth(childLevel), childHeight = (int)LevelHeight(childLevel);
+	for (int cy = y * 2; cy <= std::min(y * 2 + 1, childHeight - 1); cy++)
+	{
+		if ((cy + 1) << childLevel <= minY || cy << childLevel > maxY)
+			continue;
+
+		for (int cx = x * 2; cx <= std::min(x * 2 + 1, childWidth - 1); cx++)
+		{
+			if ((cx + 1) << childLevel <= minX || cx << childLevel > maxX)
+				continue;
+
+			if (IsRegionVisible(childLevel, cx, cy, minX, minY, maxX, maxY, depth))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+OcclusionTimings OcclusionCuller::MeasureOcclusion(unsigned int numOccludees)
+{
+	OcclusionTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// City blocks every 20 units with streets between them, and the
+	// camera standing in a street looking down +Z
+	OccluderMesh building = OccluderMesh::FromBox(BoundingBox(XMFLOAT3(0, 0.5f, 0), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+	std::vector<XMFLOAT4X4> buildings;
+	for (int z = -20; z < 20; z++)
+	{
+		for (int x = -20; x < 20; x++)
+		{
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixScaling(14, random(10, 40), 14) * XMMatrixTranslation(x * 20.0f + 10, 0, z * 20.0f + 10));
+			buildings.push_back(world);
+		}
+	}
+
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 2, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+
+	// Small objects scattered through the streets (and inside the buildings)
+	Frustum frustum = Frustum::FromViewProjection(view, projection);
+	std::vector<BoundingBox> occludees;
+	for (unsigned int i = 0; i < numOccludees; i++)
+	{
+		BoundingBox box(XMFLOAT3(random(-400, 400), random(0, 5), random(-400, 400)), XMFLOAT3(random(0.5f, 2), random(0.5f, 2), random(0.5f, 2)));
+
+		bool inside = true;
+		for (const XMFLOAT4& p : frustum.planes)
+		{
+			float distance = p.x * box.Center.x + p.y * box.Center.y + p.z * box.Center.z + p.w;
+			if (distance < -(fabsf(p.x) * box.Extents.x + fabsf(p.y) * box.Extents.y + fabsf(p.z) * box.Extents.z))
+				inside = false;
+		}
+		if (inside)
+			occludees.push_back(box);
+	}
+	timings.inFrustum = (unsigned int)occludees.size();
+
+	// Averaged over a few runs since a single one is very short
+	const int runs = 10;
+	OcclusionCuller culler;
+	for (bool threaded : { false, true })
+	{
+		auto start = now();
+		for (int r = 0; r < runs; r++)
+		{
+			culler.BeginFrame(view, projection);
+			for (const XMFLOAT4X4& world : buildings)
+				culler.AddOccluder(building, world);
+			culler.Rasterize(threaded);
+		}
+		double ms = std::chrono::duration<double, std::milli>(now() - start).count() / runs;
+		(threaded ? timings.rasterizeThreadedMs : timings.rasterizeMs) = ms;
+	}
+	timings.occluderTriangles = culler.GetTriangleCount();
+
+	auto start = now();
+	for (const BoundingBox& box : occludees)
+		timings.visible += culler.IsVisible(box) ? 1 : 0;
+	timings.testMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+	return timings;
+}
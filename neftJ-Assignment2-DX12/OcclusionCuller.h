@@ -0,0 +1,112 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <stdint.h>
+#include <vector>
+
+// Size of the depth buffer occluders are drawn into, which is split
+// into tiles that are each rasterized by one thread
+#define OCCLUSION_WIDTH			256
+#define OCCLUSION_HEIGHT		128
+#define OCCLUSION_TILE_WIDTH	32
+#define OCCLUSION_TILE_HEIGHT	16
+
+// Anything closer to the camera than this (in view space) is never
+// used as an occluder and is always treated as visible
+#define OCCLUSION_NEAR			0.01f
+
+// Occluder depths are pushed back by this fraction so an object's
+// own surface can't hide it through rounding error
+#define OCCLUSION_DEPTH_BIAS	0.001f
+
+// Timings from MeasureOcclusion()
+struct OcclusionTimings
+{
+	unsigned int occluderTriangles;
+	unsigned int inFrustum;			// Occludees the frustum keeps...
+	unsigned int visible;			// ...and how many of them occlusion keeps
+	double rasterizeMs;				// Setting up, binning and drawing occluders, one thread
+	double rasterizeThreadedMs;		// The same on all cores
+	double testMs;					// Testing every occludee in the frustum
+};
+
+// Triangles for drawing something into the occlusion buffer.  These
+// should sit inside what they stand for (so they never hide anything
+// it doesn't) and be much simpler than it.
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<uint32_t> indices;
+
+	// Twelve triangles filling a box, for things that are boxes anyway
+	static OccluderMesh FromBox(const DirectX::BoundingBox& box);
+};
+
+// --------------------------------------------------------
+// Occlusion culling against a small depth buffer drawn on
+// the CPU.
+//
+// Each frame, occluders are transformed and set up once,
+// binned into screen tiles and then drawn tile by tile
+// across all cores.  Rasterizing covers four pixels at a
+// time: the edge functions give a mask of the pixels inside
+// the triangle, and only those lanes take the new depth.
+// Depth is stored as 1 / w, which is linear across the
+// screen, with bigger being closer and 0 being empty.
+//
+// Afterwards a hierarchy is built with both the farthest
+// and closest depth of each 2x2 block of the level below.
+// An object's box is hidden if its closest point is behind
+// the farthest occluder depth everywhere it covers: whole
+// blocks are skipped if they're hidden (or are certainly
+// visible), and only the rest are looked at more closely.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	// Clears the buffer and sets the camera for this frame
+	void BeginFrame(DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection);
+
+	// Occluders are only queued here and drawn by Rasterize()
+	void AddOccluder(const OccluderMesh& mesh, const DirectX::XMFLOAT4X4& world);
+	void Rasterize(bool allowThreads = true);
+
+	// False if the world space box is certainly hidden
+	bool IsVisible(const DirectX::BoundingBox& box) const;
+
+	unsigned int GetTriangleCount() { return (unsigned int)triangles.size(); }
+
+	// Builds a grid of buildings with small objects between them and
+	// times drawing the buildings and testing the objects
+	static OcclusionTimings MeasureOcclusion(unsigned int numOccludees);
+
+private:
+	// A triangle ready to rasterize: edge functions and depth as
+	// a * x + b * y + c over the screen, plus its pixel bounds
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		int minX, minY, maxX, maxY;
+	};
+
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<Triangle> triangles;
+
+	// Triangles overlapping each tile
+	std::vector<std::vector<uint32_t>> bins;
+
+	// Level 0 is the buffer itself, and each level after that is
+	// half the size in both directions
+	std::vector<std::vector<float>> farthest;
+	std::vector<std::vector<float>> closest;
+
+	void SetupTriangle(DirectX::XMFLOAT4 a, DirectX::XMFLOAT4 b, DirectX::XMFLOAT4 c);
+	void RasterizeTiles(size_t firstTile, size_t lastTile);
+	void RasterizeTriangle(const Triangle& t, int tileX, int tileY);
+	void BuildHierarchy();
+	bool IsRegionVisible(unsigned int level, int x, int y, int minX, int minY, int maxX, int maxY, float depth) const;
+};
@@ -0,0 +1,438 @@
+#include "ProceduralMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace DirectX;
+
+// Small vector helpers so nothing here needs XMVECTOR loads and stores
+static XMFLOAT3 Add(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static XMFLOAT3 Scale(XMFLOAT3 a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+static XMFLOAT3 Cross(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+static float Dot(XMFLOAT3 a, XMFLOAT3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static XMFLOAT3 Normalize(XMFLOAT3 a) { return Scale(a, 1.0f / sqrtf(Dot(a, a))); }
+
+// --------------------------------------------------------
+// Fills a (segmentsU + 1) x (segmentsV + 1) grid of vertices
+// from a surface function and stitches it into triangles.
+// The surface must be laid out so that cross(dP/du, dP/dv)
+// points outwards, which makes the winding clockwise from
+// the outside in our left-handed space.
+// --------------------------------------------------------
+template<typename SurfaceFunction>
+static void WriteGrid(Vertex*& vert, unsigned int*& index, unsigned int& baseVertex, unsigned int segmentsU, unsigned int segmentsV, SurfaceFunction surface)
+{
+	for (unsigned int y = 0; y <= segmentsV; y++)
+	{
+		for (unsigned int x = 0; x <= segmentsU; x++)
+		{
+			surface((float)x / segmentsU, (float)y / segmentsV, *vert);
+			vert++;
+		}
+	}
+
+	unsigned int rowLength = segmentsU + 1;
+	for (unsigned int y = 0; y < segmentsV; y++)
+	{
+		for (unsigned int x = 0; x < segmentsU; x++)
+		{
+			unsigned int i00 = baseVertex + y * rowLength + x;
+			unsigned int i10 = i00 + 1;
+			unsigned int i01 = i00 + rowLength;
+			unsigned int i11 = i01 + 1;
+
+			*index++ = i00; *index++ = i10; *index++ = i01;
+			*index++ = i10; *index++ = i11; *index++ = i01;
+		}
+	}
+
+	baseVertex += rowLength * (segmentsV + 1);
+}
+
+static unsigned int GridVertexCount(unsigned int segmentsU, unsigned int segmentsV) { return (segmentsU + 1) * (segmentsV + 1); }
+static unsigned int GridIndexCount(unsigned int segmentsU, unsigned int segmentsV) { return segmentsU * segmentsV * 6; }
+
+// Tangent of a sphere-like surface at the given longitude (U runs around the Y axis)
+static XMFLOAT3 LongitudeTangent(float angle) { return XMFLOAT3(-sinf(angle), 0, cosf(angle)); }
+
+void ProceduralMesh::Plane(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int subdivisions)
+{
+	subdivisions = std::max(subdivisions, 1u);
+	verts.resize(GridVertexCount(subdivisions, subdivisions));
+	indices.resize(GridIndexCount(subdivisions, subdivisions));
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+	unsigned int baseVertex = 0;
+
+	// Facing up, with V running towards -Z
+	WriteGrid(vert, index, baseVertex, subdivisions, subdivisions, [](float u, float v, Vertex& out)
+	{
+		out.Position = XMFLOAT3(u - 0.5f, 0, 0.5f - v);
+		out.UV = XMFLOAT2(u, v);
+		out.Normal = XMFLOAT3(0, 1, 0);
+		out.Tangent = XMFLOAT3(1, 0, 0);
+	});
+}
+
+void ProceduralMesh::Cube(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int subdivisions)
+{
+	subdivisions = std::max(subdivisions, 1u);
+	verts.resize(GridVertexCount(subdivisions, subdivisions) * 6);
+	indices.resize(GridIndexCount(subdivisions, subdivisions) * 6);
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+	unsigned int baseVertex = 0;
+
+	// Each face's normal and "right" direction as seen from outside
+	const XMFLOAT3 faces[6][2] = {
+		{ XMFLOAT3(1, 0, 0), XMFLOAT3(0, 0, 1) },
+		{ XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 0, -1) },
+		{ XMFLOAT3(0, 1, 0), XMFLOAT3(1, 0, 0) },
+		{ XMFLOAT3(0, -1, 0), XMFLOAT3(1, 0, 0) },
+		{ XMFLOAT3(0, 0, 1), XMFLOAT3(-1, 0, 0) },
+		{ XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0) } };
+
+	for (auto& face : faces)
+	{
+		XMFLOAT3 normal = face[0];
+		XMFLOAT3 tangent = face[1];
+		XMFLOAT3 down = Cross(normal, tangent);
+
+		WriteGrid(vert, index, baseVertex, subdivisions, subdivisions, [&](float u, float v, Vertex& out)
+		{
+			out.Position = Add(Scale(normal, 0.5f), Add(Scale(tangent, u - 0.5f), Scale(down, v - 0.5f)));
+			out.UV = XMFLOAT2(u, v);
+			out.Normal = normal;
+			out.Tangent = tangent;
+		});
+	}
+}
+
+void ProceduralMesh::UVSphere(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segments, unsigned int rings)
+{
+	segments = std::max(segments, 3u);
+	rings = std::max(rings, 2u);
+
+	// Rings of vertices between the poles, plus a fan of triangles
+	// at each pole rather than a row of quads that collapse there.
+	// Every fan triangle gets its own copy of the pole so its UV
+	// can sit in the middle of its segment.
+	unsigned int rowLength = segments + 1;
+	unsigned int ringCount = rings - 1;
+	verts.resize(rowLength * ringCount + segments * 2);
+	indices.resize(segments * 3 * 2 + segments * (ringCount - 1) * 6);
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+
+	// U around the Y axis, V from the top pole to the bottom one
+	for (unsigned int y = 1; y < rings; y++)
+	{
+		float v = (float)y / rings;
+		float latitude = v * XM_PI;
+		for (unsigned int x = 0; x <= segments; x++)
+		{
+			float u = (float)x / segments;
+			float longitude = u * XM_2PI;
+			vert->Normal = XMFLOAT3(sinf(latitude) * cosf(longitude), cosf(latitude), sinf(latitude) * sinf(longitude));
+			vert->Position = Scale(vert->Normal, 0.5f);
+			vert->UV = XMFLOAT2(u, v);
+			vert->Tangent = LongitudeTangent(longitude);
+			vert++;
+		}
+	}
+
+	unsigned int topPole = rowLength * ringCount;
+	unsigned int bottomPole = topPole + segments;
+	for (unsigned int pole = 0; pole < 2; pole++)
+	{
+		float height = pole == 0 ? 1.0f : -1.0f;
+		for (unsigned int x = 0; x < segments; x++)
+		{
+			float u = (x + 0.5f) / segments;
+			vert->Normal = XMFLOAT3(0, height, 0);
+			vert->Position = Scale(vert->Normal, 0.5f);
+			vert->UV = XMFLOAT2(u, pole == 0 ? 0.0f : 1.0f);
+			vert->Tangent = LongitudeTangent(u * XM_2PI);
+			vert++;
+		}
+	}
+
+	// Same winding as WriteGrid's quads
+	unsigned int lastRing = rowLength * (ringCount - 1);
+	for (unsigned int x = 0; x < segments; x++)
+	{
+		*index++ = topPole + x; *index++ = x + 1; *index++ = x;
+		*index++ = lastRing + x; *index++ = lastRing + x + 1; *index++ = bottomPole + x;
+	}
+
+	for (unsigned int y = 0; y + 1 < ringCount; y++)
+	{
+		for (unsigned int x = 0; x < segments; x++)
+		{
+			unsigned int i00 = y * rowLength + x;
+			unsigned int i10 = i00 + 1;
+			unsigned int i01 = i00 + rowLength;
+			unsigned int i11 = i01 + 1;
+
+			*index++ = i00; *index++ = i10; *index++ = i01;
+			*index++ = i10; *index++ = i11; *index++ = i01;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// An icosahedron with each face split into a triangular grid
+// and pushed out onto the sphere.  Faces don't share vertices
+// (that's what lets each face fix up its own UV seam), so the
+// points along shared edges are summed in a fixed order to
+// come out bit-identical on both sides and avoid cracks.
+// --------------------------------------------------------
+void ProceduralMesh::IcoSphere(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int frequency)
+{
+	frequency = std::max(frequency, 1u);
+
+	const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+	XMFLOAT3 corners[12] = {
+		XMFLOAT3(-1, t, 0), XMFLOAT3(1, t, 0), XMFLOAT3(-1, -t, 0), XMFLOAT3(1, -t, 0),
+		XMFLOAT3(0, -1, t), XMFLOAT3(0, 1, t), XMFLOAT3(0, -1, -t), XMFLOAT3(0, 1, -t),
+		XMFLOAT3(t, 0, -1), XMFLOAT3(t, 0, 1), XMFLOAT3(-t, 0, -1), XMFLOAT3(-t, 0, 1) };
+	for (auto& c : corners)
+		c = Normalize(c);
+
+	unsigned int faces[20][3] = {
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 } };
+
+	unsigned int vertsPerFace = (frequency + 1) * (frequency + 2) / 2;
+	verts.resize(vertsPerFace * 20);
+	indices.resize(frequency * frequency * 3 * 20);
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+
+	for (unsigned int f = 0; f < 20; f++)
+	{
+		unsigned int a = faces[f][0];
+		unsigned int b = faces[f][1];
+		unsigned int c = faces[f][2];
+
+		// Make sure the face winds clockwise from outside
+		XMFLOAT3 faceNormal = Cross(Add(corners[b], Scale(corners[a], -1)), Add(corners[c], Scale(corners[a], -1)));
+		if (Dot(faceNormal, Add(corners[a], Add(corners[b], corners[c]))) < 0)
+			std::swap(b, c);
+
+		// Rows go from corner a to the b-c edge, with j moving from b towards c
+		Vertex* faceVerts = vert;
+		float minU = 1.0f;
+		float maxU = 0.0f;
+		for (unsigned int i = 0; i <= frequency; i++)
+		{
+			for (unsigned int j = 0; j <= i; j++)
+			{
+				// Weights sorted by corner index so shared edges sum identically
+				std::pair<unsigned int, float> weights[3] = {
+					{ a, (float)(frequency - i) / frequency },
+					{ b, (float)(i - j) / frequency },
+					{ c, (float)j / frequency } };
+				std::sort(weights, weights + 3, [](auto& l, auto& r) { return l.first < r.first; });
+
+				XMFLOAT3 p = Scale(corners[weights[0].first], weights[0].second);
+				p = Add(p, Scale(corners[weights[1].first], weights[1].second));
+				p = Add(p, Scale(corners[weights[2].first], weights[2].second));
+				p = Normalize(p);
+
+				float u = atan2f(p.z, p.x) / XM_2PI;
+				if (u < 0) u += 1.0f;
+
+				vert->Normal = p;
+				vert->Position = Scale(p, 0.5f);
+				vert->UV = XMFLOAT2(u, acosf(std::max(-1.0f, std::min(1.0f, p.y))) / XM_PI);
+				vert++;
+
+				minU = std::min(minU, u);
+				maxU = std::max(maxU, u);
+			}
+		}
+
+		// Faces that straddle the seam get their low side wrapped past 1
+		bool wraps = maxU - minU > 0.5f;
+		float sumU = 0.0f;
+		unsigned int countU = 0;
+		for (Vertex* v = faceVerts; v != vert; v++)
+		{
+			bool pole = v->Normal.x * v->Normal.x + v->Normal.z * v->Normal.z < 1e-10f;
+			if (wraps && v->UV.x < 0.5f) v->UV.x += 1.0f;
+			if (!pole) { sumU += v->UV.x; countU++; }
+		}
+
+		// Poles have no longitude of their own, so borrow the face's
+		for (Vertex* v = faceVerts; v != vert; v++)
+		{
+			if (v->Normal.x * v->Normal.x + v->Normal.z * v->Normal.z < 1e-10f)
+				v->UV.x = sumU / countU;
+			v->Tangent = LongitudeTangent(v->UV.x * XM_2PI);
+		}
+
+		// Triangles, in the same orientation as a-b-c
+		unsigned int baseVertex = f * vertsPerFace;
+		for (unsigned int i = 0; i < frequency; i++)
+		{
+			unsigned int row = baseVertex + i * (i + 1) / 2;
+			unsigned int nextRow = baseVertex + (i + 1) * (i + 2) / 2;
+			for (unsigned int j = 0; j <= i; j++)
+			{
+				*index++ = row + j; *index++ = nextRow + j; *index++ = nextRow + j + 1;
+				if (j < i)
+				{
+					*index++ = row + j; *index++ = nextRow + j + 1; *index++ = row + j + 1;
+				}
+			}
+		}
+	}
+}
+
+void ProceduralMesh::Torus(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segments, unsigned int sides, float majorRadius, float minorRadius)
+{
+	segments = std::max(segments, 3u);
+	sides = std::max(sides, 3u);
+	verts.resize(GridVertexCount(segments, sides));
+	indices.resize(GridIndexCount(segments, sides));
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+	unsigned int baseVertex = 0;
+
+	// U around the Y axis, V around the tube starting on the outside and heading down
+	WriteGrid(vert, index, baseVertex, segments, sides, [=](float u, float v, Vertex& out)
+	{
+		float ringAngle = u * XM_2PI;
+		float tubeAngle = v * XM_2PI;
+		XMFLOAT3 outward(cosf(ringAngle), 0, sinf(ringAngle));
+
+		out.Normal = Add(Scale(outward, cosf(tubeAngle)), XMFLOAT3(0, -sinf(tubeAngle), 0));
+		out.Position = Add(Scale(outward, majorRadius), Scale(out.Normal, minorRadius));
+		out.UV = XMFLOAT2(u, v);
+		out.Tangent = LongitudeTangent(ringAngle);
+	});
+}
+
+void ProceduralMesh::Cylinder(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segments, unsigned int stacks)
+{
+	segments = std::max(segments, 3u);
+	stacks = std::max(stacks, 1u);
+	verts.resize(GridVertexCount(segments, stacks) + (segments + 1) * 2);
+	indices.resize(GridIndexCount(segments, stacks) + segments * 3 * 2);
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+	unsigned int baseVertex = 0;
+
+	// Side, from the top down
+	WriteGrid(vert, index, baseVertex, segments, stacks, [](float u, float v, Vertex& out)
+	{
+		float angle = u * XM_2PI;
+		out.Normal = XMFLOAT3(cosf(angle), 0, sinf(angle));
+		out.Position = XMFLOAT3(out.Normal.x * 0.5f, 0.5f - v, out.Normal.z * 0.5f);
+		out.UV = XMFLOAT2(u, v);
+		out.Tangent = LongitudeTangent(angle);
+	});
+
+	// Caps are a fan around a center vertex, textured with a top-down
+	// projection so the rim needs no seam vertex
+	for (unsigned int cap = 0; cap < 2; cap++)
+	{
+		float y = cap == 0 ? 0.5f : -0.5f;
+		unsigned int center = baseVertex;
+		for (unsigned int x = 0; x <= segments; x++)
+		{
+			// The center first, then the rim
+			float angle = (float)(x - 1) / segments * XM_2PI;
+			vert->Position = x == 0 ? XMFLOAT3(0, y, 0) : XMFLOAT3(cosf(angle) * 0.5f, y, sinf(angle) * 0.5f);
+			vert->UV = XMFLOAT2(0.5f + vert->Position.x, cap == 0 ? 0.5f - vert->Position.z : 0.5f + vert->Position.z);
+			vert->Normal = XMFLOAT3(0, cap == 0 ? 1.0f : -1.0f, 0);
+			vert->Tangent = XMFLOAT3(1, 0, 0);
+			vert++;
+		}
+
+		// The top winds the other way round from the bottom so
+		// both face outwards
+		for (unsigned int x = 0; x < segments; x++)
+		{
+			unsigned int rim0 = center + 1 + x;
+			unsigned int rim1 = center + 1 + (x + 1) % segments;
+			if (cap == 0) { *index++ = center; *index++ = rim1; *index++ = rim0; }
+			else { *index++ = rim0; *index++ = rim1; *index++ = center; }
+		}
+		baseVertex += segments + 1;
+	}
+}
+
+// --------------------------------------------------------
+// A tube swept along a helix around the Y axis.  The frame
+// around the curve is its tangent, the direction away from
+// the axis and the cross of the two, which is exact for a
+// helix (no twisting to correct for).
+// --------------------------------------------------------
+void ProceduralMesh::Helix(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segmentsPerTurn, unsigned int sides, unsigned int turns)
+{
+	segmentsPerTurn = std::max(segmentsPerTurn, 3u);
+	sides = std::max(sides, 3u);
+	turns = std::max(turns, 1u);
+
+	unsigned int segments = segmentsPerTurn * turns;
+	verts.resize(GridVertexCount(segments, sides));
+	indices.resize(GridIndexCount(segments, sides));
+
+	Vertex* vert = verts.data();
+	unsigned int* index = indices.data();
+	unsigned int baseVertex = 0;
+
+	const float coilRadius = 0.35f;
+	const float tubeRadius = 0.1f;
+	const float height = 1.0f - tubeRadius * 2.0f;
+	const float totalAngle = turns * XM_2PI;
+
+	WriteGrid(vert, index, baseVertex, segments, sides, [=](float u, float v, Vertex& out)
+	{
+		float angle = u * totalAngle;
+		XMFLOAT3 outward(cosf(angle), 0, sinf(angle));
+		XMFLOAT3 center(outward.x * coilRadius, (u - 0.5f) * height, outward.z * coilRadius);
+		XMFLOAT3 along = Normalize(XMFLOAT3(-outward.z * coilRadius * totalAngle, height, outward.x * coilRadius * totalAngle));
+		XMFLOAT3 side = Cross(outward, along);
+
+		float tubeAngle = v * XM_2PI;
+		out.Normal = Add(Scale(outward, cosf(tubeAngle)), Scale(side, sinf(tubeAngle)));
+		out.Position = Add(center, Scale(out.Normal, tubeRadius));
+		out.UV = XMFLOAT2(u * turns, v);
+		out.Tangent = along;
+	});
+}
+
+bool ProceduralMesh::Generate(std::string name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	// Optional ":N" for the tessellation
+	unsigned int detail = 0;
+	size_t colon = name.find(':');
+	if (colon != std::string::npos)
+	{
+		detail = (unsigned int)strtoul(name.c_str() + colon + 1, 0, 10);
+		name = name.substr(0, colon);
+	}
+
+	if (name == "plane") Plane(verts, indices, detail ? detail : 1);
+	else if (name == "cube") Cube(verts, indices, detail ? detail : 1);
+	else if (name == "sphere") UVSphere(verts, indices, detail ? detail : 32, detail ? std::max(detail / 2, 2u) : 16);
+	else if (name == "icosphere") IcoSphere(verts, indices, detail ? detail : 8);
+	else if (name == "torus") Torus(verts, indices, detail ? detail : 48, detail ? std::max(detail / 2, 3u) : 24);
+	else if (name == "cylinder") Cylinder(verts, indices, detail ? detail : 32);
+	else if (name == "helix") Helix(verts, indices, detail ? detail : 48);
+	else return false;
+
+	return true;
+}
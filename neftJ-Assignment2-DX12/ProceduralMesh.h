@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+// Prefix for mesh names that Assets builds here instead of loading
+#define PROCEDURAL_MESH_PREFIX	"builtin:"
+
+// --------------------------------------------------------
+// Builds simple shapes straight into vertex and index arrays,
+// so they don't need a file (or a parser) at all.
+//
+// Every shape fits in a unit box around the origin, uses our
+// left-handed space and clockwise winding, and comes with
+// analytic normals and tangents (the direction of increasing
+// U), so the mesh doesn't have to calculate them.  The arrays
+// are sized once up front and never grow.
+// --------------------------------------------------------
+class ProceduralMesh
+{
+public:
+	static void Plane(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int subdivisions = 1);
+	static void Cube(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int subdivisions = 1);
+	static void UVSphere(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segments = 32, unsigned int rings = 16);
+	static void IcoSphere(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int frequency = 8);
+	static void Torus(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segments = 48, unsigned int sides = 24, float majorRadius = 0.35f, float minorRadius = 0.15f);
+	static void Cylinder(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segments = 32, unsigned int stacks = 1);
+	static void Helix(std::vector<Vertex>& verts, std::vector<unsigned int>& indices, unsigned int segmentsPerTurn = 48, unsigned int sides = 16, unsigned int turns = 3);
+
+	// Builds a shape by name, such as "sphere" or "sphere:64", where the
+	// optional number is the shape's main tessellation setting
+	static bool Generate(std::string name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+};
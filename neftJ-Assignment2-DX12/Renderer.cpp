@@ -1,5 +1,8 @@
 #include "Renderer.h"
 
+#include <algorithm>
+#include <chrono>
+
 Renderer::Renderer(
 	HWND hWnd,
 	Microsoft::WRL::ComPtr<ID3D12Device> device,
@@ -34,6 +37,11 @@ Renderer::Renderer(
 	this->width = width;
 	this->height = height;
 	this->currentSwapBuffer = 0;
+	this->boundGeometryFormat = -1;
+	this->depthPrepass = true;
+	this->stats = {};
+	this->scatterInstanceAddress = 0;
+	this->scatterInstanceCapacity = 0;
 
 	// Create ImGUI interface
 	engineGUI = std::make_shared<EngineGUI>(hWnd, device, commandList);
@@ -78,20 +86,131 @@ void Renderer::PostResize(unsigned int windowWidth, unsigned int windowHeight, M
 	Assets::GetInstance().ReloadAllRTVs();
 }
 
-void Renderer::Update(float deltaTime, float totalTime, std::vector<std::shared_ptr<GameEntity>> entities, std::shared_ptr<Sky> skyBox, std::vector<Light> lights, int lightCount)
+// --------------------------------------------------------
+// Makes the grid's index buffer and the height buffer, and
+// uploads the overview.  The height buffer is read as a
+// typed (R16_UNORM) buffer, so heights arrive as 0 to 1.
+// --------------------------------------------------------
+void Renderer::SetTerrain(std::shared_ptr<Terrain> terrain)
+{
+	this->terrain = terrain;
+	if (!terrain)
+		return;
+
+	if (!terrainIndexBuffer)
+	{
+		std::vector<uint32_t> indices;
+		Terrain::BuildGridIndices(indices);
+		terrainIndexBuffer = DX12Helper::GetInstance().CreateStaticBuffer(sizeof(uint32_t), (unsigned int)indices.size(), indices.data());
+		terrainIndexBufferView.BufferLocation = terrainIndexBuffer->GetGPUVirtualAddress();
+		terrainIndexBufferView.Format = DXGI_FORMAT_R32_UINT;
+		terrainIndexBufferView.SizeInBytes = (UINT)(indices.size() * sizeof(uint32_t));
+	}
+
+	UINT64 slotSamples = (UINT64)TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES;
+	if (!terrainHeights)
+	{
+		UINT64 numSamples = slotSamples * (TERRAIN_MAX_RESIDENT_TILES + 1);
+		terrainHeights = DX12Helper::GetInstance().CreateBuffer(numSamples * sizeof(uint16_t), D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_R16_UNORM;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = (UINT)numSamples;
+
+		D3D12_HANDLE_BUNDLE handles = DX12Helper::GetInstance().GetNextCBVSRVHeapLocationHandles();
+		device->CreateShaderResourceView(terrainHeights.Get(), &srvDesc, handles.cpuHandle);
+		terrainHeightsHandle = handles.gpuHandle;
+	}
+
+	const std::vector<uint16_t>& overview = terrain->GetOverview();
+	DX12Helper::GetInstance().UploadBufferRegion(
+		terrainHeights,
+		0,
+		(void*)overview.data(),
+		overview.size() * sizeof(uint16_t),
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+}
+
+// --------------------------------------------------------
+// Makes the instance buffer, an upload buffer that's mapped
+// once and read as a structured buffer of ScatterInstances
+// --------------------------------------------------------
+void Renderer::SetScatter(std::shared_ptr<InstanceScatter> scatter)
+{
+	this->scatter = scatter;
+	if (!scatter || scatterInstanceBuffer)
+		return;
+
+	// The view keeps this descriptor even when the buffer is replaced
+	scatterInstancesHandles = DX12Helper::GetInstance().GetNextCBVSRVHeapLocationHandles();
+	CreateScatterInstanceBuffer(SCATTER_INITIAL_VISIBLE);
+}
+
+// --------------------------------------------------------
+// (Re)creates the scattered instance buffer and points its
+// view at it.  Only called while the GPU is idle.
+// --------------------------------------------------------
+void Renderer::CreateScatterInstanceBuffer(size_t capacity)
+{
+	scatterInstanceBuffer = DX12Helper::GetInstance().CreateBuffer(capacity * sizeof(ScatterInstance), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	scatterInstanceCapacity = capacity;
+
+	// Upload heaps can stay mapped for their whole life
+	D3D12_RANGE readRange = { 0, 0 };
+	scatterInstanceBuffer->Map(0, &readRange, &scatterInstanceAddress);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = (UINT)capacity;
+	srvDesc.Buffer.StructureByteStride = sizeof(ScatterInstance);
+	device->CreateShaderResourceView(scatterInstanceBuffer.Get(), &srvDesc, scatterInstancesHandles.cpuHandle);
+}
+
+void Renderer::Update(float deltaTime, float totalTime, std::shared_ptr<EntityManager> entities, std::shared_ptr<Sky> skyBox, std::vector<Light> lights, int lightCount)
 {
 	this->allEntities = entities;
 	this->skyBox = skyBox;
 	this->lights = lights;
 	this->lightCount = lightCount;
 
-	this->SortEntityVectors();
+	this->GatherRenderItems();
+
+	// Tiles that finished streaming in go up before anything's recorded
+	// for the frame, as uploads submit the command list
+	if (terrain && terrainHeights)
+	{
+		terrain->TakeFilledSlots(terrainFilledSlots);
+		if (!terrainFilledSlots.empty())
+		{
+			UINT64 slotBytes = (UINT64)TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES * sizeof(uint16_t);
+			DX12Helper::GetInstance().BeginUploadBatch();
+			for (unsigned int slot : terrainFilledSlots)
+			{
+				DX12Helper::GetInstance().UploadBufferRegion(
+					terrainHeights,
+					(slot + 1) * slotBytes,
+					(void*)terrain->GetSlotSamples(slot),
+					slotBytes,
+					D3D12_RESOURCE_STATE_GENERIC_READ);
+			}
+			DX12Helper::GetInstance().EndUploadBatch();
+		}
+	}
 
-	engineGUI->Update(deltaTime, totalTime, width, height, allEntities, lights);
+	engineGUI->Update(deltaTime, totalTime, width, height, allEntities, lights, stats);
 }
 
 void Renderer::Render(std::shared_ptr<Camera> camera, float deltaTime, float totalTime)
 {
+	auto frameStart = std::chrono::high_resolution_clock::now();
+	stats.draws = 0;
+
 	// Grab the current back buffer for this frame
 	Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer = backBuffers[currentSwapBuffer];
 
@@ -127,12 +246,28 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float deltaTime, float tot
 
 	ClearRenderTargets();
 
+	// Nothing is bound on a freshly reset command list
+	boundGeometryFormat = -1;
+
+	// Rebuild every matrix that changed this frame in one batch, rather
+	// than one at a time as each draw asks for them
+	TransformStore::GetInstance().UpdateDirty();
+
+	// Only what the camera can see gets sorted into the passes
+	CullEntities(camera);
+	SortEntityVectors();
+	stats.items = (unsigned int)visibleItems.size();
+
 	// Do our engine rendering passes here
 	{
 		if (skyBox->GetIBLCreationState() == false) skyBox->CreateIBLResources();
+		if (depthPrepass) DepthPrepass(camera);
 		StandardEntities(camera, deltaTime, totalTime);
 		PbrEntities(camera, deltaTime, totalTime);
+		TerrainNodes(camera);
+		ScatterInstances(camera);
 		skyBox->Draw(camera);
+		boundGeometryFormat = -1; // The sky binds its own buffers
 		TransparentEntities(camera, deltaTime, totalTime);
 		RefractiveEntities(camera, deltaTime, totalTime);
 		Emitters(camera, deltaTime, totalTime);
@@ -153,6 +288,10 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float deltaTime, float tot
 		rb.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
 		commandList->ResourceBarrier(1, &rb);
 		
+		stats.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+		stats.constantBuffers = DX12Helper::GetInstance().GetConstantBufferFillCount();
+		stats.maxConstantBuffers = DX12Helper::GetInstance().GetMaxConstantBuffers();
+
 		// Must occur BEFORE present
 		DX12Helper::GetInstance().CloseExecuteAndResetCommandList();
 
@@ -166,6 +305,101 @@ void Renderer::Render(std::shared_ptr<Camera> camera, float deltaTime, float tot
 	}
 }
 
+// --------------------------------------------------------
+// Pulls everything drawable out of the ECS for this frame
+// --------------------------------------------------------
+void Renderer::GatherRenderItems()
+{
+	renderItems.clear();
+	allEntities->ForEachChunk<TransformComponent, MeshRendererComponent>(
+		[&](unsigned int count, Entity* entities, TransformComponent* transforms, MeshRendererComponent* renderers)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				renderItems.push_back({ renderers[i].mesh, renderers[i].material, transforms[i].id, entities[i] });
+		});
+
+	occluderItems.clear();
+	allEntities->ForEachChunk<TransformComponent, OccluderComponent>(
+		[&](unsigned int count, Entity* entities, TransformComponent* transforms, OccluderComponent* occluders)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				occluderItems.push_back({ occluders[i].mesh, transforms[i].id });
+		});
+}
+
+// --------------------------------------------------------
+// Tests each item's mesh bounding sphere (moved to world
+// space) against the camera's frustum, then tests the box
+// of whatever's left against the occluders.  This needs
+// the world matrices, so it runs after the transform update.
+//
+// In big scenes, entities in the spatial index are culled
+// by one query of its tree instead, which skips whole
+// subtrees out of view; only the rest go to the culler.
+// --------------------------------------------------------
+void Renderer::CullEntities(std::shared_ptr<Camera> camera)
+{
+	TransformStore& store = TransformStore::GetInstance();
+	Frustum frustum = Frustum::FromViewProjection(camera->GetView(), camera->GetProjection());
+
+	bool useIndex = spatialIndex && renderItems.size() >= RENDERER_INDEX_CULL_MIN;
+	if (useIndex)
+	{
+		indexVisible.clear();
+		spatialIndex->QueryFrustum(frustum, indexVisible);
+		std::fill(entityInView.begin(), entityInView.end(), (uint8_t)0);
+		for (uint32_t entityIndex : indexVisible)
+		{
+			if (entityIndex >= entityInView.size())
+				entityInView.resize(entityIndex + 1, 0);
+			entityInView[entityIndex] = 1;
+		}
+	}
+
+	visibleItems.clear();
+	culledItems.clear();
+	culler.Clear();
+	culler.Reserve((unsigned int)renderItems.size());
+	for (uint32_t i = 0; i < (uint32_t)renderItems.size(); i++)
+	{
+		const RenderItem& item = renderItems[i];
+		if (useIndex && allEntities->Has<SpatialComponent>(item.entity))
+		{
+			if (item.entity.index < entityInView.size() && entityInView[item.entity.index])
+				visibleItems.push_back(i);
+			continue;
+		}
+
+		DirectX::BoundingSphere sphere;
+		item.mesh->GetBoundingSphere().Transform(sphere, DirectX::XMLoadFloat4x4(&store.GetWorldMatrix(item.transform)));
+		culler.Add(sphere.Center, sphere.Radius);
+		culledItems.push_back(i);
+	}
+
+	culler.Cull(frustum, culledVisible);
+	for (uint32_t slot : culledVisible)
+		visibleItems.push_back(culledItems[slot]);
+
+	if (occluderItems.empty())
+		return;
+
+	occlusionCuller.BeginFrame(camera->GetView(), camera->GetProjection());
+	for (OccluderItem& occluder : occluderItems)
+		occlusionCuller.AddOccluder(*occluder.mesh, store.GetWorldMatrix(occluder.transform));
+	occlusionCuller.Rasterize();
+
+	size_t kept = 0;
+	for (uint32_t index : visibleItems)
+	{
+		const RenderItem& item = renderItems[index];
+		DirectX::BoundingBox box;
+		item.mesh->GetAABB().Transform(box, DirectX::XMLoadFloat4x4(&store.GetWorldMatrix(item.transform)));
+		if (occlusionCuller.IsVisible(box))
+			visibleItems[kept++] = index;
+	}
+	visibleItems.resize(kept);
+}
+
 void Renderer::SortEntityVectors()
 {
 	// Clear all of our entity vectors first to avoid any duplicates
@@ -174,30 +408,135 @@ void Renderer::SortEntityVectors()
 	transparentEntities.clear();
 	refractiveEntities.clear();
 
-	for (auto& e : allEntities)
+	// Looked up once rather than per entity
+	ID3D12PipelineState* basicPSO = Assets::GetInstance().GetPipelineStateObject("basicPSO").Get();
+	ID3D12PipelineState* pbrPSO = Assets::GetInstance().GetPipelineStateObject("pbrPSO").Get();
+	ID3D12PipelineState* transparentPSO = Assets::GetInstance().GetPipelineStateObject("transparentPSO").Get();
+	ID3D12PipelineState* refractivePSO = Assets::GetInstance().GetPipelineStateObject("refractivePSO").Get();
+
+	for (uint32_t index : visibleItems)
 	{
+		const RenderItem& item = renderItems[index];
+
 		// Get the pso from the entitiy and check it to see what type of object it is
-		Microsoft::WRL::ComPtr<ID3D12PipelineState> pso = e->GetMaterial()->GetPipelineState();
+		ID3D12PipelineState* pso = item.material->GetPipelineState().Get();
 
-		if (pso == Assets::GetInstance().GetPipelineStateObject("basicPSO"))
+		if (pso == basicPSO)
 		{
-			standardEntities.push_back(e);
+			standardEntities.push_back(item);
 		}
-		else if (pso == Assets::GetInstance().GetPipelineStateObject("pbrPSO"))
+		else if (pso == pbrPSO)
 		{
-			pbrEntities.push_back(e);
+			pbrEntities.push_back(item);
 		}
-		else if (pso == Assets::GetInstance().GetPipelineStateObject("transparentPSO"))
+		else if (pso == transparentPSO)
 		{
-			transparentEntities.push_back(e);
+			transparentEntities.push_back(item);
 		}
-		else if (pso == Assets::GetInstance().GetPipelineStateObject("refractivePSO"))
+		else if (pso == refractivePSO)
 		{
-			refractiveEntities.push_back(e);
+			refractiveEntities.push_back(item);
 		}
 	}
 }
 
+// --------------------------------------------------------
+// Binds the shared vertex/index buffers for this mesh's vertex
+// format, skipping the IA calls if they're already bound
+// --------------------------------------------------------
+void Renderer::BindGeometry(Mesh* mesh)
+{
+	int format = (int)mesh->GetVertexFormat();
+	if (format == boundGeometryFormat)
+		return;
+
+	D3D12_VERTEX_BUFFER_VIEW vbv = mesh->GetVertexBuffer();
+	D3D12_INDEX_BUFFER_VIEW ibv = mesh->GetIndexBuffer();
+
+	commandList->IASetVertexBuffers(0, 1, &vbv);
+	commandList->IASetIndexBuffer(&ibv);
+
+	boundGeometryFormat = format;
+}
+
+// --------------------------------------------------------
+// Renders depth only for the opaque entities.  Meshes with a
+// position stream are drawn from it (12 bytes per vertex);
+// anything else falls back to the full vertex buffer, which
+// works with the same input layout since position comes first.
+// --------------------------------------------------------
+void Renderer::DepthPrepass(std::shared_ptr<Camera> camera)
+{
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pso = Assets::GetInstance().GetPipelineStateObject("depthOnlyPSO");
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSig = Assets::GetInstance().GetRootSig("basicRS");
+	if (!pso || !rootSig)
+		return;
+
+	commandList->SetGraphicsRootSignature(rootSig.Get());
+	commandList->SetPipelineState(pso.Get());
+	currentRootSig = rootSig;
+	currentPSO = pso;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descriptorHeap = DX12Helper::GetInstance().GetCBVSRVDescriptorHeap();
+	commandList->SetDescriptorHeaps(1, descriptorHeap.GetAddressOf());
+
+	// Depth only, no color targets
+	commandList->OMSetRenderTargets(0, 0, false, &dsvHandle);
+	commandList->RSSetViewports(1, &viewport);
+	commandList->RSSetScissorRects(1, &scissorRect);
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Track what's bound so we don't rebind the same buffers every draw.  Position
+	// streams are drawn with their mesh's own index buffer, so that's tracked too.
+	int positionStreamIndexFormat = -1;
+	boundGeometryFormat = -1;
+
+	auto drawEntities = [&](std::vector<RenderItem>& entities)
+	{
+		for (auto& e : entities)
+		{
+			VertexShaderExternalData vsData = {};
+			vsData.World = TransformStore::GetInstance().GetWorldMatrix(e.transform);
+			vsData.WorldInverseTranspose = TransformStore::GetInstance().GetWorldInverseTransposeMatrix(e.transform);
+			vsData.View = camera->GetView();
+			vsData.Projection = camera->GetProjection();
+
+			D3D12_GPU_DESCRIPTOR_HANDLE cbHandleVS = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&vsData), sizeof(VertexShaderExternalData));
+			commandList->SetGraphicsRootDescriptorTable(0, cbHandleVS);
+
+			Mesh* mesh = e.mesh;
+			if (mesh->HasPositionStream())
+			{
+				if (positionStreamIndexFormat != (int)mesh->GetVertexFormat())
+				{
+					D3D12_VERTEX_BUFFER_VIEW vbv = mesh->GetPositionBuffer();
+					D3D12_INDEX_BUFFER_VIEW ibv = mesh->GetIndexBuffer();
+					commandList->IASetVertexBuffers(0, 1, &vbv);
+					commandList->IASetIndexBuffer(&ibv);
+					positionStreamIndexFormat = (int)mesh->GetVertexFormat();
+					boundGeometryFormat = -1;
+				}
+
+				commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, mesh->GetStartIndex(), mesh->GetPositionBaseVertex(), 0);
+				stats.draws++;
+			}
+			else
+			{
+				positionStreamIndexFormat = -1;
+				BindGeometry(mesh);
+				commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, mesh->GetStartIndex(), mesh->GetBaseVertex(), 0);
+				stats.draws++;
+			}
+		}
+	};
+
+	drawEntities(standardEntities);
+	drawEntities(pbrEntities);
+
+	// The position stream isn't a format the other passes know about
+	boundGeometryFormat = -1;
+}
+
 void Renderer::ClearRenderTargets()
 {
 	std::unordered_map<std::string, RtvSrvBundle> rtvSrvBundles = Assets::GetInstance().GetAllRTVs();
@@ -211,7 +550,7 @@ void Renderer::StandardEntities(std::shared_ptr<Camera> camera, float deltaTime,
 {
 	for (auto& e : standardEntities)
 	{
-		std::shared_ptr<Material> mat = e->GetMaterial();
+		Material* mat = e.material;
 
 		// Check if it's a new root sig being put in
 		if (currentRootSig.GetAddressOf() != mat->GetRootSig().GetAddressOf())
@@ -231,15 +570,20 @@ void Renderer::StandardEntities(std::shared_ptr<Camera> camera, float deltaTime,
 		commandList->RSSetScissorRects(1, &scissorRect);
 		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-		if (currentPSO.GetAddressOf() != mat->GetPipelineState().GetAddressOf())
+		// Compact meshes need the pipeline that reads their vertex layout
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pso = mat->GetPipelineState();
+		if (e.mesh->GetVertexFormat() == GEOMETRY_FORMAT_COMPACT)
+			pso = Assets::GetInstance().GetPipelineStateObject("basicCompactPSO");
+
+		if (currentPSO.Get() != pso.Get())
 		{
-			commandList->SetPipelineState(mat->GetPipelineState().Get());
-			currentPSO = mat->GetPipelineState();
+			commandList->SetPipelineState(pso.Get());
+			currentPSO = pso;
 		}
 
 		VertexShaderExternalData vsData = {};
-		vsData.World = e->GetTransform()->GetWorldMatrix();
-		vsData.WorldInverseTranspose = e->GetTransform()->GetWorldInverseTransposeMatrix();
+		vsData.World = TransformStore::GetInstance().GetWorldMatrix(e.transform);
+		vsData.WorldInverseTranspose = TransformStore::GetInstance().GetWorldInverseTransposeMatrix(e.transform);
 		vsData.View = camera->GetView();
 		vsData.Projection = camera->GetProjection();
 
@@ -258,14 +602,11 @@ void Renderer::StandardEntities(std::shared_ptr<Camera> camera, float deltaTime,
 
 		commandList->SetGraphicsRootDescriptorTable(2, mat->GetFinalGPUHandleForSRVs());
 
-		std::shared_ptr<Mesh> mesh = e->GetMesh();
-		D3D12_VERTEX_BUFFER_VIEW vbv = mesh->GetVertexBuffer();
-		D3D12_INDEX_BUFFER_VIEW ibv = mesh->GetIndexBuffer();
-
-		commandList->IASetVertexBuffers(0, 1, &vbv);
-		commandList->IASetIndexBuffer(&ibv);
+		Mesh* mesh = e.mesh;
+		BindGeometry(mesh);
 
-		commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, 0, 0, 0);
+		commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, mesh->GetStartIndex(), mesh->GetBaseVertex(), 0);
+		stats.draws++;
 	}
 }
 
@@ -295,7 +636,7 @@ void Renderer::PbrEntities(std::shared_ptr<Camera> camera, float deltaTime, floa
 
 	for (auto& e : pbrEntities)
 	{
-		std::shared_ptr<Material> mat = e->GetMaterial();
+		Material* mat = e.material;
 
 		// Check if it's a new root sig being put in
 		if (currentRootSig.GetAddressOf() != mat->GetRootSig().GetAddressOf())
@@ -313,15 +654,20 @@ void Renderer::PbrEntities(std::shared_ptr<Camera> camera, float deltaTime, floa
 		commandList->RSSetScissorRects(1, &scissorRect);
 		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-		if (currentPSO.GetAddressOf() != mat->GetPipelineState().GetAddressOf())
+		// Compact meshes need the pipeline that reads their vertex layout
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pso = mat->GetPipelineState();
+		if (e.mesh->GetVertexFormat() == GEOMETRY_FORMAT_COMPACT)
+			pso = Assets::GetInstance().GetPipelineStateObject("pbrCompactPSO");
+
+		if (currentPSO.Get() != pso.Get())
 		{
-			commandList->SetPipelineState(mat->GetPipelineState().Get());
-			currentPSO = mat->GetPipelineState();
+			commandList->SetPipelineState(pso.Get());
+			currentPSO = pso;
 		}
 
 		VertexShaderExternalData vsData = {};
-		vsData.World = e->GetTransform()->GetWorldMatrix();
-		vsData.WorldInverseTranspose = e->GetTransform()->GetWorldInverseTransposeMatrix();
+		vsData.World = TransformStore::GetInstance().GetWorldMatrix(e.transform);
+		vsData.WorldInverseTranspose = TransformStore::GetInstance().GetWorldInverseTransposeMatrix(e.transform);
 		vsData.View = camera->GetView();
 		vsData.Projection = camera->GetProjection();
 
@@ -340,14 +686,187 @@ void Renderer::PbrEntities(std::shared_ptr<Camera> camera, float deltaTime, floa
 
 		commandList->SetGraphicsRootDescriptorTable(3, mat->GetFinalGPUHandleForSRVs());
 
-		std::shared_ptr<Mesh> mesh = e->GetMesh();
-		D3D12_VERTEX_BUFFER_VIEW vbv = mesh->GetVertexBuffer();
-		D3D12_INDEX_BUFFER_VIEW ibv = mesh->GetIndexBuffer();
+		Mesh* mesh = e.mesh;
+		BindGeometry(mesh);
+
+		commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, mesh->GetStartIndex(), mesh->GetBaseVertex(), 0);
+		stats.draws++;
+	}
+}
+
+// --------------------------------------------------------
+// Picks the terrain's nodes for the camera and draws them
+// as instances of the grid, one draw for whole nodes and
+// one for each quarter (TERRAIN_INSTANCES_PER_DRAW at a
+// time).  The grid has no vertex buffer, as the vertex
+// shader works out each vertex from its index.
+// --------------------------------------------------------
+void Renderer::TerrainNodes(std::shared_ptr<Camera> camera)
+{
+	if (!terrain || !terrainHeights)
+		return;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pso = Assets::GetInstance().GetPipelineStateObject("terrainPSO");
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSig = Assets::GetInstance().GetRootSig("terrainRS");
+	if (!pso || !rootSig)
+		return;
+
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	terrain->Select(Frustum::FromViewProjection(camera->GetView(), camera->GetProjection()), cameraPosition, terrainNodes);
+	if (terrainNodes.empty())
+		return;
 
-		commandList->IASetVertexBuffers(0, 1, &vbv);
-		commandList->IASetIndexBuffer(&ibv);
+	commandList->SetGraphicsRootSignature(rootSig.Get());
+	commandList->SetPipelineState(pso.Get());
+	currentRootSig = rootSig;
+	currentPSO = pso;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descriptorHeap = DX12Helper::GetInstance().GetCBVSRVDescriptorHeap();
+	commandList->SetDescriptorHeaps(1, descriptorHeap.GetAddressOf());
+
+	RtvSrvBundle firstCompositeBundle = Assets::GetInstance().GetRenderTargetView("firstComposite");
+	commandList->OMSetRenderTargets(1, &firstCompositeBundle.rtvHandle, true, &dsvHandle);
+	commandList->RSSetViewports(1, &viewport);
+	commandList->RSSetScissorRects(1, &scissorRect);
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList->IASetIndexBuffer(&terrainIndexBufferView);
+	boundGeometryFormat = -1;
+
+	const TerrainDesc& desc = terrain->GetDesc();
+	TerrainVSData vsData = {};
+	vsData.View = camera->GetView();
+	vsData.Projection = camera->GetProjection();
+	vsData.cameraPosition = cameraPosition;
+	vsData.spacing = desc.spacing;
+	vsData.origin = desc.origin;
+	vsData.heightScale = desc.heightScale;
+	vsData.tilesAcross = terrain->GetTilesAcross();
+	vsData.overviewWidth = terrain->GetOverviewWidth();
+	for (unsigned int lod = 0; lod < terrain->GetLodCount(); lod++)
+	{
+		float start, end;
+		terrain->GetMorphRange(lod, start, end);
+		vsData.morphConstants[lod] = XMFLOAT4(end / (end - start), 1.0f / (end - start), 0, 0);
+	}
+	for (unsigned int z = 0; z < vsData.tilesAcross; z++)
+	{
+		for (unsigned int x = 0; x < vsData.tilesAcross; x++)
+			vsData.tileSlots[z * vsData.tilesAcross + x] = terrain->GetTileSlot(x, z) + 1;
+	}
+
+	D3D12_GPU_DESCRIPTOR_HANDLE cbHandleVS = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&vsData), sizeof(TerrainVSData));
+	commandList->SetGraphicsRootDescriptorTable(0, cbHandleVS);
+	commandList->SetGraphicsRootDescriptorTable(2, terrainHeightsHandle);
+
+	PixelShaderExternalData psData = {};
+	psData.cameraPosition = cameraPosition;
+	psData.lightCount = lights.size();
+	memcpy(psData.lights, &lights[0], sizeof(Light) * lights.size());
+
+	D3D12_GPU_DESCRIPTOR_HANDLE cbHandlePS = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&psData), sizeof(PixelShaderExternalData));
+	commandList->SetGraphicsRootDescriptorTable(3, cbHandlePS);
+
+	// Whole nodes draw the entire grid, and quarters one quarter of its indices
+	TerrainNodesData nodeData = {};
+	for (unsigned int quadrant = 0; quadrant <= TERRAIN_WHOLE_NODE; quadrant++)
+	{
+		unsigned int indexCount = Terrain::GetQuadrantIndexCount() * (quadrant == TERRAIN_WHOLE_NODE ? 4 : 1);
+		unsigned int startIndex = quadrant == TERRAIN_WHOLE_NODE ? 0 : Terrain::GetQuadrantIndexCount() * quadrant;
+
+		unsigned int count = 0;
+		for (size_t i = 0; i < terrainNodes.size(); i++)
+		{
+			const TerrainNode& node = terrainNodes[i];
+			if (node.quadrant == quadrant)
+				nodeData.nodes[count++] = XMFLOAT4(node.x, node.z, node.size, (float)node.lod);
+
+			if (count == TERRAIN_INSTANCES_PER_DRAW || (count > 0 && i == terrainNodes.size() - 1))
+			{
+				D3D12_GPU_DESCRIPTOR_HANDLE cbHandleNodes = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&nodeData), sizeof(XMFLOAT4) * count);
+				commandList->SetGraphicsRootDescriptorTable(1, cbHandleNodes);
+				commandList->DrawIndexedInstanced(indexCount, count, startIndex, 0, 0);
+				stats.draws++;
+				count = 0;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Culls the scatter for the camera and draws each layer's
+// visible instances with one instanced draw of its mesh.
+// The vertex shader finds each instance's placement in the
+// instance buffer from its layer's first instance plus
+// SV_InstanceID.
+// --------------------------------------------------------
+void Renderer::ScatterInstances(std::shared_ptr<Camera> camera)
+{
+	if (!scatter || !scatterInstanceAddress)
+		return;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pso = Assets::GetInstance().GetPipelineStateObject("scatterPSO");
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSig = Assets::GetInstance().GetRootSig("scatterRS");
+	if (!pso || !rootSig)
+		return;
+
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	scatter->Cull(Frustum::FromViewProjection(camera->GetView(), camera->GetProjection()), cameraPosition, scatterVisible);
+	if (scatterVisible.instances.empty())
+		return;
+
+	// Nothing from this frame has been recorded against the buffer yet and
+	// the last frame is done with it, so it can grow to fit every instance
+	size_t numInstances = scatterVisible.instances.size();
+	if (numInstances > scatterInstanceCapacity)
+		CreateScatterInstanceBuffer(std::max(numInstances, scatterInstanceCapacity * 2));
+	memcpy(scatterInstanceAddress, scatterVisible.instances.data(), numInstances * sizeof(ScatterInstance));
+
+	commandList->SetGraphicsRootSignature(rootSig.Get());
+	commandList->SetPipelineState(pso.Get());
+	currentRootSig = rootSig;
+	currentPSO = pso;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descriptorHeap = DX12Helper::GetInstance().GetCBVSRVDescriptorHeap();
+	commandList->SetDescriptorHeaps(1, descriptorHeap.GetAddressOf());
+
+	RtvSrvBundle firstCompositeBundle = Assets::GetInstance().GetRenderTargetView("firstComposite");
+	commandList->OMSetRenderTargets(1, &firstCompositeBundle.rtvHandle, true, &dsvHandle);
+	commandList->RSSetViewports(1, &viewport);
+	commandList->RSSetScissorRects(1, &scissorRect);
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList->SetGraphicsRootDescriptorTable(1, scatterInstancesHandles.gpuHandle);
+
+	PixelShaderExternalData psData = {};
+	psData.cameraPosition = cameraPosition;
+	psData.lightCount = lights.size();
+	memcpy(psData.lights, &lights[0], sizeof(Light) * lights.size());
+
+	D3D12_GPU_DESCRIPTOR_HANDLE cbHandlePS = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&psData), sizeof(PixelShaderExternalData));
+	commandList->SetGraphicsRootDescriptorTable(2, cbHandlePS);
+
+	for (unsigned int l = 0; l < scatter->GetLayerCount(); l++)
+	{
+		const ScatterLayer& layer = scatter->GetLayer(l);
+		uint32_t first = scatterVisible.layerFirst[l];
+		uint32_t last = scatterVisible.layerFirst[l + 1];
+
+		// The pipeline only takes full vertices
+		if (first >= last || !layer.mesh || layer.mesh->GetVertexFormat() != GEOMETRY_FORMAT_STANDARD)
+			continue;
+
+		ScatterVSData vsData = {};
+		vsData.View = camera->GetView();
+		vsData.Projection = camera->GetProjection();
+		vsData.meshScale = layer.meshScale;
+		vsData.firstInstance = first;
+		vsData.color = layer.color;
+
+		D3D12_GPU_DESCRIPTOR_HANDLE cbHandleVS = DX12Helper::GetInstance().FillNextConstantBufferAndGetGPUDescriptorHandle((void*)(&vsData), sizeof(ScatterVSData));
+		commandList->SetGraphicsRootDescriptorTable(0, cbHandleVS);
 
-		commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, 0, 0, 0);
+		BindGeometry(layer.mesh);
+		commandList->DrawIndexedInstanced(layer.mesh->GetIndexCount(), last - first, layer.mesh->GetStartIndex(), layer.mesh->GetBaseVertex(), 0);
+		stats.draws++;
 	}
 }
 
@@ -7,13 +7,42 @@
 #include <vector>
 #include <stdlib.h>
 
-#include "GameEntity.h"
+#include "EntityManager.h"
+#include "Components.h"
+#include "Mesh.h"
+#include "Material.h"
 #include "Sky.h"
 #include "Camera.h"
 #include "DX12Helper.h"
 #include "Assets.h"
 #include "Structs.h"
+#include "TransformStore.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
 #include "EngineGUI.h"
+#include "Terrain.h"
+#include "InstanceScatter.h"
+#include "SpatialIndex.h"
+
+// With at least this many render items, the ones in the spatial index
+// are culled with one query of it instead of being tested one by one
+#define RENDERER_INDEX_CULL_MIN	2048
+
+// One entity's worth of drawing, gathered from the ECS each frame
+struct RenderItem
+{
+	Mesh* mesh;
+	Material* material;
+	uint32_t transform;
+	Entity entity;
+};
+
+// Something that hides what's behind it, gathered alongside the render items
+struct OccluderItem
+{
+	OccluderMesh* mesh;
+	uint32_t transform;
+};
 
 class Renderer
 {
@@ -44,20 +73,44 @@ public:
 		D3D12_RECT scissorRect);
 	void Update(
 		float deltaTime, float totalTime,
-		std::vector<std::shared_ptr<GameEntity>> entities,
+		std::shared_ptr<EntityManager> entities,
 		std::shared_ptr<Sky> skyBox,
 		std::vector<Light> lights,
 		int lightCount);
 	void Render(std::shared_ptr<Camera> camera, float deltaTime, float totalTime);
 
+	// Lays down depth for opaque entities first so the shading passes only run once per pixel
+	void SetDepthPrepass(bool enabled) { depthPrepass = enabled; }
+	bool GetDepthPrepass() { return depthPrepass; }
+
+	// Counts and timing from the last frame
+	RenderStats GetStats() { return stats; }
+
+	// Draws this terrain (nothing when it's null), keeping its resident tiles on the GPU
+	void SetTerrain(std::shared_ptr<Terrain> terrain);
+
+	// Draws this scatter's instances (nothing when it's null)
+	void SetScatter(std::shared_ptr<InstanceScatter> scatter);
+
+	// Culls entities with a SpatialComponent in this index by querying it,
+	// once there are enough render items for that to beat testing each one
+	void SetSpatialIndex(std::shared_ptr<SpatialIndex> index) { spatialIndex = index; }
+
 private:
 	// Methods
+	void GatherRenderItems();
+	void CullEntities(std::shared_ptr<Camera> camera);
 	void SortEntityVectors();
 	void ClearRenderTargets();
+	void BindGeometry(Mesh* mesh);
+	void CreateScatterInstanceBuffer(size_t capacity);
 
 	// Rendering passes (as methods)
+	void DepthPrepass(std::shared_ptr<Camera> camera);
 	void StandardEntities(std::shared_ptr<Camera> camera, float deltaTime, float totalTime);
 	void PbrEntities(std::shared_ptr<Camera> camera, float deltaTime, float totalTime);
+	void TerrainNodes(std::shared_ptr<Camera> camera);
+	void ScatterInstances(std::shared_ptr<Camera> camera);
 	void TransparentEntities(std::shared_ptr<Camera> camera, float deltaTime, float totalTime);
 	void RefractiveEntities(std::shared_ptr<Camera> camera, float deltaTime, float totalTime);
 	void Emitters(std::shared_ptr<Camera> camera, float deltaTime, float totalTime);
@@ -81,6 +134,9 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> currentRootSig;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> currentPSO;
+	int boundGeometryFormat;
+	bool depthPrepass;
+	RenderStats stats;
 
 	unsigned int width;
 	unsigned int height;
@@ -90,11 +146,49 @@ private:
 	std::vector<Light> lights;
 	unsigned int lightCount;
 
-	std::vector<std::shared_ptr<GameEntity>> allEntities;
-	std::vector<std::shared_ptr<GameEntity>> standardEntities;
-	std::vector<std::shared_ptr<GameEntity>> pbrEntities;
-	std::vector<std::shared_ptr<GameEntity>> transparentEntities;
-	std::vector<std::shared_ptr<GameEntity>> refractiveEntities;
+	std::shared_ptr<EntityManager> allEntities;
+	std::vector<RenderItem> renderItems;
+	std::vector<RenderItem> standardEntities;
+	std::vector<RenderItem> pbrEntities;
+	std::vector<RenderItem> transparentEntities;
+	std::vector<RenderItem> refractiveEntities;
+
+	// Culling, with the indices (into renderItems) of what's in view this frame
+	FrustumCuller culler;
+	std::vector<uint32_t> visibleItems;
+
+	// Items the culler tests one by one (indices into renderItems), and
+	// the entity indices the spatial index found in view
+	std::shared_ptr<SpatialIndex> spatialIndex;
+	std::vector<uint32_t> culledItems;
+	std::vector<uint32_t> culledVisible;
+	std::vector<uint32_t> indexVisible;
+	std::vector<uint8_t> entityInView;
+
+	// Occluders, which take out whatever the frustum kept that's behind them
+	OcclusionCuller occlusionCuller;
+	std::vector<OccluderItem> occluderItems;
+
+	// Terrain, with every node drawn from one index-only grid.  The height
+	// buffer has the overview first and then a slot for each resident tile.
+	std::shared_ptr<Terrain> terrain;
+	Microsoft::WRL::ComPtr<ID3D12Resource> terrainIndexBuffer;
+	D3D12_INDEX_BUFFER_VIEW terrainIndexBufferView;
+	Microsoft::WRL::ComPtr<ID3D12Resource> terrainHeights;
+	D3D12_GPU_DESCRIPTOR_HANDLE terrainHeightsHandle;
+	std::vector<TerrainNode> terrainNodes;
+	std::vector<unsigned int> terrainFilledSlots;
+
+	// Scattered instances, written each frame straight into an upload
+	// buffer that stays mapped.  The last frame's draws are always done
+	// by then, since the end of every frame waits for the GPU, which also
+	// means the buffer (and its view) can be replaced when it's too small.
+	std::shared_ptr<InstanceScatter> scatter;
+	ScatterVisible scatterVisible;
+	Microsoft::WRL::ComPtr<ID3D12Resource> scatterInstanceBuffer;
+	void* scatterInstanceAddress;
+	size_t scatterInstanceCapacity;
+	D3D12_HANDLE_BUNDLE scatterInstancesHandles;
 
 	// GUI
 	std::shared_ptr<EngineGUI> engineGUI;
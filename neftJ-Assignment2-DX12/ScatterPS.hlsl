@@ -0,0 +1,55 @@
+#include "Lighting.hlsli"
+#define MAX_LIGHTS 128
+
+struct VertexToPixel
+{
+	float4 screenPosition : SV_POSITION;
+	float3 normal : NORMAL;
+	float3 worldPos : POSITION;
+	float3 color : COLOR;
+};
+
+// Same layout as PixelShader.hlsl's (the uv adjustments are unused)
+cbuffer ExternalData : register(b0)
+{
+	float2 uvScale;
+	float2 uvOffset;
+	float3 cameraPosition;
+	int lightCount;
+	Light lights[MAX_LIGHTS];
+}
+
+// --------------------------------------------------------
+// The layer's flat color, lit by the scene's lights without
+// any highlights, the same way as the terrain under it
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	input.normal = normalize(input.normal);
+	float3 surfaceColor = pow(input.color, 2.2f);
+
+	// A little light from the sky so nothing is ever black
+	float3 totalLight = surfaceColor * 0.1f;
+	for (int i = 0; i < lightCount; i++)
+	{
+		Light light = lights[i];
+		light.Direction = normalize(light.Direction);
+
+		switch (light.Type)
+		{
+			case LIGHT_TYPE_DIRECTIONAL:
+				totalLight += DirLight(light, input.normal, input.worldPos, cameraPosition, 0.0f, surfaceColor);
+				break;
+
+			case LIGHT_TYPE_POINT:
+				totalLight += PointLight(light, input.normal, input.worldPos, cameraPosition, 0.0f, surfaceColor);
+				break;
+
+			case LIGHT_TYPE_SPOT:
+				totalLight += SpotLight(light, input.normal, input.worldPos, cameraPosition, 0.0f, surfaceColor);
+				break;
+		}
+	}
+
+	return float4(pow(totalLight, 1.0f / 2.2f), 1.0f);
+}
\ No newline at end of file
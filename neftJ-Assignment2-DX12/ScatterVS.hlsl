@@ -0,0 +1,62 @@
+struct VertexShaderInput
+{
+	float3 localPosition : POSITION;
+	float2 uv : TEXCOORD;
+	float3 normal : NORMAL;
+	float3 tangent : TANGENT;
+};
+
+struct VertexToPixel
+{
+	float4 screenPosition : SV_POSITION;
+	float3 normal : NORMAL;
+	float3 worldPos : POSITION;
+	float3 color : COLOR;
+};
+
+// Matches ScatterVSData in BufferStructs.h
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float3 meshScale;
+	uint firstInstance;
+	float3 color;
+	float padding;
+}
+
+// Matches ScatterInstance in InstanceScatter.h
+struct Instance
+{
+	float3 position;
+	float yaw;
+	float scale;
+};
+
+// Every visible instance this frame, each layer's together
+StructuredBuffer<Instance> instances : register(t0);
+
+// --------------------------------------------------------
+// Shapes the mesh by its layer's scale, then scales, turns
+// (around Y) and moves it by its instance's placement
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input, uint instanceID : SV_InstanceID)
+{
+	VertexToPixel output;
+
+	Instance instance = instances[firstInstance + instanceID];
+	float s, c;
+	sincos(instance.yaw, s, c);
+
+	float3 local = input.localPosition * meshScale * instance.scale;
+	output.worldPos = instance.position + float3(local.x * c + local.z * s, local.y, local.z * c - local.x * s);
+
+	// Normals take the inverse of the shape's scale
+	float3 normal = input.normal / meshScale;
+	output.normal = float3(normal.x * c + normal.z * s, normal.y, normal.z * c - normal.x * s);
+
+	output.screenPosition = mul(projection, mul(view, float4(output.worldPos, 1.0f)));
+	output.color = color;
+
+	return output;
+}
\ No newline at end of file
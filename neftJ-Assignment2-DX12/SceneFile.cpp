@@ -0,0 +1,991 @@
+#include "SceneFile.h"
+
+#include <Windows.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include "rapidjson/reader.h"
+#include "rapidjson/istreamwrapper.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/prettywriter.h"
+
+using namespace DirectX;
+
+// The JSON form is read in chunks this big
+#define SCENE_JSON_BUFFER_SIZE	65536
+
+SceneData::SceneData()
+{
+	Clear();
+}
+
+void SceneData::Clear()
+{
+	meshNames.clear();
+	meshFlags.clear();
+	materialNames.clear();
+	lodNames.clear();
+	lodFirst.clear();
+	lodCount.clear();
+	lodMeshes.clear();
+	lodErrors.clear();
+	meshes.clear();
+	materials.clear();
+	lods.clear();
+	flags.clear();
+	spins.clear();
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	lights.clear();
+
+	camera.position = XMFLOAT3(0, 0, 0);
+	camera.rotation = XMFLOAT3(0, 0, 0);
+	camera.moveSpeed = 5.0f;
+	camera.lookSpeed = 1.0f;
+}
+
+// --------------------------------------------------------
+// SAX handler for the JSON form.  A stack says what the
+// parser is inside of, and the last key says what a value
+// is for.  Anything it doesn't know is skipped over, and
+// whole entities (and the rest) are only added once their
+// object ends, as keys can come in any order.
+// --------------------------------------------------------
+class SceneJsonHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, SceneJsonHandler>
+{
+public:
+	SceneJsonHandler(SceneData& scene) : scene(scene)
+	{
+		numbers = 0;
+		numberCount = 0;
+		finished = false;
+	}
+
+	bool StartObject();
+	bool EndObject(rapidjson::SizeType memberCount);
+	bool StartArray();
+	bool EndArray(rapidjson::SizeType elementCount);
+	bool Key(const char* str, rapidjson::SizeType length, bool copy);
+	bool String(const char* str, rapidjson::SizeType length, bool copy);
+	bool Bool(bool b);
+	bool Null() { return State() != JsonState::Numbers; }
+	bool Int(int i) { return Number(i); }
+	bool Uint(unsigned u) { return Number(u); }
+	bool Int64(int64_t i) { return Number((double)i); }
+	bool Uint64(uint64_t u) { return Number((double)u); }
+	bool Double(double d) { return Number(d); }
+
+	// True if the whole file was read and every LOD chain used was given levels
+	bool Finish();
+
+private:
+	enum class JsonState { Start, Root, Camera, MeshList, Mesh, LodList, Lod, LevelList, Level, LightList, Light, EntityList, Entity, Numbers, Skip };
+
+	SceneData& scene;
+	std::vector<JsonState> states;
+	std::string key;
+	bool finished;
+
+	std::unordered_map<std::string, uint32_t> meshIds;
+	std::unordered_map<std::string, uint32_t> materialIds;
+	std::unordered_map<std::string, uint32_t> lodIds;
+
+	// The array of numbers being read into, always three of them
+	float* numbers;
+	unsigned int numberCount;
+
+	// Whatever object is being read
+	std::string name;
+	uint32_t meshFlags;
+	std::vector<uint32_t> levelMeshes;
+	std::vector<float> levelErrors;
+	uint32_t levelMesh;
+	float levelError;
+	Light light;
+	bool lightTyped;
+	uint32_t entityMesh;
+	uint32_t entityMaterial;
+	uint32_t entityLod;
+	uint32_t entityFlags;
+	float entitySpin;
+	XMFLOAT3 entityPosition;
+	XMFLOAT3 entityRotation;
+	XMFLOAT3 entityScale;
+
+	JsonState State() { return states.empty() ? JsonState::Start : states.back(); }
+	bool Number(double value);
+	float* VectorFor(JsonState state);
+	uint32_t Intern(std::unordered_map<std::string, uint32_t>& ids, std::vector<std::string>& names, const char* str, rapidjson::SizeType length);
+	uint32_t InternMesh(const char* str, rapidjson::SizeType length);
+	uint32_t InternLod(const char* str, rapidjson::SizeType length);
+};
+
+bool SceneJsonHandler::StartObject()
+{
+	JsonState next = JsonState::Skip;
+	switch (State())
+	{
+	case JsonState::Start: next = JsonState::Root; break;
+	case JsonState::Root: if (key == "camera") next = JsonState::Camera; break;
+	case JsonState::Numbers: return false;
+
+	case JsonState::MeshList:
+		next = JsonState::Mesh;
+		name.clear();
+		meshFlags = 0;
+		break;
+
+	case JsonState::LodList:
+		next = JsonState::Lod;
+		name.clear();
+		levelMeshes.clear();
+		levelErrors.clear();
+		break;
+
+	case JsonState::LevelList:
+		next = JsonState::Level;
+		levelMesh = SCENE_NO_LOD;
+		levelError = 0;
+		break;
+
+	case JsonState::LightList:
+		next = JsonState::Light;
+		light = {};
+		light.Direction = XMFLOAT3(0, -1, 0);
+		light.Color = XMFLOAT3(1, 1, 1);
+		light.Intensity = 1.0f;
+		light.Range = 10.0f;
+		lightTyped = false;
+		break;
+
+	case JsonState::EntityList:
+		next = JsonState::Entity;
+		entityMesh = entityMaterial = entityLod = SCENE_NO_LOD;
+		entityFlags = 0;
+		entitySpin = 0;
+		entityPosition = XMFLOAT3(0, 0, 0);
+		entityRotation = XMFLOAT3(0, 0, 0);
+		entityScale = XMFLOAT3(1, 1, 1);
+		break;
+	}
+
+	states.push_back(next);
+	return true;
+}
+
+bool SceneJsonHandler::EndObject(rapidjson::SizeType memberCount)
+{
+	JsonState state = State();
+	states.pop_back();
+	switch (state)
+	{
+	case JsonState::Root:
+		finished = true;
+		break;
+
+	case JsonState::Mesh:
+		if (name.empty()) return false;
+		scene.meshFlags[InternMesh(name.c_str(), (rapidjson::SizeType)name.size())] = meshFlags;
+		break;
+
+	case JsonState::Lod:
+	{
+		if (name.empty() || levelMeshes.empty()) return false;
+
+		// A chain can be used before it's listed, but only listed once
+		uint32_t id = InternLod(name.c_str(), (rapidjson::SizeType)name.size());
+		if (scene.lodCount[id] != 0) return false;
+		scene.lodFirst[id] = (uint32_t)scene.lodMeshes.size();
+		scene.lodCount[id] = (uint32_t)levelMeshes.size();
+		scene.lodMeshes.insert(scene.lodMeshes.end(), levelMeshes.begin(), levelMeshes.end());
+		scene.lodErrors.insert(scene.lodErrors.end(), levelErrors.begin(), levelErrors.end());
+		break;
+	}
+
+	case JsonState::Level:
+		if (levelMesh == SCENE_NO_LOD) return false;
+		levelMeshes.push_back(levelMesh);
+		levelErrors.push_back(levelError);
+		break;
+
+	case JsonState::Light:
+		if (!lightTyped) return false;
+		scene.lights.push_back(light);
+		break;
+
+	case JsonState::Entity:
+		if (entityMesh == SCENE_NO_LOD || entityMaterial == SCENE_NO_LOD) return false;
+		scene.meshes.push_back(entityMesh);
+		scene.materials.push_back(entityMaterial);
+		scene.lods.push_back(entityLod);
+		scene.flags.push_back(entityFlags);
+		scene.spins.push_back(entitySpin);
+		scene.positions.push_back(entityPosition);
+		scene.rotations.push_back(entityRotation);
+		scene.scales.push_back(entityScale);
+		break;
+	}
+
+	return true;
+}
+
+bool SceneJsonHandler::StartArray()
+{
+	JsonState state = State();
+	JsonState next = JsonState::Skip;
+	if (state == JsonState::Start || state == JsonState::Numbers)
+		return false;
+
+	if (state == JsonState::Root)
+	{
+		if (key == "meshes") next = JsonState::MeshList;
+		else if (key == "lodChains") next = JsonState::LodList;
+		else if (key == "lights") next = JsonState::LightList;
+		else if (key == "entities") next = JsonState::EntityList;
+	}
+	else if (state == JsonState::Lod && key == "levels")
+	{
+		next = JsonState::LevelList;
+	}
+	else if (float* vector = VectorFor(state))
+	{
+		next = JsonState::Numbers;
+		numbers = vector;
+		numberCount = 0;
+	}
+
+	states.push_back(next);
+	return true;
+}
+
+bool SceneJsonHandler::EndArray(rapidjson::SizeType elementCount)
+{
+	JsonState state = State();
+	states.pop_back();
+	return state != JsonState::Numbers || numberCount == 3;
+}
+
+bool SceneJsonHandler::Key(const char* str, rapidjson::SizeType length, bool copy)
+{
+	key.assign(str, length);
+	return true;
+}
+
+bool SceneJsonHandler::String(const char* str, rapidjson::SizeType length, bool copy)
+{
+	switch (State())
+	{
+	case JsonState::Numbers:
+		return false;
+
+	case JsonState::Mesh:
+	case JsonState::Lod:
+		if (key == "name") name.assign(str, length);
+		break;
+
+	case JsonState::Level:
+		if (key == "mesh") levelMesh = InternMesh(str, length);
+		break;
+
+	case JsonState::Light:
+	{
+		if (key != "type") break;
+		std::string type(str, length);
+		if (type == "directional") light.Type = LIGHT_TYPE_DIRECTIONAL;
+		else if (type == "point") light.Type = LIGHT_TYPE_POINT;
+		else if (type == "spot") light.Type = LIGHT_TYPE_SPOT;
+		else return false;
+		lightTyped = true;
+		break;
+	}
+
+	case JsonState::Entity:
+		if (key == "mesh") entityMesh = InternMesh(str, length);
+		else if (key == "material") entityMaterial = Intern(materialIds, scene.materialNames, str, length);
+		else if (key == "lod") entityLod = InternLod(str, length);
+		break;
+	}
+
+	return true;
+}
+
+bool SceneJsonHandler::Bool(bool b)
+{
+	uint32_t flag = 0;
+	switch (State())
+	{
+	case JsonState::Numbers:
+		return false;
+
+	case JsonState::Mesh:
+		if (key == "compact") meshFlags = b ? meshFlags | SCENE_MESH_COMPACT : meshFlags & ~SCENE_MESH_COMPACT;
+		break;
+
+	case JsonState::Entity:
+		if (key == "occluder") flag = SCENE_ENTITY_OCCLUDER;
+		else if (key == "static") flag = SCENE_ENTITY_STATIC;
+		else if (key == "hlod") flag = SCENE_ENTITY_HLOD;
+		entityFlags = b ? entityFlags | flag : entityFlags & ~flag;
+		break;
+	}
+
+	return true;
+}
+
+bool SceneJsonHandler::Number(double value)
+{
+	float f = (float)value;
+	switch (State())
+	{
+	case JsonState::Numbers:
+		if (numberCount == 3) return false;
+		numbers[numberCount++] = f;
+		break;
+
+	case JsonState::Camera:
+		if (key == "moveSpeed") scene.camera.moveSpeed = f;
+		else if (key == "lookSpeed") scene.camera.lookSpeed = f;
+		break;
+
+	case JsonState::Level:
+		if (key == "error") levelError = f;
+		break;
+
+	case JsonState::Light:
+		if (key == "intensity") light.Intensity = f;
+		else if (key == "range") light.Range = f;
+		else if (key == "spotFalloff") light.SpotFalloff = f;
+		break;
+
+	case JsonState::Entity:
+		if (key == "spin") entitySpin = f;
+		break;
+	}
+
+	return true;
+}
+
+float* SceneJsonHandler::VectorFor(JsonState state)
+{
+	switch (state)
+	{
+	case JsonState::Camera:
+		if (key == "position") return &scene.camera.position.x;
+		if (key == "rotation") return &scene.camera.rotation.x;
+		break;
+
+	case JsonState::Light:
+		if (key == "direction") return &light.Direction.x;
+		if (key == "position") return &light.Position.x;
+		if (key == "color") return &light.Color.x;
+		break;
+
+	case JsonState::Entity:
+		if (key == "position") return &entityPosition.x;
+		if (key == "rotation") return &entityRotation.x;
+		if (key == "scale") return &entityScale.x;
+		break;
+	}
+
+	return 0;
+}
+
+uint32_t SceneJsonHandler::Intern(std::unordered_map<std::string, uint32_t>& ids, std::vector<std::string>& names, const char* str, rapidjson::SizeType length)
+{
+	auto inserted = ids.emplace(std::string(str, length), (uint32_t)names.size());
+	if (inserted.second)
+		names.push_back(inserted.first->first);
+	return inserted.first->second;
+}
+
+uint32_t SceneJsonHandler::InternMesh(const char* str, rapidjson::SizeType length)
+{
+	uint32_t id = Intern(meshIds, scene.meshNames, str, length);
+	if (id == scene.meshFlags.size())
+		scene.meshFlags.push_back(0);
+	return id;
+}
+
+uint32_t SceneJsonHandler::InternLod(const char* str, rapidjson::SizeType length)
+{
+	uint32_t id = Intern(lodIds, scene.lodNames, str, length);
+	if (id == scene.lodFirst.size())
+	{
+		scene.lodFirst.push_back(0);
+		scene.lodCount.push_back(0);
+	}
+	return id;
+}
+
+bool SceneJsonHandler::Finish()
+{
+	if (!finished)
+		return false;
+
+	for (uint32_t count : scene.lodCount)
+	{
+		if (count == 0)
+			return false;
+	}
+
+	return true;
+}
+
+bool SceneFile::LoadJson(std::string path, SceneData& scene)
+{
+	scene.Clear();
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<char> buffer(SCENE_JSON_BUFFER_SIZE);
+	rapidjson::IStreamWrapper stream(file, buffer.data(), buffer.size());
+	SceneJsonHandler handler(scene);
+	rapidjson::Reader reader;
+	if (reader.Parse(stream, handler).IsError() || !handler.Finish() || !Validate(scene))
+	{
+		scene.Clear();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Floats are written with as few digits as still read back
+// to exactly the same float, so files stay readable and
+// converting back and forth doesn't drift
+// --------------------------------------------------------
+static rapidjson::SizeType FormatFloat(char* buffer, float f)
+{
+	if (!std::isfinite(f))
+		f = 0;
+
+	int length = 0;
+	for (int precision = 6; precision <= 9; precision++)
+	{
+		length = snprintf(buffer, 32, "%.*g", precision, f);
+		if (strtof(buffer, 0) == f)
+			break;
+	}
+	return (rapidjson::SizeType)length;
+}
+
+template<typename Writer> static void WriteFloat(Writer& writer, float f)
+{
+	char buffer[32];
+	writer.RawValue(buffer, FormatFloat(buffer, f), rapidjson::kNumberType);
+}
+
+template<typename Writer> static void WriteVector(Writer& writer, const XMFLOAT3& v)
+{
+	char buffer[128] = "[";
+	rapidjson::SizeType length = 1;
+	for (int i = 0; i < 3; i++)
+	{
+		length += FormatFloat(buffer + length, (&v.x)[i]);
+		if (i < 2)
+		{
+			buffer[length++] = ',';
+			buffer[length++] = ' ';
+		}
+	}
+	buffer[length++] = ']';
+	writer.RawValue(buffer, length, rapidjson::kArrayType);
+}
+
+bool SceneFile::SaveJson(std::string path, const SceneData& scene)
+{
+	if (!Validate(scene))
+		return false;
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	rapidjson::OStreamWrapper stream(file);
+	rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+	writer.SetIndent('\t', 1);
+	writer.StartObject();
+
+	writer.Key("camera");
+	writer.StartObject();
+	writer.Key("position"); WriteVector(writer, scene.camera.position);
+	writer.Key("rotation"); WriteVector(writer, scene.camera.rotation);
+	writer.Key("moveSpeed"); WriteFloat(writer, scene.camera.moveSpeed);
+	writer.Key("lookSpeed"); WriteFloat(writer, scene.camera.lookSpeed);
+	writer.EndObject();
+
+	// Every mesh is listed, even without flags, so reading
+	// the file back gives the same table in the same order
+	writer.Key("meshes");
+	writer.StartArray();
+	for (size_t m = 0; m < scene.meshNames.size(); m++)
+	{
+		writer.StartObject();
+		writer.Key("name"); writer.String(scene.meshNames[m].c_str());
+		if (scene.meshFlags[m] & SCENE_MESH_COMPACT) { writer.Key("compact"); writer.Bool(true); }
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.Key("lodChains");
+	writer.StartArray();
+	for (size_t c = 0; c < scene.lodNames.size(); c++)
+	{
+		writer.StartObject();
+		writer.Key("name"); writer.String(scene.lodNames[c].c_str());
+		writer.Key("levels");
+		writer.StartArray();
+		for (uint32_t l = scene.lodFirst[c]; l < scene.lodFirst[c] + scene.lodCount[c]; l++)
+		{
+			writer.StartObject();
+			writer.Key("mesh"); writer.String(scene.meshNames[scene.lodMeshes[l]].c_str());
+			writer.Key("error"); WriteFloat(writer, scene.lodErrors[l]);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	const char* lightTypes[] = { "directional", "point", "spot" };
+	writer.Key("lights");
+	writer.StartArray();
+	for (const Light& light : scene.lights)
+	{
+		writer.StartObject();
+		writer.Key("type"); writer.String(lightTypes[light.Type]);
+		writer.Key("direction"); WriteVector(writer, light.Direction);
+		writer.Key("position"); WriteVector(writer, light.Position);
+		writer.Key("color"); WriteVector(writer, light.Color);
+		writer.Key("intensity"); WriteFloat(writer, light.Intensity);
+		writer.Key("range"); WriteFloat(writer, light.Range);
+		writer.Key("spotFalloff"); WriteFloat(writer, light.SpotFalloff);
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	// Entities leave out whatever they don't use
+	writer.Key("entities");
+	writer.StartArray();
+	for (size_t e = 0; e < scene.meshes.size(); e++)
+	{
+		writer.StartObject();
+		writer.Key("mesh"); writer.String(scene.meshNames[scene.meshes[e]].c_str());
+		writer.Key("material"); writer.String(scene.materialNames[scene.materials[e]].c_str());
+		writer.Key("position"); WriteVector(writer, scene.positions[e]);
+		writer.Key("rotation"); WriteVector(writer, scene.rotations[e]);
+		writer.Key("scale"); WriteVector(writer, scene.scales[e]);
+		if (scene.spins[e] != 0) { writer.Key("spin"); WriteFloat(writer, scene.spins[e]); }
+		if (scene.lods[e] != SCENE_NO_LOD) { writer.Key("lod"); writer.String(scene.lodNames[scene.lods[e]].c_str()); }
+		if (scene.flags[e] & SCENE_ENTITY_OCCLUDER) { writer.Key("occluder"); writer.Bool(true); }
+		if (scene.flags[e] & SCENE_ENTITY_STATIC) { writer.Key("static"); writer.Bool(true); }
+		if (scene.flags[e] & SCENE_ENTITY_HLOD) { writer.Key("hlod"); writer.Bool(true); }
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.EndObject();
+	stream.Flush();
+	return (bool)file;
+}
+
+// --------------------------------------------------------
+// The binary form: a header, a table of sections and then
+// the sections, each one of SceneData's arrays starting on
+// a 16 byte boundary.  Names are stored one after another,
+// each with a terminating zero.
+// --------------------------------------------------------
+enum SceneSection : uint32_t
+{
+	SCENE_SECTION_MESH_NAMES,
+	SCENE_SECTION_MESH_FLAGS,
+	SCENE_SECTION_MATERIAL_NAMES,
+	SCENE_SECTION_LOD_NAMES,
+	SCENE_SECTION_LOD_FIRST,
+	SCENE_SECTION_LOD_COUNT,
+	SCENE_SECTION_LOD_MESHES,
+	SCENE_SECTION_LOD_ERRORS,
+	SCENE_SECTION_ENTITY_MESHES,
+	SCENE_SECTION_ENTITY_MATERIALS,
+	SCENE_SECTION_ENTITY_LODS,
+	SCENE_SECTION_ENTITY_FLAGS,
+	SCENE_SECTION_ENTITY_SPINS,
+	SCENE_SECTION_POSITIONS,
+	SCENE_SECTION_ROTATIONS,
+	SCENE_SECTION_SCALES,
+	SCENE_SECTION_LIGHTS,
+	SCENE_SECTION_CAMERA,
+	SCENE_SECTION_COUNT
+};
+
+struct SceneBinaryHeader
+{
+	char magic[4];				// "SCNB"
+	uint32_t version;			// SCENE_BINARY_VERSION
+	uint32_t sectionCount;
+	uint32_t padding;
+};
+
+struct SceneBinarySection
+{
+	uint32_t id;				// SceneSection
+	uint32_t count;				// Elements (or names)
+	uint64_t offset;			// From the start of the file
+	uint64_t size;				// Bytes
+};
+
+// A whole file mapped read-only, unmapped when this goes
+struct SceneMappedFile
+{
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = 0;
+	const unsigned char* data = 0;
+	size_t size = 0;
+
+	~SceneMappedFile()
+	{
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	}
+
+	bool Open(const std::string& path)
+	{
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		// Empty files can't be mapped
+		LARGE_INTEGER fileSize = {};
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return false;
+
+		mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (!mapping)
+			return false;
+
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		size = (size_t)fileSize.QuadPart;
+		return data != 0;
+	}
+};
+
+template<typename T> static bool ReadSection(const SceneMappedFile& mapped, const SceneBinarySection& section, std::vector<T>& out)
+{
+	if (section.size != (uint64_t)section.count * sizeof(T))
+		return false;
+
+	const T* first = reinterpret_cast<const T*>(mapped.data + section.offset);
+	out.assign(first, first + section.count);
+	return true;
+}
+
+static bool ReadNames(const SceneMappedFile& mapped, const SceneBinarySection& section, std::vector<std::string>& out)
+{
+	const char* next = reinterpret_cast<const char*>(mapped.data + section.offset);
+	const char* end = next + section.size;
+	out.clear();
+	out.reserve(section.count);
+	for (uint32_t i = 0; i < section.count; i++)
+	{
+		const char* terminator = (const char*)memchr(next, 0, end - next);
+		if (!terminator)
+			return false;
+
+		out.emplace_back(next, terminator);
+		next = terminator + 1;
+	}
+
+	return next == end;
+}
+
+bool SceneFile::LoadBinary(std::string path, SceneData& scene)
+{
+	scene.Clear();
+	SceneMappedFile mapped;
+	if (!mapped.Open(path) || mapped.size < sizeof(SceneBinaryHeader))
+		return false;
+
+	const SceneBinaryHeader* header = reinterpret_cast<const SceneBinaryHeader*>(mapped.data);
+	if (memcmp(header->magic, "SCNB", 4) != 0 || header->version != SCENE_BINARY_VERSION ||
+		header->sectionCount > (mapped.size - sizeof(SceneBinaryHeader)) / sizeof(SceneBinarySection))
+		return false;
+
+	// Every section has to be there (once), aligned and inside the file
+	SceneBinarySection sections[SCENE_SECTION_COUNT] = {};
+	bool found[SCENE_SECTION_COUNT] = {};
+	const SceneBinarySection* table = reinterpret_cast<const SceneBinarySection*>(header + 1);
+	for (uint32_t s = 0; s < header->sectionCount; s++)
+	{
+		const SceneBinarySection& section = table[s];
+		if (section.id >= SCENE_SECTION_COUNT || found[section.id] || section.offset % 16 != 0 ||
+			section.offset > mapped.size || section.size > mapped.size - section.offset)
+			return false;
+
+		sections[section.id] = section;
+		found[section.id] = true;
+	}
+
+	for (bool f : found)
+	{
+		if (!f)
+			return false;
+	}
+
+	std::vector<SceneCamera> camera;
+	bool read =
+		ReadNames(mapped, sections[SCENE_SECTION_MESH_NAMES], scene.meshNames) &&
+		ReadSection(mapped, sections[SCENE_SECTION_MESH_FLAGS], scene.meshFlags) &&
+		ReadNames(mapped, sections[SCENE_SECTION_MATERIAL_NAMES], scene.materialNames) &&
+		ReadNames(mapped, sections[SCENE_SECTION_LOD_NAMES], scene.lodNames) &&
+		ReadSection(mapped, sections[SCENE_SECTION_LOD_FIRST], scene.lodFirst) &&
+		ReadSection(mapped, sections[SCENE_SECTION_LOD_COUNT], scene.lodCount) &&
+		ReadSection(mapped, sections[SCENE_SECTION_LOD_MESHES], scene.lodMeshes) &&
+		ReadSection(mapped, sections[SCENE_SECTION_LOD_ERRORS], scene.lodErrors) &&
+		ReadSection(mapped, sections[SCENE_SECTION_ENTITY_MESHES], scene.meshes) &&
+		ReadSection(mapped, sections[SCENE_SECTION_ENTITY_MATERIALS], scene.materials) &&
+		ReadSection(mapped, sections[SCENE_SECTION_ENTITY_LODS], scene.lods) &&
+		ReadSection(mapped, sections[SCENE_SECTION_ENTITY_FLAGS], scene.flags) &&
+		ReadSection(mapped, sections[SCENE_SECTION_ENTITY_SPINS], scene.spins) &&
+		ReadSection(mapped, sections[SCENE_SECTION_POSITIONS], scene.positions) &&
+		ReadSection(mapped, sections[SCENE_SECTION_ROTATIONS], scene.rotations) &&
+		ReadSection(mapped, sections[SCENE_SECTION_SCALES], scene.scales) &&
+		ReadSection(mapped, sections[SCENE_SECTION_LIGHTS], scene.lights) &&
+		ReadSection(mapped, sections[SCENE_SECTION_CAMERA], camera) &&
+		camera.size() == 1;
+
+	if (!read || !Validate(scene))
+	{
+		scene.Clear();
+		return false;
+	}
+
+	scene.camera = camera[0];
+	return true;
+}
+
+bool SceneFile::SaveBinary(std::string path, const SceneData& scene)
+{
+	if (!Validate(scene))
+		return false;
+
+	// Each section's bytes, in SceneSection order
+	struct Pending
+	{
+		const void* data;
+		uint32_t count;
+		uint64_t size;
+	};
+
+	std::string names[3];
+	const std::vector<std::string>* nameTables[3] = { &scene.meshNames, &scene.materialNames, &scene.lodNames };
+	for (int t = 0; t < 3; t++)
+	{
+		for (const std::string& name : *nameTables[t])
+			names[t].append(name.c_str(), name.size() + 1);
+	}
+
+	auto pending = [](const auto& v) { return Pending{ v.data(), (uint32_t)v.size(), v.size() * sizeof(v[0]) }; };
+	Pending sections[SCENE_SECTION_COUNT] =
+	{
+		{ names[0].data(), (uint32_t)scene.meshNames.size(), names[0].size() },
+		pending(scene.meshFlags),
+		{ names[1].data(), (uint32_t)scene.materialNames.size(), names[1].size() },
+		{ names[2].data(), (uint32_t)scene.lodNames.size(), names[2].size() },
+		pending(scene.lodFirst),
+		pending(scene.lodCount),
+		pending(scene.lodMeshes),
+		pending(scene.lodErrors),
+		pending(scene.meshes),
+		pending(scene.materials),
+		pending(scene.lods),
+		pending(scene.flags),
+		pending(scene.spins),
+		pending(scene.positions),
+		pending(scene.rotations),
+		pending(scene.scales),
+		pending(scene.lights),
+		{ &scene.camera, 1, sizeof(SceneCamera) },
+	};
+
+	SceneBinaryHeader header = { { 'S', 'C', 'N', 'B' }, SCENE_BINARY_VERSION, SCENE_SECTION_COUNT, 0 };
+	SceneBinarySection table[SCENE_SECTION_COUNT];
+	uint64_t offset = sizeof(header) + sizeof(table);
+	for (uint32_t s = 0; s < SCENE_SECTION_COUNT; s++)
+	{
+		offset = (offset + 15) & ~15ull;
+		table[s] = { s, sections[s].count, offset, sections[s].size };
+		offset += sections[s].size;
+	}
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	const char zeros[16] = {};
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)table, sizeof(table));
+	uint64_t written = sizeof(header) + sizeof(table);
+	for (uint32_t s = 0; s < SCENE_SECTION_COUNT; s++)
+	{
+		file.write(zeros, table[s].offset - written);
+		file.write((const char*)sections[s].data, sections[s].size);
+		written = table[s].offset + table[s].size;
+	}
+
+	return (bool)file;
+}
+
+bool SceneFile::Load(std::string jsonPath, SceneData& scene)
+{
+	std::string binaryPath = std::filesystem::path(jsonPath).replace_extension(".scene").string();
+	std::error_code jsonError, binaryError;
+	std::filesystem::file_time_type jsonTime = std::filesystem::last_write_time(jsonPath, jsonError);
+	std::filesystem::file_time_type binaryTime = std::filesystem::last_write_time(binaryPath, binaryError);
+	if (!binaryError && (jsonError || binaryTime >= jsonTime) && LoadBinary(binaryPath, scene))
+		return true;
+
+	if (!LoadJson(jsonPath, scene))
+		return false;
+
+	// Not being able to cache the scene isn't a reason to fail
+	SaveBinary(binaryPath, scene);
+	return true;
+}
+
+bool SceneFile::JsonToBinary(std::string jsonPath, std::string binaryPath)
+{
+	SceneData scene;
+	return LoadJson(jsonPath, scene) && SaveBinary(binaryPath, scene);
+}
+
+bool SceneFile::BinaryToJson(std::string binaryPath, std::string jsonPath)
+{
+	SceneData scene;
+	return LoadBinary(binaryPath, scene) && SaveJson(jsonPath, scene);
+}
+
+bool SceneFile::Validate(const SceneData& scene)
+{
+	size_t meshCount = scene.meshNames.size();
+	size_t materialCount = scene.materialNames.size();
+	size_t chainCount = scene.lodNames.size();
+	size_t levelCount = scene.lodMeshes.size();
+	size_t entityCount = scene.meshes.size();
+
+	if (scene.meshFlags.size() != meshCount ||
+		scene.lodFirst.size() != chainCount || scene.lodCount.size() != chainCount || scene.lodErrors.size() != levelCount ||
+		scene.materials.size() != entityCount || scene.lods.size() != entityCount || scene.flags.size() != entityCount ||
+		scene.spins.size() != entityCount || scene.positions.size() != entityCount ||
+		scene.rotations.size() != entityCount || scene.scales.size() != entityCount)
+		return false;
+
+	for (size_t c = 0; c < chainCount; c++)
+	{
+		if (scene.lodCount[c] == 0 || scene.lodFirst[c] > levelCount || scene.lodCount[c] > levelCount - scene.lodFirst[c])
+			return false;
+	}
+
+	for (uint32_t mesh : scene.lodMeshes)
+	{
+		if (mesh >= meshCount)
+			return false;
+	}
+
+	for (size_t e = 0; e < entityCount; e++)
+	{
+		if (scene.meshes[e] >= meshCount || scene.materials[e] >= materialCount ||
+			(scene.lods[e] != SCENE_NO_LOD && scene.lods[e] >= chainCount))
+			return false;
+	}
+
+	for (const Light& light : scene.lights)
+	{
+		if (light.Type < LIGHT_TYPE_DIRECTIONAL || light.Type > LIGHT_TYPE_SPOT)
+			return false;
+	}
+
+	return true;
+}
+
+SceneLoadTimings SceneFile::MeasureLoad(unsigned int numEntities)
+{
+	SceneLoadTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// Values are rounded to hundredths, like a hand-written file would be
+	auto rounded = [&](float min, float max) { return roundf(random(min, max) * 100.0f) / 100.0f; };
+
+	SceneData scene;
+	scene.meshNames = { "builtin:cube", "builtin:sphere", "builtin:sphere:16", "builtin:helix" };
+	scene.meshFlags = { 0, 0, 0, SCENE_MESH_COMPACT };
+	scene.materialNames = { "woodMat", "scratchMat" };
+	scene.lodNames = { "sphere" };
+	scene.lodFirst = { 0 };
+	scene.lodCount = { 2 };
+	scene.lodMeshes = { 1, 2 };
+	scene.lodErrors = { 0.0024f, 0.0096f };
+	for (unsigned int e = 0; e < numEntities; e++)
+	{
+		uint32_t mesh = rand() % 4;
+		scene.meshes.push_back(mesh);
+		scene.materials.push_back(rand() % 2);
+		scene.lods.push_back(mesh == 1 ? 0 : SCENE_NO_LOD);
+		scene.flags.push_back(rand() % 2 ? SCENE_ENTITY_STATIC : 0);
+		scene.spins.push_back(rand() % 4 ? 0 : 0.5f);
+		scene.positions.push_back(XMFLOAT3(rounded(-500, 500), rounded(0, 10), rounded(-500, 500)));
+		scene.rotations.push_back(XMFLOAT3(0, rounded(0, XM_2PI), 0));
+		float scale = rounded(0.5f, 2.0f);
+		scene.scales.push_back(XMFLOAT3(scale, scale, scale));
+	}
+
+	for (int l = 0; l < 10; l++)
+	{
+		Light light = {};
+		light.Type = LIGHT_TYPE_POINT;
+		light.Position = XMFLOAT3(rounded(-10, 10), rounded(-2, 2), rounded(-10, 10));
+		light.Color = XMFLOAT3(rounded(0, 1), rounded(0, 1), rounded(0, 1));
+		light.Intensity = rounded(0.1f, 10);
+		light.Range = rounded(1, 10);
+		scene.lights.push_back(light);
+	}
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path();
+	std::string jsonPath = (directory / "scene_benchmark.json").string();
+	std::string binaryPath = (directory / "scene_benchmark.scene").string();
+	std::string convertedPath = (directory / "scene_benchmark_converted.scene").string();
+	timings.entities = numEntities;
+	if (SaveJson(jsonPath, scene) && SaveBinary(binaryPath, scene))
+	{
+		std::error_code error;
+		timings.jsonBytes = std::filesystem::file_size(jsonPath, error);
+		timings.binaryBytes = std::filesystem::file_size(binaryPath, error);
+
+		auto start = now();
+		LoadJson(jsonPath, scene);
+		timings.loadJsonMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+		start = now();
+		LoadBinary(binaryPath, scene);
+		timings.loadBinaryMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+		start = now();
+		JsonToBinary(jsonPath, convertedPath);
+		timings.convertMs = std::chrono::duration<double, std::milli>(now() - start).count();
+	}
+
+	std::error_code error;
+	std::filesystem::remove(jsonPath, error);
+	std::filesystem::remove(binaryPath, error);
+	std::filesystem::remove(convertedPath, error);
+	return timings;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Lights.h"
+
+// What else an entity is besides a mesh with a material and a transform
+#define SCENE_ENTITY_OCCLUDER	1	// Its mesh's box goes into the occlusion buffer (so only for boxy meshes)
+#define SCENE_ENTITY_STATIC		2	// Never moves, so it's cooked into a static batch
+#define SCENE_ENTITY_HLOD		4	// Clustered with its neighbours into HLOD proxies when far away
+
+// How a mesh is loaded
+#define SCENE_MESH_COMPACT		1	// Stored quantized on the GPU
+
+// An entity with no LOD chain
+#define SCENE_NO_LOD			0xFFFFFFFF
+
+// Bumped whenever the binary layout changes, so old files are rejected
+#define SCENE_BINARY_VERSION	1
+
+struct SceneCamera
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 rotation;	// Pitch, yaw and roll
+	float moveSpeed;
+	float lookSpeed;
+};
+
+// --------------------------------------------------------
+// Everything a scene file holds, as parallel arrays.  Meshes,
+// materials and LOD chains are referred to by index into
+// their tables, and the names in those are asset names.
+// --------------------------------------------------------
+struct SceneData
+{
+	std::vector<std::string> meshNames;
+	std::vector<uint32_t> meshFlags;		// SCENE_MESH_*
+	std::vector<std::string> materialNames;
+
+	// Chain c's levels are lodFirst[c] up to lodFirst[c] + lodCount[c],
+	// each a mesh and its geometric error
+	std::vector<std::string> lodNames;
+	std::vector<uint32_t> lodFirst;
+	std::vector<uint32_t> lodCount;
+	std::vector<uint32_t> lodMeshes;
+	std::vector<float> lodErrors;
+
+	// Per entity
+	std::vector<uint32_t> meshes;
+	std::vector<uint32_t> materials;
+	std::vector<uint32_t> lods;			// SCENE_NO_LOD for none
+	std::vector<uint32_t> flags;		// SCENE_ENTITY_*
+	std::vector<float> spins;			// Radians per second around Y, 0 for none
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> rotations;	// Pitch, yaw and roll
+	std::vector<DirectX::XMFLOAT3> scales;
+
+	std::vector<Light> lights;
+	SceneCamera camera;
+
+	SceneData();
+	void Clear();
+	unsigned int GetEntityCount() const { return (unsigned int)meshes.size(); }
+};
+
+// Timings from MeasureLoad()
+struct SceneLoadTimings
+{
+	unsigned int entities;
+	uint64_t jsonBytes;
+	uint64_t binaryBytes;
+	double loadJsonMs;
+	double loadBinaryMs;
+	double convertMs;			// JSON to binary, including loading the JSON
+};
+
+// --------------------------------------------------------
+// Reads and writes scenes in two forms.
+//
+// The JSON form is for people to edit.  It's read with a
+// streaming (SAX) parser that fills the arrays as it goes,
+// so even a huge scene never exists as a whole document:
+//
+//   { "camera": { "position": [0, 0, -10], "rotation": [0, 0, 0],
+//       "moveSpeed": 5, "lookSpeed": 1 },
+//     "meshes": [ { "name": "builtin:helix", "compact": true } ],
+//     "lodChains": [ { "name": "sphere", "levels": [
+//       { "mesh": "builtin:sphere", "error": 0.0024 }, ... ] } ],
+//     "lights": [ { "type": "point", "position": [0, 1, 0],
+//       "color": [1, 1, 1], "intensity": 2, "range": 5 } ],
+//     "entities": [ { "mesh": "builtin:cube", "material": "woodMat",
+//       "position": [5, 0, 0], "rotation": [0, 0, 0], "scale": [1, 1, 1],
+//       "spin": 0.5, "lod": "sphere", "occluder": true } ] }
+//
+// Meshes only need listing to give them flags, and "static"
+// and "hlod" mark entities for the batcher and HLOD system.
+// Angles are in radians.
+//
+// The binary form is for loading fast.  It's a table of
+// sections, one for each of SceneData's arrays (so the
+// names, LOD chains, entities, transforms, lights and the
+// camera are each a run of them), and loading memory maps
+// the file, checks it and copies each array out in one go.
+// --------------------------------------------------------
+class SceneFile
+{
+public:
+	static bool LoadJson(std::string path, SceneData& scene);
+	static bool SaveJson(std::string path, const SceneData& scene);
+
+	static bool LoadBinary(std::string path, SceneData& scene);
+	static bool SaveBinary(std::string path, const SceneData& scene);
+
+	// Loads the binary form kept next to the JSON (with the same name
+	// but .scene on the end) if it's newer, and otherwise the JSON,
+	// writing the binary form from it for next time
+	static bool Load(std::string jsonPath, SceneData& scene);
+
+	// The converter, both ways
+	static bool JsonToBinary(std::string jsonPath, std::string binaryPath);
+	static bool BinaryToJson(std::string binaryPath, std::string jsonPath);
+
+	// Writes a scene of this many entities both ways (to the temp
+	// directory) and times loading each
+	static SceneLoadTimings MeasureLoad(unsigned int numEntities);
+
+private:
+	// False if an index is out of range or the arrays don't line up
+	static bool Validate(const SceneData& scene);
+};
@@ -108,7 +108,7 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
     commandList->IASetVertexBuffers(0, 1, &vbv);
     commandList->IASetIndexBuffer(&ibv);
 
-    commandList->DrawIndexedInstanced(skyMesh->GetIndexCount(), 1, 0, 0, 0);
+    commandList->DrawIndexedInstanced(skyMesh->GetIndexCount(), 1, skyMesh->GetStartIndex(), skyMesh->GetBaseVertex(), 0);
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE Sky::GetSkyCubeMap()
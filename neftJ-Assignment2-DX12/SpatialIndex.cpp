@@ -0,0 +1,868 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+// Number of buckets the SAH splits are chosen from during a rebuild
+static const int NumBins = 16;
+
+static XMFLOAT3 Min3(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+static XMFLOAT3 Max3(XMFLOAT3 a, XMFLOAT3 b) { return XMFLOAT3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+
+static float SurfaceArea(XMFLOAT3 min, XMFLOAT3 max)
+{
+	float x = max.x - min.x, y = max.y - min.y, z = max.z - min.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+static bool Contains(XMFLOAT3 outerMin, XMFLOAT3 outerMax, XMFLOAT3 innerMin, XMFLOAT3 innerMax)
+{
+	return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+		outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+}
+
+static bool Overlaps(XMFLOAT3 aMin, XMFLOAT3 aMax, XMFLOAT3 bMin, XMFLOAT3 bMax)
+{
+	return aMin.x <= bMax.x && aMin.y <= bMax.y && aMin.z <= bMax.z &&
+		aMax.x >= bMin.x && aMax.y >= bMin.y && aMax.z >= bMin.z;
+}
+
+static float DistanceSquared(XMFLOAT3 point, XMFLOAT3 min, XMFLOAT3 max)
+{
+	float x = std::max(std::max(min.x - point.x, 0.0f), point.x - max.x);
+	float y = std::max(std::max(min.y - point.y, 0.0f), point.y - max.y);
+	float z = std::max(std::max(min.z - point.z, 0.0f), point.z - max.z);
+	return x * x + y * y + z * z;
+}
+
+// -1 if the box is entirely outside the frustum, 1 if it's entirely inside, 0 if it crosses
+static int ClassifyBox(const Frustum& frustum, XMFLOAT3 min, XMFLOAT3 max)
+{
+	XMFLOAT3 center((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+	XMFLOAT3 extents((max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f);
+
+	int result = 1;
+	for (const XMFLOAT4& p : frustum.planes)
+	{
+		float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float reach = fabsf(p.x) * extents.x + fabsf(p.y) * extents.y + fabsf(p.z) * extents.z;
+		if (distance < -reach)
+			return -1;
+		if (distance < reach)
+			result = 0;
+	}
+
+	return result;
+}
+
+// Slab test; gives the distance along the ray where it enters the box
+static bool RayHitsBox(XMFLOAT3 origin, XMFLOAT3 inverseDirection, float maxDistance, XMFLOAT3 min, XMFLOAT3 max, float& entry)
+{
+	float tx1 = (min.x - origin.x) * inverseDirection.x, tx2 = (max.x - origin.x) * inverseDirection.x;
+	float ty1 = (min.y - origin.y) * inverseDirection.y, ty2 = (max.y - origin.y) * inverseDirection.y;
+	float tz1 = (min.z - origin.z) * inverseDirection.z, tz2 = (max.z - origin.z) * inverseDirection.z;
+
+	float tEnter = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+	float tExit = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), maxDistance));
+
+	entry = tEnter;
+	return tEnter <= tExit;
+}
+
+SpatialIndex::SpatialIndex()
+{
+	root = SPATIAL_NULL;
+	freeList = SPATIAL_NULL;
+	leafCount = 0;
+	buildCost = 0;
+	internalArea = 0;
+	leafArea = 0;
+}
+
+uint32_t SpatialIndex::AllocateNode()
+{
+	uint32_t node;
+	if (freeList == SPATIAL_NULL)
+	{
+		node = (uint32_t)nodes.size();
+		nodes.push_back({});
+		objectMins.push_back(XMFLOAT3(0, 0, 0));
+		objectMaxes.push_back(XMFLOAT3(0, 0, 0));
+	}
+	else
+	{
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+
+	nodes[node].parent = SPATIAL_NULL;
+	nodes[node].children[0] = SPATIAL_NULL;
+	nodes[node].children[1] = SPATIAL_NULL;
+	nodes[node].height = 0;
+	nodes[node].data = 0;
+
+	// No area until it's given a box, so it adds nothing to the cost yet
+	nodes[node].min = XMFLOAT3(0, 0, 0);
+	nodes[node].max = XMFLOAT3(0, 0, 0);
+	return node;
+}
+
+void SpatialIndex::FreeNode(uint32_t node)
+{
+	SetBox(node, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0));
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+uint32_t SpatialIndex::Insert(const BoundingBox& box, uint32_t data)
+{
+	uint32_t leaf = AllocateNode();
+	objectMins[leaf] = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	objectMaxes[leaf] = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+	XMFLOAT3 margin(SPATIAL_FAT_MARGIN, SPATIAL_FAT_MARGIN, SPATIAL_FAT_MARGIN);
+	SetBox(leaf,
+		XMFLOAT3(objectMins[leaf].x - margin.x, objectMins[leaf].y - margin.y, objectMins[leaf].z - margin.z),
+		XMFLOAT3(objectMaxes[leaf].x + margin.x, objectMaxes[leaf].y + margin.y, objectMaxes[leaf].z + margin.z));
+	nodes[leaf].data = data;
+
+	InsertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void SpatialIndex::Remove(uint32_t id)
+{
+	RemoveLeaf(id);
+	FreeNode(id);
+	leafCount--;
+}
+
+BoundingBox SpatialIndex::GetBox(uint32_t id)
+{
+	BoundingBox box;
+	BoundingBox::CreateFromPoints(box, XMLoadFloat3(&objectMins[id]), XMLoadFloat3(&objectMaxes[id]));
+	return box;
+}
+
+// --------------------------------------------------------
+// Refits instead of reinserting: the leaf's fat box is only
+// rebuilt once the object leaves it, and then the boxes
+// above it are grown (or shrunk) to match
+// --------------------------------------------------------
+void SpatialIndex::Move(uint32_t id, const BoundingBox& box)
+{
+	objectMins[id] = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	objectMaxes[id] = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+	if (Contains(nodes[id].min, nodes[id].max, objectMins[id], objectMaxes[id]))
+		return;
+
+	SetBox(id,
+		XMFLOAT3(objectMins[id].x - SPATIAL_FAT_MARGIN, objectMins[id].y - SPATIAL_FAT_MARGIN, objectMins[id].z - SPATIAL_FAT_MARGIN),
+		XMFLOAT3(objectMaxes[id].x + SPATIAL_FAT_MARGIN, objectMaxes[id].y + SPATIAL_FAT_MARGIN, objectMaxes[id].z + SPATIAL_FAT_MARGIN));
+
+	for (uint32_t node = nodes[id].parent; node != SPATIAL_NULL; node = nodes[node].parent)
+	{
+		XMFLOAT3 oldMin = nodes[node].min, oldMax = nodes[node].max;
+		SetBoxFromChildren(node);
+		if (Contains(oldMin, oldMax, nodes[node].min, nodes[node].max) && Contains(nodes[node].min, nodes[node].max, oldMin, oldMax))
+			break;
+	}
+}
+
+// --------------------------------------------------------
+// Every box change outside a rebuild goes through here so
+// the area sums behind GetCost() follow along.  A node's
+// area counts as internal or leaf by its height, so nodes
+// only change between the two with no area (just allocated
+// or about to be freed).
+// --------------------------------------------------------
+void SpatialIndex::SetBox(uint32_t node, XMFLOAT3 min, XMFLOAT3 max)
+{
+	Node& n = nodes[node];
+	double& sum = n.height > 0 ? internalArea : leafArea;
+	sum += (double)SurfaceArea(min, max) - SurfaceArea(n.min, n.max);
+	n.min = min;
+	n.max = max;
+}
+
+void SpatialIndex::SetBoxFromChildren(uint32_t node)
+{
+	const Node& a = nodes[nodes[node].children[0]];
+	const Node& b = nodes[nodes[node].children[1]];
+	SetBox(node, Min3(a.min, b.min), Max3(a.max, b.max));
+}
+
+// Sums every node's area from scratch, after a rebuild (which moves
+// boxes on several threads at once) and to drop any drift
+void SpatialIndex::RecountArea()
+{
+	internalArea = 0;
+	leafArea = 0;
+	for (const Node& n : nodes)
+	{
+		if (n.height > 0)
+			internalArea += SurfaceArea(n.min, n.max);
+		else if (n.height == 0)
+			leafArea += SurfaceArea(n.min, n.max);
+	}
+}
+
+// --------------------------------------------------------
+// Walks down to the sibling that adds the least surface
+// area (counting the growth of every ancestor on the way),
+// pairs the leaf with it under a new node and rebalances
+// --------------------------------------------------------
+void SpatialIndex::InsertLeaf(uint32_t leaf)
+{
+	if (root == SPATIAL_NULL)
+	{
+		root = leaf;
+		nodes[leaf].parent = SPATIAL_NULL;
+		return;
+	}
+
+	XMFLOAT3 leafMin = nodes[leaf].min, leafMax = nodes[leaf].max;
+	uint32_t index = root;
+	while (!IsLeaf(index))
+	{
+		float area = SurfaceArea(nodes[index].min, nodes[index].max);
+		float combinedArea = SurfaceArea(Min3(nodes[index].min, leafMin), Max3(nodes[index].max, leafMax));
+
+		// Making a new parent for this node and the leaf, or pushing the leaf further down
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = nodes[nodes[index].children[c]];
+			float grown = SurfaceArea(Min3(child.min, leafMin), Max3(child.max, leafMax));
+			childCosts[c] = (child.height == 0 ? grown : grown - SurfaceArea(child.min, child.max)) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = nodes[index].children[childCosts[0] < childCosts[1] ? 0 : 1];
+	}
+
+	uint32_t sibling = index;
+	uint32_t oldParent = nodes[sibling].parent;
+	uint32_t newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].children[0] = sibling;
+	nodes[newParent].children[1] = leaf;
+	nodes[newParent].height = nodes[sibling].height + 1;
+	SetBox(newParent, Min3(nodes[sibling].min, leafMin), Max3(nodes[sibling].max, leafMax));
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == SPATIAL_NULL)
+		root = newParent;
+	else
+		nodes[oldParent].children[nodes[oldParent].children[0] == sibling ? 0 : 1] = newParent;
+
+	FixUpwards(nodes[leaf].parent);
+}
+
+void SpatialIndex::RemoveLeaf(uint32_t leaf)
+{
+	if (leaf == root)
+	{
+		root = SPATIAL_NULL;
+		return;
+	}
+
+	// The sibling takes the parent's place
+	uint32_t parent = nodes[leaf].parent;
+	uint32_t grandParent = nodes[parent].parent;
+	uint32_t sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+	FreeNode(parent);
+	nodes[sibling].parent = grandParent;
+	nodes[leaf].parent = SPATIAL_NULL;
+
+	if (grandParent == SPATIAL_NULL)
+	{
+		root = sibling;
+		return;
+	}
+
+	nodes[grandParent].children[nodes[grandParent].children[0] == parent ? 0 : 1] = sibling;
+	FixUpwards(grandParent);
+}
+
+// Rebalances and refits everything from a node to the root
+void SpatialIndex::FixUpwards(uint32_t node)
+{
+	while (node != SPATIAL_NULL)
+	{
+		node = Balance(node);
+
+		const Node& a = nodes[nodes[node].children[0]];
+		const Node& b = nodes[nodes[node].children[1]];
+		nodes[node].height = 1 + std::max(a.height, b.height);
+		SetBoxFromChildren(node);
+
+		node = nodes[node].parent;
+	}
+}
+
+// --------------------------------------------------------
+// If one child of a is more than a level taller than the
+// other, rotates it up to take a's place and hands a its
+// own shorter child.  Returns whichever node is now where
+// a was.
+// --------------------------------------------------------
+uint32_t SpatialIndex::Balance(uint32_t a)
+{
+	if (IsLeaf(a) || nodes[a].height < 2)
+		return a;
+
+	for (int side = 0; side < 2; side++)
+	{
+		uint32_t tall = nodes[a].children[side];
+		uint32_t other = nodes[a].children[1 - side];
+		if (nodes[tall].height - nodes[other].height <= 1)
+			continue;
+
+		// The tall child replaces a under a's parent
+		uint32_t parent = nodes[a].parent;
+		nodes[tall].parent = parent;
+		if (parent == SPATIAL_NULL)
+			root = tall;
+		else
+			nodes[parent].children[nodes[parent].children[0] == a ? 0 : 1] = tall;
+
+		// The tall child keeps its taller grandchild, and a takes
+		// the shorter one in the tall child's old place
+		uint32_t first = nodes[tall].children[0];
+		uint32_t second = nodes[tall].children[1];
+		uint32_t keep = nodes[first].height > nodes[second].height ? first : second;
+		uint32_t give = keep == first ? second : first;
+
+		nodes[tall].children[0] = a;
+		nodes[tall].children[1] = keep;
+		nodes[a].parent = tall;
+		nodes[a].children[side] = give;
+		nodes[give].parent = a;
+
+		nodes[a].height = 1 + std::max(nodes[give].height, nodes[other].height);
+		SetBoxFromChildren(a);
+		nodes[tall].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+		SetBoxFromChildren(tall);
+		return tall;
+	}
+
+	return a;
+}
+
+bool SpatialIndex::RebuildIfDegraded(bool allowThreads)
+{
+	if (leafCount < 2)
+		return false;
+
+	// Anything built purely by insertion gets one rebuild to set the baseline
+	if (buildCost > 0 && GetCost() <= buildCost * SPATIAL_REBUILD_RATIO)
+		return false;
+
+	Rebuild(allowThreads);
+	return true;
+}
+
+// --------------------------------------------------------
+// Rebuilds the whole tree top down over the existing leaves
+// (so ids don't change), reusing the internal nodes
+// --------------------------------------------------------
+void SpatialIndex::Rebuild(bool allowThreads)
+{
+	if (root == SPATIAL_NULL)
+		return;
+
+	std::vector<uint32_t> leaves;
+	std::vector<uint32_t> internalNodes;
+	leaves.reserve(leafCount);
+	internalNodes.reserve(leafCount);
+	for (uint32_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].height == 0)
+			leaves.push_back(i);
+		else if (nodes[i].height > 0)
+			internalNodes.push_back(i);
+	}
+
+	// Enough levels of splitting to give every core a subtree
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	unsigned int parallelDepth = 0;
+	while ((1u << parallelDepth) < cores)
+		parallelDepth++;
+
+	root = Build(leaves, 0, leaves.size(), internalNodes, 0, parallelDepth);
+	nodes[root].parent = SPATIAL_NULL;
+	RecountArea();
+	buildCost = GetCost();
+}
+
+// --------------------------------------------------------
+// Builds the subtree over leaves[first, last).  A subtree
+// with n leaves always needs n - 1 internal nodes, so each
+// one takes its nodes from its own slice of internalNodes
+// and the two halves can be built on different threads.
+// --------------------------------------------------------
+uint32_t SpatialIndex::Build(std::vector<uint32_t>& leaves, size_t first, size_t last,
+	const std::vector<uint32_t>& internalNodes, size_t internalOffset, unsigned int parallelDepth)
+{
+	size_t count = last - first;
+	if (count == 1)
+		return leaves[first];
+
+	// Split along the longest axis of the box around the leaf centers
+	// (kept doubled, since only their order matters)
+	auto center = [this](uint32_t leaf, int axis) { return (&nodes[leaf].min.x)[axis] + (&nodes[leaf].max.x)[axis]; };
+	float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = first; i < last; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			centerMin[axis] = std::min(centerMin[axis], center(leaves[i], axis));
+			centerMax[axis] = std::max(centerMax[axis], center(leaves[i], axis));
+		}
+	}
+
+	int axis = 0;
+	for (int a = 1; a < 3; a++)
+	{
+		if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+			axis = a;
+	}
+
+	float extent = centerMax[axis] - centerMin[axis];
+	size_t mid = first + count / 2;
+	if (extent > 0)
+	{
+		// Drop the leaves into bins and pick the boundary with the lowest
+		// surface area cost
+		float scale = NumBins / extent;
+		auto binOf = [&](uint32_t leaf) { return std::min(NumBins - 1, (int)((center(leaf, axis) - centerMin[axis]) * scale)); };
+
+		unsigned int binCounts[NumBins] = {};
+		XMFLOAT3 binMins[NumBins], binMaxes[NumBins];
+		for (int b = 0; b < NumBins; b++)
+		{
+			binMins[b] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			binMaxes[b] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+		for (size_t i = first; i < last; i++)
+		{
+			int b = binOf(leaves[i]);
+			binCounts[b]++;
+			binMins[b] = Min3(binMins[b], nodes[leaves[i]].min);
+			binMaxes[b] = Max3(binMaxes[b], nodes[leaves[i]].max);
+		}
+
+		// Cost of everything left of each boundary, then sweep back from the right
+		float leftCosts[NumBins] = {};
+		XMFLOAT3 runningMin(FLT_MAX, FLT_MAX, FLT_MAX), runningMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		unsigned int runningCount = 0;
+		for (int b = 0; b < NumBins - 1; b++)
+		{
+			runningCount += binCounts[b];
+			runningMin = Min3(runningMin, binMins[b]);
+			runningMax = Max3(runningMax, binMaxes[b]);
+			leftCosts[b + 1] = runningCount ? runningCount * SurfaceArea(runningMin, runningMax) : 0;
+		}
+
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		runningMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		runningMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		runningCount = 0;
+		for (int b = NumBins - 1; b > 0; b--)
+		{
+			runningCount += binCounts[b];
+			runningMin = Min3(runningMin, binMins[b]);
+			runningMax = Max3(runningMax, binMaxes[b]);
+			float cost = leftCosts[b] + (runningCount ? runningCount * SurfaceArea(runningMin, runningMax) : 0);
+			if (runningCount < count && cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		if (bestSplit > 0)
+			mid = std::partition(leaves.begin() + first, leaves.begin() + last, [&](uint32_t leaf) { return binOf(leaf) < bestSplit; }) - leaves.begin();
+	}
+
+	// Everything in one bin (or on top of each other), so just halve it
+	if (mid == first || mid == last)
+	{
+		mid = first + count / 2;
+		std::nth_element(leaves.begin() + first, leaves.begin() + mid, leaves.begin() + last,
+			[&](uint32_t a, uint32_t b) { return center(a, axis) < center(b, axis); });
+	}
+
+	uint32_t node = internalNodes[internalOffset];
+	size_t leftOffset = internalOffset + 1;
+	size_t rightOffset = internalOffset + (mid - first);
+
+	uint32_t left, right;
+	if (parallelDepth > 0 && count >= SPATIAL_PARALLEL_MIN)
+	{
+		std::future<uint32_t> leftJob = std::async(std::launch::async, [&]() { return Build(leaves, first, mid, internalNodes, leftOffset, parallelDepth - 1); });
+		right = Build(leaves, mid, last, internalNodes, rightOffset, parallelDepth - 1);
+		left = leftJob.get();
+	}
+	else
+	{
+		left = Build(leaves, first, mid, internalNodes, leftOffset, 0);
+		right = Build(leaves, mid, last, internalNodes, rightOffset, 0);
+	}
+
+	nodes[node].children[0] = left;
+	nodes[node].children[1] = right;
+	nodes[left].parent = node;
+	nodes[right].parent = node;
+	nodes[node].height = 1 + std::max(nodes[left].height, nodes[right].height);
+
+	// Straight to the box rather than through SetBox, as the area sums
+	// can't be shared between threads (Rebuild() recounts them after)
+	nodes[node].min = Min3(nodes[left].min, nodes[right].min);
+	nodes[node].max = Max3(nodes[left].max, nodes[right].max);
+	return node;
+}
+
+void SpatialIndex::AddSubtree(uint32_t node, std::vector<uint32_t>& results)
+{
+	std::vector<uint32_t> stack;
+	stack.push_back(node);
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		stack.pop_back();
+
+		if (IsLeaf(n))
+		{
+			results.push_back(nodes[n].data);
+			continue;
+		}
+
+		stack.push_back(nodes[n].children[0]);
+		stack.push_back(nodes[n].children[1]);
+	}
+}
+
+// --------------------------------------------------------
+// Whole subtrees that are inside the frustum are added
+// without testing anything below them
+// --------------------------------------------------------
+void SpatialIndex::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results)
+{
+	if (root == SPATIAL_NULL)
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		stack.pop_back();
+
+		int classification = ClassifyBox(frustum, nodes[n].min, nodes[n].max);
+		if (classification < 0)
+			continue;
+
+		if (IsLeaf(n))
+		{
+			if (classification > 0 || ClassifyBox(frustum, objectMins[n], objectMaxes[n]) >= 0)
+				results.push_back(nodes[n].data);
+		}
+		else if (classification > 0)
+		{
+			AddSubtree(n, results);
+		}
+		else
+		{
+			stack.push_back(nodes[n].children[0]);
+			stack.push_back(nodes[n].children[1]);
+		}
+	}
+}
+
+void SpatialIndex::QuerySphere(XMFLOAT3 center, float radius, std::vector<uint32_t>& results)
+{
+	if (root == SPATIAL_NULL)
+		return;
+
+	float radiusSquared = radius * radius;
+	std::vector<uint32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		stack.pop_back();
+
+		if (DistanceSquared(center, nodes[n].min, nodes[n].max) > radiusSquared)
+			continue;
+
+		if (IsLeaf(n))
+		{
+			if (DistanceSquared(center, objectMins[n], objectMaxes[n]) <= radiusSquared)
+				results.push_back(nodes[n].data);
+			continue;
+		}
+
+		stack.push_back(nodes[n].children[0]);
+		stack.push_back(nodes[n].children[1]);
+	}
+}
+
+void SpatialIndex::QueryBox(const BoundingBox& box, std::vector<uint32_t>& results)
+{
+	if (root == SPATIAL_NULL)
+		return;
+
+	XMFLOAT3 min(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	XMFLOAT3 max(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+	std::vector<uint32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		stack.pop_back();
+
+		if (!Overlaps(min, max, nodes[n].min, nodes[n].max))
+			continue;
+
+		if (IsLeaf(n))
+		{
+			if (Overlaps(min, max, objectMins[n], objectMaxes[n]))
+				results.push_back(nodes[n].data);
+			continue;
+		}
+
+		stack.push_back(nodes[n].children[0]);
+		stack.push_back(nodes[n].children[1]);
+	}
+}
+
+// --------------------------------------------------------
+// Best first: nodes come off a queue ordered by how close
+// their boxes are, which stops as soon as nothing left in
+// it can beat the k found so far
+// --------------------------------------------------------
+void SpatialIndex::QueryNearest(XMFLOAT3 point, unsigned int k, std::vector<uint32_t>& results)
+{
+	if (root == SPATIAL_NULL || k == 0)
+		return;
+
+	typedef std::pair<float, uint32_t> Candidate;
+	auto further = [](const Candidate& a, const Candidate& b) { return a.first > b.first; };
+	auto nearer = [](const Candidate& a, const Candidate& b) { return a.first < b.first; };
+
+	// A min-heap of nodes to visit and a max-heap of the best leaves
+	std::vector<Candidate> queue;
+	std::vector<Candidate> best;
+	queue.push_back(Candidate(DistanceSquared(point, nodes[root].min, nodes[root].max), root));
+
+	while (!queue.empty())
+	{
+		std::pop_heap(queue.begin(), queue.end(), further);
+		Candidate c = queue.back();
+		queue.pop_back();
+
+		if (best.size() == k && c.first >= best.front().first)
+			break;
+
+		if (IsLeaf(c.second))
+		{
+			float distance = DistanceSquared(point, objectMins[c.second], objectMaxes[c.second]);
+			if (best.size() < k || distance < best.front().first)
+			{
+				if (best.size() == k)
+				{
+					std::pop_heap(best.begin(), best.end(), nearer);
+					best.pop_back();
+				}
+				best.push_back(Candidate(distance, c.second));
+				std::push_heap(best.begin(), best.end(), nearer);
+			}
+			continue;
+		}
+
+		for (uint32_t child : nodes[c.second].children)
+		{
+			queue.push_back(Candidate(DistanceSquared(point, nodes[child].min, nodes[child].max), child));
+			std::push_heap(queue.begin(), queue.end(), further);
+		}
+	}
+
+	std::sort_heap(best.begin(), best.end(), nearer);
+	for (const Candidate& c : best)
+		results.push_back(nodes[c.second].data);
+}
+
+bool SpatialIndex::Raycast(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, uint32_t& hitData, float& hitDistance)
+{
+	if (root == SPATIAL_NULL)
+		return false;
+
+	XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float closest = maxDistance;
+	bool hit = false;
+
+	std::vector<uint32_t> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		uint32_t n = stack.back();
+		stack.pop_back();
+
+		float entry;
+		if (!RayHitsBox(origin, inverseDirection, closest, nodes[n].min, nodes[n].max, entry))
+			continue;
+
+		if (IsLeaf(n))
+		{
+			if (RayHitsBox(origin, inverseDirection, closest, objectMins[n], objectMaxes[n], entry))
+			{
+				closest = entry;
+				hitData = nodes[n].data;
+				hit = true;
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, so the far one is more likely to be skipped
+		uint32_t a = nodes[n].children[0], b = nodes[n].children[1];
+		float entryA, entryB;
+		bool hitA = RayHitsBox(origin, inverseDirection, closest, nodes[a].min, nodes[a].max, entryA);
+		bool hitB = RayHitsBox(origin, inverseDirection, closest, nodes[b].min, nodes[b].max, entryB);
+		if (hitA && hitB)
+		{
+			stack.push_back(entryA < entryB ? b : a);
+			stack.push_back(entryA < entryB ? a : b);
+		}
+		else if (hitA)
+		{
+			stack.push_back(a);
+		}
+		else if (hitB)
+		{
+			stack.push_back(b);
+		}
+	}
+
+	if (hit)
+		hitDistance = closest;
+	return hit;
+}
+
+SpatialIndexTimings SpatialIndex::MeasureSpatialIndex(unsigned int numObjects)
+{
+	SpatialIndexTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+	auto elapsedMs = [](auto start, auto end) { return std::chrono::duration<double, std::milli>(end - start).count(); };
+
+	std::vector<BoundingBox> boxes(numObjects);
+	for (BoundingBox& box : boxes)
+	{
+		box.Center = XMFLOAT3(random(-500, 500), random(-500, 500), random(-500, 500));
+		box.Extents = XMFLOAT3(random(0.25f, 2), random(0.25f, 2), random(0.25f, 2));
+	}
+
+	SpatialIndex index;
+	std::vector<uint32_t> ids(numObjects);
+	auto start = now();
+	for (unsigned int i = 0; i < numObjects; i++)
+		ids[i] = index.Insert(boxes[i], i);
+	timings.insertMs = elapsedMs(start, now());
+
+	start = now();
+	index.Rebuild(false);
+	timings.rebuildMs = elapsedMs(start, now());
+
+	start = now();
+	index.Rebuild(true);
+	timings.rebuildThreadedMs = elapsedMs(start, now());
+
+	// Everything drifting a little, as in a normal frame
+	for (BoundingBox& box : boxes)
+		box.Center = XMFLOAT3(box.Center.x + random(-0.5f, 0.5f), box.Center.y + random(-0.5f, 0.5f), box.Center.z + random(-0.5f, 0.5f));
+	start = now();
+	for (unsigned int i = 0; i < numObjects; i++)
+		index.Move(ids[i], boxes[i]);
+	timings.refitMs = elapsedMs(start, now());
+
+	// The same camera as FrustumCuller::MeasureCulling(), against the
+	// tree and against a flat list of bounding spheres
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+	Frustum frustum = Frustum::FromViewProjection(view, projection);
+
+	std::vector<uint32_t> results;
+	start = now();
+	index.QueryFrustum(frustum, results);
+	timings.frustumMs = elapsedMs(start, now());
+	timings.visible = (unsigned int)results.size();
+
+	FrustumCuller culler;
+	culler.Reserve(numObjects);
+	for (const BoundingBox& box : boxes)
+		culler.Add(box.Center, sqrtf(box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y + box.Extents.z * box.Extents.z));
+	start = now();
+	culler.Cull(frustum, results, false);
+	timings.flatFrustumMs = elapsedMs(start, now());
+
+	const unsigned int queries = 1000;
+	std::vector<XMFLOAT3> points(queries);
+	for (XMFLOAT3& p : points)
+		p = XMFLOAT3(random(-500, 500), random(-500, 500), random(-500, 500));
+
+	start = now();
+	for (XMFLOAT3 p : points)
+	{
+		results.clear();
+		index.QuerySphere(p, 20.0f, results);
+	}
+	timings.sphereMicroseconds = elapsedMs(start, now()) * 1000.0 / queries;
+
+	start = now();
+	for (XMFLOAT3 p : points)
+	{
+		results.clear();
+		index.QueryNearest(p, 8, results);
+	}
+	timings.nearestMicroseconds = elapsedMs(start, now()) * 1000.0 / queries;
+
+	start = now();
+	for (XMFLOAT3 p : points)
+	{
+		uint32_t data;
+		float distance;
+		index.Raycast(p, XMFLOAT3(random(-1, 1), random(-1, 1), random(-1, 1)), 1000.0f, data, distance);
+	}
+	timings.raycastMicroseconds = elapsedMs(start, now()) * 1000.0 / queries;
+
+	// A tenth of everything teleporting somewhere else, which refits badly
+	for (unsigned int i = 0; i < numObjects; i += 10)
+	{
+		boxes[i].Center = XMFLOAT3(random(-500, 500), random(-500, 500), random(-500, 500));
+		index.Move(ids[i], boxes[i]);
+	}
+	timings.costBeforeRebuild = index.GetCost();
+	index.RebuildIfDegraded();
+	timings.costAfterRebuild = index.GetCost();
+
+	return timings;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <stdint.h>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+// Node index meaning "none"
+#define SPATIAL_NULL			0xFFFFFFFF
+
+// How far (in world units) a leaf's box reaches past the object,
+// so small movements don't touch the tree at all
+#define SPATIAL_FAT_MARGIN		0.1f
+
+// RebuildIfDegraded() rebuilds once the tree's cost is this
+// many times what it was right after the last rebuild
+#define SPATIAL_REBUILD_RATIO	1.5f
+
+// Below this many leaves a rebuild (or part of one) stays on one thread
+#define SPATIAL_PARALLEL_MIN	8192
+
+// Timings from MeasureSpatialIndex()
+struct SpatialIndexTimings
+{
+	double insertMs;				// Inserting everything one at a time
+	double rebuildMs;				// Full rebuild, one thread
+	double rebuildThreadedMs;		// Full rebuild, all cores
+	double refitMs;					// Moving everything a little
+	double frustumMs;				// A frustum query from the middle of the scene
+	double flatFrustumMs;			// The same test with a FrustumCuller over every object
+	double sphereMicroseconds;		// Average small sphere query
+	double nearestMicroseconds;		// Average nearest 8 query
+	double raycastMicroseconds;		// Average raycast
+	float costBeforeRebuild;		// Tree cost after moving everything a long way...
+	float costAfterRebuild;			// ...and after rebuilding
+	unsigned int visible;
+};
+
+// --------------------------------------------------------
+// A dynamic bounding volume hierarchy over object bounds.
+//
+// Leaves are objects, each with a "fat" box slightly bigger
+// than its real one.  Inserting picks the cheapest sibling
+// by surface area and rebalances with tree rotations on the
+// way back up, and removing rebalances the same way.
+//
+// Moving an object is a refit: if it's still inside its fat
+// box nothing changes, and otherwise the leaf's box grows
+// and its ancestors are refit, without any restructuring.
+// The tree gets worse over time this way, so it tracks its
+// surface area cost and RebuildIfDegraded() rebuilds it
+// from scratch (top down, binned SAH, in parallel) once
+// that cost has grown too much.
+//
+// Each object carries a number (like an entity index) that
+// queries hand back.
+// --------------------------------------------------------
+class SpatialIndex
+{
+public:
+	SpatialIndex();
+
+	// Returns the object's id, which stays the same until it's removed
+	uint32_t Insert(const DirectX::BoundingBox& box, uint32_t data);
+	void Remove(uint32_t id);
+	void Move(uint32_t id, const DirectX::BoundingBox& box);
+
+	uint32_t GetData(uint32_t id) { return nodes[id].data; }
+	DirectX::BoundingBox GetBox(uint32_t id);
+
+	// Queries add the data of each object they find to results
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results);
+	void QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<uint32_t>& results);
+	void QueryBox(const DirectX::BoundingBox& box, std::vector<uint32_t>& results);
+
+	// The k objects closest to a point (by their boxes), nearest first
+	void QueryNearest(DirectX::XMFLOAT3 point, unsigned int k, std::vector<uint32_t>& results);
+
+	// The first object box along a ray (direction needn't be normalized,
+	// and distances are in multiples of it).  False if nothing's hit.
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, uint32_t& hitData, float& hitDistance);
+
+	void Rebuild(bool allowThreads = true);
+	bool RebuildIfDegraded(bool allowThreads = true);
+
+	// Total surface area of the internal nodes over that of the leaves
+	// (kept up to date as boxes change, so this is cheap every frame)
+	float GetCost() { return leafArea > 0 ? (float)(internalArea / leafArea) : 0; }
+	unsigned int GetHeight() { return root == SPATIAL_NULL ? 0 : (unsigned int)nodes[root].height; }
+	unsigned int GetCount() { return leafCount; }
+
+	// Scatters boxes around and times building, updating and querying
+	static SpatialIndexTimings MeasureSpatialIndex(unsigned int numObjects);
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+		uint32_t parent;		// The next free node, for free nodes
+		uint32_t children[2];	// SPATIAL_NULL in leaves
+		int height;				// 0 for leaves, -1 for free nodes
+		uint32_t data;
+	};
+
+	std::vector<Node> nodes;
+
+	// The real boxes of the leaves (the tree itself only has the fat ones)
+	std::vector<DirectX::XMFLOAT3> objectMins;
+	std::vector<DirectX::XMFLOAT3> objectMaxes;
+
+	uint32_t root;
+	uint32_t freeList;
+	unsigned int leafCount;
+	float buildCost;
+
+	// Surface area sums behind GetCost(), updated by SetBox()
+	double internalArea;
+	double leafArea;
+
+	bool IsLeaf(uint32_t node) { return nodes[node].children[0] == SPATIAL_NULL; }
+	uint32_t AllocateNode();
+	void FreeNode(uint32_t node);
+
+	void InsertLeaf(uint32_t leaf);
+	void RemoveLeaf(uint32_t leaf);
+	void FixUpwards(uint32_t node);
+	uint32_t Balance(uint32_t node);
+	void SetBox(uint32_t node, DirectX::XMFLOAT3 min, DirectX::XMFLOAT3 max);
+	void SetBoxFromChildren(uint32_t node);
+	void RecountArea();
+
+	uint32_t Build(std::vector<uint32_t>& leaves, size_t first, size_t last,
+		const std::vector<uint32_t>& internalNodes, size_t internalOffset, unsigned int parallelDepth);
+
+	void AddSubtree(uint32_t node, std::vector<uint32_t>& results);
+};
@@ -0,0 +1,293 @@
+#include "StaticBatcher.h"
+#include "Assets.h"
+#include "ProceduralMesh.h"
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+// Singleton requirement
+StaticBatcher* StaticBatcher::instance;
+
+StaticBatcher::StaticBatcher()
+{
+	cookedBatches = 0;
+	enabled = true;
+}
+
+void StaticBatcher::Add(std::string meshName, Material* material, XMFLOAT3 position, XMFLOAT4 rotation, XMFLOAT3 scale)
+{
+	pending.push_back({ meshName, material, position, rotation, scale });
+}
+
+void StaticBatcher::Cook(EntityManager& entities)
+{
+	if (pending.empty())
+		return;
+
+	// Every mesh's source data, loaded once no matter how many instances use it
+	Assets& assets = Assets::GetInstance();
+	std::unordered_map<std::string, SourceMesh> sources;
+	for (const Instance& i : pending)
+	{
+		if (sources.find(i.mesh) != sources.end())
+			continue;
+
+		SourceMesh& source = sources[i.mesh];
+		if (!assets.LoadMeshData(i.mesh, source.verts, source.indices))
+		{
+			source.verts.clear();
+			source.indices.clear();
+		}
+	}
+
+	std::vector<Batch> batches = GroupInstances(pending, sources);
+	MergeBatches(batches, pending, sources, true);
+
+	// The unbatched entities, drawn as they would have been without cooking
+	TransformStore& store = TransformStore::GetInstance();
+	for (const Instance& i : pending)
+	{
+		std::shared_ptr<Mesh> mesh = assets.GetMesh(i.mesh);
+		if (!mesh || sources[i.mesh].verts.empty())
+			continue;
+
+		uint32_t transform = store.Allocate();
+		store.SetPosition(transform, i.position);
+		store.SetRotation(transform, i.rotation);
+		store.SetScale(transform, i.scale);
+
+		MeshRendererComponent renderer = { mesh.get(), i.material };
+		instanceEntities.push_back(enabled ?
+			entities.Create(TransformComponent{ transform }) :
+			entities.Create(TransformComponent{ transform }, renderer));
+		instanceRenderers.push_back(renderer);
+	}
+
+	// The batches, already in world space
+	for (Batch& batch : batches)
+	{
+		std::shared_ptr<Mesh> mesh = assets.CreateMesh(
+			"static:" + std::to_string(cookedBatches++),
+			batch.verts.data(), (int)batch.verts.size(),
+			batch.indices.data(), (int)batch.indices.size(),
+			MESH_FLAG_POSITION_STREAM);
+
+		MeshRendererComponent renderer = { mesh.get(), batch.material };
+		uint32_t transform = store.Allocate();
+		batchEntities.push_back(enabled ?
+			entities.Create(TransformComponent{ transform }, renderer) :
+			entities.Create(TransformComponent{ transform }));
+		batchRenderers.push_back(renderer);
+	}
+
+	pending.clear();
+}
+
+void StaticBatcher::SetEnabled(EntityManager& entities, bool enabled)
+{
+	if (this->enabled == enabled)
+		return;
+
+	this->enabled = enabled;
+	for (size_t i = 0; i < instanceEntities.size(); i++)
+	{
+		if (!entities.IsAlive(instanceEntities[i])) continue;
+		if (enabled) entities.Remove<MeshRendererComponent>(instanceEntities[i]);
+		else entities.Add(instanceEntities[i], instanceRenderers[i]);
+	}
+
+	for (size_t i = 0; i < batchEntities.size(); i++)
+	{
+		if (!entities.IsAlive(batchEntities[i])) continue;
+		if (enabled) entities.Add(batchEntities[i], batchRenderers[i]);
+		else entities.Remove<MeshRendererComponent>(batchEntities[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Sorts the instances by material and then chunk, so each
+// group is one run, and splits runs that get too big.
+// Instances whose mesh couldn't be loaded are left out.
+// --------------------------------------------------------
+std::vector<StaticBatcher::Batch> StaticBatcher::GroupInstances(const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources)
+{
+	struct Key
+	{
+		Material* material;
+		int chunkX, chunkZ;
+		uint32_t instance;
+	};
+
+	std::vector<Key> keys;
+	keys.reserve(instances.size());
+	for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+	{
+		if (sources.at(instances[i].mesh).verts.empty())
+			continue;
+
+		keys.push_back({
+			instances[i].material,
+			(int)floorf(instances[i].position.x / STATIC_BATCH_CHUNK_SIZE),
+			(int)floorf(instances[i].position.z / STATIC_BATCH_CHUNK_SIZE),
+			i });
+	}
+
+	std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b)
+		{
+			if (a.material != b.material) return a.material < b.material;
+			if (a.chunkZ != b.chunkZ) return a.chunkZ < b.chunkZ;
+			if (a.chunkX != b.chunkX) return a.chunkX < b.chunkX;
+			return a.instance < b.instance;
+		});
+
+	std::vector<Batch> batches;
+	size_t batchVertices = 0;
+	for (size_t k = 0; k < keys.size(); k++)
+	{
+		size_t vertices = sources.at(instances[keys[k].instance].mesh).verts.size();
+		bool sameGroup = k > 0 &&
+			keys[k].material == keys[k - 1].material &&
+			keys[k].chunkX == keys[k - 1].chunkX &&
+			keys[k].chunkZ == keys[k - 1].chunkZ;
+
+		if (!sameGroup || batchVertices + vertices > STATIC_BATCH_MAX_VERTICES)
+		{
+			batches.push_back({ keys[k].material });
+			batchVertices = 0;
+		}
+
+		batches.back().instances.push_back(keys[k].instance);
+		batchVertices += vertices;
+	}
+
+	return batches;
+}
+
+void StaticBatcher::MergeBatches(std::vector<Batch>& batches, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources, bool allowThreads)
+{
+	size_t numBatches = batches.size();
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	size_t perJob = (numBatches + cores - 1) / cores;
+	if (cores == 1 || numBatches < 2)
+	{
+		for (Batch& batch : batches)
+			MergeBatch(batch, instances, sources);
+		return;
+	}
+
+	std::vector<std::future<void>> jobs;
+	for (size_t first = perJob; first < numBatches; first += perJob)
+	{
+		size_t last = std::min(first + perJob, numBatches);
+		jobs.push_back(std::async(std::launch::async, [&batches, &instances, &sources, first, last]()
+			{
+				for (size_t b = first; b < last; b++)
+					MergeBatch(batches[b], instances, sources);
+			}));
+	}
+
+	for (size_t b = 0; b < std::min(perJob, numBatches); b++)
+		MergeBatch(batches[b], instances, sources);
+	for (std::future<void>& job : jobs)
+		job.get();
+}
+
+void StaticBatcher::MergeBatch(Batch& batch, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources)
+{
+	size_t numVerts = 0, numIndices = 0;
+	for (uint32_t i : batch.instances)
+	{
+		const SourceMesh& source = sources.at(instances[i].mesh);
+		numVerts += source.verts.size();
+		numIndices += source.indices.size();
+	}
+	batch.verts.clear();
+	batch.indices.clear();
+	batch.verts.reserve(numVerts);
+	batch.indices.reserve(numIndices);
+
+	for (uint32_t i : batch.instances)
+	{
+		const Instance& instance = instances[i];
+		const SourceMesh& source = sources.at(instance.mesh);
+		AppendTransformed(source.verts, source.indices, instance.position, instance.rotation, instance.scale, batch.verts, batch.indices);
+	}
+}
+
+// --------------------------------------------------------
+// Normals go through the rotation with the inverse scale
+// (the inverse transpose, without a general inverse), and
+// mirrored instances get their winding flipped.  Tangents
+// are left for the mesh to rebuild.
+// --------------------------------------------------------
+void StaticBatcher::AppendTransformed(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, XMFLOAT3 position, XMFLOAT4 rotation, XMFLOAT3 scale, std::vector<Vertex>& outVerts, std::vector<unsigned int>& outIndices)
+{
+	XMVECTOR quaternion = XMLoadFloat4(&rotation);
+	XMMATRIX world = XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixRotationQuaternion(quaternion) * XMMatrixTranslation(position.x, position.y, position.z);
+	XMMATRIX normalMatrix = XMMatrixScaling(1.0f / scale.x, 1.0f / scale.y, 1.0f / scale.z) * XMMatrixRotationQuaternion(quaternion);
+	bool mirrored = scale.x * scale.y * scale.z < 0;
+
+	unsigned int baseVertex = (unsigned int)outVerts.size();
+	for (const Vertex& v : verts)
+	{
+		Vertex w = v;
+		XMStoreFloat3(&w.Position, XMVector3Transform(XMLoadFloat3(&v.Position), world));
+		XMStoreFloat3(&w.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v.Normal), normalMatrix)));
+		w.Tangent = XMFLOAT3(0, 0, 0);
+		outVerts.push_back(w);
+	}
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		outIndices.push_back(baseVertex + indices[t]);
+		outIndices.push_back(baseVertex + indices[t + (mirrored ? 2 : 1)]);
+		outIndices.push_back(baseVertex + indices[t + (mirrored ? 1 : 2)]);
+	}
+}
+
+StaticBatchTimings StaticBatcher::MeasureCook(unsigned int numInstances)
+{
+	StaticBatchTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// Shapes are generated straight away, so this needs no assets or GPU
+	const char* shapes[] = { "cube", "sphere:16", "cylinder:16" };
+	std::unordered_map<std::string, SourceMesh> sources;
+	for (const char* shape : shapes)
+		ProceduralMesh::Generate(shape, sources[shape].verts, sources[shape].indices);
+
+	// Instances scattered over a few hundred units with two materials
+	Material* materials[] = { reinterpret_cast<Material*>(1), reinterpret_cast<Material*>(2) };
+	std::vector<Instance> instances(numInstances);
+	for (Instance& i : instances)
+	{
+		i.mesh = shapes[rand() % 3];
+		i.material = materials[rand() % 2];
+		i.position = XMFLOAT3(random(-200, 200), 0, random(-200, 200));
+		XMStoreFloat4(&i.rotation, XMQuaternionRotationRollPitchYaw(0, random(0, XM_2PI), 0));
+		float scale = random(0.5f, 2.0f);
+		i.scale = XMFLOAT3(scale, scale, scale);
+	}
+
+	std::vector<Batch> batches = GroupInstances(instances, sources);
+	timings.instances = numInstances;
+	timings.batches = (unsigned int)batches.size();
+
+	for (bool threaded : { false, true })
+	{
+		auto start = now();
+		MergeBatches(batches, instances, sources, threaded);
+		(threaded ? timings.mergeThreadedMs : timings.mergeMs) = std::chrono::duration<double, std::milli>(now() - start).count();
+	}
+
+	for (const Batch& batch : batches)
+		timings.vertices += (unsigned int)batch.verts.size();
+
+	return timings;
+}
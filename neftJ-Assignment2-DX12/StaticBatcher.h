@@ -0,0 +1,134 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EntityManager.h"
+#include "Components.h"
+#include "Vertex.h"
+
+class Material;
+
+// Static scenery is merged per material within square chunks of the
+// ground this wide, so each batch is still small enough to cull
+#define STATIC_BATCH_CHUNK_SIZE		32.0f
+
+// A chunk's batch is split once it would have more vertices than this
+#define STATIC_BATCH_MAX_VERTICES	65536
+
+// Timings from MeasureCook()
+struct StaticBatchTimings
+{
+	unsigned int instances;
+	unsigned int batches;
+	unsigned int vertices;		// In all of the batches together
+	double mergeMs;				// Transforming and merging, one thread
+	double mergeThreadedMs;		// The same on all cores
+};
+
+// --------------------------------------------------------
+// Cooks scenery that never moves into a few big meshes.
+//
+// Static instances (a mesh by asset name, a material and
+// a transform) are added while the scene is built and then
+// cooked once.  Cooking groups them by material and by the
+// chunk of the ground they stand in, transforms each one's
+// vertices into world space (across all cores) and merges
+// every group into one mesh, drawn by one entity with an
+// identity transform.  One draw, constant buffer fill and
+// descriptor table then covers the whole group.
+//
+// Every instance also gets an entity of its own, which is
+// only drawn while batching is off, so the two can be
+// compared.  Nothing that's been cooked can move.
+// --------------------------------------------------------
+class StaticBatcher
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static StaticBatcher& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new StaticBatcher();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	StaticBatcher(StaticBatcher const&) = delete;
+	void operator=(StaticBatcher const&) = delete;
+
+private:
+	static StaticBatcher* instance;
+	StaticBatcher();
+#pragma endregion
+
+public:
+	// Rotation is a quaternion
+	void Add(std::string meshName, Material* material, DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale);
+
+	// Builds the batches and every entity for what's been added so far (which
+	// creates meshes, so this goes inside an upload batch)
+	void Cook(EntityManager& entities);
+
+	// Swaps which set of entities is drawn
+	void SetEnabled(EntityManager& entities, bool enabled);
+	bool GetEnabled() { return enabled; }
+
+	unsigned int GetInstanceCount() { return (unsigned int)instanceEntities.size(); }
+	unsigned int GetBatchCount() { return (unsigned int)batchEntities.size(); }
+
+	// Appends a mesh moved into world space (with its indices offset to
+	// match), for anything else that merges meshes
+	static void AppendTransformed(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices,
+		DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale,
+		std::vector<Vertex>& outVerts, std::vector<unsigned int>& outIndices);
+
+	// Scatters instances of a few meshes and times merging them
+	static StaticBatchTimings MeasureCook(unsigned int numInstances);
+
+private:
+	struct Instance
+	{
+		std::string mesh;
+		Material* material;
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT4 rotation;
+		DirectX::XMFLOAT3 scale;
+	};
+
+	struct SourceMesh
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+	};
+
+	// A group of instances and, once merged, their geometry in world space
+	struct Batch
+	{
+		Material* material;
+		std::vector<uint32_t> instances;
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+	};
+
+	std::vector<Instance> pending;
+	unsigned int cookedBatches;
+	bool enabled;
+
+	// Both sets of entities, with what each draws while it's the enabled set
+	std::vector<Entity> instanceEntities;
+	std::vector<MeshRendererComponent> instanceRenderers;
+	std::vector<Entity> batchEntities;
+	std::vector<MeshRendererComponent> batchRenderers;
+
+	static std::vector<Batch> GroupInstances(const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources);
+	static void MergeBatches(std::vector<Batch>& batches, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources, bool allowThreads);
+	static void MergeBatch(Batch& batch, const std::vector<Instance>& instances, const std::unordered_map<std::string, SourceMesh>& sources);
+};
@@ -17,4 +17,26 @@ struct D3D12_HANDLE_BUNDLE
 {
 	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle;
 	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+};
+
+// Results of one DX12Helper upload batch
+struct UploadBatchStats
+{
+	unsigned long long bytesUploaded;
+	unsigned int copyCount;
+	unsigned int submitCount;
+	unsigned long long stagingBytesAllocated;
+	double seconds;				// Whole batch, including whatever the caller did in between
+	double copySeconds;			// Only from submitting the copies to the GPU finishing them
+	double megabytesPerSecond;	// Over copySeconds
+};
+
+// What the renderer did last frame
+struct RenderStats
+{
+	unsigned int draws;		// Every draw call, depth prepass included
+	unsigned int items;		// Render items that passed culling
+	unsigned int constantBuffers;	// Filled this frame, out of maxConstantBuffers
+	unsigned int maxConstantBuffers;
+	double cpuMs;			// Recording the frame, up to presenting it
 };
\ No newline at end of file
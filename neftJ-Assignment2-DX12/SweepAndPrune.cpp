@@ -0,0 +1,320 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+SweepAndPrune::SweepAndPrune()
+{
+	addedSinceUpdate = 0;
+	removedSinceUpdate = 0;
+}
+
+uint32_t SweepAndPrune::Add(const BoundingBox& box, uint32_t data)
+{
+	uint32_t id;
+	if (!freeIds.empty())
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		id = (uint32_t)mins.size();
+		mins.emplace_back();
+		maxs.emplace_back();
+		this->data.push_back(0);
+		alive.push_back(0);
+	}
+
+	this->data[id] = data;
+	alive[id] = 1;
+	Move(id, box);
+
+	// The new endpoints start at the end and are sorted into place by the
+	// next update, which finds the new body's pairs as they pass the others
+	for (int axis = 0; axis < 3; axis++)
+	{
+		axes[axis].push_back({ 0, id * 2 });
+		axes[axis].push_back({ 0, id * 2 + 1 });
+	}
+
+	addedSinceUpdate++;
+	return id;
+}
+
+void SweepAndPrune::Remove(uint32_t id)
+{
+	// Its endpoints and pairs go in the next update
+	alive[id] = 0;
+	pendingFree.push_back(id);
+	removedSinceUpdate++;
+}
+
+void SweepAndPrune::Move(uint32_t id, const BoundingBox& box)
+{
+	mins[id] = XMFLOAT4(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z, 0);
+	maxs[id] = XMFLOAT4(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z, 0);
+}
+
+// --------------------------------------------------------
+// Drops removed bodies, refreshes every endpoint from its
+// body's box and re-sorts.  After a lot of adds or removes
+// it's quicker to sort from scratch and sweep for pairs,
+// and otherwise the insertion sort finds the changes.
+// --------------------------------------------------------
+void SweepAndPrune::Update()
+{
+	added.clear();
+	removed.clear();
+	changed.clear();
+
+	if (removedSinceUpdate > 0)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			std::vector<Endpoint>& endpoints = axes[axis];
+			endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+				[this](const Endpoint& e) { return !alive[e.code / 2]; }), endpoints.end());
+		}
+
+		for (auto it = pairs.begin(); it != pairs.end();)
+		{
+			uint32_t a = (uint32_t)(*it >> 32), b = (uint32_t)*it;
+			if (alive[a] && alive[b])
+			{
+				++it;
+				continue;
+			}
+
+			changed.emplace(*it, true);
+			it = pairs.erase(it);
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (Endpoint& e : axes[axis])
+		{
+			const XMFLOAT4& corner = (e.code & 1) ? maxs[e.code / 2] : mins[e.code / 2];
+			e.value = (&corner.x)[axis];
+		}
+	}
+
+	unsigned int count = GetCount();
+	if (addedSinceUpdate + removedSinceUpdate > count * SAP_REBUILD_FRACTION)
+	{
+		Rebuild();
+	}
+	else
+	{
+		for (int axis = 0; axis < 3; axis++)
+			InsertionSort(axis);
+	}
+
+	// Only pairs that are different from before the update are events
+	for (const auto& [key, existed] : changed)
+	{
+		bool exists = pairs.count(key) != 0;
+		if (exists == existed)
+			continue;
+
+		OverlapPair pair = { (uint32_t)(key >> 32), (uint32_t)key };
+		(exists ? added : removed).push_back(pair);
+	}
+	changed.clear();
+
+	// Removed ids can be handed out again now their pairs have been reported
+	freeIds.insert(freeIds.end(), pendingFree.begin(), pendingFree.end());
+	pendingFree.clear();
+	addedSinceUpdate = 0;
+	removedSinceUpdate = 0;
+}
+
+void SweepAndPrune::GetPairs(std::vector<OverlapPair>& results)
+{
+	results.reserve(results.size() + pairs.size());
+	for (uint64_t key : pairs)
+		results.push_back({ (uint32_t)(key >> 32), (uint32_t)key });
+}
+
+// Mins come before maxes at the same value, so boxes that only touch still overlap
+bool SweepAndPrune::Before(const Endpoint& a, const Endpoint& b)
+{
+	return a.value < b.value || (a.value == b.value && !(a.code & 1) && (b.code & 1));
+}
+
+bool SweepAndPrune::Overlaps(uint32_t a, uint32_t b) const
+{
+	XMVECTOR minA = XMLoadFloat4(&mins[a]);
+	XMVECTOR maxA = XMLoadFloat4(&maxs[a]);
+	XMVECTOR minB = XMLoadFloat4(&mins[b]);
+	XMVECTOR maxB = XMLoadFloat4(&maxs[b]);
+	return XMVector3LessOrEqual(minA, maxB) && XMVector3LessOrEqual(minB, maxA);
+}
+
+void SweepAndPrune::AddPair(uint32_t a, uint32_t b)
+{
+	uint64_t key = PairKey(a, b);
+	if (pairs.insert(key).second)
+		changed.emplace(key, false);
+}
+
+void SweepAndPrune::RemovePair(uint32_t a, uint32_t b)
+{
+	uint64_t key = PairKey(a, b);
+	if (pairs.erase(key))
+		changed.emplace(key, true);
+}
+
+// --------------------------------------------------------
+// Insertion sort, which always moves the right hand one of
+// two endpoints that are out of order.  If a min moves left
+// past a max, the two bodies now overlap on this axis and
+// might overlap on all of them.  If a max moves left past a
+// min, they no longer overlap on this axis at all.
+// --------------------------------------------------------
+void SweepAndPrune::InsertionSort(int axis)
+{
+	std::vector<Endpoint>& endpoints = axes[axis];
+	for (size_t i = 1; i < endpoints.size(); i++)
+	{
+		Endpoint e = endpoints[i];
+		size_t j = i;
+		while (j > 0 && Before(e, endpoints[j - 1]))
+		{
+			const Endpoint& passed = endpoints[j - 1];
+			bool isMax = (e.code & 1) != 0;
+			bool passedIsMax = (passed.code & 1) != 0;
+			if (!isMax && passedIsMax)
+			{
+				if (Overlaps(e.code / 2, passed.code / 2))
+					AddPair(e.code / 2, passed.code / 2);
+			}
+			else if (isMax && !passedIsMax)
+			{
+				RemovePair(e.code / 2, passed.code / 2);
+			}
+
+			endpoints[j] = passed;
+			j--;
+		}
+		endpoints[j] = e;
+	}
+}
+
+// --------------------------------------------------------
+// Sorts every axis from scratch and finds all pairs with a
+// sweep along x, keeping a list of the bodies whose range
+// on x the sweep is inside
+// --------------------------------------------------------
+void SweepAndPrune::Rebuild()
+{
+	for (int axis = 0; axis < 3; axis++)
+		std::sort(axes[axis].begin(), axes[axis].end(), Before);
+
+	// The active bodies' boxes are kept side by side, so checking a new
+	// body against all of them streams through memory
+	struct ActiveBody
+	{
+		XMFLOAT4 min;
+		XMFLOAT4 max;
+		uint32_t body;
+	};
+
+	std::unordered_set<uint64_t> found;
+	found.reserve(pairs.size());
+	std::vector<ActiveBody> active;
+	std::vector<uint32_t> activeSlot(mins.size());
+	for (const Endpoint& e : axes[0])
+	{
+		uint32_t body = e.code / 2;
+		if (e.code & 1)
+		{
+			uint32_t slot = activeSlot[body];
+			active[slot] = active.back();
+			activeSlot[active[slot].body] = slot;
+			active.pop_back();
+			continue;
+		}
+
+		XMVECTOR bodyMin = XMLoadFloat4(&mins[body]);
+		XMVECTOR bodyMax = XMLoadFloat4(&maxs[body]);
+		for (const ActiveBody& other : active)
+		{
+			if (XMVector3LessOrEqual(bodyMin, XMLoadFloat4(&other.max)) &&
+				XMVector3LessOrEqual(XMLoadFloat4(&other.min), bodyMax))
+				found.insert(PairKey(body, other.body));
+		}
+		activeSlot[body] = (uint32_t)active.size();
+		active.push_back({ mins[body], maxs[body], body });
+	}
+
+	for (uint64_t key : pairs)
+	{
+		if (!found.count(key))
+			changed.emplace(key, true);
+	}
+	for (uint64_t key : found)
+	{
+		if (!pairs.count(key))
+			changed.emplace(key, false);
+	}
+	pairs.swap(found);
+}
+
+SweepAndPruneTimings SweepAndPrune::MeasureSweepAndPrune(unsigned int numBodies, unsigned int numFrames)
+{
+	SweepAndPruneTimings timings = {};
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// Boxes of a few sizes drifting around inside a cube, bouncing off its sides
+	const float halfSize = 500.0f;
+	SweepAndPrune broadphase;
+	std::vector<BoundingBox> boxes(numBodies);
+	std::vector<XMFLOAT3> velocities(numBodies);
+	std::vector<uint32_t> ids(numBodies);
+	for (unsigned int i = 0; i < numBodies; i++)
+	{
+		float extent = random(1.0f, 4.0f);
+		boxes[i] = BoundingBox(XMFLOAT3(random(-halfSize, halfSize), random(-halfSize, halfSize), random(-halfSize, halfSize)), XMFLOAT3(extent, extent, extent));
+		velocities[i] = XMFLOAT3(random(-0.1f, 0.1f), random(-0.1f, 0.1f), random(-0.1f, 0.1f));
+		ids[i] = broadphase.Add(boxes[i], i);
+	}
+
+	auto start = now();
+	broadphase.Update();
+	timings.buildMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+	double totalMs = 0;
+	uint64_t totalAdded = 0, totalRemoved = 0;
+	for (unsigned int frame = 0; frame < numFrames; frame++)
+	{
+		for (unsigned int i = 0; i < numBodies; i++)
+		{
+			float* center = &boxes[i].Center.x;
+			float* velocity = &velocities[i].x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				center[axis] += velocity[axis];
+				if (center[axis] < -halfSize || center[axis] > halfSize)
+					velocity[axis] = -velocity[axis];
+			}
+			broadphase.Move(ids[i], boxes[i]);
+		}
+
+		start = now();
+		broadphase.Update();
+		totalMs += std::chrono::duration<double, std::milli>(now() - start).count();
+		totalAdded += broadphase.GetAddedPairs().size();
+		totalRemoved += broadphase.GetRemovedPairs().size();
+	}
+
+	timings.updateMs = numFrames ? totalMs / numFrames : 0;
+	timings.pairs = broadphase.GetPairCount();
+	timings.added = numFrames ? (unsigned int)(totalAdded / numFrames) : 0;
+	timings.removed = numFrames ? (unsigned int)(totalRemoved / numFrames) : 0;
+	return timings;
+}
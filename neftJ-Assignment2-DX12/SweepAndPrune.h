@@ -0,0 +1,114 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Once more than this fraction of the bodies have been added or
+// removed since the last update, the next one re-sorts everything
+// from scratch instead of inserting them one by one
+#define SAP_REBUILD_FRACTION	0.1f
+
+// Two bodies whose boxes overlap (by id, with a lower than b)
+struct OverlapPair
+{
+	uint32_t a;
+	uint32_t b;
+};
+
+// Timings from MeasureSweepAndPrune()
+struct SweepAndPruneTimings
+{
+	double buildMs;				// First update, sorting everything from scratch
+	double updateMs;			// Average update with every body moving a little
+	unsigned int pairs;			// Overlapping at the end
+	unsigned int added;			// Average pairs starting and...
+	unsigned int removed;		// ...ending per update
+};
+
+// --------------------------------------------------------
+// Broadphase that keeps the set of bodies whose boxes
+// overlap.
+//
+// Each axis has a sorted array of every body's min and max
+// endpoints, and two boxes overlap on an axis exactly when
+// each one's min comes before the other's max.  As bodies
+// only move a little from one frame to the next, the arrays
+// are nearly sorted already, so each update re-sorts them
+// with an insertion sort.  That only swaps endpoints that
+// passed each other, and those swaps are the only times a
+// pair can start or stop overlapping: a min passing a max
+// might start a pair (if the boxes now overlap on every
+// axis, which is one SIMD compare), and a max passing a min
+// ends one.
+//
+// Pairs persist between updates, and each update lists the
+// pairs that started and ended during it.  An id that's been
+// removed isn't reused until after the update that reports
+// its pairs ending, so events never mix two bodies up.
+// --------------------------------------------------------
+class SweepAndPrune
+{
+public:
+	SweepAndPrune();
+
+	// Returns the body's id, which stays the same until it's removed
+	uint32_t Add(const DirectX::BoundingBox& box, uint32_t data);
+	void Remove(uint32_t id);
+	void Move(uint32_t id, const DirectX::BoundingBox& box);
+
+	uint32_t GetData(uint32_t id) { return data[id]; }
+
+	// Re-sorts the endpoints and updates the pairs for everything since the last update
+	void Update();
+
+	// Every overlapping pair, and those that started or ended in the last update
+	void GetPairs(std::vector<OverlapPair>& results);
+	const std::vector<OverlapPair>& GetAddedPairs() { return added; }
+	const std::vector<OverlapPair>& GetRemovedPairs() { return removed; }
+	unsigned int GetPairCount() { return (unsigned int)pairs.size(); }
+	bool IsOverlapping(uint32_t a, uint32_t b) { return pairs.count(PairKey(a, b)) != 0; }
+
+	unsigned int GetCount() { return (unsigned int)(mins.size() - freeIds.size() - pendingFree.size()); }
+
+	// Scatters bodies that drift around a box and times keeping their pairs
+	static SweepAndPruneTimings MeasureSweepAndPrune(unsigned int numBodies, unsigned int numFrames);
+
+private:
+	// An endpoint's body is its code / 2, and odd codes are maxes
+	struct Endpoint
+	{
+		float value;
+		uint32_t code;
+	};
+
+	// Per body (w is unused, so each box loads straight into an XMVECTOR)
+	std::vector<DirectX::XMFLOAT4> mins;
+	std::vector<DirectX::XMFLOAT4> maxs;
+	std::vector<uint32_t> data;
+	std::vector<uint8_t> alive;
+	std::vector<uint32_t> freeIds;
+	std::vector<uint32_t> pendingFree;
+
+	std::vector<Endpoint> axes[3];
+	unsigned int addedSinceUpdate;
+	unsigned int removedSinceUpdate;
+
+	std::unordered_set<uint64_t> pairs;
+	std::vector<OverlapPair> added;
+	std::vector<OverlapPair> removed;
+
+	// Pairs changed during this update, and whether each existed before it
+	std::unordered_map<uint64_t, bool> changed;
+
+	static uint64_t PairKey(uint32_t a, uint32_t b) { return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a; }
+	static bool Before(const Endpoint& a, const Endpoint& b);
+	bool Overlaps(uint32_t a, uint32_t b) const;
+	void AddPair(uint32_t a, uint32_t b);
+	void RemovePair(uint32_t a, uint32_t b);
+	void InsertionSort(int axis);
+	void Rebuild();
+};
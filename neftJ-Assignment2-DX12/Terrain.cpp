@@ -0,0 +1,654 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace DirectX;
+
+static float DistanceSquared(XMFLOAT3 point, XMFLOAT3 min, XMFLOAT3 max)
+{
+	float x = std::max(std::max(min.x - point.x, 0.0f), point.x - max.x);
+	float y = std::max(std::max(min.y - point.y, 0.0f), point.y - max.y);
+	float z = std::max(std::max(min.z - point.z, 0.0f), point.z - max.z);
+	return x * x + y * y + z * z;
+}
+
+// -1 if the box is entirely outside the frustum, 1 if it's entirely inside, 0 if it crosses
+static int ClassifyBox(const Frustum& frustum, XMFLOAT3 min, XMFLOAT3 max)
+{
+	XMFLOAT3 center((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+	XMFLOAT3 extents((max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f);
+
+	int result = 1;
+	for (const XMFLOAT4& p : frustum.planes)
+	{
+		float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float reach = fabsf(p.x) * extents.x + fabsf(p.y) * extents.y + fabsf(p.z) * extents.z;
+		if (distance < -reach)
+			return -1;
+		if (distance < reach)
+			result = 0;
+	}
+
+	return result;
+}
+
+// A value in [0, 1) for each point of a noise lattice
+static float LatticeValue(unsigned int seed, int x, int z)
+{
+	uint32_t h = seed * 0x9E3779B9u ^ (uint32_t)x * 0x85EBCA6Bu ^ (uint32_t)z * 0xC2B2AE35u;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// --------------------------------------------------------
+// Fills a tile from octaves of value noise over the whole
+// field, so neighbouring tiles agree on the samples they
+// share.  Each row blends the lattice rows above and below
+// it once, leaving one lerp per sample per octave.
+// --------------------------------------------------------
+static void GenerateTile(unsigned int seed, int tileX, int tileZ, std::vector<uint16_t>& samples)
+{
+	const unsigned int firstShift = 12;	// Lattice every 4096 samples...
+	const unsigned int lastShift = 5;	// ...down to every 32
+	const int baseX = tileX * TERRAIN_TILE_SIZE;
+	const int baseZ = tileZ * TERRAIN_TILE_SIZE;
+
+	std::vector<float> heights(TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES, 0.0f);
+	std::vector<float> weights;
+	std::vector<float> column;
+	float amplitude = 0.5f;
+	float total = 0.0f;
+	for (unsigned int shift = firstShift; shift >= lastShift; shift--, amplitude *= 0.5f)
+	{
+		unsigned int octaveSeed = seed + shift * 1013;
+		int period = 1 << shift;
+
+		// Smoothstep across each lattice cell
+		weights.resize(period);
+		for (int i = 0; i < period; i++)
+		{
+			float t = (float)i / period;
+			weights[i] = t * t * (3.0f - 2.0f * t);
+		}
+
+		int firstCell = baseX >> shift;
+		int cells = ((baseX + TERRAIN_TILE_SIZE) >> shift) - firstCell + 2;
+		column.resize(cells);
+		for (int z = 0; z < TERRAIN_TILE_SAMPLES; z++)
+		{
+			int sampleZ = baseZ + z;
+			int cellZ = sampleZ >> shift;
+			float weightZ = weights[sampleZ & (period - 1)];
+			for (int c = 0; c < cells; c++)
+			{
+				float a = LatticeValue(octaveSeed, firstCell + c, cellZ);
+				float b = LatticeValue(octaveSeed, firstCell + c, cellZ + 1);
+				column[c] = a + (b - a) * weightZ;
+			}
+
+			float* row = &heights[z * TERRAIN_TILE_SAMPLES];
+			for (int x = 0; x < TERRAIN_TILE_SAMPLES; x++)
+			{
+				int sampleX = baseX + x;
+				int c = (sampleX >> shift) - firstCell;
+				float weightX = weights[sampleX & (period - 1)];
+				row[x] += amplitude * (column[c] + (column[c + 1] - column[c]) * weightX);
+			}
+		}
+
+		total += amplitude;
+	}
+
+	// Octave sums bunch up around the middle, so they're stretched out
+	// to the full range, then squared for flatter valleys and sharper peaks
+	samples.resize(heights.size());
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		float h = std::min(std::max((heights[i] / total - 0.3f) * 2.5f, 0.0f), 1.0f);
+		samples[i] = (uint16_t)(h * h * 65535.0f + 0.5f);
+	}
+}
+
+Terrain::Terrain()
+{
+	desc = {};
+	tilesAcross = 0;
+	leavesAcross = 0;
+	lodCount = 0;
+	loadRadius = 0;
+	for (float& range : ranges)
+		range = 0;
+}
+
+Terrain::~Terrain()
+{
+	WaitForLoads();
+}
+
+void Terrain::WaitForLoads()
+{
+	for (std::unique_ptr<Tile>& tile : tiles)
+	{
+		if (tile->load.valid())
+			tile->load.wait();
+	}
+}
+
+bool Terrain::Create(const TerrainDesc& desc, TerrainTileLoader loader, bool allowThreads)
+{
+	WaitForLoads();
+	tiles.clear();
+	slotSamples.clear();
+	freeSlots.clear();
+	filledSlots.clear();
+	heightRanges.clear();
+	overview.clear();
+	lodCount = 0;
+
+	// The quadtree needs a power of two leaves across
+	unsigned int across = desc.size / TERRAIN_TILE_SIZE;
+	if (!loader || across == 0 || desc.size % TERRAIN_TILE_SIZE != 0 ||
+		across > TERRAIN_MAX_TILES_ACROSS || (across & (across - 1)) != 0)
+		return false;
+
+	this->desc = desc;
+	this->loader = loader;
+	tilesAcross = across;
+	leavesAcross = desc.size / TERRAIN_LEAF_SIZE;
+	lodCount = 1;
+	while ((1u << (lodCount - 1)) < leavesAcross)
+		lodCount++;
+
+	float leafSize = TERRAIN_LEAF_SIZE * desc.spacing;
+	for (unsigned int lod = 0; lod < lodCount; lod++)
+		ranges[lod] = leafSize * TERRAIN_LOD0_RANGE * (float)(1u << lod);
+
+	heightRanges.resize(lodCount);
+	heightRanges[0].resize((size_t)leavesAcross * leavesAcross * 2);
+	overview.resize((size_t)(leavesAcross + 1) * (leavesAcross + 1));
+
+	// Tiles are shared out between the cores, each writing only its own leaves and overview samples
+	unsigned int numTiles = tilesAcross * tilesAcross;
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	unsigned int perJob = (numTiles + cores - 1) / cores;
+
+	std::vector<std::future<bool>> jobs;
+	for (unsigned int first = perJob; first < numTiles; first += perJob)
+	{
+		unsigned int last = std::min(first + perJob, numTiles);
+		jobs.push_back(std::async(std::launch::async, [this, first, last]() { return ReadTiles(first, last); }));
+	}
+
+	bool read = ReadTiles(0, std::min(perJob, numTiles));
+	for (std::future<bool>& job : jobs)
+		read = job.get() && read;
+
+	if (!read)
+	{
+		lodCount = 0;
+		return false;
+	}
+
+	// Each coarser LOD's ranges cover its four children's
+	for (unsigned int lod = 1; lod < lodCount; lod++)
+	{
+		unsigned int nodesAcross = leavesAcross >> lod;
+		const std::vector<uint16_t>& finer = heightRanges[lod - 1];
+		std::vector<uint16_t>& coarser = heightRanges[lod];
+		coarser.resize((size_t)nodesAcross * nodesAcross * 2);
+		for (unsigned int z = 0; z < nodesAcross; z++)
+		{
+			for (unsigned int x = 0; x < nodesAcross; x++)
+			{
+				const uint16_t* a = &finer[((z * 2) * (nodesAcross * 2) + x * 2) * 2];
+				const uint16_t* b = a + nodesAcross * 2 * 2;
+				uint16_t* node = &coarser[(z * nodesAcross + x) * 2];
+				node[0] = std::min(std::min(a[0], a[2]), std::min(b[0], b[2]));
+				node[1] = std::max(std::max(a[1], a[3]), std::max(b[1], b[3]));
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < numTiles; i++)
+	{
+		std::unique_ptr<Tile> tile = std::make_unique<Tile>();
+		tile->x = i % tilesAcross;
+		tile->z = i / tilesAcross;
+		tile->state = TileState::Unloaded;
+		tile->slot = -1;
+		tile->distance = 0;
+		tiles.push_back(std::move(tile));
+	}
+
+	slotSamples.resize(TERRAIN_MAX_RESIDENT_TILES);
+	for (unsigned int slot = TERRAIN_MAX_RESIDENT_TILES; slot > 0; slot--)
+		freeSlots.push_back(slot - 1);
+
+	// Nodes whose vertices are at least a leaf apart only land on the
+	// overview's samples, so tiles are only needed out to the finer LODs' ranges
+	unsigned int overviewLod = 0;
+	while ((1u << overviewLod) < TERRAIN_LEAF_SIZE)
+		overviewLod++;
+	loadRadius = ranges[std::min(overviewLod, lodCount) - 1];
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads tiles first to last (row by row), for the height
+// range of each leaf on them and their overview samples
+// --------------------------------------------------------
+bool Terrain::ReadTiles(unsigned int first, unsigned int last)
+{
+	const unsigned int leavesPerTile = TERRAIN_TILE_SIZE / TERRAIN_LEAF_SIZE;
+	const unsigned int overviewWidth = leavesAcross + 1;
+
+	std::vector<uint16_t> samples;
+	for (unsigned int t = first; t < last; t++)
+	{
+		unsigned int tileX = t % tilesAcross;
+		unsigned int tileZ = t / tilesAcross;
+		samples.clear();
+		if (!loader(tileX, tileZ, samples) || samples.size() != TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES)
+			return false;
+
+		// Leaves include their far edges, which they share with the next ones
+		for (unsigned int leafZ = 0; leafZ < leavesPerTile; leafZ++)
+		{
+			for (unsigned int leafX = 0; leafX < leavesPerTile; leafX++)
+			{
+				uint16_t low = 0xFFFF, high = 0;
+				for (unsigned int z = 0; z <= TERRAIN_LEAF_SIZE; z++)
+				{
+					const uint16_t* row = &samples[(leafZ * TERRAIN_LEAF_SIZE + z) * TERRAIN_TILE_SAMPLES + leafX * TERRAIN_LEAF_SIZE];
+					for (unsigned int x = 0; x <= TERRAIN_LEAF_SIZE; x++)
+					{
+						low = std::min(low, row[x]);
+						high = std::max(high, row[x]);
+					}
+				}
+
+				size_t leaf = (size_t)(tileZ * leavesPerTile + leafZ) * leavesAcross + tileX * leavesPerTile + leafX;
+				heightRanges[0][leaf * 2] = low;
+				heightRanges[0][leaf * 2 + 1] = high;
+			}
+		}
+
+		// The tile's leaf corners, leaving those on its far edges to the
+		// next tile unless it's at the edge of the field
+		unsigned int lastX = tileX == tilesAcross - 1 ? leavesPerTile : leavesPerTile - 1;
+		unsigned int lastZ = tileZ == tilesAcross - 1 ? leavesPerTile : leavesPerTile - 1;
+		for (unsigned int z = 0; z <= lastZ; z++)
+		{
+			for (unsigned int x = 0; x <= lastX; x++)
+			{
+				overview[(size_t)(tileZ * leavesPerTile + z) * overviewWidth + tileX * leavesPerTile + x] =
+					samples[(z * TERRAIN_LEAF_SIZE) * TERRAIN_TILE_SAMPLES + x * TERRAIN_LEAF_SIZE];
+			}
+		}
+	}
+
+	return true;
+}
+
+void Terrain::Update(XMFLOAT3 cameraPosition)
+{
+	if (tiles.empty())
+		return;
+
+	// Distance from the camera to each tile's square on the ground
+	float tileSize = TERRAIN_TILE_SIZE * desc.spacing;
+	for (unsigned int i = 0; i < tiles.size(); i++)
+	{
+		float left = desc.origin.x + tiles[i]->x * tileSize;
+		float back = desc.origin.z + tiles[i]->z * tileSize;
+		float dx = std::max(std::max(left - cameraPosition.x, 0.0f), cameraPosition.x - (left + tileSize));
+		float dz = std::max(std::max(back - cameraPosition.z, 0.0f), cameraPosition.z - (back + tileSize));
+		tiles[i]->distance = sqrtf(dx * dx + dz * dz);
+	}
+
+	// Pick up finished reads.  There's always a slot for them, as no
+	// more are started than there are free slots.
+	float unloadRadius = loadRadius * TERRAIN_UNLOAD_MARGIN;
+	unsigned int loading = 0;
+	for (std::unique_ptr<Tile>& tile : tiles)
+	{
+		if (tile->state != TileState::Loading)
+			continue;
+
+		if (tile->load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			loading++;
+			continue;
+		}
+
+		if (!tile->load.get())
+		{
+			tile->state = TileState::Failed;
+			std::vector<uint16_t>().swap(tile->samples);
+			continue;
+		}
+
+		if (tile->distance > unloadRadius || freeSlots.empty())
+		{
+			tile->state = TileState::Unloaded;
+			std::vector<uint16_t>().swap(tile->samples);
+			continue;
+		}
+
+		tile->slot = freeSlots.back();
+		freeSlots.pop_back();
+		slotSamples[tile->slot].swap(tile->samples);
+		std::vector<uint16_t>().swap(tile->samples);
+		tile->state = TileState::Resident;
+		filledSlots.push_back(tile->slot);
+	}
+
+	auto unload = [this](Tile& tile)
+	{
+		freeSlots.push_back(tile.slot);
+		tile.slot = -1;
+		tile.state = TileState::Unloaded;
+	};
+
+	for (std::unique_ptr<Tile>& tile : tiles)
+	{
+		if (tile->state == TileState::Resident && tile->distance > unloadRadius)
+			unload(*tile);
+	}
+
+	// Nearest tiles are read first
+	std::vector<Tile*> waiting;
+	std::vector<Tile*> resident;
+	for (std::unique_ptr<Tile>& tile : tiles)
+	{
+		if (tile->state == TileState::Unloaded && tile->distance <= loadRadius)
+			waiting.push_back(tile.get());
+		else if (tile->state == TileState::Resident)
+			resident.push_back(tile.get());
+	}
+	std::sort(waiting.begin(), waiting.end(), [](const Tile* a, const Tile* b) { return a->distance < b->distance; });
+	std::sort(resident.begin(), resident.end(), [](const Tile* a, const Tile* b) { return a->distance > b->distance; });
+
+	size_t farthest = 0;
+	for (size_t i = 0; i < waiting.size() && loading < TERRAIN_MAX_LOADS; i++)
+	{
+		// With every slot spoken for, the farthest resident tiles make way for nearer ones
+		if (loading >= freeSlots.size())
+		{
+			if (farthest == resident.size() || resident[farthest]->distance <= waiting[i]->distance)
+				break;
+			unload(*resident[farthest++]);
+		}
+
+		StartLoad(*waiting[i]);
+		loading++;
+	}
+}
+
+void Terrain::StartLoad(Tile& tile)
+{
+	tile.state = TileState::Loading;
+
+	Tile* target = &tile;
+	TerrainTileLoader loader = this->loader;
+	tile.load = std::async(std::launch::async, [target, loader]()
+		{
+			return loader(target->x, target->z, target->samples) &&
+				target->samples.size() == TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES;
+		});
+}
+
+unsigned int Terrain::GetTileCount(TileState state)
+{
+	unsigned int count = 0;
+	for (std::unique_ptr<Tile>& tile : tiles)
+	{
+		if (tile->state == state)
+			count++;
+	}
+	return count;
+}
+
+void Terrain::TakeFilledSlots(std::vector<unsigned int>& slots)
+{
+	slots.clear();
+	slots.swap(filledSlots);
+}
+
+// --------------------------------------------------------
+// The distances over which a LOD's vertices slide onto the
+// next LOD's grid.  The end is pulled in a little from the
+// edge of its range, so they've fully arrived by there.
+// --------------------------------------------------------
+void Terrain::GetMorphRange(unsigned int lod, float& start, float& end)
+{
+	float previous = lod > 0 ? ranges[lod - 1] : 0.0f;
+	end = ranges[lod];
+	start = previous + (end - previous) * TERRAIN_MORPH_START;
+	end = end + (start - end) * 0.01f;
+}
+
+void Terrain::GetNodeBox(unsigned int lod, unsigned int x, unsigned int z, XMFLOAT3& min, XMFLOAT3& max)
+{
+	unsigned int nodesAcross = leavesAcross >> lod;
+	const uint16_t* range = &heightRanges[lod][((size_t)z * nodesAcross + x) * 2];
+	float size = (float)(TERRAIN_LEAF_SIZE << lod) * desc.spacing;
+	float scale = desc.heightScale / 65535.0f;
+
+	min = XMFLOAT3(desc.origin.x + x * size, desc.origin.y + range[0] * scale, desc.origin.z + z * size);
+	max = XMFLOAT3(min.x + size, desc.origin.y + range[1] * scale, min.z + size);
+}
+
+void Terrain::Select(const Frustum& frustum, XMFLOAT3 cameraPosition, std::vector<TerrainNode>& nodes)
+{
+	nodes.clear();
+	if (lodCount == 0)
+		return;
+
+	SelectNode(lodCount - 1, 0, 0, frustum, cameraPosition, false, nodes);
+}
+
+// --------------------------------------------------------
+// Adds the node, or as much of its children as are in
+// their finer range and the rest of it as quarters.  False
+// if the node is out of its own range, so its parent has
+// to draw that part of itself instead.  Nodes out of view
+// count as dealt with, and once a node is entirely in view
+// its children skip the frustum test.
+// --------------------------------------------------------
+bool Terrain::SelectNode(unsigned int lod, unsigned int x, unsigned int z, const Frustum& frustum, XMFLOAT3 cameraPosition, bool inside, std::vector<TerrainNode>& nodes)
+{
+	XMFLOAT3 min, max;
+	GetNodeBox(lod, x, z, min, max);
+
+	if (!inside)
+	{
+		int classification = ClassifyBox(frustum, min, max);
+		if (classification < 0)
+			return true;
+		inside = classification > 0;
+	}
+
+	float distance = DistanceSquared(cameraPosition, min, max);
+	if (distance > ranges[lod] * ranges[lod])
+		return false;
+
+	TerrainNode node = { min.x, min.z, max.x - min.x, (uint8_t)lod, TERRAIN_WHOLE_NODE };
+	if (lod == 0 || distance > ranges[lod - 1] * ranges[lod - 1])
+	{
+		nodes.push_back(node);
+		return true;
+	}
+
+	bool covered[4];
+	for (unsigned int child = 0; child < 4; child++)
+		covered[child] = SelectNode(lod - 1, x * 2 + (child & 1), z * 2 + (child >> 1), frustum, cameraPosition, inside, nodes);
+
+	for (unsigned int child = 0; child < 4; child++)
+	{
+		if (covered[child])
+			continue;
+
+		node.quadrant = (uint8_t)child;
+		nodes.push_back(node);
+	}
+
+	return true;
+}
+
+// Bilinear, in sample values, at a position in samples from the corner
+float Terrain::Sample(const uint16_t* samples, unsigned int width, float x, float z)
+{
+	x = std::min(std::max(x, 0.0f), (float)(width - 1));
+	z = std::min(std::max(z, 0.0f), (float)(width - 1));
+	unsigned int x0 = std::min((unsigned int)x, width - 2);
+	unsigned int z0 = std::min((unsigned int)z, width - 2);
+	float fx = x - x0;
+	float fz = z - z0;
+
+	const uint16_t* row = samples + (size_t)z0 * width + x0;
+	float back = row[0] + (row[1] - row[0]) * fx;
+	float front = row[width] + (row[width + 1] - row[width]) * fx;
+	return back + (front - back) * fz;
+}
+
+float Terrain::GetHeight(float x, float z)
+{
+	if (lodCount == 0)
+		return desc.origin.y;
+
+	float sampleX = std::min(std::max((x - desc.origin.x) / desc.spacing, 0.0f), (float)desc.size);
+	float sampleZ = std::min(std::max((z - desc.origin.z) / desc.spacing, 0.0f), (float)desc.size);
+	unsigned int tileX = std::min((unsigned int)sampleX / TERRAIN_TILE_SIZE, tilesAcross - 1);
+	unsigned int tileZ = std::min((unsigned int)sampleZ / TERRAIN_TILE_SIZE, tilesAcross - 1);
+
+	// Coarser from the overview when the tile isn't in
+	int slot = GetTileSlot(tileX, tileZ);
+	float value = slot >= 0 ?
+		Sample(slotSamples[slot].data(), TERRAIN_TILE_SAMPLES, sampleX - tileX * TERRAIN_TILE_SIZE, sampleZ - tileZ * TERRAIN_TILE_SIZE) :
+		Sample(overview.data(), GetOverviewWidth(), sampleX / TERRAIN_LEAF_SIZE, sampleZ / TERRAIN_LEAF_SIZE);
+	return desc.origin.y + value * desc.heightScale / 65535.0f;
+}
+
+// --------------------------------------------------------
+// Two triangles per quad, clockwise from above, a quarter
+// of the grid at a time
+// --------------------------------------------------------
+void Terrain::BuildGridIndices(std::vector<uint32_t>& indices)
+{
+	const unsigned int width = GetGridWidth();
+	const unsigned int half = TERRAIN_LEAF_SIZE / 2;
+
+	indices.clear();
+	indices.reserve(GetQuadrantIndexCount() * 4);
+	for (unsigned int quadrant = 0; quadrant < 4; quadrant++)
+	{
+		for (unsigned int z = 0; z < half; z++)
+		{
+			for (unsigned int x = 0; x < half; x++)
+			{
+				uint32_t corner = (uint32_t)(((quadrant >> 1) * half + z) * width + (quadrant & 1) * half + x);
+				uint32_t quad[6] = { corner, corner + width, corner + 1, corner + 1, corner + width, corner + width + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+}
+
+TerrainTileLoader Terrain::ProceduralTiles(unsigned int seed)
+{
+	return [seed](int tileX, int tileZ, std::vector<uint16_t>& samples)
+		{
+			GenerateTile(seed, tileX, tileZ, samples);
+			return true;
+		};
+}
+
+TerrainTileLoader Terrain::RawTiles(std::string folder)
+{
+	return [folder](int tileX, int tileZ, std::vector<uint16_t>& samples)
+		{
+			std::string name = std::to_string(tileX) + "_" + std::to_string(tileZ) + ".r16";
+			std::ifstream file((std::filesystem::path(folder) / name).string(), std::ios::binary);
+			if (!file)
+				return false;
+
+			samples.resize(TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES);
+			file.read((char*)samples.data(), samples.size() * sizeof(uint16_t));
+			return file.gcount() == (std::streamsize)(samples.size() * sizeof(uint16_t));
+		};
+}
+
+TerrainTimings Terrain::MeasureTerrain(unsigned int size)
+{
+	TerrainTimings timings = {};
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+	auto elapsedMs = [](auto start, auto end) { return std::chrono::duration<double, std::milli>(end - start).count(); };
+
+	// A metre between samples, with hills up to a few hundred metres
+	TerrainDesc desc = { size, 1.0f, 400.0f, XMFLOAT3(0, 0, 0) };
+	Terrain terrain;
+	auto start = now();
+	bool created = terrain.Create(desc, ProceduralTiles(1));
+	timings.buildMs = elapsedMs(start, now());
+	if (!created)
+		return timings;
+
+	timings.size = size;
+	timings.lods = terrain.GetLodCount();
+
+	// Everything the first position needs, streamed in as fast as it'll go
+	XMFLOAT3 position(size * 0.1f, 0, size * 0.1f);
+	start = now();
+	do
+	{
+		terrain.Update(position);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	} while (terrain.GetTileCount(TileState::Loading) > 0);
+	timings.streamMs = elapsedMs(start, now());
+	timings.residentTiles = terrain.GetTileCount(TileState::Resident);
+
+	// Flying diagonally across the field a little above the ground, looking
+	// slightly down and weaving from side to side, with the far plane out
+	// past the coarsest LOD's range
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, terrain.GetLodRange(terrain.GetLodCount() - 1)));
+
+	const unsigned int steps = 200;
+	std::vector<TerrainNode> nodes;
+	double totalMs = 0;
+	uint64_t totalNodes = 0;
+	for (unsigned int i = 0; i < steps; i++)
+	{
+		float t = 0.1f + 0.8f * i / steps;
+		position = XMFLOAT3(size * t, 0, size * t);
+		position.y = terrain.GetHeight(position.x, position.z) + 20.0f;
+
+		float yaw = XM_PIDIV4 + sinf(i * 0.1f);
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position), XMVectorSet(sinf(yaw), -0.2f, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+		Frustum frustum = Frustum::FromViewProjection(view, projection);
+
+		start = now();
+		terrain.Select(frustum, position, nodes);
+		double ms = elapsedMs(start, now());
+
+		totalMs += ms;
+		timings.maxSelectMs = std::max(timings.maxSelectMs, ms);
+		totalNodes += nodes.size();
+		timings.maxNodes = std::max(timings.maxNodes, (unsigned int)nodes.size());
+	}
+
+	timings.selectMs = totalMs / steps;
+	timings.nodes = (unsigned int)(totalNodes / steps);
+	return timings;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+// Quads along a heightmap tile's side.  Each tile also has the
+// samples along its far edges, which it shares with the next tile.
+#define TERRAIN_TILE_SIZE			512
+#define TERRAIN_TILE_SAMPLES		(TERRAIN_TILE_SIZE + 1)
+
+// Quads along a leaf node's side, which is also the grid mesh's size
+#define TERRAIN_LEAF_SIZE			32
+
+// Largest field is this many tiles across (16384 quads), so the
+// overview has no more samples than a tile and the GPU's tile table
+// stays a fixed size
+#define TERRAIN_MAX_TILES_ACROSS	32
+
+// Tiles that can be resident at once (each has a slot in the GPU's
+// height buffer), and how many are read at a time
+#define TERRAIN_MAX_RESIDENT_TILES	96
+#define TERRAIN_MAX_LOADS			4
+
+// Leaf nodes are drawn out to this many of their own sizes from the
+// camera, and each coarser LOD out to twice the distance of the last
+#define TERRAIN_LOD0_RANGE			3.0f
+
+// How far through its range a LOD starts morphing into the next one
+#define TERRAIN_MORPH_START			0.66f
+
+// Tiles are unloaded this much further out than they're loaded
+#define TERRAIN_UNLOAD_MARGIN		1.25f
+
+// Most LODs any field can have (a 16384 field has 10)
+#define TERRAIN_MAX_LODS			16
+
+// A node drawn whole rather than as one quarter
+#define TERRAIN_WHOLE_NODE			4
+
+// Most nodes in one instanced draw (each is a float4 in a constant buffer)
+#define TERRAIN_INSTANCES_PER_DRAW	256
+
+// Where a heightmap tile is in being streamed in
+enum class TileState
+{
+	Unloaded,
+	Loading,	// Being read on another thread
+	Resident,	// Has a slot
+	Failed		// Couldn't be read, so it isn't tried again
+};
+
+// The size and placement of a heightfield
+struct TerrainDesc
+{
+	unsigned int size;			// Quads along each side, TERRAIN_TILE_SIZE times a power of two
+	float spacing;				// World distance between samples
+	float heightScale;			// World height of the largest sample value
+	DirectX::XMFLOAT3 origin;	// World position of sample (0, 0) at a value of 0
+};
+
+// Fills a tile's TERRAIN_TILE_SAMPLES squared samples, row by row,
+// false if it can't.  Called from several threads at once.
+using TerrainTileLoader = std::function<bool(int tileX, int tileZ, std::vector<uint16_t>& samples)>;
+
+// One node picked by Select(), which draws as the grid mesh (or a
+// quarter of it) stretched over its square
+struct TerrainNode
+{
+	float x;			// World position of its corner
+	float z;
+	float size;			// World size of its side
+	uint8_t lod;
+	uint8_t quadrant;	// 0 to 3 (-x-z, +x-z, -x+z, +x+z), or TERRAIN_WHOLE_NODE
+};
+
+// Timings from MeasureTerrain()
+struct TerrainTimings
+{
+	unsigned int size;
+	unsigned int lods;
+	double buildMs;				// Reading every tile for the node height ranges and the overview, all cores
+	double streamMs;			// Loading every tile needed around the first camera position
+	unsigned int residentTiles;
+	double selectMs;			// Average over a camera flying across the field
+	double maxSelectMs;
+	unsigned int nodes;			// Average selected...
+	unsigned int maxNodes;		// ...and the most in any one view
+};
+
+// --------------------------------------------------------
+// A heightfield drawn with CDLOD (Strugar's continuous
+// distance-dependent level of detail).
+//
+// The field is a quadtree whose leaves are TERRAIN_LEAF_SIZE
+// quads across.  Each LOD has a distance range, doubling
+// from one LOD to the next, and Select() walks down from
+// the root taking the coarsest node whose range reaches
+// the camera.  Where only some of a node's children are in
+// their finer range, the node is drawn as just its other
+// quarters.  Every node is the same grid mesh, so a frame
+// is one instanced draw for each quarter and one for whole
+// nodes.  Over the far part of its range each LOD's
+// vertices slide onto the next LOD's grid (in the vertex
+// shader), so neighbouring LODs meet without cracks or
+// popping.
+//
+// Create() reads every tile once, on all cores, for each
+// node's height range (for culling and ranges) and for an
+// overview heightmap with a sample at every leaf corner.
+// After that, tiles are only read around the camera:
+// Update() streams in those near enough for a node finer
+// than the overview to be drawn on them, nearest first, a
+// few at a time on other threads.  Anywhere else the
+// overview has every sample the coarser nodes need.
+// --------------------------------------------------------
+class Terrain
+{
+public:
+	Terrain();
+	~Terrain();
+
+	// Reads every tile to set up the quadtree, false if one can't be
+	// read or the size isn't one the quadtree can take
+	bool Create(const TerrainDesc& desc, TerrainTileLoader loader, bool allowThreads = true);
+
+	// Streams tiles in and out for a camera at this position
+	void Update(DirectX::XMFLOAT3 cameraPosition);
+
+	// Picks the nodes to draw for this view
+	void Select(const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition, std::vector<TerrainNode>& nodes);
+
+	// Height at a world position, from its tile if that's resident
+	float GetHeight(float x, float z);
+
+	const TerrainDesc& GetDesc() { return desc; }
+	unsigned int GetLodCount() { return lodCount; }
+	float GetLodRange(unsigned int lod) { return ranges[lod]; }
+	void GetMorphRange(unsigned int lod, float& start, float& end);
+
+	// The overview has a sample at every leaf corner
+	unsigned int GetOverviewWidth() { return leavesAcross + 1; }
+	const std::vector<uint16_t>& GetOverview() { return overview; }
+
+	// Residency, for the GPU's copy of the heights.  A tile's slot
+	// is -1 when it isn't resident.
+	unsigned int GetTilesAcross() { return tilesAcross; }
+	int GetTileSlot(int tileX, int tileZ) { return tiles[tileZ * tilesAcross + tileX]->slot; }
+	const uint16_t* GetSlotSamples(unsigned int slot) { return slotSamples[slot].data(); }
+	TileState GetTileState(int tileX, int tileZ) { return tiles[tileZ * tilesAcross + tileX]->state; }
+	unsigned int GetTileCount(TileState state);
+	float GetLoadRadius() { return loadRadius; }
+
+	// Slots filled since the last call, which need uploading
+	void TakeFilledSlots(std::vector<unsigned int>& slots);
+
+	// The grid mesh's indices, one quarter after another so each is
+	// a quarter of the range.  Vertex i is at (i % width, i / width).
+	static unsigned int GetGridWidth() { return TERRAIN_LEAF_SIZE + 1; }
+	static unsigned int GetQuadrantIndexCount() { return TERRAIN_LEAF_SIZE * TERRAIN_LEAF_SIZE / 4 * 6; }
+	static void BuildGridIndices(std::vector<uint32_t>& indices);
+
+	// Rolling hills from a few octaves of value noise, which any tile
+	// can make on its own
+	static TerrainTileLoader ProceduralTiles(unsigned int seed);
+
+	// Raw 16 bit tiles from a folder, named "<x>_<z>.r16"
+	static TerrainTileLoader RawTiles(std::string folder);
+
+	// Builds and streams a procedural field this many quads across and
+	// times selection from a camera flying over it
+	static TerrainTimings MeasureTerrain(unsigned int size);
+
+private:
+	struct Tile
+	{
+		int x, z;
+		TileState state;
+		int slot;
+		float distance;
+
+		// Filled by the loading thread, which owns it until the future is ready
+		std::future<bool> load;
+		std::vector<uint16_t> samples;
+	};
+
+	TerrainDesc desc;
+	TerrainTileLoader loader;
+	unsigned int tilesAcross;
+	unsigned int leavesAcross;
+	unsigned int lodCount;
+	float ranges[TERRAIN_MAX_LODS];
+
+	// Each LOD's nodes' (min, max) sample values, row by row
+	std::vector<std::vector<uint16_t>> heightRanges;
+	std::vector<uint16_t> overview;
+
+	std::vector<std::unique_ptr<Tile>> tiles;
+	std::vector<std::vector<uint16_t>> slotSamples;
+	std::vector<unsigned int> freeSlots;
+	std::vector<unsigned int> filledSlots;
+	float loadRadius;
+
+	void WaitForLoads();
+	bool ReadTiles(unsigned int first, unsigned int last);
+	void StartLoad(Tile& tile);
+	void GetNodeBox(unsigned int lod, unsigned int x, unsigned int z, DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max);
+	bool SelectNode(unsigned int lod, unsigned int x, unsigned int z, const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition, bool inside, std::vector<TerrainNode>& nodes);
+	float Sample(const uint16_t* samples, unsigned int width, float x, float z);
+};
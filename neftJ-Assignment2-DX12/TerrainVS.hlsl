@@ -0,0 +1,110 @@
+
+// Must match Terrain.h
+#define TERRAIN_TILE_SIZE			512
+#define TERRAIN_TILE_SAMPLES		513
+#define TERRAIN_LEAF_SIZE			32
+#define TERRAIN_MAX_TILES_ACROSS	32
+#define TERRAIN_MAX_LODS			16
+#define TERRAIN_INSTANCES_PER_DRAW	256
+
+struct VertexToPixel
+{
+	float4 screenPosition : SV_POSITION;
+	float3 normal : NORMAL;
+	float3 worldPos : POSITION;
+};
+
+// Matches TerrainVSData in BufferStructs.h
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float3 cameraPosition;
+	float spacing;
+	float3 origin;
+	float heightScale;
+	uint tilesAcross;
+	uint overviewWidth;
+	float2 padding;
+	float4 morphConstants[TERRAIN_MAX_LODS];
+	uint4 tileSlots[TERRAIN_MAX_TILES_ACROSS * TERRAIN_MAX_TILES_ACROSS / 4];
+}
+
+// This draw's nodes, each as (corner x, corner z, size, LOD)
+cbuffer nodeData : register(b1)
+{
+	float4 nodes[TERRAIN_INSTANCES_PER_DRAW];
+}
+
+// Every sample of the overview (in slot 0) and the resident tiles (one per slot after it)
+Buffer<float> heights : register(t0);
+
+// --------------------------------------------------------
+// Bilinear from a square of samples starting at base
+// --------------------------------------------------------
+float SampleSquare(uint base, uint width, float2 position)
+{
+	position = clamp(position, 0.0f, width - 1.0f);
+	uint2 corner = min((uint2)position, width - 2);
+	float2 f = position - corner;
+
+	uint index = base + corner.y * width + corner.x;
+	float back = lerp(heights.Load(index), heights.Load(index + 1), f.x);
+	float front = lerp(heights.Load(index + width), heights.Load(index + width + 1), f.x);
+	return lerp(back, front, f.y);
+}
+
+// --------------------------------------------------------
+// World height at a position in samples from the field's
+// corner, from its tile if that's resident and otherwise
+// from the overview
+// --------------------------------------------------------
+float SampleHeight(float2 position)
+{
+	position = clamp(position, 0.0f, (float)(tilesAcross * TERRAIN_TILE_SIZE));
+	uint2 tile = min((uint2)(position / TERRAIN_TILE_SIZE), tilesAcross - 1);
+	uint tileIndex = tile.y * tilesAcross + tile.x;
+	uint slot = tileSlots[tileIndex / 4][tileIndex % 4];
+
+	float height = slot != 0 ?
+		SampleSquare(slot * TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES, TERRAIN_TILE_SAMPLES, position - tile * TERRAIN_TILE_SIZE) :
+		SampleSquare(0, overviewWidth, position / TERRAIN_LEAF_SIZE);
+	return origin.y + height * heightScale;
+}
+
+// --------------------------------------------------------
+// Places a vertex of the shared grid on its node.  Over
+// the far part of the node's range the odd vertices slide
+// onto the even ones, which are the next LOD's grid, so by
+// the time the next LOD takes over it's the same surface.
+// --------------------------------------------------------
+VertexToPixel main(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID)
+{
+	VertexToPixel output;
+
+	float4 node = nodes[instanceID];
+	float quadSize = node.z / TERRAIN_LEAF_SIZE;
+	float2 grid = float2(vertexID % (TERRAIN_LEAF_SIZE + 1), vertexID / (TERRAIN_LEAF_SIZE + 1));
+
+	float2 worldXZ = node.xy + grid * quadSize;
+	float height = SampleHeight((worldXZ - origin.xz) / spacing);
+	float4 morph = morphConstants[(uint)node.w];
+	float morphAmount = 1.0f - saturate(morph.x - distance(cameraPosition, float3(worldXZ.x, height, worldXZ.y)) * morph.y);
+	grid -= frac(grid * 0.5f) * 2.0f * morphAmount;
+
+	worldXZ = node.xy + grid * quadSize;
+	float2 position = (worldXZ - origin.xz) / spacing;
+	output.worldPos = float3(worldXZ.x, SampleHeight(position), worldXZ.y);
+
+	// From the heights a grid step either side, so coarse nodes shade smoothly
+	float step = quadSize / spacing;
+	float left = SampleHeight(position - float2(step, 0));
+	float right = SampleHeight(position + float2(step, 0));
+	float back = SampleHeight(position - float2(0, step));
+	float front = SampleHeight(position + float2(0, step));
+	output.normal = normalize(float3(left - right, 2.0f * quadSize, back - front));
+
+	output.screenPosition = mul(projection, mul(view, float4(output.worldPos, 1.0f)));
+
+	return output;
+}
\ No newline at end of file
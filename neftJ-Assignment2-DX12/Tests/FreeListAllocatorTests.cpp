@@ -0,0 +1,216 @@
+#include <cstdio>
+#include <vector>
+
+#include "FreeListAllocator.h"
+
+// Counts failures instead of stopping, so one run reports every broken case
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static void TestAllocate()
+{
+	FreeListAllocator a(100);
+	CHECK(a.GetCapacity() == 100);
+	CHECK(a.GetFree() == 100);
+	CHECK(a.GetFreeBlockCount() == 1);
+
+	// First fit packs allocations towards the front
+	FreeListAllocator::Allocation x = a.Allocate(30);
+	FreeListAllocator::Allocation y = a.Allocate(20);
+	CHECK(x.offset == 0 && x.size == 30);
+	CHECK(y.offset == 30 && y.size == 20);
+	CHECK(x.id != y.id);
+	CHECK(a.GetUsed() == 50);
+	CHECK(a.GetAllocationCount() == 2);
+	CHECK(a.GetOffset(y.id) == 30);
+	CHECK(a.GetSize(y.id) == 20);
+
+	// Exactly the rest fits, then nothing does
+	FreeListAllocator::Allocation z = a.Allocate(50);
+	CHECK(z.offset == 50);
+	CHECK(a.GetFree() == 0);
+	CHECK(a.GetFreeBlockCount() == 0);
+
+	FreeListAllocator::Allocation none = a.Allocate(1);
+	CHECK(none.offset == FreeListAllocator::InvalidOffset);
+	CHECK(none.id == FreeListAllocator::InvalidId);
+
+	// Empty requests never succeed
+	FreeListAllocator b(10);
+	CHECK(b.Allocate(0).offset == FreeListAllocator::InvalidOffset);
+	CHECK(b.GetUsed() == 0);
+}
+
+static void TestFree()
+{
+	FreeListAllocator a(100);
+	FreeListAllocator::Allocation x = a.Allocate(40);
+	FreeListAllocator::Allocation y = a.Allocate(40);
+
+	a.Free(x.id);
+	CHECK(!a.IsValid(x.id));
+	CHECK(a.IsValid(y.id));
+	CHECK(a.GetOffset(x.id) == FreeListAllocator::InvalidOffset);
+	CHECK(a.GetUsed() == 40);
+	CHECK(a.GetAllocationCount() == 1);
+
+	// Freeing twice (or an id never handed out) does nothing
+	a.Free(x.id);
+	a.Free(12345);
+	CHECK(a.GetUsed() == 40);
+
+	// The hole is reused, along with the id
+	FreeListAllocator::Allocation z = a.Allocate(40);
+	CHECK(z.offset == 0);
+	CHECK(z.id == x.id);
+}
+
+static void TestMerge()
+{
+	FreeListAllocator a(100);
+	FreeListAllocator::Allocation p = a.Allocate(25);
+	FreeListAllocator::Allocation q = a.Allocate(25);
+	FreeListAllocator::Allocation r = a.Allocate(25);
+	FreeListAllocator::Allocation s = a.Allocate(25);
+
+	// Two holes that don't touch
+	a.Free(p.id);
+	a.Free(r.id);
+	CHECK(a.GetFreeBlockCount() == 2);
+	CHECK(a.GetLargestFreeBlock() == 25);
+
+	// Freeing the middle merges with the blocks on both sides
+	a.Free(q.id);
+	CHECK(a.GetFreeBlockCount() == 1);
+	CHECK(a.GetLargestFreeBlock() == 75);
+
+	// And freeing the last one gives back the whole range
+	a.Free(s.id);
+	CHECK(a.GetFreeBlockCount() == 1);
+	CHECK(a.GetLargestFreeBlock() == 100);
+	CHECK(a.Allocate(100).offset == 0);
+
+	// Growing merges with a trailing free block
+	FreeListAllocator b(10);
+	b.Allocate(5);
+	b.Grow(20);
+	CHECK(b.GetCapacity() == 20);
+	CHECK(b.GetFreeBlockCount() == 1);
+	CHECK(b.GetLargestFreeBlock() == 15);
+}
+
+static void TestAlignment()
+{
+	FreeListAllocator a(256);
+	FreeListAllocator::Allocation x = a.Allocate(3);
+	FreeListAllocator::Allocation y = a.Allocate(16, 16);
+	CHECK(x.offset == 0);
+	CHECK(y.offset == 16);
+
+	// The padding in front of y is left free for small allocations
+	CHECK(a.GetFreeBlockCount() == 2);
+	FreeListAllocator::Allocation z = a.Allocate(13);
+	CHECK(z.offset == 3);
+	CHECK(a.GetFreeBlockCount() == 1);
+
+	// An alignment of zero is treated as one
+	FreeListAllocator::Allocation w = a.Allocate(5, 0);
+	CHECK(w.offset == 32);
+
+	// Padding counts against the block, so this can't fit
+	FreeListAllocator b(20);
+	b.Allocate(1);
+	CHECK(b.Allocate(16, 8).offset == FreeListAllocator::InvalidOffset);
+	CHECK(b.Allocate(12, 8).offset == 8);
+}
+
+static void TestDefragment()
+{
+	FreeListAllocator a(100);
+	std::vector<FreeListAllocator::Allocation> allocs;
+	for (int i = 0; i < 5; i++)
+		allocs.push_back(a.Allocate(20));
+
+	// Leave holes at 0, 40 and 80
+	a.Free(allocs[0].id);
+	a.Free(allocs[2].id);
+	a.Free(allocs[4].id);
+	CHECK(a.GetFree() == 60);
+	CHECK(a.GetLargestFreeBlock() == 20);
+	CHECK(a.Allocate(30).offset == FreeListAllocator::InvalidOffset);
+
+	std::vector<FreeListAllocator::Move> moves = a.Defragment();
+
+	// One move per live allocation, in offset order
+	CHECK(moves.size() == 2);
+	if (moves.size() == 2)
+	{
+		CHECK(moves[0].id == allocs[1].id);
+		CHECK(moves[0].srcOffset == 20 && moves[0].dstOffset == 0 && moves[0].size == 20);
+		CHECK(moves[1].id == allocs[3].id);
+		CHECK(moves[1].srcOffset == 60 && moves[1].dstOffset == 20 && moves[1].size == 20);
+	}
+
+	// Ids stay valid at their new offsets, and the free space is one block
+	CHECK(a.GetOffset(allocs[1].id) == 0);
+	CHECK(a.GetOffset(allocs[3].id) == 20);
+	CHECK(a.GetFreeBlockCount() == 1);
+	CHECK(a.GetLargestFreeBlock() == 60);
+	CHECK(a.Allocate(60).offset == 40);
+
+	// Allocations already in place stay put
+	FreeListAllocator b(50);
+	FreeListAllocator::Allocation first = b.Allocate(10);
+	FreeListAllocator::Allocation second = b.Allocate(10);
+	b.Free(second.id);
+	std::vector<FreeListAllocator::Move> still = b.Defragment();
+	CHECK(still.size() == 1);
+	if (still.size() == 1)
+	{
+		CHECK(still[0].id == first.id);
+		CHECK(still[0].srcOffset == still[0].dstOffset);
+	}
+}
+
+static void TestDefragmentAlignment()
+{
+	FreeListAllocator a(128);
+	FreeListAllocator::Allocation x = a.Allocate(10);
+	FreeListAllocator::Allocation y = a.Allocate(8, 32);
+	FreeListAllocator::Allocation z = a.Allocate(5);
+	CHECK(y.offset == 32);
+	CHECK(z.offset == 10);
+
+	// With x gone, z slides to 0 and y keeps its alignment
+	a.Free(x.id);
+	std::vector<FreeListAllocator::Move> moves = a.Defragment();
+	CHECK(moves.size() == 2);
+	CHECK(a.GetOffset(z.id) == 0);
+	CHECK(a.GetOffset(y.id) == 32);
+
+	// The padding before y and the tail are the free blocks left
+	CHECK(a.GetFreeBlockCount() == 2);
+	CHECK(a.GetFree() == 128 - 13);
+	CHECK(a.GetLargestFreeBlock() == 128 - 40);
+}
+
+int main()
+{
+	TestAllocate();
+	TestFree();
+	TestMerge();
+	TestAlignment();
+	TestDefragment();
+	TestDefragmentAlignment();
+
+	if (failures > 0)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("All FreeListAllocator tests passed\n");
+	return 0;
+}
@@ -0,0 +1,226 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+using namespace DirectX;
+
+// Counts failures instead of stopping, so one run reports every broken case
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// Spheres closer than this to a plane could go either way through rounding
+#define PLANE_EPSILON	0.001f
+
+struct Sphere
+{
+	XMFLOAT3 center;
+	float radius;
+};
+
+static Frustum MakeFrustum(XMFLOAT3 position, XMFLOAT3 direction, float fov, float aspect)
+{
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position), XMLoadFloat3(&direction),
+		fabsf(direction.y) > 0.9f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(fov, aspect, 0.1f, 200.0f));
+	return Frustum::FromViewProjection(view, projection);
+}
+
+// The plain, one sphere and one plane at a time version of the test.
+// Sets ambiguous when the sphere is too close to a plane to call.
+static bool BruteForceVisible(const Frustum& frustum, const Sphere& s, bool& ambiguous)
+{
+	bool visible = true;
+	ambiguous = false;
+	for (const XMFLOAT4& p : frustum.planes)
+	{
+		float distance = p.x * s.center.x + p.y * s.center.y + p.z * s.center.z + p.w + s.radius;
+		if (fabsf(distance) < PLANE_EPSILON)
+			ambiguous = true;
+		if (distance < 0)
+			visible = false;
+	}
+	return visible;
+}
+
+static std::vector<Sphere> RandomSpheres(unsigned int count, unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+	std::uniform_real_distribution<float> size(0.1f, 8.0f);
+
+	std::vector<Sphere> spheres(count);
+	for (Sphere& s : spheres)
+	{
+		s.center = XMFLOAT3(position(generator), position(generator), position(generator));
+		s.radius = size(generator);
+	}
+	return spheres;
+}
+
+// Every sphere the reference clearly keeps or drops must be kept or
+// dropped, in order, with nothing from the padding
+static void CheckAgainstReference(const Frustum& frustum, const std::vector<Sphere>& spheres, const std::vector<uint32_t>& visible)
+{
+	for (size_t i = 1; i < visible.size(); i++)
+		CHECK(visible[i - 1] < visible[i]);
+	for (uint32_t index : visible)
+		CHECK(index < spheres.size());
+
+	size_t next = 0;
+	unsigned int mismatches = 0;
+	for (uint32_t i = 0; i < spheres.size(); i++)
+	{
+		bool culled = next < visible.size() && visible[next] == i;
+		if (culled)
+			next++;
+
+		bool ambiguous;
+		bool expected = BruteForceVisible(frustum, spheres[i], ambiguous);
+		if (!ambiguous && expected != culled)
+			mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
+
+static void TestPlanes()
+{
+	// Straight ahead is in, behind and past the far plane are out
+	Frustum frustum = MakeFrustum(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), XM_PIDIV4, 16.0f / 9.0f);
+	bool ambiguous;
+	CHECK(BruteForceVisible(frustum, { XMFLOAT3(0, 0, 10), 0.0f }, ambiguous));
+	CHECK(!BruteForceVisible(frustum, { XMFLOAT3(0, 0, -10), 0.0f }, ambiguous));
+	CHECK(!BruteForceVisible(frustum, { XMFLOAT3(0, 0, 250), 0.0f }, ambiguous));
+	CHECK(!BruteForceVisible(frustum, { XMFLOAT3(50, 0, 10), 0.0f }, ambiguous));
+
+	// Normalized, so a sphere just reaching over a plane is in
+	for (const XMFLOAT4& p : frustum.planes)
+		CHECK(fabsf(p.x * p.x + p.y * p.y + p.z * p.z - 1.0f) < 0.0001f);
+	CHECK(BruteForceVisible(frustum, { XMFLOAT3(0, 0, -1), 1.2f }, ambiguous));
+
+	// Points agree with the clip space test the planes came from
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(3, 1, -2, 0), XMVectorSet(1, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.5f, 0.1f, 200.0f));
+	frustum = Frustum::FromViewProjection(view, projection);
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection));
+
+	unsigned int mismatches = 0;
+	for (const Sphere& s : RandomSpheres(5000, 7))
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&s.center), viewProjection));
+		bool inClip = clip.x >= -clip.w && clip.x <= clip.w && clip.y >= -clip.w && clip.y <= clip.w && clip.z >= 0 && clip.z <= clip.w;
+
+		bool inPlanes = BruteForceVisible(frustum, { s.center, 0.0f }, ambiguous);
+		if (!ambiguous && inClip != inPlanes)
+			mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
+
+static void TestCull()
+{
+	// Not a multiple of four, so the last group is part padding
+	std::vector<Sphere> spheres = RandomSpheres(4099, 1);
+	FrustumCuller culler;
+	for (uint32_t i = 0; i < spheres.size(); i++)
+		CHECK(culler.Add(spheres[i].center, spheres[i].radius) == i);
+	CHECK(culler.GetCount() == spheres.size());
+
+	Frustum frustum = MakeFrustum(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), XM_PIDIV4, 16.0f / 9.0f);
+	std::vector<uint32_t> visible = { 12345 };
+	culler.Cull(frustum, visible, false);
+	CHECK(!visible.empty());
+	CheckAgainstReference(frustum, spheres, visible);
+
+	// Clearing leaves nothing to find
+	culler.Clear();
+	culler.Cull(frustum, visible, false);
+	CHECK(visible.empty());
+	CHECK(culler.GetCount() == 0);
+}
+
+static void TestCullThreaded()
+{
+	// Enough spheres to be split across threads, which must give the same list
+	std::vector<Sphere> spheres = RandomSpheres(CULLING_PARALLEL_MIN * 2 + 3, 2);
+	FrustumCuller culler;
+	culler.Reserve((unsigned int)spheres.size());
+	for (const Sphere& s : spheres)
+		culler.Add(s.center, s.radius);
+
+	Frustum frustum = MakeFrustum(XMFLOAT3(10, -5, 20), XMFLOAT3(-1, 0.3f, -0.5f), XM_PIDIV2, 1.0f);
+	std::vector<uint32_t> single, threaded;
+	culler.Cull(frustum, single, false);
+	culler.Cull(frustum, threaded, true);
+	CHECK(single == threaded);
+	CheckAgainstReference(frustum, spheres, threaded);
+}
+
+static void TestCullViews()
+{
+	// The six faces of a cube around a point plus a narrow main view
+	std::vector<Sphere> spheres = RandomSpheres(CULLING_PARALLEL_MIN + 1, 3);
+	FrustumCuller culler;
+	for (const Sphere& s : spheres)
+		culler.Add(s.center, s.radius);
+
+	XMFLOAT3 directions[] = {
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0),
+		XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0),
+		XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+	Frustum frustums[7];
+	for (int face = 0; face < 6; face++)
+		frustums[face] = MakeFrustum(XMFLOAT3(5, 5, 5), directions[face], XM_PIDIV2, 1.0f);
+	frustums[6] = MakeFrustum(XMFLOAT3(0, 0, -50), XMFLOAT3(0, 0, 1), XM_PIDIV4 / 2, 2.0f);
+
+	for (int threads = 0; threads < 2; threads++)
+	{
+		std::vector<uint16_t> masks;
+		culler.CullViews(frustums, 7, masks, threads == 1);
+		CHECK(masks.size() >= spheres.size());
+		for (size_t i = spheres.size(); i < masks.size(); i++)
+			CHECK(masks[i] == 0);
+
+		for (unsigned int view = 0; view < 7; view++)
+		{
+			std::vector<uint32_t> combined, separate;
+			FrustumCuller::ExtractView(masks, view, combined);
+			culler.Cull(frustums[view], separate, false);
+			CHECK(combined == separate);
+			CheckAgainstReference(frustums[view], spheres, combined);
+		}
+
+		// The cube covers everything, so every sphere is in at least one face
+		unsigned int unseen = 0;
+		for (size_t i = 0; i < spheres.size(); i++)
+		{
+			if ((masks[i] & 0x3F) == 0)
+				unseen++;
+		}
+		CHECK(unseen == 0);
+	}
+}
+
+int main()
+{
+	TestPlanes();
+	TestCull();
+	TestCullThreaded();
+	TestCullViews();
+
+	if (failures > 0)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("All FrustumCuller tests passed\n");
+	return 0;
+}
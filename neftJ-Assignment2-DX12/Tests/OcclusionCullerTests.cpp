@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "OcclusionCuller.h"
+
+using namespace DirectX;
+
+// Counts failures instead of stopping, so one run reports every broken case
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// The camera sits at the origin looking down +Z, so a point's screen
+// position is just x / z and y / z, out to these at the edges
+#define VIEW_FOV		(XM_PI / 3.0f)
+#define VIEW_ASPECT		2.0f
+#define VIEW_TAN_Y		0.57735f
+#define VIEW_TAN_X		(VIEW_TAN_Y * VIEW_ASPECT)
+
+// One wall facing the camera: its front face is at WALL_DEPTH and
+// it covers |x| and |y| up to WALL_HALF_SIZE, so it hides exactly the
+// points with z >= WALL_DEPTH and |x| and |y| <= z * WALL_SLOPE
+#define WALL_DEPTH		10.0f
+#define WALL_HALF_SIZE	4.0f
+#define WALL_SLOPE		(WALL_HALF_SIZE / WALL_DEPTH)
+
+static void BeginFrame(OcclusionCuller& culler)
+{
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(VIEW_FOV, VIEW_ASPECT, 0.1f, 500.0f));
+	culler.BeginFrame(view, projection);
+}
+
+static void AddWall(OcclusionCuller& culler)
+{
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+	OccluderMesh wall = OccluderMesh::FromBox(BoundingBox(
+		XMFLOAT3(0, 0, WALL_DEPTH + 0.5f),
+		XMFLOAT3(WALL_HALF_SIZE, WALL_HALF_SIZE, 0.5f)));
+	culler.AddOccluder(wall, world);
+}
+
+// --------------------------------------------------------
+// How far (as a fraction of depth) the box's corner that's
+// least hidden is inside the region the wall hides, which
+// is negative when some of the box isn't behind the wall.
+// The region is convex, so the box is hidden exactly when
+// all of its corners are.
+// --------------------------------------------------------
+static float HiddenMargin(const BoundingBox& box)
+{
+	float margin = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		float x = box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x);
+		float y = box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y);
+		float z = box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z);
+		margin = std::min(margin, (z - WALL_DEPTH) / z);
+		margin = std::min(margin, WALL_SLOPE - fabsf(x) / z);
+		margin = std::min(margin, WALL_SLOPE - fabsf(y) / z);
+	}
+	return margin;
+}
+
+static void TestNoOccluders()
+{
+	OcclusionCuller culler;
+	BeginFrame(culler);
+	culler.Rasterize(false);
+	CHECK(culler.GetTriangleCount() == 0);
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 20), XMFLOAT3(1, 1, 1))));
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 400), XMFLOAT3(0.01f, 0.01f, 0.01f))));
+}
+
+static void TestWall()
+{
+	for (int threads = 0; threads < 2; threads++)
+	{
+		OcclusionCuller culler;
+		BeginFrame(culler);
+		AddWall(culler);
+		culler.Rasterize(threads == 1);
+		CHECK(culler.GetTriangleCount() > 0);
+
+		// Straight behind it, however far
+		CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 20), XMFLOAT3(1, 1, 1))));
+		CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 300), XMFLOAT3(20, 20, 1))));
+		CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(2, -2, 12), XMFLOAT3(0.5f, 0.5f, 0.5f))));
+
+		// In front of it, beside it, poking out around it and touching the
+		// wall's front face (whose depth the bias keeps from hiding it)
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 5), XMFLOAT3(1, 1, 1))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(10, 0, 20), XMFLOAT3(1, 1, 1))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, -9, 20), XMFLOAT3(1, 1, 1))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 20), XMFLOAT3(10, 1, 1))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, WALL_DEPTH - 0.5f), XMFLOAT3(0.5f, 0.5f, 0.5f))));
+
+		// Reaching past the near plane, or entirely behind the camera
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1))));
+		CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0, 0, -20), XMFLOAT3(1, 1, 1))));
+	}
+}
+
+// --------------------------------------------------------
+// Random boxes in view: none that can be seen may ever be
+// culled, and those well behind the wall must be
+// --------------------------------------------------------
+static void TestConservative()
+{
+	OcclusionCuller culler;
+	BeginFrame(culler);
+	AddWall(culler);
+	culler.Rasterize(true);
+
+	std::mt19937 generator(11);
+	std::uniform_real_distribution<float> across(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> depth(1.0f, 60.0f);
+	std::uniform_real_distribution<float> size(0.05f, 3.0f);
+
+	unsigned int tested = 0, visibleCulled = 0, hiddenKept = 0, hidden = 0;
+	while (tested < 20000)
+	{
+		float z = depth(generator);
+		BoundingBox box(
+			XMFLOAT3(across(generator) * z * VIEW_TAN_X, across(generator) * z * VIEW_TAN_Y, z),
+			XMFLOAT3(size(generator), size(generator), size(generator)));
+
+		// Only boxes entirely on screen, so what the wall doesn't hide is seen
+		bool onScreen = true;
+		for (int i = 0; i < 8; i++)
+		{
+			float x = box.Center.x + (i & 1 ? box.Extents.x : -box.Extents.x);
+			float y = box.Center.y + (i & 2 ? box.Extents.y : -box.Extents.y);
+			float cz = box.Center.z + (i & 4 ? box.Extents.z : -box.Extents.z);
+			if (cz < 0.5f || fabsf(x) > cz * VIEW_TAN_X * 0.98f || fabsf(y) > cz * VIEW_TAN_Y * 0.98f)
+				onScreen = false;
+		}
+		if (!onScreen)
+			continue;
+		tested++;
+
+		bool visible = culler.IsVisible(box);
+		float margin = HiddenMargin(box);
+		if (margin < 0 && !visible)
+			visibleCulled++;
+
+		// A few pixels in, so the edges of the wall aren't in question
+		if (margin > 0.03f)
+		{
+			hidden++;
+			if (visible)
+				hiddenKept++;
+		}
+	}
+
+	CHECK(visibleCulled == 0);
+	CHECK(hidden > 100);
+	CHECK(hiddenKept == 0);
+}
+
+int main()
+{
+	TestNoOccluders();
+	TestWall();
+	TestConservative();
+
+	if (failures > 0)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("All OcclusionCuller tests passed\n");
+	return 0;
+}
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Terrain.h"
+
+using namespace DirectX;
+
+// Counts failures instead of stopping, so one run reports every broken case
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+// Four tiles across with a spacing of one, so there are 64 leaves across
+#define FIELD_SIZE		2048
+#define LEAVES_ACROSS	(FIELD_SIZE / TERRAIN_LEAF_SIZE)
+
+// Every sample at zero, so with the camera at a height of zero its
+// distance to a node is the same as on the ground plane
+static bool FlatTile(int tileX, int tileZ, std::vector<uint16_t>& samples)
+{
+	samples.assign((size_t)TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES, 0);
+	return true;
+}
+
+static bool CreateFlat(Terrain& terrain, bool allowThreads)
+{
+	TerrainDesc desc = {};
+	desc.size = FIELD_SIZE;
+	desc.spacing = 1.0f;
+	desc.heightScale = 100.0f;
+	desc.origin = XMFLOAT3(0, 0, 0);
+	return terrain.Create(desc, FlatTile, allowThreads);
+}
+
+// Planes that every point is in front of, for selecting without culling
+static Frustum Everything()
+{
+	Frustum frustum;
+	for (XMFLOAT4& p : frustum.planes)
+		p = XMFLOAT4(0, 0, 0, 1);
+	return frustum;
+}
+
+static bool SameNode(const TerrainNode& a, const TerrainNode& b)
+{
+	return a.x == b.x && a.z == b.z && a.size == b.size && a.lod == b.lod && a.quadrant == b.quadrant;
+}
+
+// Distance on the ground from a point to the segment between two others
+static float DistanceToSegment(float px, float pz, float ax, float az, float bx, float bz)
+{
+	float dx = bx - ax, dz = bz - az;
+	float t = ((px - ax) * dx + (pz - az) * dz) / (dx * dx + dz * dz);
+	t = std::min(std::max(t, 0.0f), 1.0f);
+	float x = ax + dx * t - px, z = az + dz * t - pz;
+	return sqrtf(x * x + z * z);
+}
+
+// --------------------------------------------------------
+// Which LOD covers each leaf, -1 where nothing does and -2
+// where more than one node does
+// --------------------------------------------------------
+static std::vector<int> CoverLeaves(const std::vector<TerrainNode>& nodes)
+{
+	std::vector<int> leaves(LEAVES_ACROSS * LEAVES_ACROSS, -1);
+	for (const TerrainNode& node : nodes)
+	{
+		int x0 = (int)(node.x / TERRAIN_LEAF_SIZE);
+		int z0 = (int)(node.z / TERRAIN_LEAF_SIZE);
+		int across = (int)(node.size / TERRAIN_LEAF_SIZE);
+		CHECK(across == 1 << node.lod);
+
+		if (node.quadrant != TERRAIN_WHOLE_NODE)
+		{
+			CHECK(node.quadrant < 4);
+			CHECK(node.lod > 0);
+			across /= 2;
+			x0 += (node.quadrant & 1) * across;
+			z0 += (node.quadrant >> 1) * across;
+		}
+
+		for (int z = z0; z < z0 + across; z++)
+		{
+			for (int x = x0; x < x0 + across; x++)
+			{
+				if (x < 0 || z < 0 || x >= LEAVES_ACROSS || z >= LEAVES_ACROSS)
+				{
+					CHECK(!"node outside the field");
+					continue;
+				}
+
+				int& leaf = leaves[z * LEAVES_ACROSS + x];
+				leaf = leaf == -1 ? node.lod : -2;
+			}
+		}
+	}
+	return leaves;
+}
+
+// --------------------------------------------------------
+// Without culling, the field is covered exactly once, the
+// camera's own leaf is the finest LOD, and neighbours are
+// at most one LOD apart.  Where two LODs meet, the finer
+// one's edge is past the end of its morph range, so its
+// vertices there have fully slid onto the coarser grid
+// and the two sides line up.
+// --------------------------------------------------------
+static void CheckSelection(Terrain& terrain, XMFLOAT3 camera)
+{
+	std::vector<TerrainNode> nodes;
+	terrain.Select(Everything(), camera, nodes);
+	CHECK(!nodes.empty());
+
+	std::vector<int> leaves = CoverLeaves(nodes);
+	unsigned int uncovered = 0, overlapped = 0;
+	for (int leaf : leaves)
+	{
+		if (leaf == -1)
+			uncovered++;
+		if (leaf == -2)
+			overlapped++;
+	}
+	CHECK(uncovered == 0);
+	CHECK(overlapped == 0);
+	if (uncovered > 0 || overlapped > 0)
+		return;
+
+	int cameraX = (int)floorf(camera.x / TERRAIN_LEAF_SIZE);
+	int cameraZ = (int)floorf(camera.z / TERRAIN_LEAF_SIZE);
+	if (cameraX >= 0 && cameraZ >= 0 && cameraX < LEAVES_ACROSS && cameraZ < LEAVES_ACROSS)
+		CHECK(leaves[cameraZ * LEAVES_ACROSS + cameraX] == 0);
+
+	unsigned int jumps = 0, seams = 0, unmorphed = 0;
+	for (int z = 0; z < LEAVES_ACROSS; z++)
+	{
+		for (int x = 0; x < LEAVES_ACROSS; x++)
+		{
+			int lod = leaves[z * LEAVES_ACROSS + x];
+
+			// The +x and +z neighbours, and the edge shared with each
+			for (int side = 0; side < 2; side++)
+			{
+				int nx = x + (side == 0), nz = z + (side == 1);
+				if (nx >= LEAVES_ACROSS || nz >= LEAVES_ACROSS)
+					continue;
+
+				int other = leaves[nz * LEAVES_ACROSS + nx];
+				if (other == lod)
+					continue;
+				if (abs(other - lod) > 1)
+					jumps++;
+
+				float ax = (float)(nx * TERRAIN_LEAF_SIZE), az = (float)(nz * TERRAIN_LEAF_SIZE);
+				float bx = side == 0 ? ax : ax + TERRAIN_LEAF_SIZE;
+				float bz = side == 0 ? az + TERRAIN_LEAF_SIZE : az;
+
+				float start, end;
+				terrain.GetMorphRange((unsigned int)std::min(lod, other), start, end);
+				if (DistanceToSegment(camera.x, camera.z, ax, az, bx, bz) < end)
+					unmorphed++;
+				seams++;
+			}
+		}
+	}
+	CHECK(jumps == 0);
+	CHECK(unmorphed == 0);
+
+	// A camera anywhere near the field sees more than one LOD
+	CHECK(seams > 0);
+}
+
+static void TestCreate()
+{
+	Terrain terrain;
+	CHECK(CreateFlat(terrain, false));
+	CHECK(terrain.GetLodCount() == 7);
+	for (unsigned int lod = 1; lod < terrain.GetLodCount(); lod++)
+		CHECK(terrain.GetLodRange(lod) == terrain.GetLodRange(lod - 1) * 2);
+
+	// Morphing ends just short of each range and starts after the last one's
+	for (unsigned int lod = 0; lod < terrain.GetLodCount(); lod++)
+	{
+		float start, end;
+		terrain.GetMorphRange(lod, start, end);
+		CHECK(start < end);
+		CHECK(end < terrain.GetLodRange(lod));
+		if (lod > 0)
+			CHECK(start > terrain.GetLodRange(lod - 1));
+	}
+
+	// Sizes the quadtree can't take
+	TerrainDesc desc = {};
+	desc.size = 1000;
+	desc.spacing = 1.0f;
+	Terrain odd;
+	CHECK(!odd.Create(desc, FlatTile, false));
+	desc.size = TERRAIN_TILE_SIZE * 3;
+	CHECK(!odd.Create(desc, FlatTile, false));
+	desc.size = TERRAIN_TILE_SIZE * TERRAIN_MAX_TILES_ACROSS * 2;
+	CHECK(!odd.Create(desc, FlatTile, false));
+
+	// Or a tile that can't be read
+	desc.size = FIELD_SIZE;
+	CHECK(!odd.Create(desc, [](int, int, std::vector<uint16_t>&) { return false; }, false));
+}
+
+static void TestFixedCameras()
+{
+	Terrain terrain;
+	CHECK(CreateFlat(terrain, true));
+
+	// Corners, middle, on leaf and node edges, and off the field
+	XMFLOAT3 cameras[] = {
+		XMFLOAT3(0, 0, 0),
+		XMFLOAT3(FIELD_SIZE / 2, 0, FIELD_SIZE / 2),
+		XMFLOAT3(FIELD_SIZE - 1, 0, FIELD_SIZE - 1),
+		XMFLOAT3(300, 0, 1700),
+		XMFLOAT3(512, 0, 1000.5f),
+		XMFLOAT3(96, 0, 1407),
+		XMFLOAT3(-400, 0, 800),
+		XMFLOAT3(FIELD_SIZE + 150, 0, -90) };
+	for (XMFLOAT3 camera : cameras)
+		CheckSelection(terrain, camera);
+}
+
+// --------------------------------------------------------
+// Culling only drops nodes: what a real view keeps is part
+// of the unculled selection, and everything it drops lies
+// entirely behind one of the view's planes
+// --------------------------------------------------------
+static void TestCulling()
+{
+	Terrain terrain;
+	CHECK(CreateFlat(terrain, true));
+
+	XMFLOAT3 camera(700, 0, 900);
+	XMFLOAT3 directions[] = { XMFLOAT3(1, -0.2f, 0.3f), XMFLOAT3(-0.5f, -1, -0.5f), XMFLOAT3(0, 0.1f, 1) };
+	for (XMFLOAT3 direction : directions)
+	{
+		XMFLOAT4X4 view, projection;
+		XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&camera), XMLoadFloat3(&direction), XMVectorSet(0, 1, 0, 0)));
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 5000.0f));
+		Frustum frustum = Frustum::FromViewProjection(view, projection);
+
+		std::vector<TerrainNode> all, culled;
+		terrain.Select(Everything(), camera, all);
+		terrain.Select(frustum, camera, culled);
+		CHECK(!culled.empty());
+		CHECK(culled.size() < all.size());
+
+		unsigned int extra = 0, droppedInView = 0;
+		for (const TerrainNode& node : culled)
+		{
+			if (std::none_of(all.begin(), all.end(), [&](const TerrainNode& n) { return SameNode(n, node); }))
+				extra++;
+		}
+
+		for (const TerrainNode& node : all)
+		{
+			if (std::any_of(culled.begin(), culled.end(), [&](const TerrainNode& n) { return SameNode(n, node); }))
+				continue;
+
+			// Just the quarter, for a node drawn as one
+			float x0 = node.x, z0 = node.z, size = node.size;
+			if (node.quadrant != TERRAIN_WHOLE_NODE)
+			{
+				size *= 0.5f;
+				x0 += (node.quadrant & 1) * size;
+				z0 += (node.quadrant >> 1) * size;
+			}
+
+			bool outside = false;
+			for (const XMFLOAT4& p : frustum.planes)
+			{
+				bool allBehind = true;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					float x = x0 + (corner & 1 ? size : 0);
+					float z = z0 + (corner & 2 ? size : 0);
+					if (p.x * x + p.z * z + p.w >= 0.01f)
+						allBehind = false;
+				}
+				outside |= allBehind;
+			}
+			if (!outside)
+				droppedInView++;
+		}
+
+		CHECK(extra == 0);
+		CHECK(droppedInView == 0);
+	}
+}
+
+int main()
+{
+	TestCreate();
+	TestFixedCameras();
+	TestCulling();
+
+	if (failures > 0)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("All Terrain tests passed\n");
+	return 0;
+}
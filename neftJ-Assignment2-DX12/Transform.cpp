@@ -1,136 +1,137 @@
 #include "Transform.h"
+#include "TransformStore.h"
 
 using namespace DirectX;
 
 Transform::Transform()
 {
-	// Start with an identity matrix and basic transform data
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
+	// Start with basic transform data (an identity matrix)
+	id = TransformStore::GetInstance().Allocate();
+}
+
+Transform::Transform(const Transform& other)
+{
+	id = TransformStore::GetInstance().Allocate(other.id);
+}
 
-	position = XMFLOAT3(0, 0, 0);
-	pitchYawRoll = XMFLOAT3(0, 0, 0);
-	scale = XMFLOAT3(1, 1, 1);
+Transform& Transform::operator=(const Transform& other)
+{
+	if (this != &other)
+	{
+		TransformStore& store = TransformStore::GetInstance();
+		store.SetPosition(id, store.GetPosition(other.id));
+		store.SetRotation(id, store.GetRotation(other.id));
+		store.SetScale(id, store.GetScale(other.id));
+	}
 
-	// No need to recalc yet
-	matricesDirty = false;
+	return *this;
+}
+
+Transform::~Transform()
+{
+	TransformStore::GetInstance().Free(id);
 }
 
 void Transform::MoveAbsolute(float x, float y, float z)
 {
-	position.x += x;
-	position.y += y;
-	position.z += z;
-	matricesDirty = true;
+	XMFLOAT3 position = GetPosition();
+	SetPosition(position.x + x, position.y + y, position.z + z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	// Create a direction vector from the params
-	// and a rotation quaternion
-	XMVECTOR movement = XMVectorSet(x, y, z, 0);
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-
-	// Rotate the movement by the quaternion
-	XMVECTOR dir = XMVector3Rotate(movement, rotQuat);
+	// Rotating the movement is just a sum of the rotated axes
+	XMFLOAT3 right = GetRight();
+	XMFLOAT3 up = GetUp();
+	XMFLOAT3 forward = GetForward();
+	XMVECTOR dir =
+		XMLoadFloat3(&right) * x +
+		XMLoadFloat3(&up) * y +
+		XMLoadFloat3(&forward) * z;
 
 	// Add and store, and invalidate the matrices
+	XMFLOAT3 position = GetPosition();
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + dir);
-	matricesDirty = true;
+	SetPosition(position);
 }
 
 void Transform::Rotate(float p, float y, float r)
 {
-	pitchYawRoll.x += p;
-	pitchYawRoll.y += y;
-	pitchYawRoll.z += r;
-	matricesDirty = true;
+	TransformStore::GetInstance().Rotate(id, p, y, r);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
-	scale.x *= x;
-	scale.y *= y;
-	scale.z *= z;
-	matricesDirty = true;
+	XMFLOAT3 scale = GetScale();
+	SetScale(scale.x * x, scale.y * y, scale.z * z);
 }
 
 void Transform::SetPosition(float x, float y, float z)
 {
-	position.x = x;
-	position.y = y;
-	position.z = z;
-	matricesDirty = true;
+	SetPosition(XMFLOAT3(x, y, z));
 }
 
 void Transform::SetPosition(XMFLOAT3 newPos)
 {
-	position = newPos;
+	TransformStore::GetInstance().SetPosition(id, newPos);
 }
 
 void Transform::SetRotation(float p, float y, float r)
 {
-	pitchYawRoll.x = p;
-	pitchYawRoll.y = y;
-	pitchYawRoll.z = r;
-	matricesDirty = true;
+	SetRotation(XMFLOAT3(p, y, r));
 }
 
 void Transform::SetRotation(XMFLOAT3 newRot)
 {
-	pitchYawRoll = newRot;
+	TransformStore::GetInstance().SetPitchYawRoll(id, newRot);
+}
+
+void Transform::SetRotation(XMFLOAT4 quaternion)
+{
+	TransformStore::GetInstance().SetRotation(id, quaternion);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	scale.x = x;
-	scale.y = y;
-	scale.z = z;
-	matricesDirty = true;
+	SetScale(XMFLOAT3(x, y, z));
 }
 
 void Transform::SetScale(XMFLOAT3 newScale)
 {
-	scale = newScale;
+	TransformStore::GetInstance().SetScale(id, newScale);
 }
 
-DirectX::XMFLOAT3 Transform::GetPosition() { return position; }
-
-DirectX::XMFLOAT3 Transform::GetPitchYawRoll() { return pitchYawRoll; }
-
-DirectX::XMFLOAT3 Transform::GetScale() { return scale; }
-
-
-DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
+void Transform::SetParent(Transform* parent)
 {
-	UpdateMatrices();
-	return worldMatrix;
+	TransformStore::GetInstance().SetParent(id, parent ? parent->id : TRANSFORM_NO_PARENT);
 }
 
-DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
+bool Transform::HasParent()
 {
-	UpdateMatrices();
-	return worldMatrix;
+	return TransformStore::GetInstance().GetParent(id) != TRANSFORM_NO_PARENT;
 }
 
-void Transform::UpdateMatrices()
-{
-	// Are the matrices out of date (dirty)?
-	if (matricesDirty)
-	{
-		// Create the three transformation pieces
-		XMMATRIX trans = XMMatrixTranslationFromVector(XMLoadFloat3(&position));
-		XMMATRIX rot = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-		XMMATRIX sc = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
+DirectX::XMFLOAT3 Transform::GetPosition() { return TransformStore::GetInstance().GetPosition(id); }
 
-		// Combine and store the world
-		XMMATRIX wm = sc * rot * trans;
-		XMStoreFloat4x4(&worldMatrix, wm);
+DirectX::XMFLOAT4 Transform::GetRotation() { return TransformStore::GetInstance().GetRotation(id); }
 
-		// Invert and transpose, too
-		XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(wm)));
+DirectX::XMFLOAT3 Transform::GetPitchYawRoll() { return TransformStore::GetInstance().GetPitchYawRoll(id); }
 
-		// All set
-		matricesDirty = false;
-	}
+DirectX::XMFLOAT3 Transform::GetScale() { return TransformStore::GetInstance().GetScale(id); }
+
+DirectX::XMFLOAT3 Transform::GetRight() { return TransformStore::GetInstance().GetRight(id); }
+
+DirectX::XMFLOAT3 Transform::GetUp() { return TransformStore::GetInstance().GetUp(id); }
+
+DirectX::XMFLOAT3 Transform::GetForward() { return TransformStore::GetInstance().GetForward(id); }
+
+
+const DirectX::XMFLOAT4X4& Transform::GetWorldMatrix()
+{
+	return TransformStore::GetInstance().GetWorldMatrix(id);
+}
+
+const DirectX::XMFLOAT4X4& Transform::GetWorldInverseTransposeMatrix()
+{
+	return TransformStore::GetInstance().GetWorldInverseTransposeMatrix(id);
 }
\ No newline at end of file
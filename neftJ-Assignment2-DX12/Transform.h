@@ -1,11 +1,20 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <stdint.h>
 
+// --------------------------------------------------------
+// A handle to one transform in the TransformStore, which
+// holds the actual data and builds the matrices in batches.
+// Copying a Transform copies its data into a new slot.
+// --------------------------------------------------------
 class Transform
 {
 public:
 	Transform();
+	Transform(const Transform& other);
+	Transform& operator=(const Transform& other);
+	~Transform();
 
 	void MoveAbsolute(float x, float y, float z);
 	void MoveRelative(float x, float y, float z);
@@ -16,27 +25,32 @@ public:
 	void SetPosition(DirectX::XMFLOAT3 newPos);
 	void SetRotation(float p, float y, float r);
 	void SetRotation(DirectX::XMFLOAT3 newRot);
+	void SetRotation(DirectX::XMFLOAT4 quaternion);
 	void SetScale(float x, float y, float z);
 	void SetScale(DirectX::XMFLOAT3 newScale);
 
+	// Position, rotation and scale are relative to the parent, if there is one
+	void SetParent(Transform* parent);
+	bool HasParent();
+
 	DirectX::XMFLOAT3 GetPosition();
+	DirectX::XMFLOAT4 GetRotation();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
 	DirectX::XMFLOAT3 GetScale();
-	DirectX::XMFLOAT4X4 GetWorldMatrix();
-	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
+
+	// The rotated local axes, kept up to date by the store
+	DirectX::XMFLOAT3 GetRight();
+	DirectX::XMFLOAT3 GetUp();
+	DirectX::XMFLOAT3 GetForward();
+
+	// Only good until the next transform is created
+	const DirectX::XMFLOAT4X4& GetWorldMatrix();
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix();
+
+	uint32_t GetId() { return id; }
 
 private:
-	// Raw transformation data
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 pitchYawRoll;
-	DirectX::XMFLOAT3 scale;
-
-	// World matrix and inverse transpose of the world matrix
-	bool matricesDirty;
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
-
-	// Helper to update both matrices if necessary
-	void UpdateMatrices();
+	// Where this transform's data lives in the TransformStore
+	uint32_t id;
 };
 
@@ -0,0 +1,643 @@
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <thread>
+
+using namespace DirectX;
+
+// Singleton requirement
+TransformStore* TransformStore::instance;
+
+uint32_t TransformStore::Allocate()
+{
+	if (freeIds.empty())
+		Grow();
+
+	uint32_t id = freeIds.back();
+	freeIds.pop_back();
+
+	positionX[id] = 0; positionY[id] = 0; positionZ[id] = 0;
+	rotationX[id] = 0; rotationY[id] = 0; rotationZ[id] = 0; rotationW[id] = 1;
+	scaleX[id] = 1; scaleY[id] = 1; scaleZ[id] = 1;
+	MarkDirty(id);
+
+	return id;
+}
+
+uint32_t TransformStore::Allocate(uint32_t copyOf)
+{
+	uint32_t id = Allocate();
+
+	positionX[id] = positionX[copyOf]; positionY[id] = positionY[copyOf]; positionZ[id] = positionZ[copyOf];
+	rotationX[id] = rotationX[copyOf]; rotationY[id] = rotationY[copyOf]; rotationZ[id] = rotationZ[copyOf]; rotationW[id] = rotationW[copyOf];
+	scaleX[id] = scaleX[copyOf]; scaleY[id] = scaleY[copyOf]; scaleZ[id] = scaleZ[copyOf];
+
+	return id;
+}
+
+void TransformStore::Free(uint32_t id)
+{
+	// Children are left where they are, as roots
+	while (firstChildren[id] != TRANSFORM_NO_PARENT)
+		SetParent(firstChildren[id], TRANSFORM_NO_PARENT);
+	SetParent(id, TRANSFORM_NO_PARENT);
+
+	// Freed slots still get updated with their group, so put them back
+	// to identity (a zero scale or quaternion would divide by zero)
+	rotationX[id] = 0; rotationY[id] = 0; rotationZ[id] = 0; rotationW[id] = 1;
+	scaleX[id] = 1; scaleY[id] = 1; scaleZ[id] = 1;
+	freeIds.push_back(id);
+}
+
+// --------------------------------------------------------
+// Doubles the number of slots (at least one word of the
+// dirty bitset), so creating lots of transforms isn't
+// constantly copying everything
+// --------------------------------------------------------
+void TransformStore::Grow()
+{
+	size_t oldSize = positionX.size();
+	size_t newSize = std::max<size_t>(64, oldSize * 2);
+	Resize(newSize);
+
+	// Hand out the lowest ids first
+	for (size_t i = newSize; i > oldSize; i--)
+		freeIds.push_back((uint32_t)(i - 1));
+}
+
+void TransformStore::Trim()
+{
+	std::vector<bool> free(positionX.size(), false);
+	for (uint32_t id : freeIds)
+		free[id] = true;
+
+	size_t newSize = positionX.size();
+	while (newSize > 0 && free[newSize - 1])
+		newSize--;
+	newSize = (newSize + 63) / 64 * 64;
+	if (newSize == positionX.size())
+		return;
+
+	freeIds.erase(std::remove_if(freeIds.begin(), freeIds.end(), [newSize](uint32_t id) { return id >= newSize; }), freeIds.end());
+	Resize(newSize);
+
+	for (std::vector<float>* a : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ,
+		&rightX, &rightY, &rightZ, &upX, &upY, &upZ, &forwardX, &forwardY, &forwardZ })
+		a->shrink_to_fit();
+	for (std::vector<XMFLOAT4X4>* a : { &worldMatrices, &worldInverseTransposeMatrices, &localMatrices, &localInverseTransposeMatrices })
+		a->shrink_to_fit();
+	for (std::vector<uint32_t>* a : { &parents, &firstChildren, &nextSiblings, &previousSiblings, &depths, &levelIndices, &freeIds })
+		a->shrink_to_fit();
+	worldChanged.shrink_to_fit();
+}
+
+// --------------------------------------------------------
+// Sets the length of every array (a multiple of 64), with
+// new slots holding identity transforms
+// --------------------------------------------------------
+void TransformStore::Resize(size_t newSize)
+{
+	for (std::vector<float>* a : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ })
+		a->resize(newSize, 0.0f);
+	for (std::vector<float>* a : { &rotationW, &scaleX, &scaleY, &scaleZ })
+		a->resize(newSize, 1.0f);
+
+	// Identity axes
+	for (std::vector<float>* a : { &rightY, &rightZ, &upX, &upZ, &forwardX, &forwardY })
+		a->resize(newSize, 0.0f);
+	for (std::vector<float>* a : { &rightX, &upY, &forwardZ })
+		a->resize(newSize, 1.0f);
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	for (std::vector<XMFLOAT4X4>* a : { &worldMatrices, &worldInverseTransposeMatrices, &localMatrices, &localInverseTransposeMatrices })
+		a->resize(newSize, identity);
+
+	for (std::vector<uint32_t>* a : { &parents, &firstChildren, &nextSiblings, &previousSiblings })
+		a->resize(newSize, TRANSFORM_NO_PARENT);
+	depths.resize(newSize, 0);
+	levelIndices.resize(newSize, 0);
+	worldChanged.resize(newSize, 0);
+
+	// Atomics can't be moved, so the bitset is copied over by hand
+	std::vector<std::atomic<uint64_t>> newDirty(newSize / 64);
+	for (size_t w = 0; w < newDirty.size(); w++)
+		newDirty[w].store(w < dirty.size() ? dirty[w].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+	dirty.swap(newDirty);
+}
+
+XMFLOAT3 TransformStore::GetPosition(uint32_t id) { return XMFLOAT3(positionX[id], positionY[id], positionZ[id]); }
+
+XMFLOAT4 TransformStore::GetRotation(uint32_t id) { return XMFLOAT4(rotationX[id], rotationY[id], rotationZ[id], rotationW[id]); }
+
+XMFLOAT3 TransformStore::GetScale(uint32_t id) { return XMFLOAT3(scaleX[id], scaleY[id], scaleZ[id]); }
+
+void TransformStore::SetPosition(uint32_t id, XMFLOAT3 position)
+{
+	positionX[id] = position.x;
+	positionY[id] = position.y;
+	positionZ[id] = position.z;
+	MarkDirty(id);
+}
+
+void TransformStore::SetRotation(uint32_t id, XMFLOAT4 quaternion)
+{
+	rotationX[id] = quaternion.x;
+	rotationY[id] = quaternion.y;
+	rotationZ[id] = quaternion.z;
+	rotationW[id] = quaternion.w;
+	MarkDirty(id);
+}
+
+// --------------------------------------------------------
+// Euler angles in the same convention as the rest of
+// DirectXMath (roll, then pitch, then yaw)
+// --------------------------------------------------------
+XMFLOAT3 TransformStore::GetPitchYawRoll(uint32_t id)
+{
+	float x = rotationX[id], y = rotationY[id], z = rotationZ[id], w = rotationW[id];
+
+	// The matrix elements that the angles can be read back from
+	float m01 = 2 * (x * y + z * w);
+	float m11 = 1 - 2 * (x * x + z * z);
+	float m20 = 2 * (x * z + y * w);
+	float m21 = 2 * (y * z - x * w);
+	float m22 = 1 - 2 * (x * x + y * y);
+
+	float pitch = asinf(std::max(-1.0f, std::min(1.0f, -m21)));
+	if (fabsf(m21) < 0.99999f)
+		return XMFLOAT3(pitch, atan2f(m20, m22), atan2f(m01, m11));
+
+	// Straight up or down, where yaw and roll are the same axis, so it's all yaw
+	float m00 = 1 - 2 * (y * y + z * z);
+	float m02 = 2 * (x * z - y * w);
+	return XMFLOAT3(pitch, atan2f(-m02, m00), 0.0f);
+}
+
+void TransformStore::SetPitchYawRoll(uint32_t id, XMFLOAT3 pitchYawRoll)
+{
+	XMFLOAT4 quaternion;
+	XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll)));
+	SetRotation(id, quaternion);
+}
+
+// --------------------------------------------------------
+// Pitch and roll turn around the local axes and yaw around
+// the parent's up, which is exactly the same as adding to
+// the Euler angles as long as there's no roll
+// --------------------------------------------------------
+void TransformStore::Rotate(uint32_t id, float pitch, float yaw, float roll)
+{
+	XMVECTOR q = XMVectorSet(rotationX[id], rotationY[id], rotationZ[id], rotationW[id]);
+
+	if (pitch != 0 || roll != 0)
+		q = XMQuaternionMultiply(XMQuaternionRotationRollPitchYaw(pitch, 0, roll), q);
+	if (yaw != 0)
+		q = XMQuaternionMultiply(q, XMQuaternionRotationNormal(XMVectorSet(0, 1, 0, 0), yaw));
+
+	// Keep it unit length as the small errors add up
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionNormalize(q));
+	SetRotation(id, rotation);
+}
+
+XMFLOAT3 TransformStore::GetRight(uint32_t id)
+{
+	RebuildGroupIfDirty(id);
+	return XMFLOAT3(rightX[id], rightY[id], rightZ[id]);
+}
+
+XMFLOAT3 TransformStore::GetUp(uint32_t id)
+{
+	RebuildGroupIfDirty(id);
+	return XMFLOAT3(upX[id], upY[id], upZ[id]);
+}
+
+XMFLOAT3 TransformStore::GetForward(uint32_t id)
+{
+	RebuildGroupIfDirty(id);
+	return XMFLOAT3(forwardX[id], forwardY[id], forwardZ[id]);
+}
+
+void TransformStore::SetScale(uint32_t id, XMFLOAT3 scale)
+{
+	scaleX[id] = scale.x;
+	scaleY[id] = scale.y;
+	scaleZ[id] = scale.z;
+	MarkDirty(id);
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldMatrix(uint32_t id)
+{
+	if (parents[id] == TRANSFORM_NO_PARENT)
+		RebuildGroupIfDirty(id);
+	else if (ChainOutOfDate(id))
+		UpdateChain(id);
+
+	return worldMatrices[id];
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldInverseTransposeMatrix(uint32_t id)
+{
+	// Both matrices are always built together
+	GetWorldMatrix(id);
+	return worldInverseTransposeMatrices[id];
+}
+
+unsigned int TransformStore::GetDirtyCount()
+{
+	unsigned int count = 0;
+	for (const std::atomic<uint64_t>& word : dirty)
+		count += (unsigned int)std::bitset<64>(word.load(std::memory_order_relaxed)).count();
+	return count;
+}
+
+void TransformStore::UpdateDirty(bool allowThreads)
+{
+	unsigned int cores = allowThreads ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+
+	// Runs work(first, last) over [0, count), split between threads if it's big enough
+	auto runSplit = [cores](size_t count, size_t work, auto&& job)
+	{
+		if (cores == 1 || work < TRANSFORM_PARALLEL_MIN)
+		{
+			job(0, count);
+			return;
+		}
+
+		std::vector<std::future<void>> jobs;
+		size_t perJob = (count + cores - 1) / cores;
+		for (size_t first = perJob; first < count; first += perJob)
+		{
+			size_t last = std::min(first + perJob, count);
+			jobs.push_back(std::async(std::launch::async, [&job, first, last]() { job(first, last); }));
+		}
+
+		job(0, std::min(perJob, count));
+		for (auto& j : jobs)
+			j.get();
+	};
+
+	// Local (or root world) matrices first.  Words never share
+	// a group, so each thread gets its own range of them.
+	runSplit(dirty.size(), GetDirtyCount(),
+		[this](size_t first, size_t last) { UpdateWords(first, last); });
+
+	// Then down the hierarchy one level at a time, where every
+	// transform's parent is already up to date
+	for (const std::vector<uint32_t>& level : levels)
+	{
+		runSplit(level.size(), level.size(),
+			[this, &level](size_t first, size_t last) { UpdateLevel(level, first, last); });
+	}
+
+	std::fill(worldChanged.begin(), worldChanged.end(), (uint8_t)0);
+}
+
+void TransformStore::UpdateWords(size_t firstWord, size_t lastWord)
+{
+	for (size_t w = firstWord; w < lastWord; w++)
+	{
+		uint64_t bits = dirty[w].load(std::memory_order_relaxed);
+		if (!bits)
+			continue;
+
+		for (uint32_t group = 0; group < 64; group += 4)
+		{
+			if ((bits >> group) & 0xF)
+				UpdateGroup((uint32_t)(w * 64) + group);
+		}
+
+		// Remember what changed for the hierarchy pass
+		for (uint32_t bit = 0; bit < 64; bit++)
+		{
+			if ((bits >> bit) & 1)
+				worldChanged[w * 64 + bit] = 1;
+		}
+
+		dirty[w].store(0, std::memory_order_relaxed);
+	}
+}
+
+// --------------------------------------------------------
+// The lazy version of UpdateWords() for a single transform
+// --------------------------------------------------------
+void TransformStore::RebuildGroupIfDirty(uint32_t id)
+{
+	std::atomic<uint64_t>& word = dirty[id / 64];
+	uint32_t shift = id % 64 & ~3u;
+	uint64_t bits = (word.load(std::memory_order_relaxed) >> shift) & 0xF;
+	if (!bits)
+		return;
+
+	UpdateGroup(id & ~3u);
+	for (uint32_t lane = 0; lane < 4; lane++)
+	{
+		if ((bits >> lane) & 1)
+			worldChanged[(id & ~3u) + lane] = 1;
+	}
+
+	word.fetch_and(~(0xFull << shift), std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------
+// Builds both matrices for the four transforms starting at
+// first.  Each XMVECTOR holds one matrix element (or input)
+// for all four, so this is the same math as
+// scale * rotation * translation done one lane per transform.
+// --------------------------------------------------------
+void TransformStore::UpdateGroup(uint32_t first)
+{
+	auto load = [first](std::vector<float>& a) { return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&a[first])); };
+
+	XMVECTOR px = load(positionX), py = load(positionY), pz = load(positionZ);
+	XMVECTOR sx = load(scaleX), sy = load(scaleY), sz = load(scaleZ);
+	XMVECTOR qx = load(rotationX), qy = load(rotationY), qz = load(rotationZ), qw = load(rotationW);
+
+	// Same rotation as XMMatrixRotationQuaternion
+	XMVECTOR two = XMVectorReplicate(2.0f);
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR xx = qx * qx * two, yy = qy * qy * two, zz = qz * qz * two;
+	XMVECTOR xy = qx * qy * two, xz = qx * qz * two, yz = qy * qz * two;
+	XMVECTOR xw = qx * qw * two, yw = qy * qw * two, zw = qz * qw * two;
+	XMVECTOR rot[3][3] = {
+		{ one - yy - zz,	xy + zw,		xz - yw },
+		{ xy - zw,			one - xx - zz,	yz + xw },
+		{ xz + yw,			yz - xw,		one - xx - yy } };
+
+	// The rows are the rotated axes
+	auto store = [first](std::vector<float>& a, FXMVECTOR v) { XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&a[first]), v); };
+	store(rightX, rot[0][0]); store(rightY, rot[0][1]); store(rightZ, rot[0][2]);
+	store(upX, rot[1][0]); store(upY, rot[1][1]); store(upZ, rot[1][2]);
+	store(forwardX, rot[2][0]); store(forwardY, rot[2][1]); store(forwardZ, rot[2][2]);
+
+	// Uniform scale (the common case) only needs one reciprocal
+	XMVECTOR invScale[3];
+	XMVECTOR uniform = XMVectorAndInt(XMVectorEqual(sx, sy), XMVectorEqual(sy, sz));
+	if (XMVector4EqualInt(uniform, XMVectorTrueInt()))
+	{
+		invScale[0] = invScale[1] = invScale[2] = XMVectorReciprocal(sx);
+	}
+	else
+	{
+		invScale[0] = XMVectorReciprocal(sx);
+		invScale[1] = XMVectorReciprocal(sy);
+		invScale[2] = XMVectorReciprocal(sz);
+	}
+	XMVECTOR scale[3] = { sx, sy, sz };
+
+	// World rows are the scaled rotation rows and then the position.  Since the
+	// rotation is orthonormal, the inverse transpose's rows are the rotation rows
+	// divided by the scale, with the inverse translation down the last column.
+	XMVECTOR zero = XMVectorZero();
+	XMMATRIX world[4];
+	XMMATRIX inverseTranspose[4];
+	for (int i = 0; i < 3; i++)
+	{
+		world[i] = XMMATRIX(rot[i][0] * scale[i], rot[i][1] * scale[i], rot[i][2] * scale[i], zero);
+
+		XMVECTOR translation = -(px * rot[i][0] + py * rot[i][1] + pz * rot[i][2]) * invScale[i];
+		inverseTranspose[i] = XMMATRIX(rot[i][0] * invScale[i], rot[i][1] * invScale[i], rot[i][2] * invScale[i], translation);
+	}
+	world[3] = XMMATRIX(px, py, pz, one);
+	inverseTranspose[3] = XMMATRIX(zero, zero, zero, one);
+
+	// Children's matrices are only local, so they go to the local arrays
+	XMFLOAT4X4* worldTargets[4];
+	XMFLOAT4X4* inverseTransposeTargets[4];
+	for (uint32_t t = 0; t < 4; t++)
+	{
+		bool child = parents[first + t] != TRANSFORM_NO_PARENT;
+		worldTargets[t] = child ? &localMatrices[first + t] : &worldMatrices[first + t];
+		inverseTransposeTargets[t] = child ? &localInverseTransposeMatrices[first + t] : &worldInverseTransposeMatrices[first + t];
+	}
+
+	// Each of those is one row for all four transforms, so a transpose
+	// turns it into that row of each transform's own matrix
+	for (int row = 0; row < 4; row++)
+	{
+		XMMATRIX worldRow = XMMatrixTranspose(world[row]);
+		XMMATRIX inverseTransposeRow = XMMatrixTranspose(inverseTranspose[row]);
+		for (uint32_t t = 0; t < 4; t++)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(worldTargets[t]->m[row]), worldRow.r[t]);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(inverseTransposeTargets[t]->m[row]), inverseTransposeRow.r[t]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Moves a transform under a new parent (or makes it a root)
+// --------------------------------------------------------
+void TransformStore::SetParent(uint32_t id, uint32_t parent)
+{
+	if (parent == parents[id])
+		return;
+
+	// No cycles
+	for (uint32_t p = parent; p != TRANSFORM_NO_PARENT; p = parents[p])
+	{
+		if (p == id)
+			return;
+	}
+
+	// Unlink from the old parent's children
+	uint32_t oldParent = parents[id];
+	if (oldParent != TRANSFORM_NO_PARENT)
+	{
+		if (previousSiblings[id] != TRANSFORM_NO_PARENT)
+			nextSiblings[previousSiblings[id]] = nextSiblings[id];
+		else
+			firstChildren[oldParent] = nextSiblings[id];
+
+		if (nextSiblings[id] != TRANSFORM_NO_PARENT)
+			previousSiblings[nextSiblings[id]] = previousSiblings[id];
+	}
+	previousSiblings[id] = TRANSFORM_NO_PARENT;
+	nextSiblings[id] = TRANSFORM_NO_PARENT;
+
+	// Link in as the new parent's first child
+	parents[id] = parent;
+	if (parent != TRANSFORM_NO_PARENT)
+	{
+		nextSiblings[id] = firstChildren[parent];
+		if (nextSiblings[id] != TRANSFORM_NO_PARENT)
+			previousSiblings[nextSiblings[id]] = id;
+		firstChildren[parent] = id;
+	}
+
+	unsigned int depth = parent == TRANSFORM_NO_PARENT ? 0 : depths[parent] + 1;
+	if (depth != depths[id])
+		SetSubtreeDepth(id, depth);
+
+	// Its matrices now belong in the other (local or world) arrays
+	MarkDirty(id);
+}
+
+void TransformStore::AddToLevel(uint32_t id, unsigned int depth)
+{
+	if (levels.size() < depth)
+		levels.resize(depth);
+
+	levelIndices[id] = (uint32_t)levels[depth - 1].size();
+	levels[depth - 1].push_back(id);
+}
+
+void TransformStore::RemoveFromLevel(uint32_t id)
+{
+	// Swap with the last one, since order within a level doesn't matter
+	std::vector<uint32_t>& level = levels[depths[id] - 1];
+	uint32_t last = level.back();
+	level[levelIndices[id]] = last;
+	levelIndices[last] = levelIndices[id];
+	level.pop_back();
+
+	while (!levels.empty() && levels.back().empty())
+		levels.pop_back();
+}
+
+// --------------------------------------------------------
+// Moves a whole subtree to the levels for its new depth
+// (without recursion, since hierarchies can be very deep)
+// --------------------------------------------------------
+void TransformStore::SetSubtreeDepth(uint32_t id, unsigned int depth)
+{
+	std::vector<uint32_t> stack;
+	stack.push_back(id);
+	int delta = (int)depth - (int)depths[id];
+
+	while (!stack.empty())
+	{
+		uint32_t node = stack.back();
+		stack.pop_back();
+
+		if (depths[node] > 0)
+			RemoveFromLevel(node);
+		depths[node] = (uint32_t)((int)depths[node] + delta);
+		if (depths[node] > 0)
+			AddToLevel(node, depths[node]);
+
+		for (uint32_t c = firstChildren[node]; c != TRANSFORM_NO_PARENT; c = nextSiblings[c])
+			stack.push_back(c);
+	}
+}
+
+void TransformStore::UpdateLevel(const std::vector<uint32_t>& level, size_t first, size_t last)
+{
+	for (size_t i = first; i < last; i++)
+	{
+		uint32_t id = level[i];
+		if (worldChanged[id] || worldChanged[parents[id]])
+		{
+			UpdateWorldFromParent(id);
+			worldChanged[id] = 1;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// World is local then parent's world.  The inverse transpose
+// of a product is the product of the inverse transposes (in
+// the same order), so that one's just as cheap.
+// --------------------------------------------------------
+void TransformStore::UpdateWorldFromParent(uint32_t id)
+{
+	uint32_t parent = parents[id];
+
+	XMMATRIX world = XMMatrixMultiply(XMLoadFloat4x4(&localMatrices[id]), XMLoadFloat4x4(&worldMatrices[parent]));
+	XMStoreFloat4x4(&worldMatrices[id], world);
+
+	XMMATRIX inverseTranspose = XMMatrixMultiply(XMLoadFloat4x4(&localInverseTransposeMatrices[id]), XMLoadFloat4x4(&worldInverseTransposeMatrices[parent]));
+	XMStoreFloat4x4(&worldInverseTransposeMatrices[id], inverseTranspose);
+}
+
+// --------------------------------------------------------
+// True if the transform or anything above it has changed
+// since the last update
+// --------------------------------------------------------
+bool TransformStore::ChainOutOfDate(uint32_t id)
+{
+	for (uint32_t t = id; t != TRANSFORM_NO_PARENT; t = parents[t])
+	{
+		if (worldChanged[t] || (dirty[t / 64].load(std::memory_order_relaxed) >> (t % 64)) & 1)
+			return true;
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Brings one transform's world matrix up to date outside of
+// a full update, starting from its root.  Returns whether
+// the world matrix changed.
+// --------------------------------------------------------
+bool TransformStore::UpdateChain(uint32_t id)
+{
+	bool parentChanged = parents[id] != TRANSFORM_NO_PARENT && UpdateChain(parents[id]);
+
+	RebuildGroupIfDirty(id);
+	if (!parentChanged && !worldChanged[id])
+		return false;
+
+	// Roots already have their world matrix
+	if (parents[id] != TRANSFORM_NO_PARENT)
+		UpdateWorldFromParent(id);
+
+	// Anything below this that isn't updated now will be in the next full update
+	worldChanged[id] = 1;
+	return true;
+}
+
+TransformHierarchyTimings TransformStore::MeasureHierarchy(unsigned int numNodes, unsigned int childrenPerNode)
+{
+	TransformHierarchyTimings timings = {};
+	TransformStore store;
+
+	auto random = [](float min, float max) { return (float)rand() / RAND_MAX * (max - min) + min; };
+	auto now = []() { return std::chrono::high_resolution_clock::now(); };
+
+	// A tree with a fixed number of children per node, built breadth first
+	std::vector<uint32_t> ids(numNodes);
+	for (unsigned int i = 0; i < numNodes; i++)
+	{
+		ids[i] = store.Allocate();
+		store.SetPosition(ids[i], XMFLOAT3(random(-10, 10), random(-10, 10), random(-10, 10)));
+		store.SetPitchYawRoll(ids[i], XMFLOAT3(random(-3, 3), random(-3, 3), random(-3, 3)));
+		store.SetScale(ids[i], XMFLOAT3(random(0.9f, 1.1f), random(0.9f, 1.1f), random(0.9f, 1.1f)));
+		if (i > 0)
+			store.SetParent(ids[i], ids[(i - 1) / childrenPerNode]);
+	}
+	timings.levels = store.GetLevelCount();
+
+	auto start = now();
+	store.UpdateDirty(false);
+	timings.fullUpdateMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+	for (uint32_t id : ids)
+		store.MarkDirty(id);
+
+	start = now();
+	store.UpdateDirty(true);
+	timings.fullUpdateThreadedMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+	// A few things moving, as in a normal frame
+	for (unsigned int i = 0; i < numNodes / 100; i++)
+		store.MarkDirty(ids[rand() % numNodes]);
+
+	start = now();
+	store.UpdateDirty(true);
+	timings.partialUpdateMs = std::chrono::duration<double, std::milli>(now() - start).count();
+
+	// Random reparenting (attempts that would make a cycle are ignored)
+	const unsigned int reparents = 10000;
+	start = now();
+	for (unsigned int i = 0; i < reparents; i++)
+		store.SetParent(ids[rand() % numNodes], ids[rand() % numNodes]);
+	timings.reparentMicroseconds = std::chrono::duration<double, std::micro>(now() - start).count() / reparents;
+
+	return timings;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Below this many dirty transforms (or transforms in one level
+// of the hierarchy) an update stays on one thread
+#define TRANSFORM_PARALLEL_MIN	16384
+
+// Parent of a transform that isn't attached to anything
+#define TRANSFORM_NO_PARENT		0xFFFFFFFF
+
+// Timings from MeasureHierarchy()
+struct TransformHierarchyTimings
+{
+	unsigned int levels;
+	double fullUpdateMs;			// Everything dirty, one thread
+	double fullUpdateThreadedMs;	// Everything dirty, all cores
+	double partialUpdateMs;			// 1% of nodes dirty, all cores
+	double reparentMicroseconds;	// Average for a random reparent
+};
+
+// --------------------------------------------------------
+// Every Transform's data, kept as structure-of-arrays so
+// matrices can be rebuilt four at a time with SIMD.
+//
+// Positions, rotations (unit quaternions) and scales each
+// get one float array per component, and a bitset tracks
+// which transforms have changed since their matrices were
+// last built.  Matrices are rebuilt in groups of four (the
+// width of an XMVECTOR) without any trig.  The inverse
+// transpose comes straight from the rotation and scale, so
+// no general matrix inverse is ever needed, and the rotated
+// right/up/forward axes are saved along the way.
+//
+// Transforms can also have a parent, in which case their
+// data is relative to it.  Children are kept in one array
+// per depth (so the levels, in order, are a breadth-first
+// flattening of the hierarchy), and each level only depends
+// on the ones before it, so a level is updated in parallel.
+// A change only reaches the world matrices of the changed
+// transform's own subtree.
+//
+// Ids are stable for the life of a transform; references to
+// matrices are only good until the next Allocate().  Setting
+// the data of different transforms from several threads at
+// once is fine, but nothing else is thread safe.
+// --------------------------------------------------------
+class TransformStore
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformStore& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformStore();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformStore(TransformStore const&) = delete;
+	void operator=(TransformStore const&) = delete;
+
+private:
+	static TransformStore* instance;
+	TransformStore() {};
+#pragma endregion
+
+public:
+	// A new identity transform, or a copy of an existing one's data
+	// (without its place in the hierarchy)
+	uint32_t Allocate();
+	uint32_t Allocate(uint32_t copyOf);
+	void Free(uint32_t id);
+
+	// Raw transformation data (relative to the parent, if there is one)
+	DirectX::XMFLOAT3 GetPosition(uint32_t id);
+	DirectX::XMFLOAT4 GetRotation(uint32_t id);
+	DirectX::XMFLOAT3 GetScale(uint32_t id);
+	void SetPosition(uint32_t id, DirectX::XMFLOAT3 position);
+	void SetRotation(uint32_t id, DirectX::XMFLOAT4 quaternion);
+	void SetScale(uint32_t id, DirectX::XMFLOAT3 scale);
+
+	// Rotation as Euler angles, converted to and from the quaternion
+	DirectX::XMFLOAT3 GetPitchYawRoll(uint32_t id);
+	void SetPitchYawRoll(uint32_t id, DirectX::XMFLOAT3 pitchYawRoll);
+
+	// Pitch and roll turn around the transform's own axes, yaw around the parent's up
+	void Rotate(uint32_t id, float pitch, float yaw, float roll);
+
+	// Local axes after rotation (relative to the parent, like the rest)
+	DirectX::XMFLOAT3 GetRight(uint32_t id);
+	DirectX::XMFLOAT3 GetUp(uint32_t id);
+	DirectX::XMFLOAT3 GetForward(uint32_t id);
+
+	// Hierarchy.  Children keep their local data when moved, and a transform
+	// can't be parented to itself or to anything below it.  Moving a transform
+	// to a parent at the same depth is O(1); otherwise its subtree moves levels.
+	void SetParent(uint32_t id, uint32_t parent);
+	uint32_t GetParent(uint32_t id) { return parents[id]; }
+	uint32_t GetFirstChild(uint32_t id) { return firstChildren[id]; }
+	uint32_t GetNextSibling(uint32_t id) { return nextSiblings[id]; }
+	unsigned int GetDepth(uint32_t id) { return depths[id]; }
+	unsigned int GetLevelCount() { return (unsigned int)levels.size() + 1; }
+
+	// Rebuilds whatever's out of date between the transform and its root first
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(uint32_t id);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(uint32_t id);
+
+	// Rebuilds every out of date matrix, spread across all cores
+	// if there are enough of them (and threads are allowed)
+	void UpdateDirty(bool allowThreads = true);
+
+	unsigned int GetCount() { return (unsigned int)(positionX.size() - freeIds.size()); }
+	unsigned int GetDirtyCount();
+
+	// Gives back the memory of any free slots at the end, for
+	// after something like a benchmark frees a lot of transforms
+	void Trim();
+
+	// Builds a random hierarchy in a separate store and times updating it
+	static TransformHierarchyTimings MeasureHierarchy(unsigned int numNodes, unsigned int childrenPerNode);
+
+private:
+	// One array per component, always a multiple of 64 long so
+	// each word of the dirty bitset covers 16 whole groups.  The
+	// words are atomic since neighbouring transforms can be set
+	// from different threads (by ECS systems, for instance).
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<std::atomic<uint64_t>> dirty;
+
+	// Rotated axes, rebuilt along with the matrices
+	std::vector<float> rightX, rightY, rightZ;
+	std::vector<float> upX, upY, upZ;
+	std::vector<float> forwardX, forwardY, forwardZ;
+
+	// Children's own matrices go in the local arrays, and the world
+	// ones are built from them and the parent's during an update
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposeMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposeMatrices;
+
+	// Hierarchy links (TRANSFORM_NO_PARENT where there isn't one)
+	std::vector<uint32_t> parents, firstChildren, nextSiblings, previousSiblings;
+	std::vector<uint32_t> depths, levelIndices;
+
+	// Every transform with a parent, by depth (levels[0] is depth 1)
+	std::vector<std::vector<uint32_t>> levels;
+
+	// Whether a world matrix changed since the last full update, one byte
+	// each so the threads updating a level never share a write
+	std::vector<uint8_t> worldChanged;
+
+	std::vector<uint32_t> freeIds;
+
+	void MarkDirty(uint32_t id) { dirty[id / 64].fetch_or(1ull << (id % 64), std::memory_order_relaxed); }
+	void Grow();
+	void Resize(size_t newSize);
+	void UpdateWords(size_t firstWord, size_t lastWord);
+	void UpdateGroup(uint32_t first);
+	void RebuildGroupIfDirty(uint32_t id);
+
+	void AddToLevel(uint32_t id, unsigned int depth);
+	void RemoveFromLevel(uint32_t id);
+	void SetSubtreeDepth(uint32_t id, unsigned int depth);
+	void UpdateLevel(const std::vector<uint32_t>& level, size_t first, size_t last);
+	void UpdateWorldFromParent(uint32_t id);
+	bool ChainOutOfDate(uint32_t id);
+	bool UpdateChain(uint32_t id);
+};
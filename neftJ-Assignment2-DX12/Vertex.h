@@ -13,4 +13,14 @@ struct Vertex
 	DirectX::XMFLOAT2 UV; 
 	DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT3 Tangent;
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// Just the position, for passes that don't need anything else
+// (depth prepass, shadow maps).  Kept in its own stream next
+// to the full vertices.
+// --------------------------------------------------------
+struct VertexPosition
+{
+	DirectX::XMFLOAT3 Position;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <d3d12.h>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// How a single attribute is stored in the vertex buffer.
+// Each one knows its DXGI format and size, and how to write
+// a value into that form.
+// --------------------------------------------------------
+namespace VertexEncoding
+{
+	struct float3
+	{
+		static constexpr DXGI_FORMAT Format = DXGI_FORMAT_R32G32B32_FLOAT;
+		static constexpr unsigned int Size = 12;
+		static void Write(void* destination, DirectX::XMFLOAT3 value) { memcpy(destination, &value, Size); }
+	};
+
+	struct float2
+	{
+		static constexpr DXGI_FORMAT Format = DXGI_FORMAT_R32G32_FLOAT;
+		static constexpr unsigned int Size = 8;
+		static void Write(void* destination, DirectX::XMFLOAT2 value) { memcpy(destination, &value, Size); }
+	};
+
+	// Reads as a float2 in the shader
+	struct half2
+	{
+		static constexpr DXGI_FORMAT Format = DXGI_FORMAT_R16G16_FLOAT;
+		static constexpr unsigned int Size = 4;
+		static void Write(void* destination, DirectX::XMFLOAT2 value)
+		{
+			DirectX::PackedVector::HALF halves[2] = {
+				DirectX::PackedVector::XMConvertFloatToHalf(value.x),
+				DirectX::PackedVector::XMConvertFloatToHalf(value.y) };
+			memcpy(destination, halves, Size);
+		}
+	};
+
+	// A unit vector folded onto an octahedron and stored as two snorm16s.
+	// Reads as a float2 in the shader; see OctDecode() in CompactVS.hlsl.
+	struct oct16
+	{
+		static constexpr DXGI_FORMAT Format = DXGI_FORMAT_R16G16_SNORM;
+		static constexpr unsigned int Size = 4;
+		static void Write(void* destination, DirectX::XMFLOAT3 value)
+		{
+			float length = fabsf(value.x) + fabsf(value.y) + fabsf(value.z);
+			float x = length > 0 ? value.x / length : 0;
+			float y = length > 0 ? value.y / length : 0;
+
+			// The lower half folds over the diagonals
+			if (value.z < 0)
+			{
+				float foldedX = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+				float foldedY = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+				x = foldedX;
+				y = foldedY;
+			}
+
+			short packed[2] = {
+				(short)lroundf(fmaxf(-1.0f, fminf(1.0f, x)) * 32767.0f),
+				(short)lroundf(fmaxf(-1.0f, fminf(1.0f, y)) * 32767.0f) };
+			memcpy(destination, packed, Size);
+		}
+	};
+}
+
+// --------------------------------------------------------
+// The attributes a vertex can have, each with the encoding
+// it's stored with.  Using an encoding that can't hold the
+// attribute (like UV<float3>) won't compile.
+// --------------------------------------------------------
+template<typename EncodingType>
+struct Position
+{
+	using Encoding = EncodingType;
+	static constexpr const char* Semantic = "POSITION";
+	static void Write(void* destination, const Vertex& v) { Encoding::Write(destination, v.Position); }
+};
+
+template<typename EncodingType>
+struct UV
+{
+	using Encoding = EncodingType;
+	static constexpr const char* Semantic = "TEXCOORD";
+	static void Write(void* destination, const Vertex& v) { Encoding::Write(destination, v.UV); }
+};
+
+template<typename EncodingType>
+struct Normal
+{
+	using Encoding = EncodingType;
+	static constexpr const char* Semantic = "NORMAL";
+	static void Write(void* destination, const Vertex& v) { Encoding::Write(destination, v.Normal); }
+};
+
+template<typename EncodingType>
+struct Tangent
+{
+	using Encoding = EncodingType;
+	static constexpr const char* Semantic = "TANGENT";
+	static void Write(void* destination, const Vertex& v) { Encoding::Write(destination, v.Tangent); }
+};
+
+// --------------------------------------------------------
+// A vertex layout described as a list of attributes, in
+// order, tightly packed.  The stride and the input layout
+// for pipeline states are worked out at compile time, and
+// Pack() converts our full Vertex into the layout.
+// --------------------------------------------------------
+template<typename... Attributes>
+struct VertexFormat
+{
+	static constexpr unsigned int AttributeCount = sizeof...(Attributes);
+	static constexpr unsigned int Stride = (Attributes::Encoding::Size + ...);
+
+	static constexpr std::array<D3D12_INPUT_ELEMENT_DESC, AttributeCount> InputElements = []()
+	{
+		std::array<D3D12_INPUT_ELEMENT_DESC, AttributeCount> elements = {};
+		unsigned int index = 0;
+		unsigned int offset = 0;
+		((elements[index++] = { Attributes::Semantic, 0, Attributes::Encoding::Format, 0, offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			offset += Attributes::Encoding::Size), ...);
+		return elements;
+	}();
+
+	template<unsigned int Index>
+	static constexpr unsigned int OffsetOf() { return InputElements[Index].AlignedByteOffset; }
+
+	static void Pack(const Vertex& source, void* destination)
+	{
+		unsigned char* out = (unsigned char*)destination;
+		((Attributes::Write(out, source), out += Attributes::Encoding::Size), ...);
+	}
+
+	static void Pack(const Vertex* source, unsigned int count, void* destination)
+	{
+		unsigned char* out = (unsigned char*)destination;
+		for (unsigned int i = 0; i < count; i++, out += Stride)
+			Pack(source[i], out);
+	}
+};
+
+// The layouts meshes are stored in (see GeometryPool's formats)
+using StandardVertexFormat = VertexFormat<Position<VertexEncoding::float3>, UV<VertexEncoding::float2>, Normal<VertexEncoding::float3>, Tangent<VertexEncoding::float3>>;
+using PositionVertexFormat = VertexFormat<Position<VertexEncoding::float3>>;
+using CompactVertexFormat = VertexFormat<Position<VertexEncoding::float3>, UV<VertexEncoding::half2>, Normal<VertexEncoding::oct16>, Tangent<VertexEncoding::oct16>>;
+
+// The structs that are copied straight into buffers have to agree with their formats
+static_assert(StandardVertexFormat::Stride == sizeof(Vertex), "Vertex doesn't match StandardVertexFormat");
+static_assert(StandardVertexFormat::OffsetOf<1>() == offsetof(Vertex, UV), "Vertex doesn't match StandardVertexFormat");
+static_assert(StandardVertexFormat::OffsetOf<2>() == offsetof(Vertex, Normal), "Vertex doesn't match StandardVertexFormat");
+static_assert(StandardVertexFormat::OffsetOf<3>() == offsetof(Vertex, Tangent), "Vertex doesn't match StandardVertexFormat");
+static_assert(PositionVertexFormat::Stride == sizeof(VertexPosition), "VertexPosition doesn't match PositionVertexFormat");
+
+// --------------------------------------------------------
+// Looks up a format's input layout by the name used for it
+// in pipeline state files ("vertexFormat")
+// --------------------------------------------------------
+inline bool GetVertexFormatInputLayout(std::string name, D3D12_INPUT_LAYOUT_DESC& layout)
+{
+	if (name == "standard") layout = { StandardVertexFormat::InputElements.data(), StandardVertexFormat::AttributeCount };
+	else if (name == "position") layout = { PositionVertexFormat::InputElements.data(), PositionVertexFormat::AttributeCount };
+	else if (name == "compact") layout = { CompactVertexFormat::InputElements.data(), CompactVertexFormat::AttributeCount };
+	else return false;
+
+	return true;
+}
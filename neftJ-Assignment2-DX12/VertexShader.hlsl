@@ -59,8 +59,10 @@ VertexToPixel main( VertexShaderInput input )
 	// - Each of these components is then automatically divided by the W component, 
 	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
 	//   a perspective projection matrix, which we'll get to in the future).
-	matrix worldViewProj = mul(projection, mul(view, world));
-	output.screenPosition = mul(worldViewProj, float4(input.localPosition, 1.0f));
+	// precise to match the depth pre-pass bit for bit (see DepthOnlyVS)
+	precise matrix worldViewProj = mul(projection, mul(view, world));
+	precise float4 screenPosition = mul(worldViewProj, float4(input.localPosition, 1.0f));
+	output.screenPosition = screenPosition;
 
 	output.worldPos = mul(world, float4(input.localPosition, 1.0f)).xyz;
 
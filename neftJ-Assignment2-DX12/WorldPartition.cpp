@@ -0,0 +1,480 @@
+#include "WorldPartition.h"
+#include "Assets.h"
+#include "Components.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+
+#include "rapidjson/document.h"
+
+using namespace DirectX;
+
+// Singleton requirement
+WorldPartition* WorldPartition::instance;
+
+WorldPartition::WorldPartition()
+{
+	cellSize = 1;
+	origin = XMFLOAT2(0, 0);
+	minX = minZ = cellsX = cellsZ = 0;
+	loadRadius = WORLD_LOAD_RADIUS;
+	unloadRadius = WORLD_UNLOAD_RADIUS;
+	maxLoads = WORLD_MAX_LOADS;
+	activationBudgetMs = WORLD_ACTIVATION_MS;
+	bytesLoaded = 0;
+	windowBytes = 0;
+	bytesPerSecond = 0;
+	lastActivationMs = 0;
+}
+
+// Reads a whole file, false if it can't be opened
+static bool ReadFile(const std::string& path, std::string& content)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) return false;
+
+	std::error_code error;
+	std::uintmax_t size = std::filesystem::file_size(path, error);
+	if (error) return false;
+
+	content.assign((size_t)size, '\0');
+	file.read(content.data(), size);
+	return (bool)file;
+}
+
+bool WorldPartition::Open(std::string worldFile, std::shared_ptr<EntityManager> entities)
+{
+	Close();
+
+	std::string content;
+	if (!ReadFile(worldFile, content))
+		return false;
+
+	rapidjson::Document doc;
+	doc.Parse(content.c_str());
+	if (doc.HasParseError() || !doc.IsObject() ||
+		!doc.HasMember("cellSize") || !doc["cellSize"].IsNumber() || doc["cellSize"].GetFloat() <= 0 ||
+		!doc.HasMember("cells") || !doc["cells"].IsArray())
+		return false;
+
+	cellSize = doc["cellSize"].GetFloat();
+	origin = XMFLOAT2(0, 0);
+	if (doc.HasMember("origin") && doc["origin"].IsArray() && doc["origin"].Size() == 2 &&
+		doc["origin"][0].IsNumber() && doc["origin"][1].IsNumber())
+		origin = XMFLOAT2(doc["origin"][0].GetFloat(), doc["origin"][1].GetFloat());
+
+	// Cell manifests sit next to the world file
+	folder = std::filesystem::path(worldFile).parent_path().string();
+
+	for (const rapidjson::Value& c : doc["cells"].GetArray())
+	{
+		if (!c.IsObject() || !c.HasMember("x") || !c["x"].IsInt() || !c.HasMember("z") || !c["z"].IsInt() ||
+			!c.HasMember("file") || !c["file"].IsString())
+			continue;
+
+		std::unique_ptr<Cell> cell = std::make_unique<Cell>();
+		cell->x = c["x"].GetInt();
+		cell->z = c["z"].GetInt();
+		cell->file = c["file"].GetString();
+		cell->state = CellState::Unloaded;
+		cell->distance = 0;
+		cell->bytes = 0;
+		cell->activated = 0;
+		cells.push_back(std::move(cell));
+	}
+
+	// Grid lookup over the cells' bounds
+	if (!cells.empty())
+	{
+		int maxX = cells[0]->x, maxZ = cells[0]->z;
+		minX = maxX;
+		minZ = maxZ;
+		for (const std::unique_ptr<Cell>& cell : cells)
+		{
+			minX = std::min(minX, cell->x);
+			minZ = std::min(minZ, cell->z);
+			maxX = std::max(maxX, cell->x);
+			maxZ = std::max(maxZ, cell->z);
+		}
+		cellsX = maxX - minX + 1;
+		cellsZ = maxZ - minZ + 1;
+		grid.assign((size_t)cellsX * cellsZ, -1);
+		for (size_t i = 0; i < cells.size(); i++)
+			grid[(size_t)(cells[i]->z - minZ) * cellsX + (cells[i]->x - minX)] = (int)i;
+	}
+
+	this->entities = entities;
+	bytesLoaded = 0;
+	windowBytes = 0;
+	windowStart = std::chrono::steady_clock::now();
+	bytesPerSecond = 0;
+	lastActivationMs = 0;
+	return true;
+}
+
+void WorldPartition::Close()
+{
+	// Loading threads write to their cells, so they have to finish first
+	for (std::unique_ptr<Cell>& cell : cells)
+	{
+		if (cell->state == CellState::Loading)
+			cell->load.wait();
+		Unload(*cell);
+	}
+
+	cells.clear();
+	grid.clear();
+	minX = minZ = cellsX = cellsZ = 0;
+	meshRefs.clear();
+	materialRefs.clear();
+	entities.reset();
+}
+
+void WorldPartition::SetRadii(float loadRadius, float unloadRadius)
+{
+	// Cells have to load before they can be unloaded
+	this->loadRadius = loadRadius;
+	this->unloadRadius = std::max(loadRadius, unloadRadius);
+}
+
+void WorldPartition::Update(XMFLOAT3 cameraPosition)
+{
+	if (!entities)
+		return;
+
+	// Distance from the camera to each cell's square on the ground
+	for (std::unique_ptr<Cell>& cell : cells)
+	{
+		float left = origin.x + cell->x * cellSize;
+		float back = origin.y + cell->z * cellSize;
+		float dx = std::max(std::max(left - cameraPosition.x, 0.0f), cameraPosition.x - (left + cellSize));
+		float dz = std::max(std::max(back - cameraPosition.z, 0.0f), cameraPosition.z - (back + cellSize));
+		cell->distance = sqrtf(dx * dx + dz * dz);
+	}
+
+	// Pick up finished reads.  Those that are now out of range
+	// are dropped straight away below.
+	unsigned int loading = 0;
+	for (std::unique_ptr<Cell>& cell : cells)
+	{
+		if (cell->state != CellState::Loading)
+			continue;
+
+		if (cell->load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			loading++;
+			continue;
+		}
+
+		cell->state = cell->load.get() ? CellState::Loaded : CellState::Failed;
+		bytesLoaded += cell->bytes;
+		windowBytes += cell->bytes;
+	}
+
+	for (std::unique_ptr<Cell>& cell : cells)
+	{
+		if (cell->distance > unloadRadius &&
+			(cell->state == CellState::Loaded || cell->state == CellState::Activating || cell->state == CellState::Active))
+			Unload(*cell);
+	}
+
+	// Nearest cells are read first
+	std::vector<Cell*> waiting;
+	for (std::unique_ptr<Cell>& cell : cells)
+	{
+		if (cell->state == CellState::Unloaded && cell->distance <= loadRadius)
+			waiting.push_back(cell.get());
+	}
+	std::sort(waiting.begin(), waiting.end(), [](const Cell* a, const Cell* b) { return a->distance < b->distance; });
+	for (size_t i = 0; i < waiting.size() && loading < maxLoads; i++, loading++)
+		StartLoad(*waiting[i]);
+
+	// And the nearest are activated first, one entity at a time until
+	// the budget runs out (but always at least one, so it can't stall)
+	std::vector<Cell*> ready;
+	for (std::unique_ptr<Cell>& cell : cells)
+	{
+		if (cell->state == CellState::Loaded || cell->state == CellState::Activating)
+			ready.push_back(cell.get());
+	}
+	std::sort(ready.begin(), ready.end(), [](const Cell* a, const Cell* b) { return a->distance < b->distance; });
+
+	auto start = std::chrono::steady_clock::now();
+	auto elapsedMs = [&]() { return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+	bool overBudget = false;
+	for (Cell* cell : ready)
+	{
+		cell->state = CellState::Activating;
+		while (cell->activated < cell->cellEntities.size() && !overBudget)
+		{
+			Entity e;
+			if (CreateEntity(*cell, cell->cellEntities[cell->activated++], e))
+				cell->created.push_back(e);
+			overBudget = elapsedMs() >= activationBudgetMs;
+		}
+
+		// The manifest and mesh data aren't needed once everything in it exists
+		if (cell->activated == cell->cellEntities.size())
+		{
+			cell->state = CellState::Active;
+			std::vector<CellEntity>().swap(cell->cellEntities);
+			cell->meshData.clear();
+		}
+
+		if (overBudget)
+			break;
+	}
+	lastActivationMs = ready.empty() ? 0 : elapsedMs();
+
+	// Bandwidth is averaged over about a second
+	auto now = std::chrono::steady_clock::now();
+	double windowSeconds = std::chrono::duration<double>(now - windowStart).count();
+	if (windowSeconds >= 1.0)
+	{
+		bytesPerSecond = windowBytes / windowSeconds;
+		windowBytes = 0;
+		windowStart = now;
+	}
+}
+
+void WorldPartition::StartLoad(Cell& cell)
+{
+	cell.state = CellState::Loading;
+	cell.bytes = 0;
+	cell.activated = 0;
+	cell.cellEntities.clear();
+	cell.meshData.clear();
+
+	// Meshes a resident cell already holds won't need reading again
+	std::unordered_set<std::string> resident;
+	for (const auto& [name, ref] : meshRefs)
+		resident.insert(name);
+
+	std::string path = (std::filesystem::path(folder) / cell.file).string();
+	Cell* target = &cell;
+	cell.load = std::async(std::launch::async, [target, path, resident = std::move(resident)]()
+		{
+			std::string content;
+			if (!ReadFile(path, content))
+				return false;
+
+			target->bytes = content.size();
+			if (!ParseCell(content, target->cellEntities))
+				return false;
+
+			// Each new mesh once, however many entities use it
+			for (const CellEntity& e : target->cellEntities)
+			{
+				if (resident.count(e.mesh) || target->meshData.count(e.mesh))
+					continue;
+
+				CellMeshData& data = target->meshData[e.mesh];
+				if (!Assets::GetInstance().LoadMeshData(e.mesh, data.verts, data.indices))
+				{
+					data = CellMeshData();
+					continue;
+				}
+
+				// The mesh data is most of what a cell streams in, not the manifest
+				target->bytes += data.verts.size() * sizeof(Vertex) + data.indices.size() * sizeof(unsigned int);
+			}
+			return true;
+		});
+}
+
+void WorldPartition::Unload(Cell& cell)
+{
+	if (entities)
+	{
+		for (Entity e : cell.created)
+		{
+			if (entities->IsAlive(e))
+				entities->Destroy(e);
+		}
+	}
+
+	std::vector<Entity>().swap(cell.created);
+	std::vector<CellEntity>().swap(cell.cellEntities);
+	cell.meshData.clear();
+	ReleaseAssets(cell);
+	cell.activated = 0;
+	cell.state = CellState::Unloaded;
+}
+
+bool WorldPartition::CreateEntity(Cell& cell, const CellEntity& desc, Entity& entity)
+{
+	std::shared_ptr<Mesh> mesh = AcquireMesh(cell, desc.mesh);
+	std::shared_ptr<Material> material = AcquireMaterial(cell, desc.material);
+	if (!mesh || !material)
+		return false;
+
+	TransformStore& store = TransformStore::GetInstance();
+	uint32_t transform = store.Allocate();
+	store.SetPosition(transform, desc.position);
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(desc.rotation.x, desc.rotation.y, desc.rotation.z));
+	store.SetRotation(transform, rotation);
+	store.SetScale(transform, desc.scale);
+
+	entity = entities->Create(
+		TransformComponent{ transform },
+		MeshRendererComponent{ mesh.get(), material.get() });
+	return true;
+}
+
+// --------------------------------------------------------
+// Gets a mesh for one of the cell's entities, taking a
+// reference for the cell the first time it asks for it.
+// Meshes decoded by the loading thread only need their
+// buffers made here.
+// --------------------------------------------------------
+std::shared_ptr<Mesh> WorldPartition::AcquireMesh(Cell& cell, const std::string& name)
+{
+	auto held = cell.meshes.find(name);
+	if (held != cell.meshes.end())
+		return held->second;
+
+	Assets& assets = Assets::GetInstance();
+	bool loaded = assets.IsMeshLoaded(name);
+
+	std::shared_ptr<Mesh> mesh;
+	auto data = cell.meshData.find(name);
+	if (data != cell.meshData.end() && !data->second.verts.empty())
+		mesh = assets.CreateMeshFromData(name, data->second.verts, data->second.indices);
+	else
+		mesh = assets.GetMesh(name);
+	if (!mesh)
+		return 0;
+
+	AssetRef& ref = meshRefs.try_emplace(name, AssetRef{ 0, !loaded }).first->second;
+	ref.cells++;
+	cell.meshes[name] = mesh;
+	return mesh;
+}
+
+std::shared_ptr<Material> WorldPartition::AcquireMaterial(Cell& cell, const std::string& name)
+{
+	auto held = cell.materials.find(name);
+	if (held != cell.materials.end())
+		return held->second;
+
+	Assets& assets = Assets::GetInstance();
+	bool loaded = assets.IsMaterialLoaded(name);
+
+	std::shared_ptr<Material> material = assets.GetMaterial(name);
+	if (!material)
+		return 0;
+
+	AssetRef& ref = materialRefs.try_emplace(name, AssetRef{ 0, !loaded }).first->second;
+	ref.cells++;
+	cell.materials[name] = material;
+	return material;
+}
+
+// --------------------------------------------------------
+// Drops the cell's references, releasing anything streaming
+// loaded that no other cell is still holding.  The cell's
+// entities have to be gone first, as they point at these.
+// --------------------------------------------------------
+void WorldPartition::ReleaseAssets(Cell& cell)
+{
+	Assets& assets = Assets::GetInstance();
+
+	for (const auto& [name, mesh] : cell.meshes)
+	{
+		auto ref = meshRefs.find(name);
+		if (ref == meshRefs.end() || --ref->second.cells > 0)
+			continue;
+
+		if (ref->second.owned)
+			assets.ReleaseMesh(name);
+		meshRefs.erase(ref);
+	}
+
+	for (const auto& [name, material] : cell.materials)
+	{
+		auto ref = materialRefs.find(name);
+		if (ref == materialRefs.end() || --ref->second.cells > 0)
+			continue;
+
+		if (ref->second.owned)
+			assets.ReleaseMaterial(name);
+		materialRefs.erase(ref);
+	}
+
+	cell.meshes.clear();
+	cell.materials.clear();
+}
+
+bool WorldPartition::ParseCell(const std::string& json, std::vector<CellEntity>& cellEntities)
+{
+	rapidjson::Document doc;
+	doc.Parse(json.c_str(), json.size());
+	if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("entities") || !doc["entities"].IsArray())
+		return false;
+
+	// Three numbers, or the default if the member isn't there at all
+	auto readFloat3 = [](const rapidjson::Value& object, const char* name, XMFLOAT3 defaultValue, XMFLOAT3& value)
+	{
+		value = defaultValue;
+		if (!object.HasMember(name))
+			return true;
+
+		const rapidjson::Value& a = object[name];
+		if (!a.IsArray() || a.Size() != 3 || !a[0].IsNumber() || !a[1].IsNumber() || !a[2].IsNumber())
+			return false;
+
+		value = XMFLOAT3(a[0].GetFloat(), a[1].GetFloat(), a[2].GetFloat());
+		return true;
+	};
+
+	const rapidjson::Value& list = doc["entities"];
+	cellEntities.clear();
+	cellEntities.reserve(list.Size());
+	for (const rapidjson::Value& e : list.GetArray())
+	{
+		if (!e.IsObject() || !e.HasMember("mesh") || !e["mesh"].IsString() || !e.HasMember("material") || !e["material"].IsString())
+			return false;
+
+		CellEntity entity;
+		entity.mesh = e["mesh"].GetString();
+		entity.material = e["material"].GetString();
+		if (!readFloat3(e, "position", XMFLOAT3(0, 0, 0), entity.position) ||
+			!readFloat3(e, "rotation", XMFLOAT3(0, 0, 0), entity.rotation) ||
+			!readFloat3(e, "scale", XMFLOAT3(1, 1, 1), entity.scale))
+			return false;
+
+		cellEntities.push_back(entity);
+	}
+
+	return true;
+}
+
+CellState WorldPartition::GetCellState(int x, int z)
+{
+	x -= minX;
+	z -= minZ;
+	if (x < 0 || z < 0 || x >= cellsX || z >= cellsZ)
+		return CellState::Unloaded;
+
+	int cell = grid[(size_t)z * cellsX + x];
+	return cell < 0 ? CellState::Unloaded : cells[cell]->state;
+}
+
+unsigned int WorldPartition::GetCellCount(CellState state)
+{
+	unsigned int count = 0;
+	for (const std::unique_ptr<Cell>& cell : cells)
+		count += cell->state == state ? 1 : 0;
+	return count;
+}
+
+unsigned int WorldPartition::GetStreamedEntityCount()
+{
+	unsigned int count = 0;
+	for (const std::unique_ptr<Cell>& cell : cells)
+		count += (unsigned int)cell->created.size();
+	return count;
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <stdint.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EntityManager.h"
+#include "Vertex.h"
+
+class Mesh;
+class Material;
+
+// Default distances (from the camera to the nearest point of a cell,
+// on the ground plane) at which cells start loading and are unloaded.
+// Unloading further out than loading stops cells on the edge from
+// going back and forth.
+#define WORLD_LOAD_RADIUS		40.0f
+#define WORLD_UNLOAD_RADIUS		60.0f
+
+// Default number of cells reading from disk at once
+#define WORLD_MAX_LOADS			2
+
+// Default time each frame can spend turning loaded cells into entities
+#define WORLD_ACTIVATION_MS		2.0f
+
+// Where a cell is in being streamed in
+enum class CellState
+{
+	Unloaded,
+	Loading,	// Being read and parsed on another thread
+	Loaded,		// Parsed, waiting to be turned into entities
+	Activating,	// Some of its entities exist
+	Active,		// All of its entities exist
+	Failed		// Its manifest couldn't be read, so it isn't tried again
+};
+
+// One entity listed in a cell's manifest
+struct CellEntity
+{
+	std::string mesh;
+	std::string material;
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 rotation;	// Pitch, yaw and roll
+	DirectX::XMFLOAT3 scale;
+};
+
+// --------------------------------------------------------
+// Streams a world split into a grid of square cells in and
+// out around the camera.
+//
+// The world file gives the cell size, the grid's corner
+// and every cell that has something in it, and each cell
+// has its own manifest listing its entities (with their
+// meshes and materials by asset name):
+//
+//   world.json: { "cellSize": 20, "origin": [-80, -80],
+//     "cells": [ { "x": 0, "z": 0, "file": "cell_0_0.json" } ] }
+//
+//   cell_0_0.json: { "entities": [ { "mesh": "builtin:cube",
+//     "material": "woodMat", "position": [1, 0, 2],
+//     "rotation": [0, 0, 0], "scale": [1, 1, 1] } ] }
+//
+// Each frame, cells past the unload radius lose their
+// entities, and unloaded cells inside the load radius are
+// read and parsed on other threads, nearest first, a few
+// at a time.  The same threads read and decode the meshes
+// the manifest names (those no resident cell already
+// holds).  Parsed cells are then turned into entities on
+// the main thread (as GPU buffers and materials can only be
+// made there), nearest first, until the frame's activation
+// budget runs out.
+//
+// Each cell holds a reference to the meshes and materials
+// its entities use.  Once the last cell holding one unloads,
+// it's released from Assets again, unless it was already
+// loaded before any cell asked for it.
+// --------------------------------------------------------
+class WorldPartition
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static WorldPartition& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new WorldPartition();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	WorldPartition(WorldPartition const&) = delete;
+	void operator=(WorldPartition const&) = delete;
+
+private:
+	static WorldPartition* instance;
+	WorldPartition();
+#pragma endregion
+
+public:
+	// Reads the world file (closing any world that's already open)
+	bool Open(std::string worldFile, std::shared_ptr<EntityManager> entities);
+
+	// Waits for any reads and removes every streamed entity
+	void Close();
+
+	// Streams cells in and out for a camera at this position
+	void Update(DirectX::XMFLOAT3 cameraPosition);
+
+	void SetRadii(float loadRadius, float unloadRadius);
+	void SetMaxLoads(unsigned int maxLoads) { this->maxLoads = maxLoads; }
+	void SetActivationBudget(float ms) { activationBudgetMs = ms; }
+
+	// Reads a cell manifest's entities, false if it's not a valid one
+	static bool ParseCell(const std::string& json, std::vector<CellEntity>& cellEntities);
+
+	// For showing residency in the GUI
+	float GetCellSize() { return cellSize; }
+	int GetMinCellX() { return minX; }
+	int GetMinCellZ() { return minZ; }
+	int GetCellsX() { return cellsX; }
+	int GetCellsZ() { return cellsZ; }
+	CellState GetCellState(int x, int z);
+	unsigned int GetCellCount() { return (unsigned int)cells.size(); }
+	unsigned int GetCellCount(CellState state);
+	unsigned int GetStreamedEntityCount();
+
+	// Manifest bytes read over about the last second, and since Open()
+	double GetBytesPerSecond() { return bytesPerSecond; }
+	uint64_t GetBytesLoaded() { return bytesLoaded; }
+	float GetLastActivationMs() { return lastActivationMs; }
+
+	// Meshes and materials held by resident cells
+	unsigned int GetResidentMeshCount() { return (unsigned int)meshRefs.size(); }
+	unsigned int GetResidentMaterialCount() { return (unsigned int)materialRefs.size(); }
+
+private:
+	// Mesh data decoded by a loading thread (empty if it couldn't be
+	// read there, in which case it's loaded the usual way)
+	struct CellMeshData
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+	};
+
+	// How many cells hold an asset, and whether streaming loaded it
+	// (and so should release it)
+	struct AssetRef
+	{
+		unsigned int cells;
+		bool owned;
+	};
+
+	struct Cell
+	{
+		int x, z;
+		std::string file;
+		CellState state;
+		float distance;
+
+		// Filled in by the loading thread, which owns the cell
+		// until its future is ready
+		std::future<bool> load;
+		std::vector<CellEntity> cellEntities;
+		std::unordered_map<std::string, CellMeshData> meshData;
+		uint64_t bytes;
+
+		// How far through its manifest activation has got, and the
+		// entities made so far (missing meshes or materials are skipped)
+		size_t activated;
+		std::vector<Entity> created;
+
+		// The assets it holds a reference to, by name
+		std::unordered_map<std::string, std::shared_ptr<Mesh>> meshes;
+		std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+	};
+
+	std::shared_ptr<EntityManager> entities;
+	std::string folder;
+	float cellSize;
+	DirectX::XMFLOAT2 origin;
+
+	// Cells are never added or removed while a world is open, so
+	// loading threads can hold on to them
+	std::vector<std::unique_ptr<Cell>> cells;
+
+	// Grid lookup for the GUI (-1 where there's no cell)
+	int minX, minZ, cellsX, cellsZ;
+	std::vector<int> grid;
+
+	float loadRadius;
+	float unloadRadius;
+	unsigned int maxLoads;
+	float activationBudgetMs;
+
+	// Bandwidth over a window of about a second
+	uint64_t bytesLoaded;
+	uint64_t windowBytes;
+	std::chrono::steady_clock::time_point windowStart;
+	double bytesPerSecond;
+	float lastActivationMs;
+
+	std::unordered_map<std::string, AssetRef> meshRefs;
+	std::unordered_map<std::string, AssetRef> materialRefs;
+
+	void StartLoad(Cell& cell);
+	void Unload(Cell& cell);
+	bool CreateEntity(Cell& cell, const CellEntity& e, Entity& entity);
+	std::shared_ptr<Mesh> AcquireMesh(Cell& cell, const std::string& name);
+	std::shared_ptr<Material> AcquireMaterial(Cell& cell, const std::string& name);
+	void ReleaseAssets(Cell& cell);
+};